@@ -0,0 +1,276 @@
+#include "BuildManifest.h"
+#include "Fileio.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#define MANIFEST_VERSION 1
+
+const char * BuildManifest::s_textureManifest = "data\\generated\\texture_manifest.txt";
+
+/*
+================================
+BuildManifest::GetFileStamp
+	-size and last write time of a file. False if it doesnt exist.
+================================
+*/
+bool BuildManifest::GetFileStamp( const char * relativePath, fileStamp_t & stamp ) {
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if ( GetFileAttributesExA( fullPath, GetFileExInfoStandard, &attributes ) == 0 ) {
+		return false;
+	}
+	stamp.size = ( ( uint64_t )attributes.nFileSizeHigh << 32 ) | attributes.nFileSizeLow;
+	stamp.writeTime = ( ( uint64_t )attributes.ftLastWriteTime.dwHighDateTime << 32 ) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+/*
+================================
+StampsMatch
+================================
+*/
+static bool StampsMatch( const fileStamp_t & a, const fileStamp_t & b ) {
+	return a.size == b.size && a.writeTime == b.writeTime;
+}
+
+/*
+================================
+BuildManifest::HashBytes
+	-64 bit FNV-1a. Pass the previous result as hash to continue a hash over several buffers.
+================================
+*/
+uint64_t BuildManifest::HashBytes( const void * data, const size_t size, const uint64_t hash ) {
+	const unsigned char * bytes = ( const unsigned char * )data;
+	uint64_t result = hash;
+	for ( size_t i = 0; i < size; i++ ) {
+		result ^= bytes[i];
+		result *= 0x100000001b3ULL;
+	}
+	return result;
+}
+
+/*
+================================
+BuildManifest::HashFile
+================================
+*/
+bool BuildManifest::HashFile( const char * relativePath, uint64_t & hash ) {
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+
+	FILE * fs = fopen( fullPath, "rb" );
+	if ( !fs ) {
+		return false;
+	}
+	unsigned char buffer[ 64 * 1024 ];
+	hash = FNV_OFFSET_BASIS;
+	size_t readSize = 0;
+	while ( ( readSize = fread( buffer, 1, sizeof( buffer ), fs ) ) > 0 ) {
+		hash = HashBytes( buffer, readSize, hash );
+	}
+	const bool success = ( ferror( fs ) == 0 );
+	fclose( fs );
+	return success;
+}
+
+/*
+================================
+BuildManifest::ReadEntries
+	-a missing manifest is not an error, it just has no entries
+================================
+*/
+bool BuildManifest::ReadEntries( const char * relativePath, std::map< std::string, manifestEntry_t > & entries ) {
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+
+	FILE * fs = fopen( fullPath, "r" );
+	if ( !fs ) {
+		return true;
+	}
+
+	int version = 0;
+	if ( fscanf( fs, "buildManifest %d\n", &version ) != 1 || version != MANIFEST_VERSION ) {
+		printf( "Ignoring build manifest with unknown version: %s\n", relativePath );
+		fclose( fs );
+		return false;
+	}
+
+	char line[ 4096 ];
+	while ( fgets( line, sizeof( line ), fs ) ) {
+		manifestEntry_t entry;
+		int pathStart = 0;
+		const int readCount = sscanf( line, "%llx %llx %llx %llu %llu %llu %llu %n",
+			( unsigned long long * )&entry.sourceHash, ( unsigned long long * )&entry.settingsHash, ( unsigned long long * )&entry.outputHash,
+			( unsigned long long * )&entry.sourceStamp.size, ( unsigned long long * )&entry.sourceStamp.writeTime,
+			( unsigned long long * )&entry.outputStamp.size, ( unsigned long long * )&entry.outputStamp.writeTime, &pathStart );
+		if ( readCount != 7 || pathStart == 0 ) {
+			continue; //skip damaged lines, they get rebuilt
+		}
+		std::string path( line + pathStart );
+		while ( !path.empty() && ( path.back() == '\n' || path.back() == '\r' ) ) {
+			path.pop_back();
+		}
+		if ( !path.empty() ) {
+			entries[ path ] = entry;
+		}
+	}
+	fclose( fs );
+	return true;
+}
+
+/*
+================================
+BuildManifest::Load
+================================
+*/
+bool BuildManifest::Load( const char * relativePath ) {
+	std::lock_guard< std::mutex > lock( m_mutex );
+	m_entries.clear();
+	m_changed.clear();
+	return ReadEntries( relativePath, m_entries );
+}
+
+/*
+================================
+BuildManifest::Save
+	-rereads the manifest on disk and applies this manifest's changes on top, then swaps the new
+	 file in with a rename so readers never see a partial manifest.
+================================
+*/
+bool BuildManifest::Save( const char * relativePath ) {
+	std::lock_guard< std::mutex > lock( m_mutex );
+
+	std::map< std::string, manifestEntry_t > merged;
+	ReadEntries( relativePath, merged );
+	std::map< std::string, manifestEntry_t >::iterator it = m_changed.begin();
+	while ( it != m_changed.end() ) {
+		merged[ it->first ] = it->second;
+		it++;
+	}
+
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+	char tempPath[ 2048 + 32 ];
+	sprintf( tempPath, "%s.%lu.tmp", fullPath, GetCurrentProcessId() );
+
+	FILE * fs = fopen( tempPath, "w" );
+	if ( !fs ) {
+		printf( "Failed to write build manifest: %s\n", tempPath );
+		return false;
+	}
+	fprintf( fs, "buildManifest %d\n", MANIFEST_VERSION );
+	it = merged.begin();
+	while ( it != merged.end() ) {
+		const manifestEntry_t & entry = it->second;
+		fprintf( fs, "%016llx %016llx %016llx %llu %llu %llu %llu %s\n",
+			( unsigned long long )entry.sourceHash, ( unsigned long long )entry.settingsHash, ( unsigned long long )entry.outputHash,
+			( unsigned long long )entry.sourceStamp.size, ( unsigned long long )entry.sourceStamp.writeTime,
+			( unsigned long long )entry.outputStamp.size, ( unsigned long long )entry.outputStamp.writeTime, it->first.c_str() );
+		it++;
+	}
+	const bool writeFailed = ( ferror( fs ) != 0 );
+	fclose( fs );
+	if ( writeFailed || MoveFileExA( tempPath, fullPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) == 0 ) {
+		printf( "Failed to write build manifest: %s\n", fullPath );
+		DeleteFileA( tempPath );
+		return false;
+	}
+
+	m_entries.swap( merged );
+	m_changed.clear();
+	return true;
+}
+
+/*
+================================
+BuildManifest::IsUpToDate
+	-true if sourcePath was built with settingsHash and neither it nor its output changed since.
+	-a file whose write time changed but whose content didnt is still up to date. Its entry is
+	 refreshed so it isnt hashed again next time.
+================================
+*/
+bool BuildManifest::IsUpToDate( const char * sourcePath, const char * outputPath, const uint64_t settingsHash ) {
+	manifestEntry_t entry;
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		std::map< std::string, manifestEntry_t >::iterator it = m_entries.find( sourcePath );
+		if ( it == m_entries.end() ) {
+			return false;
+		}
+		entry = it->second;
+	}
+	if ( entry.settingsHash != settingsHash ) {
+		return false;
+	}
+
+	//the hashes are only checked when the stamps differ
+	bool refreshed = false;
+	fileStamp_t outputStamp;
+	if ( !GetFileStamp( outputPath, outputStamp ) ) {
+		return false;
+	}
+	if ( !StampsMatch( outputStamp, entry.outputStamp ) ) {
+		uint64_t outputHash;
+		if ( !HashFile( outputPath, outputHash ) || outputHash != entry.outputHash ) {
+			return false;
+		}
+		entry.outputStamp = outputStamp;
+		refreshed = true;
+	}
+
+	fileStamp_t sourceStamp;
+	if ( !GetFileStamp( sourcePath, sourceStamp ) ) {
+		return false;
+	}
+	if ( !StampsMatch( sourceStamp, entry.sourceStamp ) ) {
+		uint64_t sourceHash;
+		if ( !HashFile( sourcePath, sourceHash ) || sourceHash != entry.sourceHash ) {
+			return false;
+		}
+		entry.sourceStamp = sourceStamp;
+		refreshed = true;
+	}
+
+	if ( refreshed ) {
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_entries[ sourcePath ] = entry;
+		m_changed[ sourcePath ] = entry;
+	}
+	return true;
+}
+
+/*
+================================
+BuildManifest::Update
+	-records that outputPath was just built from sourcePath with settingsHash
+================================
+*/
+bool BuildManifest::Update( const char * sourcePath, const char * outputPath, const uint64_t settingsHash ) {
+	manifestEntry_t entry;
+	entry.settingsHash = settingsHash;
+	if ( !GetFileStamp( sourcePath, entry.sourceStamp ) || !HashFile( sourcePath, entry.sourceHash ) ) {
+		return false;
+	}
+	if ( !GetFileStamp( outputPath, entry.outputStamp ) || !HashFile( outputPath, entry.outputHash ) ) {
+		return false;
+	}
+
+	std::lock_guard< std::mutex > lock( m_mutex );
+	m_entries[ sourcePath ] = entry;
+	m_changed[ sourcePath ] = entry;
+	return true;
+}
+
+/*
+================================
+BuildManifest::EntryCount
+================================
+*/
+unsigned int BuildManifest::EntryCount() {
+	std::lock_guard< std::mutex > lock( m_mutex );
+	return ( unsigned int )m_entries.size();
+}
\ No newline at end of file
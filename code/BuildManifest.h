@@ -0,0 +1,62 @@
+#pragma once
+#ifndef __BUILDMANIFEST_H_INCLUDE__
+#define __BUILDMANIFEST_H_INCLUDE__
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+
+struct fileStamp_t {
+	uint64_t size;
+	uint64_t writeTime;
+};
+
+struct manifestEntry_t {
+	uint64_t sourceHash;
+	uint64_t settingsHash; //compressor settings the output was built with
+	uint64_t outputHash;
+	fileStamp_t sourceStamp; //lets unchanged files skip rehashing
+	fileStamp_t outputStamp;
+};
+
+/*
+==============================
+BuildManifest
+	-maps a source file to the content hash of the source, the settings it was built with and the
+	 hash of the output. A source is up to date when all three still match.
+	-files are only rehashed when their size or write time changed since the entry was made.
+	-Update and IsUpToDate may be called from several threads at once.
+	-Save merges with the manifest on disk and replaces it atomically, so builds that loaded the
+	 same manifest dont drop each other's entries.
+==============================
+*/
+class BuildManifest {
+	public:
+		BuildManifest() {};
+		~BuildManifest() {};
+
+		bool Load( const char * relativePath );
+		bool Save( const char * relativePath );
+
+		bool IsUpToDate( const char * sourcePath, const char * outputPath, const uint64_t settingsHash );
+		bool Update( const char * sourcePath, const char * outputPath, const uint64_t settingsHash );
+		unsigned int EntryCount();
+
+		static bool HashFile( const char * relativePath, uint64_t & hash );
+		static uint64_t HashBytes( const void * data, const size_t size, const uint64_t hash = FNV_OFFSET_BASIS );
+		static bool GetFileStamp( const char * relativePath, fileStamp_t & stamp );
+
+		static const char * s_textureManifest; //manifest used by buildScene
+
+	private:
+		static bool ReadEntries( const char * relativePath, std::map< std::string, manifestEntry_t > & entries );
+
+		std::map< std::string, manifestEntry_t > m_entries;
+		std::map< std::string, manifestEntry_t > m_changed; //entries made or refreshed since Load
+		std::mutex m_mutex;
+};
+
+#endif
\ No newline at end of file
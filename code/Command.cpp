@@ -3,8 +3,30 @@
 #include "Command.h"
 #include "Console.h"
 #include "Scene.h"
+#include "GLRecorder.h"
+#include "ShadowScheduler.h"
+#include "LightBinning.h"
+#include "Camera.h"
+#include "ThreadPool.h"
+#include "BuildManifest.h"
+#include "TextureStreamer.h"
+#include "EnvMapBaker.h"
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+#include "DrawList.h"
+#include "IndirectDraw.h"
+#include "MaterialTable.h"
+#include "DeclCache.h"
+#include "ShaderWatcher.h"
 
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <psapi.h>
 #include <GL/freeglut.h>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -22,6 +44,15 @@ CVar * g_cvar_showBloom = new CVar();
 CVar * g_cvar_showSSAO = new CVar();
 CVar * g_cvar_screenshot = new CVar();
 
+extern ShadowScheduler g_shadowScheduler;
+extern DrawList g_drawList;
+extern std::vector< drawElementsCommand_t > g_drawCommands;
+extern std::vector< indirectBatch_t > g_drawBatches;
+extern Camera camera;
+extern int gScreenWidth;
+extern int gScreenHeight;
+extern void RenderScene( const float * view, const float * projection );
+
 CommandSys * g_cmdSys = CommandSys::getInstance(); //declare g_cmdSys singleton
 
 CommandSys * CommandSys::inst_ = NULL; //Define the static Singleton pointer
@@ -242,153 +273,56 @@ void Fn_GenerateLUT( Str args ) {
 /*
 ================================
 Fn_EquirectangularToCubeMap
+	-args: relative path of a tga or hdr panorama, optional face size (default half the panorama
+	 height) and supersample count per texel axis (default 1)
+	-writes the faces side by side next to the input as <name>_cube.tga or <name>_cube.hdr
 ================================
 */
 void Fn_EquirectangularToCubeMap( Str args ) {
 	Console * console = Console::getInstance(); //retrieve console singleton
 
 	args.Strip();
-	const Str equImg_relative = args;
-
-	//ensure an arg is present
-	if ( equImg_relative.Length() < 1 ) {
+	char equImg_relative[ 1024 ] = { 0 };
+	int faceSize = 0;
+	int supersample = 1;
+	if ( sscanf( args.c_str(), "%1023s %d %d", equImg_relative, &faceSize, &supersample ) < 1 ) {
 		console->AddError( "equirectangularToCubeMap :: RelativePath arg required!!!" );
 		return;
-	}	
+	}
+	if ( faceSize < 0 || supersample < 1 || supersample > 8 ) {
+		console->AddError( "equirectangularToCubeMap :: invalid face size or supersample count!!!" );
+		return;
+	}
 
 	//generate absolute path for the input equirectangular map
 	char imgPath[ 2048 ];
-	if ( RelativePathToFullPath( equImg_relative.c_str(), imgPath ) == false ) {
+	if ( RelativePathToFullPath( equImg_relative, imgPath ) == false ) {
 		console->AddError( "equirectangularToCubeMap :: Invalid arg!!!" );
 		return;
 	}
 	Str equImg_absolute = Str( imgPath );
-	Str cubeMap_absolute;
-
-	//read data from image file
-	int width, height, nrChannels;
-	const Vec3 x_axis = Vec3( 1.0, 0.0, 0.0 );
-	const Vec3 y_axis = Vec3( 0.0, 1.0, 0.0 );
-	const Vec3 z_axis = Vec3( 0.0, 0.0, 1.0 );
-
-	if ( equImg_absolute.EndsWith( ".tga" ) ) {
-		unsigned char *data = stbi_load( equImg_absolute.c_str(), &width, &height, &nrChannels, 0 );
-		if ( data ) {
-			const int cubemapSize = height / 2;
-			const float halfSize = ( float )cubemapSize / 2.0f;
-			uint8_t * output_data = new uint8_t[ cubemapSize * 6 * cubemapSize * 3 ];
-
-			//generate cubemap image here
-			for ( int i = 0; i < cubemapSize; i++ ) {
-				for ( int j = 0; j < cubemapSize * 6; j++ ) {
-					const int k = j % cubemapSize;
-				
-					Vec3 sampleVec;
-					if ( j < cubemapSize ) { //front
-						sampleVec = ( z_axis * -halfSize ) + ( Vec3( k, i, 0 ) - Vec3( halfSize, halfSize, 0.0 ) );
-					} else if ( j < cubemapSize * 2 ) { //back
-						sampleVec = ( z_axis * halfSize ) + ( Vec3( abs( cubemapSize - k ), i, 0 ) - Vec3( halfSize, halfSize, 0.0 ) );
-					} else if ( j < cubemapSize * 3 ) { //up
-						sampleVec = ( y_axis * -halfSize ) + ( Vec3( abs( cubemapSize - i ), 0, abs( cubemapSize - k ) ) - Vec3( halfSize, 0.0, halfSize ) );
-					} else if ( j < cubemapSize * 4 ) { //down
-						sampleVec = ( y_axis * halfSize ) + ( Vec3( i, 0, abs( cubemapSize - k ) ) - Vec3( halfSize, 0.0, halfSize ) );
-					} else if ( j < cubemapSize * 5 ) { //right
-						sampleVec = ( x_axis * -halfSize ) + ( Vec3( 0, i, abs( cubemapSize - k ) ) - Vec3( 0.0, halfSize, halfSize ) );
-					} else if ( j < cubemapSize * 6 ) { //left
-						sampleVec = ( x_axis * halfSize ) + ( Vec3( 0, i, k ) - Vec3( 0.0, halfSize, halfSize ) );
-					}
-					sampleVec.normalize();
-
-					//convert to uv coords of spherical map
-					const Vec2 invAtan = Vec2( 0.1591, 0.3183 );
-					Vec2 uv = Vec2( atan2( sampleVec.z, sampleVec.x ), asin( sampleVec.y ) );
-					uv[0] *= invAtan[0];
-					uv[1] *= invAtan[1];
-					uv += 0.5;
-
-					//write to output
-					unsigned int uv_x = ( unsigned int )( uv.x * ( float )width );
-					unsigned int uv_y = ( unsigned int )( uv.y * ( float )height );
-					unsigned int data_idx = ( width * uv_y + uv_x ) * 3;
-					const unsigned int output_data_idx = ( cubemapSize * 6 * 3 * i ) + ( 3 * j );
-					output_data[ output_data_idx + 0 ] = data[ data_idx + 0 ];
-					output_data[ output_data_idx + 1 ] = data[ data_idx + 1 ];
-					output_data[ output_data_idx + 2 ] = data[ data_idx + 2 ];
-				}
-			}
-
-			//generate output image path
-			cubeMap_absolute = equImg_absolute.Substring( 0, equImg_absolute.Length() - 4 );
-			cubeMap_absolute += "_cube.tga";
-			stbi_write_tga( cubeMap_absolute.c_str(), cubemapSize * 6, cubemapSize, 3, output_data ); //save image
-			delete[] output_data;
-			output_data = nullptr;
-
-		} else {
-			console->AddError( "equirectangularToCubeMap :: Equirectangular image could not be found!!!" );
-			return;
-		}
-
-	} else if ( equImg_absolute.EndsWith( ".hdr" ) ) {
-		float *data = stbi_loadf( equImg_absolute.c_str(), &width, &height, &nrChannels, 0 );
-		if ( data ) {
-			const int cubemapSize = height / 2;
-			const float halfSize = ( float )cubemapSize / 2.0f;
-			float * output_data = new float[ cubemapSize * 6 * cubemapSize * 3 ];
-
-			//generate cubemap image here
-			for ( int i = 0; i < cubemapSize; i++ ) {
-				for ( int j = 0; j < cubemapSize * 6; j++ ) {
-					const int k = j % cubemapSize;
-				
-					Vec3 sampleVec;
-					if ( j < cubemapSize ) { //front
-						sampleVec = ( z_axis * -halfSize ) + ( Vec3( k, i, 0 ) - Vec3( halfSize, halfSize, 0.0 ) );
-					} else if ( j < cubemapSize * 2 ) { //back
-						sampleVec = ( z_axis * halfSize ) + ( Vec3( abs( cubemapSize - k ), i, 0 ) - Vec3( halfSize, halfSize, 0.0 ) );
-					} else if ( j < cubemapSize * 3 ) { //up
-						sampleVec = ( y_axis * -halfSize ) + ( Vec3( abs( cubemapSize - i ), 0, abs( cubemapSize - k ) ) - Vec3( halfSize, 0.0, halfSize ) );
-					} else if ( j < cubemapSize * 4 ) { //down
-						sampleVec = ( y_axis * halfSize ) + ( Vec3( i, 0, abs( cubemapSize - k ) ) - Vec3( halfSize, 0.0, halfSize ) );
-					} else if ( j < cubemapSize * 5 ) { //right
-						sampleVec = ( x_axis * -halfSize ) + ( Vec3( 0, i, abs( cubemapSize - k ) ) - Vec3( 0.0, halfSize, halfSize ) );
-					} else if ( j < cubemapSize * 6 ) { //left
-						sampleVec = ( x_axis * halfSize ) + ( Vec3( 0, i, k ) - Vec3( 0.0, halfSize, halfSize ) );
-					}
-					sampleVec.normalize();
-
-					//convert to uv coords of spherical map
-					const Vec2 invAtan = Vec2( 0.1591, 0.3183 );
-					Vec2 uv = Vec2( atan2( sampleVec.z, sampleVec.x ), asin( sampleVec.y ) );
-					uv[0] *= invAtan[0];
-					uv[1] *= invAtan[1];
-					uv += 0.5;
-
-					//write to output
-					unsigned int uv_x = ( unsigned int )( uv.x * ( float )width );
-					unsigned int uv_y = ( unsigned int )( uv.y * ( float )height );
-					unsigned int data_idx = ( width * uv_y + uv_x ) * 3;
-					const unsigned int output_data_idx = ( cubemapSize * 6 * 3 * i ) + ( 3 * j );
-					output_data[ output_data_idx + 0 ] = data[ data_idx + 0 ];
-					output_data[ output_data_idx + 1 ] = data[ data_idx + 1 ];
-					output_data[ output_data_idx + 2 ] = data[ data_idx + 2 ];
-				}
-			}
+	if ( !equImg_absolute.EndsWith( ".tga" ) && !equImg_absolute.EndsWith( ".hdr" ) ) {
+		console->AddError( "equirectangularToCubeMap :: Unsuported filetype!!!" );
+		return;
+	}
 
-			//generate output image path
-			cubeMap_absolute = equImg_absolute.Substring( 0, equImg_absolute.Length() - 4 );
-			cubeMap_absolute += "_cube.hdr";
-			stbi_write_hdr( cubeMap_absolute.c_str(), cubemapSize * 6, cubemapSize, 3, output_data ); //save image
-			delete[] output_data;
-			output_data = nullptr;
+	envImage_t equirect;
+	if ( !EnvMapBaker::LoadEnvImage( equImg_absolute.c_str(), equirect ) ) {
+		console->AddError( "equirectangularToCubeMap :: Equirectangular image could not be found!!!" );
+		return;
+	}
+	if ( faceSize == 0 ) {
+		faceSize = equirect.height / 2;
+	}
 
-		} else {
-			console->AddError( "equirectangularToCubeMap :: Equirectangular image could not be found!!!" );
-			return;
-		}
+	envImage_t cubemap;
+	EnvMapBaker::EquirectToCubemap( equirect, faceSize, supersample, cubemap, true, true );
 
-	} else {
-		console->AddError( "equirectangularToCubeMap :: Unsuported filetype!!!" );
+	//generate output image path
+	Str cubeMap_absolute = equImg_absolute.Substring( 0, equImg_absolute.Length() - 4 );
+	cubeMap_absolute += equImg_absolute.EndsWith( ".tga" ) ? "_cube.tga" : "_cube.hdr";
+	if ( !EnvMapBaker::SaveEnvImage( cubeMap_absolute.c_str(), cubemap ) ) {
+		console->AddError( "equirectangularToCubeMap :: couldnt write cubemap image!!!" );
 		return;
 	}
 
@@ -488,6 +422,10 @@ void Fn_ComputeIrradianceMap( Str args ) {
 	Str irradianceMap_absolute = cubeMap_absolute.Substring( 0, cubeMap_absolute.Length() - 4 );
 	irradianceMap_absolute += "_irr.hdr";
 	stbi_write_hdr( irradianceMap_absolute.c_str(), width, height, chanCount, output_data ); //save image
+	std::vector< envImage_t > irradianceLevels( 1 );
+	irradianceLevels[0].width = width;
+	irradianceLevels[0].height = height;
+	irradianceLevels[0].pixels.assign( output_data, output_data + width * height * chanCount );
 	delete[] cubemapFace_data;
 	cubemapFace_data = nullptr;
 	delete[] output_data;
@@ -503,8 +441,8 @@ void Fn_ComputeIrradianceMap( Str args ) {
 	Str irradianceMap_relative = envmap_relative.Substring( 0, envmap_relative.Length() - 4 );
 	irradianceMap_relative += "_irr.hdr";
 
-	//compress env map
-	if ( Texture::CompressFromFile( irradianceMap_relative.c_str() ) ) {
+	//compress irradiance map
+	if ( Texture::CompressCubemap( irradianceMap_relative.c_str(), irradianceLevels ) ) {
 		Str info( "Irrmap compressed successfully: " );
 		info.Append( irradianceMap_relative );
 		console->AddInfo( info.c_str() );
@@ -515,43 +453,173 @@ void Fn_ComputeIrradianceMap( Str args ) {
 	}
 }
 
+/*
+================================
+TextureUsageFromUniform
+	-how a material texture is filtered, based on the uniform it is bound to
+================================
+*/
+static textureUsage_t TextureUsageFromUniform( const std::string & uniformName ) {
+	if ( uniformName.find( "normal" ) != std::string::npos ) {
+		return TEXTURE_USAGE_NORMAL;
+	} else if ( uniformName.find( "albedo" ) != std::string::npos ) {
+		return TEXTURE_USAGE_COLOR;
+	}
+	return TEXTURE_USAGE_LINEAR;
+}
+
+/*
+================================
+Fn_ComputeIrradianceSH
+	-projects an env probe cubemap onto L2 spherical harmonics and saves them next to it as _sh.txt
+================================
+*/
+void Fn_ComputeIrradianceSH( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+
+	args.Strip();
+	const Str cubemap_relative = args;
+	if ( cubemap_relative.Length() < 5 ) {
+		console->AddError( "computeIrradianceSH :: RelativePath arg required!!!" );
+		return;
+	}
+	char imgPath[ 2048 ];
+	envImage_t cubemap;
+	if ( !RelativePathToFullPath( cubemap_relative.c_str(), imgPath ) || !EnvMapBaker::LoadEnvImage( imgPath, cubemap ) || cubemap.width != cubemap.height * 6 ) {
+		console->AddError( "computeIrradianceSH :: couldnt load cubemap!!!" );
+		return;
+	}
+
+	irradianceSH_t sh;
+	EnvMapBaker::ProjectIrradianceSH( cubemap, sh, true );
+
+	Str sh_relative = cubemap_relative.Substring( 0, cubemap_relative.Length() - 4 );
+	sh_relative.Append( "_sh.txt" );
+	char shPath[ 2048 ];
+	if ( !RelativePathToFullPath( sh_relative.c_str(), shPath ) || !EnvMapBaker::SaveIrradianceSH( shPath, sh ) ) {
+		console->AddError( "computeIrradianceSH :: couldnt save coefficients!!!" );
+		return;
+	}
+
+	Str info( "Irradiance SH saved to: " );
+	info.Append( shPath );
+	console->AddInfo( info.c_str() );
+}
+
 /*
 ================================
 Fn_BuildScene
 	-Compress all scene textures and save to disk
-	-Render env maps and irr maps, compress, and save to disk
+	-Render env maps and irr maps, prefilter the env maps' specular levels, compress, and save to disk
+	-Project env maps onto irradiance SH
 ================================
 */
 void Fn_BuildScene( Str args ) {
 	Console * console = Console::getInstance();
 	Scene * scene = Scene::getInstance();
 
-	//compress scene textures
-    resourceMap_t::iterator it_decl = MaterialDecl::s_matDecls.begin();
-    while ( it_decl != MaterialDecl::s_matDecls.end() ) {
+	//compress scene textures. Textures are compressed in parallel, limited by how much memory the jobs may hold at once.
+	std::vector< Texture * > textures;
+	std::vector< textureUsage_t > usages; //mips are filtered based on the uniform the texture is bound to
+	resourceMap_t::iterator it_decl = MaterialDecl::s_matDecls.begin();
+	while ( it_decl != MaterialDecl::s_matDecls.end() ) {
 		MaterialDecl * currentMatDecl = it_decl->second;
 		textureMap::iterator it_tex = currentMatDecl->m_textures.begin();
 		while ( it_tex != currentMatDecl->m_textures.end() ) {
 			Texture * currentTexture = it_tex->second;
-			if ( currentTexture->m_compressed ) {
-				it_tex++;
-				continue;
+			if ( !currentTexture->m_compressed && std::find( textures.begin(), textures.end(), currentTexture ) == textures.end() ) {
+				textures.push_back( currentTexture );
+				usages.push_back( TextureUsageFromUniform( it_tex->first ) );
+			}
+			it_tex++;
+		}
+		it_decl++;
+	}
+
+	const size_t memoryBudget = 1024 * 1024 * 1024;
+	MemoryBudget budget( memoryBudget );
+	std::mutex finishedMutex;
+	std::vector< std::pair< unsigned int, bool > > finished; //texture idx, success
+	std::vector< size_t > compressedPixels( textures.size(), 0 ); //every level of every texture
+	std::vector< char > upToDate( textures.size(), 0 ); //skipped because the manifest says the output is current
+	BuildManifest manifest;
+	manifest.Load( BuildManifest::s_textureManifest );
+	jobGroup_t group;
+	ThreadPool * pool = ThreadPool::getInstance();
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < textures.size(); i++ ) {
+		const char * relativePath = textures[i]->mStrName;
+		const textureUsage_t usage = usages[i];
+		pool->Submit( group, [i, relativePath, usage, &budget, &finishedMutex, &finished, &compressedPixels, &upToDate, &manifest] {
+			const Str outputPath = Texture::CompressedPath( relativePath );
+			const uint64_t settingsHash = Texture::CompressionSettingsHash( true, usage );
+			bool success = true;
+			if ( manifest.IsUpToDate( relativePath, outputPath.c_str(), settingsHash ) ) {
+				upToDate[i] = 1;
+			} else {
+				const size_t bytes = Texture::CompressionMemoryEstimate( relativePath, true );
+				budget.Acquire( bytes );
+				success = Texture::CompressFromFile( relativePath, true, usage, &compressedPixels[i] );
+				budget.Release( bytes );
+				if ( success ) {
+					manifest.Update( relativePath, outputPath.c_str(), settingsHash );
+				}
 			}
-			if ( Texture::CompressFromFile( currentTexture->mStrName ) ) {
+
+			std::lock_guard< std::mutex > lock( finishedMutex );
+			finished.push_back( std::pair< unsigned int, bool >( i, success ) );
+		} );
+	}
+
+	//report progress from the main thread. Console calls arent safe from the workers.
+	unsigned int reportedCount = 0;
+	unsigned int upToDateCount = 0;
+	double pixelCount = 0.0;
+	bool done = textures.empty();
+	while ( !done ) {
+		done = pool->WaitFor( group, 100 );
+
+		std::vector< std::pair< unsigned int, bool > > newlyFinished;
+		{
+			std::lock_guard< std::mutex > lock( finishedMutex );
+			newlyFinished.assign( finished.begin() + reportedCount, finished.end() );
+		}
+		for ( unsigned int i = 0; i < newlyFinished.size(); i++ ) {
+			Texture * currentTexture = textures[ newlyFinished[i].first ];
+			reportedCount += 1;
+			char progress[32];
+			sprintf( progress, "(%u/%u) ", reportedCount, ( unsigned int )textures.size() );
+			if ( newlyFinished[i].second && upToDate[ newlyFinished[i].first ] ) {
+				currentTexture->m_compressed = true;
+				upToDateCount += 1;
+			} else if ( newlyFinished[i].second ) {
 				currentTexture->m_compressed = true;
-				Str info( "Texture compressed successfully: " );
+				pixelCount += ( double )compressedPixels[ newlyFinished[i].first ];
+				Str info( progress );
+				info.Append( "Texture compressed successfully: " );
 				info.Append( Str( currentTexture->mStrName ) );
 				console->AddInfo( info.c_str() );
 			} else {
-				Str error( "Compression task failed: " );
+				Str error( progress );
+				error.Append( "Compression task failed: " );
 				error.Append( Str( currentTexture->mStrName ) );
 				console->AddError( error.c_str() );
 			}
-			it_tex++;
-
 		}
-		it_decl++;
-    }
+	}
+	if ( !textures.empty() ) {
+		const double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+		char info[256];
+		sprintf( info, "Compressed %u textures in %.2fs on %u threads (%.1f MPix/s), %u were up to date", reportedCount - upToDateCount, seconds, pool->WorkerCount(), pixelCount / 1000000.0 / seconds, upToDateCount );
+		console->AddInfo( info );
+
+		if ( dirExists( "data\\generated" ) == false ) {
+			makeDir( "data\\generated" );
+		}
+		if ( !manifest.Save( BuildManifest::s_textureManifest ) ) {
+			console->AddError( "Failed to save the texture build manifest" );
+		}
+	}
 
 	const Str scene_relativePath = scene->GetName();
 	unsigned int idx = scene_relativePath.Find( "scenes" );
@@ -564,7 +632,7 @@ void Fn_BuildScene( Str args ) {
 	envProbe_shader = envProbe_shader->GetShader( "cook-torrance-envProbes" );
 
 	const unsigned int chanCount = 3;
-	const unsigned int cubemapSize = 128;
+	const unsigned int cubemapSize = ENV_PROBE_SIZE;
 	for ( unsigned int i = 0; i < scene->EnvProbeCount(); i++ ) {
 		//create probe img filename
 		char idx_str[5];
@@ -614,6 +682,10 @@ void Fn_BuildScene( Str args ) {
 		}
 		Str environment_absolutePath = Str( imgPath );
 		stbi_write_hdr( environment_absolutePath.c_str(), cubemapSize * 6, cubemapSize, chanCount, output_data ); //save image
+		envImage_t environment;
+		environment.width = cubemapSize * 6;
+		environment.height = cubemapSize;
+		environment.pixels.assign( output_data, output_data + cubemapSize * 6 * cubemapSize * chanCount );
 		delete[] cubemapFace_data;
 		cubemapFace_data = nullptr;
 		delete[] output_data;
@@ -624,9 +696,11 @@ void Fn_BuildScene( Str args ) {
 		info.Append( environment_absolutePath );
 		console->AddInfo( info.c_str() );
 
-		//compress env map
-		if ( Texture::CompressFromFile( environment_relativePath.c_str() ) ) {
-			Str info( "Envmap compressed successfully: " );
+		//prefilter the specular levels and compress them into the env map's bc file
+		std::vector< envImage_t > prefilteredLevels;
+		EnvMapBaker::PrefilterGGX( environment, cubemapSize, ENV_PROBE_LEVELS, ENV_PROBE_SAMPLES, prefilteredLevels, true );
+		if ( Texture::CompressCubemap( environment_relativePath.c_str(), prefilteredLevels ) ) {
+			Str info( "Envmap prefiltered and compressed successfully: " );
 			info.Append( environment_relativePath );
 			console->AddInfo( info.c_str() );
 		} else {
@@ -637,6 +711,7 @@ void Fn_BuildScene( Str args ) {
 
 		//kickoff irradianceMap creation
 		Fn_ComputeIrradianceMap( environment_relativePath );
+		Fn_ComputeIrradianceSH( environment_relativePath );
 	}
 
 	console->AddInfo( "Scene build successfull." );
@@ -698,6 +773,26 @@ void Fn_BRDFIntegrationLUT( Str args ) {
 	output_data = nullptr;
 }
 
+/*
+================================
+SceneMaterialNames
+	-the material of every surface of the scene, once per surface
+================================
+*/
+static void SceneMaterialNames( Scene * scene, std::vector< std::string > & names ) {
+	names.clear();
+	for ( int n = 0; n < scene->MeshCount(); n++ ) {
+		Mesh * mesh = NULL;
+		scene->MeshByIndex( n, &mesh );
+		if ( NULL == mesh ) {
+			continue;
+		}
+		for ( unsigned int i = 0; i < mesh->m_surfaces.size(); i++ ) {
+			names.push_back( mesh->m_surfaces[i]->materialName.c_str() );
+		}
+	}
+}
+
 /*
 ================================
 Fn_LoadScene
@@ -728,10 +823,14 @@ void Fn_LoadScene( Str args ) {
 	//unload the current scene
 	Scene * scene = Scene::getInstance();
 	scene->Unload();
+	g_shadowScheduler.Reset(); //light idxs are about to change
 
 	//remove all shaders and buffers
 	Shader::DeleteAllPrograms();
 
+	//remove all materials. Their textures are freed with the last material using them.
+	MaterialDecl::DeleteAllDecls();
+
 	//build debuglighting shader
 	Shader * debugLighting_shader = new Shader();
 	debugLighting_shader = debugLighting_shader->GetShader( "debugLighting" );
@@ -752,6 +851,13 @@ void Fn_LoadScene( Str args ) {
 	//load new scene
 	MaterialDecl * matDecl = NULL;
 	if ( scene->LoadFromFile( args.c_str() ) ) {
+		//every decl of the scene is read with its textures on the thread pool first, the loop
+		//below then finds them loaded and only compiles and binds
+		std::vector< std::string > materialNames;
+		SceneMaterialNames( scene, materialNames );
+		materialNames.push_back( "material\\error" );
+		MaterialDecl::LoadMaterialDecls( materialNames );
+
 		for ( int n = 0; n < scene->MeshCount(); n++ ) {
 			Mesh * mesh = scene->MeshByIndex( n );
 			scene->MeshByIndex( n, &mesh );
@@ -775,6 +881,7 @@ void Fn_LoadScene( Str args ) {
 				} else {
 					assert( false );
 				}
+				mesh->m_surfaces[ i ]->declId = matDecl->m_id;
 			}
 		}
 	}
@@ -922,108 +1029,2488 @@ void TakeScreenshot() {
 
 /*
 ================================
-CommandSys::getInstance
+Fn_GLStats
+	-prints the GL call counts of the last frame
 ================================
 */
-CommandSys * CommandSys::getInstance() {
-   if ( inst_ == NULL ) {
-      inst_ = new CommandSys();
-   }
-   return( inst_ );
+void Fn_GLStats( Str args ) {
+	if ( args != "" ) {
+		Console * console = Console::getInstance(); //retrieve console singleton
+		console->AddError( "glStats :: this command takes no args!!!" );
+		return;
+	}
+	GLRecorder::Report();
 }
 
 /*
 ================================
-CommandSys::BuildCommands
+Fn_SinglePassCubeShadows
+	-toggles between single pass and 6 pass point light shadow rendering
 ================================
 */
-void CommandSys::BuildCommands() {
-	Cmd * testLogCommand = new Cmd;
-	testLogCommand->name = Str( "testLog" );
-	testLogCommand->description = Str( "Prints stuff to the log." );
-	testLogCommand->fn = Fn_TestLog;
-	m_commands.push_back( testLogCommand );
+void Fn_SinglePassCubeShadows( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args == "" ) {		
+		console->AddError( "singlePassCubeShadows :: this command requires an int arg!!!" );
+		return;
+	}
 
-	Cmd * quitCommand = new Cmd;
-	quitCommand->name = Str( "quit" );
-	quitCommand->description = Str( "closes application." );
-	quitCommand->fn = Fn_Quit;
-	m_commands.push_back( quitCommand );
+	const int argVal = atoi( args.c_str() );
+	if ( argVal < 0 || argVal > 1 ) {
+		console->AddError( "singlePassCubeShadows :: invalid arg!!!" );
+		return;
+	}
+	Light::s_cubeShadowsSinglePass = ( argVal == 1 );
+	if ( Light::s_cubeShadowsSinglePass && !Light::s_cubeShadowsSinglePassSupported ) {
+		console->AddWarning( "singlePassCubeShadows :: not supported by this driver. Using 6 passes." );
+	}
 
-	Cmd * debugLightingCommand = new Cmd;
-	debugLightingCommand->name = Str( "debugLighting" );
-	debugLightingCommand->description = Str( "Sets a rendering mode." );
-	debugLightingCommand->fn = Fn_DebugLighting;
-	m_commands.push_back( debugLightingCommand );
+	//re-render point light shadows with the selected path
+	Scene * scene = Scene::getInstance();
+	for ( int i = 0; i < scene->LightCount(); i++ ) {
+		Light * light = NULL;
+		scene->LightByIndex( i, &light );
+		light->MarkShadowDirty();
+	}
+}
 
-	Cmd * showVertTransformsCommand = new Cmd;
-	showVertTransformsCommand->name = Str( "showVertTransforms" );
-	showVertTransformsCommand->description = Str( "Renders normals, tangents, and bitangents of all rendered vertices." );
-	showVertTransformsCommand->fn = Fn_ShowVertTransforms;
-	m_commands.push_back( showVertTransformsCommand );
+/*
+================================
+Fn_ShadowBudget
+	-sets how much shadow rendering the scheduler may do per frame
+	-args: "partitions <count>" or "triangles <count>"
+================================
+*/
+void Fn_ShadowBudget( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	char type[64] = { 0 };
+	unsigned int budget = 0;
+	if ( sscanf( args.c_str(), "%63s %u", type, &budget ) != 2 || budget == 0 ) {
+		console->AddError( "shadowBudget :: requires a budget type (partitions or triangles) and a count!!!" );
+		return;
+	}
 
-	Cmd * renderLightModelsCommand = new Cmd;
-	renderLightModelsCommand->name = Str( "renderLightModels" );
-	renderLightModelsCommand->description = Str( "Render debug models for lights in the scene." );
-	renderLightModelsCommand->fn = Fn_RenderLightModels;
-	m_commands.push_back( renderLightModelsCommand );
+	if ( strcmp( type, "partitions" ) == 0 ) {
+		ShadowScheduler::s_budgetType = SHADOW_BUDGET_PARTITIONS;
+	} else if ( strcmp( type, "triangles" ) == 0 ) {
+		ShadowScheduler::s_budgetType = SHADOW_BUDGET_TRIANGLES;
+	} else {
+		console->AddError( "shadowBudget :: invalid budget type!!!" );
+		return;
+	}
+	ShadowScheduler::s_budget = budget;
+}
 
-	Cmd * createDefaultLUTCommand = new Cmd;
-	createDefaultLUTCommand->name = Str( "createLUT" );
-	createDefaultLUTCommand->description = Str( "Generate the default LUT tga image. Optional arg is filename without file extension." );
-	createDefaultLUTCommand->fn = Fn_GenerateLUT;
-	m_commands.push_back( createDefaultLUTCommand );
+/*
+================================
+Fn_SimShadowSchedule
+	-runs the shadow scheduler for 1000 frames on a synthetic scene with the current budget.
+	-the simulation is run twice to verify the schedule is deterministic.
+	-fails if a frame went over budget for more than its first light, a light waited longer than
+	 ShadowScheduler::MaxStaleness or lights were still waiting past the staleness cap at the end
+	-optional arg is the light count
+================================
+*/
+void Fn_SimShadowSchedule( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int lightCount = 64;
+	if ( args != "" ) {
+		lightCount = ( unsigned int )atoi( args.c_str() );
+		if ( lightCount == 0 ) {
+			console->AddError( "simShadowSchedule :: invalid light count!!!" );
+			return;
+		}
+	}
 
-	Cmd * showEdgeHighlightsCommand = new Cmd;
-	showEdgeHighlightsCommand->name = Str( "showEdgeHighlights" );
-	showEdgeHighlightsCommand->description = Str( "Render geo as wireframe. Args: 0->off, 1->overlayed, 2->on" );
-	showEdgeHighlightsCommand->fn = Fn_ShowEdgeHighlights;
-	m_commands.push_back( showEdgeHighlightsCommand );
+	const unsigned int frameCount = 1000;
+	const unsigned int seed = 1;
+	const shadowSimStats_t stats = ShadowScheduler::Simulate( lightCount, frameCount, seed );
+	const shadowSimStats_t rerun = ShadowScheduler::Simulate( lightCount, frameCount, seed );
+
+	char line[256];
+	sprintf( line, "lights: %u  frames: %u  budget: %u %s", lightCount, stats.frames, ShadowScheduler::s_budget, ShadowScheduler::s_budgetType == SHADOW_BUDGET_PARTITIONS ? "partitions" : "triangles" );
+	console->AddInfo( line );
+	sprintf( line, "cost per frame: avg %.2f  max %u", stats.avgCost, stats.maxCost );
+	console->AddInfo( line );
+	sprintf( line, "latency: avg %.2f frames  max staleness %u  starved lights %u", stats.avgLatency, stats.maxStaleness, stats.starvedLights );
+	console->AddInfo( line );
+	sprintf( line, "checksum: %08x", stats.checksum );
+	console->AddInfo( line );
+	if ( stats.checksum != rerun.checksum ) {
+		console->AddError( "simShadowSchedule :: schedule isnt deterministic!!!" );
+	}
+	if ( stats.overBudgetFrames > 0 ) {
+		sprintf( line, "simShadowSchedule :: %u frames went over budget for more than their first light!!!", stats.overBudgetFrames );
+		console->AddError( line );
+	}
+	if ( stats.maxStaleness > ShadowScheduler::MaxStaleness( lightCount ) ) {
+		sprintf( line, "simShadowSchedule :: a light waited %u frames, more than the %u an overdue light can wait!!!", stats.maxStaleness, ShadowScheduler::MaxStaleness( lightCount ) );
+		console->AddError( line );
+	}
+	if ( stats.starvedLights > 0 ) {
+		sprintf( line, "simShadowSchedule :: %u lights were still waiting past the staleness cap at the end!!!", stats.starvedLights );
+		console->AddError( line );
+	}
+}
 
-	Cmd * convertEquirectangularToCubemapCommand = new Cmd;
-	convertEquirectangularToCubemapCommand->name = Str( "equirectangularToCubeMap" );
-	convertEquirectangularToCubemapCommand->description = Str( "Converts equirectangular map provided by arg (relative path) to a cubemap texture." );
-	convertEquirectangularToCubemapCommand->fn = Fn_EquirectangularToCubeMap;
-	m_commands.push_back( convertEquirectangularToCubemapCommand );
+/*
+================================
+Fn_TightLightVolumes
+	-toggles between the tight light volume hulls and the legacy oriented boxes used for light binning
+	-optional second arg is the number of icosphere subdivisions used for point lights
+================================
+*/
+void Fn_TightLightVolumes( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	int argVal = 0;
+	int subdivisions = ( int )Light::s_pointVolumeSubdivisions;
+	if ( sscanf( args.c_str(), "%d %d", &argVal, &subdivisions ) < 1 ) {
+		console->AddError( "tightLightVolumes :: this command requires an int arg!!!" );
+		return;
+	}
+	if ( argVal < 0 || argVal > 1 || subdivisions < 0 || subdivisions > 1 ) {
+		console->AddError( "tightLightVolumes :: invalid arg!!!" );
+		return;
+	}
+	Light::s_tightVolumes = ( argVal == 1 );
+	Light::s_pointVolumeSubdivisions = ( unsigned int )subdivisions;
 
-	Cmd * computeIrradianceMapCommand = new Cmd;
-	computeIrradianceMapCommand->name = Str( "computeIrradianceMap" );
-	computeIrradianceMapCommand->description = Str( "Convolutes input cubemap and outputs an irradiance map." );
-	computeIrradianceMapCommand->fn = Fn_ComputeIrradianceMap;
-	m_commands.push_back( computeIrradianceMapCommand );
+	Scene * scene = Scene::getInstance();
+	for ( int i = 0; i < scene->LightCount(); i++ ) {
+		Light * light = NULL;
+		scene->LightByIndex( i, &light );
+		light->InvalidateLightEffectStorage();
+	}
+}
 
-	Cmd * buildSceneCommand = new Cmd;
-	buildSceneCommand->name = Str( "buildScene" );
-	buildSceneCommand->description = Str( "Pre-generate all required data for the scene." );
-	buildSceneCommand->fn = Fn_BuildScene;
-	m_commands.push_back( buildSceneCommand );
+/*
+================================
+Fn_BinningStats
+	-bins the scene's lights on the cpu from the current camera and prints the lights per tile for
+	 the legacy box volumes, the tight hulls, and the tight hulls cut off at each light's EffectRadius.
+================================
+*/
+void Fn_BinningStats( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	Scene * scene = Scene::getInstance();
+	const int tileSize = 16; //WORK_GROUP_SIZE of the tilePrepass shader
+
+	const char * names[] = { "box volumes", "tight hulls", "luminance cutoff" };
+	binningStats_t stats[3];
+	for ( unsigned int v = 0; v < 3; v++ ) {
+		std::vector< LightEffectStorage > volumes( scene->LightCount() );
+		std::vector< const LightEffectStorage * > volumePtrs;
+		for ( int i = 0; i < scene->LightCount(); i++ ) {
+			Light * light = NULL;
+			scene->LightByIndex( i, &light );
+			const float radius = ( v == 2 ) ? light->EffectRadius() : light->GetMaxRadius();
+			light->BuildEffectVolume( volumes[i], v != 0, radius );
+			volumePtrs.push_back( &volumes[i] );
+		}
+		stats[v] = LightBinning::BinLights( volumePtrs, camera.GetView(), camera.GetProjection(), camera.m_position, camera.m_look, gScreenWidth, gScreenHeight, tileSize );
+	}
 
-	Cmd * brdfIntegrationLUTCommand = new Cmd;
-	brdfIntegrationLUTCommand->name = Str( "brdfIntegrationLUT" );
-	brdfIntegrationLUTCommand->description = Str( "Pre-compute the BRDF as a LUT." );
-	brdfIntegrationLUTCommand->fn = Fn_BRDFIntegrationLUT;
-	m_commands.push_back( brdfIntegrationLUTCommand );
+	char line[256];
+	sprintf( line, "lights: %d  tiles: %u  max lights per tile: %u  cutoff luminance: %g", scene->LightCount(), stats[0].tileCount, LightBinning::s_maxLightsPerTile, Light::s_cutoffLuminance );
+	console->AddInfo( line );
+	for ( unsigned int v = 0; v < 3; v++ ) {
+		sprintf( line, "%s:  avg %.2f  max %u  overflowing tiles %u", names[v], stats[v].avgLightsPerTile, stats[v].maxLightsPerTile, stats[v].overflowTiles );
+		console->AddInfo( line );
+	}
+	if ( stats[0].binnedPairs > 0 ) {
+		const float tightReduction = 100.0f * ( 1.0f - ( float )stats[1].binnedPairs / ( float )stats[0].binnedPairs );
+		const float cutoffReduction = 100.0f * ( 1.0f - ( float )stats[2].binnedPairs / ( float )stats[0].binnedPairs );
+		sprintf( line, "light tile pairs reduced by %.1f%% with tight hulls, %.1f%% with the luminance cutoff", tightReduction, cutoffReduction );
+		console->AddInfo( line );
+	}
+}
 
-	Cmd * fpsCommand = new Cmd;
-	fpsCommand->name = Str( "showFPS" );
-	fpsCommand->description = Str( "Toggle FramesPerSecond counter." );
-	fpsCommand->fn = Fn_FPS;
-	m_commands.push_back( fpsCommand );
+/*
+================================
+Fn_LightCutoff
+	-sets the luminance below which a light's contribution is ignored when building its light volume
+	-0 bins lights over their whole max radius
+================================
+*/
+void Fn_LightCutoff( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args == "" ) {		
+		console->AddError( "lightCutoff :: this command requires a float arg!!!" );
+		return;
+	}
 
-	Cmd * loadSceneCommand = new Cmd;
-	loadSceneCommand->name = Str( "loadScene" );
-	loadSceneCommand->description = Str( "Load scene file at user-defined location." );
-	loadSceneCommand->fn = Fn_LoadScene;
-	m_commands.push_back( loadSceneCommand );
+	const float cutoff = ( float )atof( args.c_str() );
+	if ( cutoff < 0.0f ) {
+		console->AddError( "lightCutoff :: invalid arg!!!" );
+		return;
+	}
+	Light::s_cutoffLuminance = cutoff;
 
-	Cmd * reloadSceneCommand = new Cmd;
-	reloadSceneCommand->name = Str( "reloadScene" );
-	reloadSceneCommand->description = Str( "Reload current scene." );
-	reloadSceneCommand->fn = Fn_ReloadScene;
-	m_commands.push_back( reloadSceneCommand );
+	Scene * scene = Scene::getInstance();
+	for ( int i = 0; i < scene->LightCount(); i++ ) {
+		Light * light = NULL;
+		scene->LightByIndex( i, &light );
+		light->InvalidateLightEffectStorage();
+	}
+}
+/*
+================================
+Fn_CompressBenchmark
+	-compresses a tga or hdr texture on one thread and on the thread pool, checks that both outputs are
+	 byte identical and prints the throughput of each. Nothing is written to disk.
+================================
+*/
+void Fn_CompressBenchmark( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args == "" ) {
+		console->AddError( "compressBenchmark :: this command requires a texture path!!!" );
+		return;
+	}
 
-	Cmd * showBloomCommand = new Cmd;
-	showBloomCommand->name = Str( "showBloom" );
+	compressionInput_t input;
+	if ( !Texture::LoadCompressionInput( args.c_str(), input ) ) {
+		console->AddError( "compressBenchmark :: couldnt load texture!!!" );
+		return;
+	}
+	const double megaPixels = ( double )input.width * ( double )input.height / 1000000.0;
+
+	std::vector< uint8_t > singleThreaded;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	Texture::CompressSurface( input, singleThreaded, false );
+	const double singleSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	std::vector< uint8_t > multiThreaded;
+	startTime = std::chrono::steady_clock::now();
+	Texture::CompressSurface( input, multiThreaded, true );
+	const double multiSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	char line[256];
+	sprintf( line, "%dx%d %s", input.width, input.height, input.hdr ? "BC6H" : "BC7" );
+	console->AddInfo( line );
+	sprintf( line, "1 thread: %.3fs (%.2f MPix/s)", singleSeconds, megaPixels / singleSeconds );
+	console->AddInfo( line );
+	sprintf( line, "%u threads: %.3fs (%.2f MPix/s)", ThreadPool::getInstance()->WorkerCount(), multiSeconds, megaPixels / multiSeconds );
+	console->AddInfo( line );
+	if ( singleThreaded == multiThreaded ) {
+		console->AddInfo( "outputs are byte identical" );
+	} else {
+		console->AddError( "compressBenchmark :: outputs differ!!!" );
+	}
+}
+
+/*
+================================
+Fn_BuildCacheBenchmark
+	-times the manifest check buildScene does for every texture before compressing it.
+	 The scene's textures are checked repeatedly until count checks were made, default 500.
+	-also times hashing the content of every source once, which is what a check costs when
+	 the manifest cant trust a file's write time.
+================================
+*/
+void Fn_BuildCacheBenchmark( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int checkCount = 500;
+	if ( args != "" ) {
+		checkCount = ( unsigned int )atoi( args.c_str() );
+	}
+
+	std::vector< std::string > sources;
+	std::vector< textureUsage_t > usages;
+	resourceMap_t::iterator it_decl = MaterialDecl::s_matDecls.begin();
+	while ( it_decl != MaterialDecl::s_matDecls.end() ) {
+		textureMap::iterator it_tex = it_decl->second->m_textures.begin();
+		while ( it_tex != it_decl->second->m_textures.end() ) {
+			const std::string source = it_tex->second->mStrName;
+			if ( std::find( sources.begin(), sources.end(), source ) == sources.end() ) {
+				sources.push_back( source );
+				usages.push_back( TextureUsageFromUniform( it_tex->first ) );
+			}
+			it_tex++;
+		}
+		it_decl++;
+	}
+	if ( sources.empty() || checkCount == 0 ) {
+		console->AddError( "buildCacheBenchmark :: the scene has no textures!!!" );
+		return;
+	}
+
+	BuildManifest manifest;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	manifest.Load( BuildManifest::s_textureManifest );
+	const double loadSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	std::atomic< unsigned int > upToDateCount( 0 );
+	startTime = std::chrono::steady_clock::now();
+	ThreadPool::getInstance()->ParallelFor( checkCount, [&sources, &usages, &manifest, &upToDateCount]( unsigned int i ) {
+		const unsigned int sourceIdx = i % sources.size();
+		const Str outputPath = Texture::CompressedPath( sources[ sourceIdx ].c_str() );
+		if ( manifest.IsUpToDate( sources[ sourceIdx ].c_str(), outputPath.c_str(), Texture::CompressionSettingsHash( true, usages[ sourceIdx ] ) ) ) {
+			upToDateCount += 1;
+		}
+	} );
+	const double checkSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	startTime = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < sources.size(); i++ ) {
+		uint64_t hash;
+		BuildManifest::HashFile( sources[i].c_str(), hash );
+	}
+	const double hashSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	char line[256];
+	sprintf( line, "manifest: %u entries loaded in %.2fms", manifest.EntryCount(), loadSeconds * 1000.0 );
+	console->AddInfo( line );
+	sprintf( line, "%u checks over %u textures: %.2fms (%.1fus per texture), %u up to date", checkCount, ( unsigned int )sources.size(), checkSeconds * 1000.0, checkSeconds * 1000000.0 / checkCount, upToDateCount.load() );
+	console->AddInfo( line );
+	sprintf( line, "content hash of every source: %.2fms (%.1fus per texture)", hashSeconds * 1000.0, hashSeconds * 1000000.0 / sources.size() );
+	console->AddInfo( line );
+}
+
+/*
+================================
+Fn_TextureLoadBenchmark
+	-loads every compressed scene texture again and reports the load time and how much the peak
+	 working set and peak committed memory of the process grew. The copies are deleted afterwards.
+	-the peaks are for the whole process so they only grow if loading goes past the earlier peak.
+================================
+*/
+void Fn_TextureLoadBenchmark( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+
+	std::vector< std::string > sources;
+	resourceMap_t::iterator it_decl = MaterialDecl::s_matDecls.begin();
+	while ( it_decl != MaterialDecl::s_matDecls.end() ) {
+		textureMap::iterator it_tex = it_decl->second->m_textures.begin();
+		while ( it_tex != it_decl->second->m_textures.end() ) {
+			const std::string source = it_tex->second->mStrName;
+			const bool hasBC = it_tex->second->m_compressed || it_tex->second->m_streamed; //streamed textures are always read from their .bc
+			if ( hasBC && std::find( sources.begin(), sources.end(), source ) == sources.end() ) {
+				sources.push_back( source );
+			}
+			it_tex++;
+		}
+		it_decl++;
+	}
+	if ( sources.empty() ) {
+		console->AddError( "textureLoadBenchmark :: the scene has no compressed textures!!!" );
+		return;
+	}
+
+	PROCESS_MEMORY_COUNTERS before;
+	GetProcessMemoryInfo( GetCurrentProcess(), &before, sizeof( before ) );
+
+	std::vector< Texture * > textures;
+	double fileBytes = 0.0;
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < sources.size(); i++ ) {
+		Texture * texture = new Texture;
+		texture->InitFromFile( sources[i].c_str() );
+		textures.push_back( texture );
+	}
+	glFinish();
+	const double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	PROCESS_MEMORY_COUNTERS after;
+	GetProcessMemoryInfo( GetCurrentProcess(), &after, sizeof( after ) );
+
+	for ( unsigned int i = 0; i < textures.size(); i++ ) {
+		char compressedPath[ 2048 ];
+		RelativePathToFullPath( Texture::CompressedPath( sources[i].c_str() ).c_str(), compressedPath );
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if ( GetFileAttributesExA( compressedPath, GetFileExInfoStandard, &attributes ) != 0 ) {
+			fileBytes += ( double )attributes.nFileSizeLow + ( double )attributes.nFileSizeHigh * 4294967296.0;
+		}
+		textures[i]->Delete();
+		delete textures[i];
+	}
+
+	const double megaByte = 1024.0 * 1024.0;
+	char line[256];
+	sprintf( line, "loaded %u textures (%.1fMB of .bc files) in %.2fs (%.1fMB/s)", ( unsigned int )sources.size(), fileBytes / megaByte, seconds, fileBytes / megaByte / seconds );
+	console->AddInfo( line );
+	sprintf( line, "peak working set: %.1fMB -> %.1fMB", ( double )before.PeakWorkingSetSize / megaByte, ( double )after.PeakWorkingSetSize / megaByte );
+	console->AddInfo( line );
+	sprintf( line, "peak committed: %.1fMB -> %.1fMB", ( double )before.PeakPagefileUsage / megaByte, ( double )after.PeakPagefileUsage / megaByte );
+	console->AddInfo( line );
+}
+
+/*
+================================
+Fn_EquirectBenchmark
+	-converts a panorama to a cubemap with the scalar reference, the vectorized path on one thread
+	 and the vectorized path on the thread pool, and prints the throughput of each.
+	-without args an 8192x4096 hdr panorama is synthesized. Optional args are a relative path
+	 to a tga or hdr panorama and the face size, default 2048. Nothing is written to disk.
+================================
+*/
+void Fn_EquirectBenchmark( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	char equImg_relative[ 1024 ] = { 0 };
+	int faceSize = 2048;
+	envImage_t equirect;
+	if ( sscanf( args.c_str(), "%1023s %d", equImg_relative, &faceSize ) >= 1 ) {
+		char imgPath[ 2048 ];
+		if ( !RelativePathToFullPath( equImg_relative, imgPath ) || !EnvMapBaker::LoadEnvImage( imgPath, equirect ) ) {
+			console->AddError( "equirectBenchmark :: couldnt load panorama!!!" );
+			return;
+		}
+	} else {
+		//sky gradient with a sun, bright enough to need hdr
+		equirect.width = 8192;
+		equirect.height = 4096;
+		equirect.pixels.resize( ( size_t )equirect.width * equirect.height * 3 );
+		for ( int y = 0; y < equirect.height; y++ ) {
+			const float elevation = 1.0f - ( float )y / ( float )equirect.height;
+			for ( int x = 0; x < equirect.width; x++ ) {
+				const float dx = ( float )( x - equirect.width / 3 ) / ( float )equirect.width;
+				const float dy = ( float )( y - equirect.height / 4 ) / ( float )equirect.height;
+				const float sun = 50.0f / ( 1.0f + 20000.0f * ( dx * dx + dy * dy ) );
+				float * pixel = &equirect.pixels[ ( ( size_t )y * equirect.width + x ) * 3 ];
+				pixel[0] = 0.2f + 0.3f * elevation + sun;
+				pixel[1] = 0.3f + 0.4f * elevation + sun;
+				pixel[2] = 0.5f + 0.5f * elevation + sun * 0.8f;
+			}
+		}
+	}
+	if ( faceSize < 1 ) {
+		console->AddError( "equirectBenchmark :: invalid face size!!!" );
+		return;
+	}
+	const double megaPixels = 6.0 * ( double )faceSize * ( double )faceSize / 1000000.0;
+
+	envImage_t scalar;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	EnvMapBaker::EquirectToCubemap( equirect, faceSize, 1, scalar, false, false );
+	const double scalarSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	envImage_t vectorized;
+	startTime = std::chrono::steady_clock::now();
+	EnvMapBaker::EquirectToCubemap( equirect, faceSize, 1, vectorized, true, false );
+	const double vectorSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	envImage_t multiThreaded;
+	startTime = std::chrono::steady_clock::now();
+	EnvMapBaker::EquirectToCubemap( equirect, faceSize, 1, multiThreaded, true, true );
+	const double multiSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	//the vectorized atan2 is an approximation, compare it relative to the texel value
+	float maxError = 0.0f;
+	for ( size_t i = 0; i < scalar.pixels.size(); i++ ) {
+		const float error = fabsf( scalar.pixels[i] - vectorized.pixels[i] ) / std::max( fabsf( scalar.pixels[i] ), 1.0f );
+		maxError = std::max( maxError, error );
+	}
+
+	char line[256];
+	sprintf( line, "%dx%d panorama to %d faces", equirect.width, equirect.height, faceSize );
+	console->AddInfo( line );
+	sprintf( line, "scalar: %.3fs (%.2f MPix/s)", scalarSeconds, megaPixels / scalarSeconds );
+	console->AddInfo( line );
+	sprintf( line, "vectorized: %.3fs (%.2f MPix/s)", vectorSeconds, megaPixels / vectorSeconds );
+	console->AddInfo( line );
+	sprintf( line, "vectorized %u threads: %.3fs (%.2f MPix/s)", ThreadPool::getInstance()->WorkerCount(), multiSeconds, megaPixels / multiSeconds );
+	console->AddInfo( line );
+	sprintf( line, "max relative difference to scalar: %g", maxError );
+	console->AddInfo( line );
+	if ( vectorized.pixels != multiThreaded.pixels ) {
+		console->AddError( "equirectBenchmark :: multithreaded output differs!!!" );
+	}
+}
+
+/*
+================================
+Fn_TextureStreaming
+	-args: "0" or "1" to stream textures loaded from now on, optional second arg is the budget in MB
+	-without args prints the streaming stats
+================================
+*/
+void Fn_TextureStreaming( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	const double megaByte = 1024.0 * 1024.0;
+	if ( args == "" ) {
+		const StreamingScheduler & scheduler = TextureStreamer::getInstance()->GetScheduler();
+		char line[256];
+		sprintf( line, "streaming %s  textures: %u  loads in flight: %u", TextureStreamer::s_enabled ? "on" : "off", scheduler.TextureCount(), scheduler.LoadsInFlight() );
+		console->AddInfo( line );
+		sprintf( line, "committed: %.1fMB of %.1fMB  mip tails: %.1fMB", ( double )scheduler.CommittedBytes() / megaByte, ( double )StreamingScheduler::s_budget / megaByte, ( double )scheduler.TailBytes() / megaByte );
+		console->AddInfo( line );
+		return;
+	}
+
+	int argVal = 0;
+	unsigned int budget = 0;
+	const int argCount = sscanf( args.c_str(), "%d %u", &argVal, &budget );
+	if ( argCount < 1 || argVal < 0 || argVal > 1 || ( argCount == 2 && budget == 0 ) ) {
+		console->AddError( "textureStreaming :: requires 0 or 1 and an optional budget in MB!!!" );
+		return;
+	}
+	TextureStreamer::s_enabled = ( argVal == 1 );
+	if ( argCount == 2 ) {
+		StreamingScheduler::s_budget = ( size_t )budget * 1024 * 1024;
+	}
+}
+
+/*
+================================
+Fn_SimTextureStreaming
+	-runs the streaming scheduler for 2000 frames on synthetic textures with the current budget.
+	-the simulation is run twice to verify the schedule is deterministic, and fails when a frame
+	 goes over budget.
+	-optional arg is the texture count
+================================
+*/
+void Fn_SimTextureStreaming( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int textureCount = 500;
+	if ( args != "" ) {
+		textureCount = ( unsigned int )atoi( args.c_str() );
+		if ( textureCount == 0 ) {
+			console->AddError( "simTextureStreaming :: invalid texture count!!!" );
+			return;
+		}
+	}
+
+	const unsigned int frameCount = 2000;
+	const unsigned int seed = 1;
+	const streamSimStats_t stats = StreamingScheduler::Simulate( textureCount, frameCount, seed );
+	const streamSimStats_t rerun = StreamingScheduler::Simulate( textureCount, frameCount, seed );
+
+	const double megaByte = 1024.0 * 1024.0;
+	char line[256];
+	sprintf( line, "textures: %u  frames: %u  budget: %.1fMB", textureCount, stats.frames, ( double )StreamingScheduler::s_budget / megaByte );
+	console->AddInfo( line );
+	sprintf( line, "loads: %u  evictions: %u  peak committed: %.1fMB  frames over budget: %u", stats.loads, stats.evictions, ( double )stats.peakCommittedBytes / megaByte, stats.overBudgetFrames );
+	console->AddInfo( line );
+	sprintf( line, "visible textures are %.2f levels coarser than wanted on average", stats.avgLevelGap );
+	console->AddInfo( line );
+	sprintf( line, "checksum: %08x", stats.checksum );
+	console->AddInfo( line );
+	if ( stats.checksum != rerun.checksum ) {
+		console->AddError( "simTextureStreaming :: schedule isnt deterministic!!!" );
+	}
+	if ( stats.overBudgetFrames > 0 ) {
+		sprintf( line, "simTextureStreaming :: %u frames committed more than the budget while the mip tails fit!!!", stats.overBudgetFrames );
+		console->AddError( line );
+	}
+}
+
+/*
+================================
+Fn_IrradianceSHError
+	-compares the SH of an env probe cubemap with its convolved _irr cubemap texel by texel and
+	 times the projection on one thread and on the thread pool.
+================================
+*/
+void Fn_IrradianceSHError( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+
+	args.Strip();
+	const Str cubemap_relative = args;
+	if ( cubemap_relative.Length() < 5 ) {
+		console->AddError( "irradianceSHError :: RelativePath arg required!!!" );
+		return;
+	}
+	Str irradiance_relative = cubemap_relative.Substring( 0, cubemap_relative.Length() - 4 );
+	irradiance_relative.Append( "_irr.hdr" );
+	char imgPath[ 2048 ];
+	envImage_t cubemap;
+	envImage_t irradiance;
+	if ( !RelativePathToFullPath( cubemap_relative.c_str(), imgPath ) || !EnvMapBaker::LoadEnvImage( imgPath, cubemap ) || cubemap.width != cubemap.height * 6 ) {
+		console->AddError( "irradianceSHError :: couldnt load cubemap!!!" );
+		return;
+	}
+	if ( !RelativePathToFullPath( irradiance_relative.c_str(), imgPath ) || !EnvMapBaker::LoadEnvImage( imgPath, irradiance ) || irradiance.width != irradiance.height * 6 ) {
+		console->AddError( "irradianceSHError :: couldnt load irradiance map, run computeIrradianceMap first!!!" );
+		return;
+	}
+
+	irradianceSH_t sh;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	EnvMapBaker::ProjectIrradianceSH( cubemap, sh, false );
+	const double singleSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	irradianceSH_t shThreaded;
+	startTime = std::chrono::steady_clock::now();
+	EnvMapBaker::ProjectIrradianceSH( cubemap, shThreaded, true );
+	const double multiSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	//relative error of the luminance, texels are weighted equally
+	const int faceSize = irradiance.height;
+	double sumSquaredError = 0.0;
+	double sumError = 0.0;
+	float maxError = 0.0f;
+	for ( int face = 0; face < 6; face++ ) {
+		for ( int t = 0; t < faceSize; t++ ) {
+			for ( int s = 0; s < faceSize; s++ ) {
+				const float * texel = &irradiance.pixels[ ( ( size_t )t * irradiance.width + face * faceSize + s ) * 3 ];
+				const Vec3 dir = EnvMapBaker::CubeTexelDirection( face, ( float )s + 0.5f, ( float )t + 0.5f, faceSize );
+				const Vec3 value = EnvMapBaker::EvaluateIrradianceSH( sh, dir );
+				const float reference = 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+				const float estimate = 0.2126f * value.x + 0.7152f * value.y + 0.0722f * value.z;
+				const float error = fabsf( estimate - reference ) / std::max( reference, 0.0001f );
+				sumSquaredError += ( double )error * error;
+				sumError += error;
+				maxError = std::max( maxError, error );
+			}
+		}
+	}
+	const double texelCount = 6.0 * ( double )faceSize * ( double )faceSize;
+	const int blocks = ( faceSize + 3 ) / 4;
+	const unsigned int cubemapBytes = ( unsigned int )( blocks * blocks * 16 * 6 );
+
+	char line[256];
+	sprintf( line, "%d faces against %d irradiance faces", cubemap.height, faceSize );
+	console->AddInfo( line );
+	sprintf( line, "relative error  mean: %.4f  rms: %.4f  max: %.4f", sumError / texelCount, sqrt( sumSquaredError / texelCount ), maxError );
+	console->AddInfo( line );
+	sprintf( line, "projection  1 thread: %.2fms  %u threads: %.2fms", singleSeconds * 1000.0, ThreadPool::getInstance()->WorkerCount(), multiSeconds * 1000.0 );
+	console->AddInfo( line );
+	sprintf( line, "storage  SH: %u bytes  BC6H cubemap: %u bytes", ( unsigned int )sizeof( irradianceSH_t ), cubemapBytes );
+	console->AddInfo( line );
+	if ( memcmp( &sh, &shThreaded, sizeof( irradianceSH_t ) ) != 0 ) {
+		console->AddError( "irradianceSHError :: multithreaded projection differs!!!" );
+	}
+}
+
+/*
+================================
+Fn_IrradianceSH
+	-args: "0" to light probes with their irradiance cubemaps, "1" to use their SH when baked
+================================
+*/
+void Fn_IrradianceSH( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args == "0" ) {
+		EnvProbe::s_useIrradianceSH = false;
+	} else if ( args == "1" ) {
+		EnvProbe::s_useIrradianceSH = true;
+	} else {
+		console->AddError( "irradianceSH :: requires 0 or 1!!!" );
+		return;
+	}
+	console->AddInfo( "irradianceSH :: takes effect on the next loadScene" );
+}
+
+/*
+================================
+Fn_PrefilterAccuracy
+	-prefilters an environment that is linear in the direction, 1 + 0.5 * L per channel with L
+	 along x, y and z, and compares every level against the analytic result 1 + 0.5 * N * GGXLobeCosine.
+	-optional arg is the sample count, default ENV_PROBE_SAMPLES.
+================================
+*/
+void Fn_PrefilterAccuracy( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	int sampleCount = ENV_PROBE_SAMPLES;
+	if ( args != "" && ( sscanf( args.c_str(), "%d", &sampleCount ) != 1 || sampleCount < 1 ) ) {
+		console->AddError( "prefilterAccuracy :: invalid sample count!!!" );
+		return;
+	}
+
+	const int faceSize = ENV_PROBE_SIZE;
+	envImage_t environment;
+	environment.width = faceSize * 6;
+	environment.height = faceSize;
+	environment.pixels.resize( ( size_t )environment.width * environment.height * 3 );
+	for ( int face = 0; face < 6; face++ ) {
+		for ( int t = 0; t < faceSize; t++ ) {
+			for ( int s = 0; s < faceSize; s++ ) {
+				const Vec3 dir = EnvMapBaker::CubeTexelDirection( face, ( float )s + 0.5f, ( float )t + 0.5f, faceSize );
+				float * texel = &environment.pixels[ ( ( size_t )t * environment.width + face * faceSize + s ) * 3 ];
+				texel[0] = 1.0f + 0.5f * dir.x;
+				texel[1] = 1.0f + 0.5f * dir.y;
+				texel[2] = 1.0f + 0.5f * dir.z;
+			}
+		}
+	}
+
+	std::vector< envImage_t > levels;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	EnvMapBaker::PrefilterGGX( environment, faceSize, ENV_PROBE_LEVELS, ( unsigned int )sampleCount, levels, true );
+	const double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	char line[256];
+	sprintf( line, "%d faces, %d levels, %d samples: %.3fs on %u threads", faceSize, ENV_PROBE_LEVELS, sampleCount, seconds, ThreadPool::getInstance()->WorkerCount() );
+	console->AddInfo( line );
+	for ( unsigned int level = 0; level < levels.size(); level++ ) {
+		const float roughness = ( float )level / ( float )( ENV_PROBE_LEVELS - 1 );
+		const float lobeCosine = EnvMapBaker::GGXLobeCosine( roughness );
+		const int levelSize = levels[ level ].height;
+		double sumError = 0.0;
+		float maxError = 0.0f;
+		for ( int face = 0; face < 6; face++ ) {
+			for ( int t = 0; t < levelSize; t++ ) {
+				for ( int s = 0; s < levelSize; s++ ) {
+					const Vec3 normal = EnvMapBaker::CubeTexelDirection( face, ( float )s + 0.5f, ( float )t + 0.5f, levelSize );
+					const float reference[3] = { 1.0f + 0.5f * normal.x * lobeCosine, 1.0f + 0.5f * normal.y * lobeCosine, 1.0f + 0.5f * normal.z * lobeCosine };
+					const float * texel = &levels[ level ].pixels[ ( ( size_t )t * levels[ level ].width + face * levelSize + s ) * 3 ];
+					for ( int c = 0; c < 3; c++ ) {
+						const float error = fabsf( texel[c] - reference[c] );
+						sumError += error;
+						maxError = std::max( maxError, error );
+					}
+				}
+			}
+		}
+		sprintf( line, "level %u roughness %.2f: mean error %.6f max error %.6f", level, roughness, sumError / ( 18.0 * levelSize * levelSize ), maxError );
+		console->AddInfo( line );
+	}
+}
+
+/*
+================================
+MakeTestStripCubemap
+	-strip cubemap whose blocks are tagged with their layer, level, face and block coordinates
+================================
+*/
+static void MakeTestStripCubemap( compressedLevels_t & cubemap, const unsigned int layer, const int faceSize, const unsigned int levelCount ) {
+	cubemap.width = faceSize * 6;
+	cubemap.height = faceSize;
+	cubemap.mipCount = levelCount;
+	cubemap.chanCount = 3;
+	cubemap.internalFormat = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB;
+	cubemap.firstLevel = 0;
+	cubemap.data.clear();
+	cubemap.offsets.clear();
+	for ( unsigned int level = 0; level < levelCount; level++ ) {
+		const unsigned int faceBlocks = ( unsigned int )( faceSize >> level ) / 4;
+		cubemap.offsets.push_back( cubemap.data.size() );
+		for ( unsigned int by = 0; by < faceBlocks; by++ ) {
+			for ( unsigned int face = 0; face < 6; face++ ) {
+				for ( unsigned int bx = 0; bx < faceBlocks; bx++ ) {
+					const uint8_t block[16] = { ( uint8_t )layer, ( uint8_t )level, ( uint8_t )face, ( uint8_t )bx, ( uint8_t )by, 1 };
+					cubemap.data.insert( cubemap.data.end(), block, block + 16 );
+				}
+			}
+		}
+	}
+}
+
+/*
+================================
+Fn_ProbeArrayTest
+	-packs synthetic strip cubemaps into cubemap array layers and checks where every block lands,
+	 then checks the nearest probe assignment of instances
+================================
+*/
+void Fn_ProbeArrayTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	char line[256];
+	bool passed = true;
+
+	//layer 0 couldnt be read, 1 is complete, 2 only has its first level and 3 is the wrong size
+	std::vector< compressedLevels_t > cubemaps( 4 );
+	cubemaps[0].width = 0;
+	cubemaps[0].height = 0;
+	cubemaps[0].firstLevel = 0;
+	MakeTestStripCubemap( cubemaps[1], 1, 16, 3 );
+	MakeTestStripCubemap( cubemaps[2], 2, 16, 1 );
+	MakeTestStripCubemap( cubemaps[3], 3, 8, 2 );
+
+	cubemapArrayData_t packed;
+	if ( !CubemapArrayTexture::PackLayers( cubemaps, ENV_PROBE_LEVELS, packed ) ) {
+		console->AddError( "probeArrayTest :: PackLayers failed!!!" );
+		return;
+	}
+	sprintf( line, "faces %d, layers %u, levels %u (16, 8 and 4 texel faces)", packed.faceSize, packed.layerCount, packed.mipCount );
+	console->AddInfo( line );
+	if ( packed.faceSize != 16 || packed.layerCount != 4 || packed.mipCount != 3 ) {
+		console->AddError( "probeArrayTest :: wrong array dimensions!!!" );
+		return;
+	}
+
+	const bool expectedMissing[4] = { true, false, true, true };
+	for ( unsigned int layer = 0; layer < 4; layer++ ) {
+		if ( packed.missingLayers[ layer ] != expectedMissing[ layer ] ) {
+			sprintf( line, "probeArrayTest :: layer %u missing flag is wrong!!!", layer );
+			console->AddError( line );
+			passed = false;
+		}
+	}
+
+	//blocks are layer major, then face, then block row
+	unsigned int blockCount = 0;
+	for ( unsigned int level = 0; level < packed.mipCount; level++ ) {
+		const unsigned int faceBlocks = ( unsigned int )( packed.faceSize >> level ) / 4;
+		if ( packed.levels[ level ].size() != ( size_t )faceBlocks * faceBlocks * 16 * 6 * packed.layerCount ) {
+			sprintf( line, "probeArrayTest :: level %u has the wrong size!!!", level );
+			console->AddError( line );
+			passed = false;
+			continue;
+		}
+		for ( unsigned int layer = 0; layer < packed.layerCount; layer++ ) {
+			const bool present = ( layer == 1 ) || ( layer == 2 && level == 0 );
+			for ( unsigned int face = 0; face < 6; face++ ) {
+				for ( unsigned int by = 0; by < faceBlocks; by++ ) {
+					for ( unsigned int bx = 0; bx < faceBlocks; bx++ ) {
+						const uint8_t * block = &packed.levels[ level ][ ( ( ( size_t )( layer * 6 + face ) * faceBlocks + by ) * faceBlocks + bx ) * 16 ];
+						uint8_t expected[16] = { 0 };
+						if ( present ) {
+							const uint8_t tag[6] = { ( uint8_t )layer, ( uint8_t )level, ( uint8_t )face, ( uint8_t )bx, ( uint8_t )by, 1 };
+							memcpy( expected, tag, sizeof( tag ) );
+						}
+						if ( memcmp( block, expected, 16 ) != 0 ) {
+							if ( passed ) {
+								sprintf( line, "probeArrayTest :: wrong block at level %u layer %u face %u block %u %u!!!", level, layer, face, bx, by );
+								console->AddError( line );
+							}
+							passed = false;
+						}
+						blockCount++;
+					}
+				}
+			}
+		}
+	}
+	sprintf( line, "checked %u blocks", blockCount );
+	console->AddInfo( line );
+
+	//instances pick the nearest probe, the first probe wins a tie
+	std::vector< Vec3 > probePositions;
+	probePositions.push_back( Vec3( 0.0f, 0.0f, 0.0f ) );
+	probePositions.push_back( Vec3( 10.0f, 0.0f, 0.0f ) );
+	probePositions.push_back( Vec3( 0.0f, 10.0f, 0.0f ) );
+	std::vector< Vec3 > points;
+	points.push_back( Vec3( 1.0f, 0.0f, 0.0f ) );
+	points.push_back( Vec3( 9.0f, 1.0f, 0.0f ) );
+	points.push_back( Vec3( 0.0f, 7.0f, -2.0f ) );
+	points.push_back( Vec3( 5.0f, 0.0f, 0.0f ) );
+	points.push_back( Vec3( 5.0f, 5.0f, 0.0f ) );
+	const unsigned int expectedProbes[5] = { 0, 1, 2, 0, 0 };
+	std::vector< unsigned int > probeIndices;
+	EnvProbe::AssignNearestProbes( points, probePositions, probeIndices );
+	for ( unsigned int i = 0; i < points.size(); i++ ) {
+		if ( probeIndices[i] != expectedProbes[i] ) {
+			sprintf( line, "probeArrayTest :: point %u got probe %u instead of %u!!!", i, probeIndices[i], expectedProbes[i] );
+			console->AddError( line );
+			passed = false;
+		}
+	}
+
+	if ( passed ) {
+		console->AddInfo( "probeArrayTest :: passed" );
+	}
+}
+
+/*
+================================
+Fn_UniformCache
+	-args: "0" to query uniform locations and check for errors on every set like before the cache, "1" to use the reflected tables
+	-compare the uniform counts of glStats with it on and off
+================================
+*/
+void Fn_UniformCache( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args == "0" ) {
+		Shader::s_uniformCache = false;
+	} else if ( args == "1" ) {
+		Shader::s_uniformCache = true;
+	} else {
+		console->AddError( "uniformCache :: requires 0 or 1!!!" );
+		return;
+	}
+
+	char line[256];
+	sprintf( line, "last frame: %u uniform sets, %u lookups, %u error checks, %u uniform block updates and binds", GLRecorder::LastFrame( GLCALL_UNIFORM ), GLRecorder::LastFrame( GLCALL_UNIFORM_LOOKUP ), GLRecorder::LastFrame( GLCALL_ERROR_CHECK ), GLRecorder::LastFrame( GLCALL_UNIFORM_BLOCK ) );
+	console->AddInfo( line );
+}
+
+/*
+================================
+Fn_ReflectTableTest
+	-builds perfect hash tables of synthetic uniform names and checks every name finds its own entry
+================================
+*/
+void Fn_ReflectTableTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	char line[256];
+	bool passed = true;
+
+	const unsigned int counts[4] = { 1, 7, 64, 500 };
+	for ( unsigned int c = 0; c < 4; c++ ) {
+		std::vector< reflectEntry_t > entries;
+		for ( unsigned int i = 0; i < counts[c]; i++ ) {
+			char name[64];
+			sprintf( name, "light_data[%u].pos", i );
+			reflectEntry_t entry;
+			entry.hash = reflectTable_t::HashName( name );
+			entry.value = ( GLint )i;
+			entry.type = GL_FLOAT_VEC3;
+			entry.size = 1;
+			entries.push_back( entry );
+		}
+		entries.push_back( entries[0] ); //names can be reflected twice
+
+		reflectTable_t table;
+		table.Build( entries );
+		unsigned int found = 0;
+		unsigned int falseHits = 0;
+		for ( unsigned int i = 0; i < counts[c]; i++ ) {
+			char name[64];
+			sprintf( name, "light_data[%u].pos", i );
+			const reflectEntry_t * entry = table.Find( name );
+			if ( entry != NULL && entry->value == ( GLint )i ) {
+				found++;
+			}
+			sprintf( name, "light_data[%u].dir", i );
+			if ( table.Find( name ) != NULL ) {
+				falseHits++;
+			}
+		}
+		sprintf( line, "%u names: %u slots, %u found, %u false hits", counts[c], ( unsigned int )table.slots.size(), found, falseHits );
+		console->AddInfo( line );
+		passed = passed && ( found == counts[c] ) && ( falseHits == 0 ) && ( table.Count() == counts[c] );
+	}
+
+	reflectTable_t empty;
+	empty.Build( std::vector< reflectEntry_t >() );
+	passed = passed && ( empty.Find( "view" ) == NULL );
+
+	if ( passed ) {
+		console->AddInfo( "reflectTableTest :: passed" );
+	} else {
+		console->AddError( "reflectTableTest :: failed!!!" );
+	}
+}
+
+/*
+================================
+TimeProgramLoads
+	-loads every program again without keeping it, returns the seconds it took
+================================
+*/
+static double TimeProgramLoads( const std::vector< std::string > & prefixes, const std::vector< std::string > & permutations ) {
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < prefixes.size(); i++ ) {
+		Shader * shader = NULL;
+		shader = shader->LoadShader( prefixes[i].c_str(), permutations[i].c_str() );
+		if ( shader != NULL ) {
+			shader->DeleteProgram();
+			delete shader;
+		}
+	}
+	return std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+/*
+================================
+Fn_ProgramCache
+	-args: "0" to always compile programs from source, "1" to load them from the program cache
+	 when it has an entry, "time" to load every loaded program again both ways and compare
+	-prints the cache hits and misses and the time spent loading programs so far
+================================
+*/
+void Fn_ProgramCache( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	char line[256];
+	if ( args == "0" ) {
+		ProgramCache::s_enabled = false;
+	} else if ( args == "1" ) {
+		ProgramCache::s_enabled = true;
+	} else if ( args == "time" ) {
+		std::vector< std::string > prefixes;
+		std::vector< std::string > permutations;
+		Shader::LoadedPermutations( prefixes, permutations );
+
+		//keep the counters of startup, the timing runs would skew them
+		const bool enabled = ProgramCache::s_enabled;
+		const unsigned int hits = ProgramCache::s_hits;
+		const unsigned int misses = ProgramCache::s_misses;
+		const double loadSeconds = ProgramCache::s_loadSeconds;
+
+		ProgramCache::s_enabled = false;
+		const double sourceSeconds = TimeProgramLoads( prefixes, permutations );
+		ProgramCache::s_enabled = true;
+		TimeProgramLoads( prefixes, permutations ); //makes sure every program has an entry
+		const unsigned int warmHits = ProgramCache::s_hits;
+		const double cacheSeconds = TimeProgramLoads( prefixes, permutations );
+		const unsigned int timedHits = ProgramCache::s_hits - warmHits;
+
+		ProgramCache::s_enabled = enabled;
+		ProgramCache::s_hits = hits;
+		ProgramCache::s_misses = misses;
+		ProgramCache::s_loadSeconds = loadSeconds;
+
+		sprintf( line, "%u programs: %.1f ms from source, %.1f ms from the cache (%u hits), %.1f ms saved", ( unsigned int )prefixes.size(), sourceSeconds * 1000.0, cacheSeconds * 1000.0, timedHits, ( sourceSeconds - cacheSeconds ) * 1000.0 );
+		console->AddInfo( line );
+		return;
+	} else if ( args != "" ) {
+		console->AddError( "programCache :: requires 0, 1 or time!!!" );
+		return;
+	}
+
+	sprintf( line, "program cache %s: %u hits, %u misses, %.1f ms loading programs", ProgramCache::s_enabled ? "on" : "off", ProgramCache::s_hits, ProgramCache::s_misses, ProgramCache::s_loadSeconds * 1000.0 );
+	console->AddInfo( line );
+}
+
+/*
+================================
+Fn_ProgramCacheTest
+	-writes a cache entry with a fake binary and checks it is only read back with the key it was made with
+================================
+*/
+void Fn_ProgramCacheTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	char line[256];
+	bool passed = true;
+
+	const char * entryPath = "data\\generated\\shader\\programCacheTest.bin";
+	const unsigned int stageTypes[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	const char * sources[2] = { "#version 430\nvoid main() { gl_Position = vec4( 0.0 ); }\n", "#version 430\nout vec4 color;\nvoid main() { color = vec4( 1.0 ); }\n" };
+	const programKey_t key = ProgramCache::MakeKey( 2, stageTypes, sources, "vendor", "renderer", "4.3.0 driver 1.0" );
+
+	programBinary_t binary;
+	binary.format = 0x1234;
+	for ( unsigned int i = 0; i < 1000; i++ ) {
+		binary.data.push_back( ( uint8_t )( i * 7 ) );
+	}
+	if ( !ProgramCache::Write( entryPath, key, binary ) ) {
+		console->AddError( "programCacheTest :: failed to write the entry!!!" );
+		return;
+	}
+
+	programBinary_t readBack;
+	if ( !ProgramCache::Read( entryPath, key, readBack ) || readBack.format != binary.format || readBack.data != binary.data ) {
+		console->AddError( "programCacheTest :: entry didnt read back!!!" );
+		passed = false;
+	}
+
+	//every part of the key has to invalidate the entry
+	const char * editedSources[2] = { sources[0], "#version 430\nout vec4 color;\nvoid main() { color = vec4( 0.5 ); }\n" };
+	const unsigned int swappedTypes[2] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER };
+	const char * movedSources[2] = { "#version 430\nvoid main() { gl_Position = vec4( 0.0 ); }\n#version 430\n", "out vec4 color;\nvoid main() { color = vec4( 1.0 ); }\n" };
+	const char * staleNames[6] = { "edited source", "stage type", "text moved between stages", "vendor", "renderer", "driver version" };
+	const programKey_t staleKeys[6] = {
+		ProgramCache::MakeKey( 2, stageTypes, editedSources, "vendor", "renderer", "4.3.0 driver 1.0" ),
+		ProgramCache::MakeKey( 2, swappedTypes, sources, "vendor", "renderer", "4.3.0 driver 1.0" ),
+		ProgramCache::MakeKey( 2, stageTypes, movedSources, "vendor", "renderer", "4.3.0 driver 1.0" ),
+		ProgramCache::MakeKey( 2, stageTypes, sources, "other vendor", "renderer", "4.3.0 driver 1.0" ),
+		ProgramCache::MakeKey( 2, stageTypes, sources, "vendor", "other renderer", "4.3.0 driver 1.0" ),
+		ProgramCache::MakeKey( 2, stageTypes, sources, "vendor", "renderer", "4.3.0 driver 1.1" ),
+	};
+	for ( unsigned int i = 0; i < 6; i++ ) {
+		if ( ProgramCache::Read( entryPath, staleKeys[i], readBack ) ) {
+			sprintf( line, "programCacheTest :: entry still used after changing the %s!!!", staleNames[i] );
+			console->AddError( line );
+			passed = false;
+		}
+	}
+
+	//damaged entries are misses
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( entryPath, fullPath );
+	std::vector< uint8_t > fileBytes;
+	FILE * fs = fopen( fullPath, "rb" );
+	if ( fs ) {
+		uint8_t buffer[ 4096 ];
+		size_t readSize = 0;
+		while ( ( readSize = fread( buffer, 1, sizeof( buffer ), fs ) ) > 0 ) {
+			fileBytes.insert( fileBytes.end(), buffer, buffer + readSize );
+		}
+		fclose( fs );
+	}
+	if ( fileBytes.size() <= binary.data.size() ) {
+		sprintf( line, "programCacheTest :: entry has only %u bytes!!!", ( unsigned int )fileBytes.size() );
+		console->AddError( line );
+		passed = false;
+	} else {
+		for ( unsigned int damage = 0; damage < 2; damage++ ) {
+			std::vector< uint8_t > damaged = fileBytes;
+			if ( damage == 0 ) {
+				damaged.resize( damaged.size() - 100 );
+			} else {
+				damaged[ damaged.size() / 2 ] ^= 0xff;
+			}
+			fs = fopen( fullPath, "wb" );
+			if ( fs ) {
+				fwrite( damaged.data(), 1, damaged.size(), fs );
+				fclose( fs );
+			}
+			if ( ProgramCache::Read( entryPath, key, readBack ) ) {
+				console->AddError( damage == 0 ? "programCacheTest :: truncated entry was used!!!" : "programCacheTest :: corrupted entry was used!!!" );
+				passed = false;
+			}
+		}
+	}
+
+	remove( fullPath );
+	if ( ProgramCache::Read( entryPath, key, readBack ) ) {
+		console->AddError( "programCacheTest :: missing entry was used!!!" );
+		passed = false;
+	}
+
+	if ( passed ) {
+		console->AddInfo( "programCacheTest :: passed" );
+	}
+}
+
+/*
+================================
+Fn_ShaderPreprocessorTest
+	-expands virtual shader files and checks the include, #line and define output
+================================
+*/
+void Fn_ShaderPreprocessorTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	bool passed = true;
+
+	//a and b include each other, the stage includes both
+	ShaderPreprocessor::SetFileText( "test\\stage.glsl", "#version 430 core\n#include \"inc/a.glsl\"\n#include \"inc/b.glsl\"\nvoid main() {}\n" );
+	ShaderPreprocessor::SetFileText( "test\\inc\\a.glsl", "#include \"b.glsl\"\nfloat a;\n" );
+	ShaderPreprocessor::SetFileText( "test\\inc\\b.glsl", "#include \"../inc/a.glsl\"\r\nfloat b;\r\n" );
+	ShaderPreprocessor::SetFileText( "test\\missing.glsl", "#version 430 core\n#include \"nothere.glsl\"\n" );
+	ShaderPreprocessor::SetFileText( "test\\version.glsl", "#version 430 core\n#include \"inc/version.glsl\"\n" );
+	ShaderPreprocessor::SetFileText( "test\\inc\\version.glsl", "#version 430 core\n" );
+
+	shaderSource_t source;
+	if ( !ShaderPreprocessor::Process( "test/./inc/../stage.glsl", "MAX_LIGHTS_PER_TILE=8", source ) ) {
+		console->AddError( "shaderPreprocessorTest :: stage failed to expand!!!" );
+		passed = false;
+	} else {
+		const std::string & text = source.text;
+		const size_t body = text.find( "#line 2 0\n" );
+		const std::string expectedBody = "#line 2 0\n#line 1 1\n#line 1 2\n\nfloat b;\n#line 2 1\nfloat a;\n#line 3 0\n\nvoid main() {}\n";
+		if ( text.compare( 0, 18, "#version 430 core\n" ) != 0 || body == std::string::npos || text.substr( body ) != expectedBody ) {
+			console->AddError( "shaderPreprocessorTest :: includes expanded wrong!!!" );
+			passed = false;
+		}
+
+		//the permutation replaces the global define instead of defining it twice
+		const size_t define = text.find( "#define MAX_LIGHTS_PER_TILE " );
+		if ( define == std::string::npos || define > body || text.compare( define, 30, "#define MAX_LIGHTS_PER_TILE 8\n" ) != 0 || text.find( "#define MAX_LIGHTS_PER_TILE ", define + 1 ) != std::string::npos ) {
+			console->AddError( "shaderPreprocessorTest :: permutation define missing!!!" );
+			passed = false;
+		}
+
+		if ( source.files.size() != 3 || source.files[0] != "test\\stage.glsl" || source.files[1] != "test\\inc\\a.glsl" || source.files[2] != "test\\inc\\b.glsl" ) {
+			console->AddError( "shaderPreprocessorTest :: wrong source string files!!!" );
+			passed = false;
+		}
+	}
+
+	if ( ShaderPreprocessor::Process( "test\\missing.glsl", NULL, source ) ) {
+		console->AddError( "shaderPreprocessorTest :: missing include wasnt an error!!!" );
+		passed = false;
+	}
+	if ( ShaderPreprocessor::Process( "test\\version.glsl", NULL, source ) ) {
+		console->AddError( "shaderPreprocessorTest :: #version in an include wasnt an error!!!" );
+		passed = false;
+	}
+
+	if ( ShaderPreprocessor::PermutationKey( "SHADOWS=0,IBL=0" ) != "IBL=0 SHADOWS=0" || ShaderPreprocessor::PermutationKey( " IBL=0\tSHADOWS=0 " ) != "IBL=0 SHADOWS=0" ||
+		ShaderPreprocessor::PermutationKey( "SHADOWS" ) != "SHADOWS=1" || ShaderPreprocessor::PermutationKey( "SHADOWS=0 SHADOWS=1" ) != "SHADOWS=1" ) {
+		console->AddError( "shaderPreprocessorTest :: permutation keys differ!!!" );
+		passed = false;
+	}
+
+	//a real stage and its includes are only read from disk once
+	ShaderPreprocessor::ClearFiles();
+	const unsigned int readsBefore = ShaderPreprocessor::s_fileReads;
+	ShaderPreprocessor::Process( "data\\shader\\cook-torrance_fshader.glsl", "SHADOWS=0 IBL=0", source );
+	const unsigned int readsFirst = ShaderPreprocessor::s_fileReads - readsBefore;
+	ShaderPreprocessor::Process( "data\\shader\\cook-torrance_fshader.glsl", NULL, source );
+	if ( readsFirst != source.files.size() || ShaderPreprocessor::s_fileReads - readsBefore != readsFirst ) {
+		console->AddError( "shaderPreprocessorTest :: shader files read more than once!!!" );
+		passed = false;
+	}
+	ShaderPreprocessor::ClearFiles(); //drop the virtual files
+
+	if ( passed ) {
+		console->AddInfo( "shaderPreprocessorTest :: passed" );
+	}
+}
+
+/*
+================================
+Fn_ShaderPermutationTest
+	-draws the loaded scene with every material decl built as each SHADOWS and IBL permutation.
+	 Uniforms of a feature the permutation leaves out must not be set, and the draws must not
+	 raise a gl error. The decls get their own permutation back afterwards.
+================================
+*/
+void Fn_ShaderPermutationTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( MaterialDecl::s_declsById.empty() ) {
+		console->AddError( "shaderPermutationTest :: no material decls, load a scene first!!!" );
+		return;
+	}
+
+	struct permutation_t {
+		const char * defines;
+		bool shadows;
+		bool ibl;
+	};
+	const permutation_t permutations[ 4 ] = { { "SHADOWS=1 IBL=1", true, true }, { "SHADOWS=0 IBL=1", false, true }, { "SHADOWS=1 IBL=0", true, false }, { "SHADOWS=0 IBL=0", false, false } };
+
+	std::vector< std::string > declDefines;
+	for ( size_t i = 0; i < MaterialDecl::s_declsById.size(); i++ ) {
+		declDefines.push_back( MaterialDecl::s_declsById[i]->m_shaderDefines );
+	}
+
+	const Mat4 view = camera.GetView();
+	const Mat4 projection = camera.GetProjection();
+	unsigned int failures = 0;
+	char line[256];
+	for ( unsigned int p = 0; p < 4; p++ ) {
+		const permutation_t & permutation = permutations[p];
+		bool built = true;
+		for ( size_t i = 0; i < MaterialDecl::s_declsById.size(); i++ ) {
+			MaterialDecl * decl = MaterialDecl::s_declsById[i];
+			decl->m_shaderDefines = permutation.defines;
+			if ( !decl->CompileShader() ) {
+				decl->m_shaderDefines = declDefines[i];
+				decl->CompileShader();
+				built = false;
+				continue;
+			}
+			if ( ( !permutation.shadows && decl->shader->HasUniform( "shadowAtlas" ) ) || ( !permutation.ibl && decl->shader->HasUniform( "irradianceMaps" ) ) ) {
+				sprintf( line, "shaderPermutationTest :: %s of %s kept the uniforms of a removed feature!!!", permutation.defines, decl->getName().c_str() );
+				console->AddError( line );
+				failures++;
+			}
+		}
+		if ( !built ) {
+			sprintf( line, "shaderPermutationTest :: %s failed to build!!!", permutation.defines );
+			console->AddError( line );
+			failures++;
+			continue;
+		}
+
+		while ( glGetError() != GL_NO_ERROR ) {}
+		RenderScene( view.as_ptr(), projection.as_ptr() );
+		const GLenum error = glGetError();
+		if ( error != GL_NO_ERROR ) {
+			sprintf( line, "shaderPermutationTest :: drawing %s raised gl error 0x%x!!!", permutation.defines, error );
+			console->AddError( line );
+			failures++;
+		}
+	}
+
+	for ( size_t i = 0; i < MaterialDecl::s_declsById.size(); i++ ) {
+		MaterialDecl::s_declsById[i]->m_shaderDefines = declDefines[i];
+		MaterialDecl::s_declsById[i]->CompileShader();
+	}
+
+	sprintf( line, "%u material decls drawn with 4 permutations", ( unsigned int )declDefines.size() );
+	console->AddInfo( line );
+	if ( failures == 0 ) {
+		console->AddInfo( "shaderPermutationTest :: passed" );
+	}
+}
+
+/*
+================================
+PrintDrawStateChanges
+================================
+*/
+static void PrintDrawStateChanges( const char * label, const drawStateChanges_t & changes ) {
+	char line[256];
+	sprintf( line, "%s: %u draws  %u programs  %u materials  %u vertex arrays  %u front faces", label, changes.draws, changes.programs, changes.materials, changes.vertexArrays, changes.frontFaces );
+	Console::getInstance()->AddInfo( line );
+}
+
+/*
+================================
+Fn_DrawSort
+	-args: "0" to submit the scene in scene order, "1" to sort the draw list. Without args the
+	 state changes of the last frame are printed.
+================================
+*/
+void Fn_DrawSort( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args != "" && args != "0" && args != "1" ) {
+		console->AddError( "drawSort :: requires 0 or 1!!!" );
+		return;
+	}
+
+	PrintDrawStateChanges( DrawList::s_sort ? "last frame, sorted" : "last frame, scene order", DrawList::CountStateChanges( g_drawList.Keys() ) );
+	char line[256];
+	sprintf( line, "last frame: %u program binds, %u texture binds, %u vertex array binds, %u draw calls", GLRecorder::LastFrame( GLCALL_PROGRAM ), GLRecorder::LastFrame( GLCALL_TEXTURE ), GLRecorder::LastFrame( GLCALL_VERTEX_ARRAY ), GLRecorder::LastFrame( GLCALL_DRAW ) );
+	console->AddInfo( line );
+
+	if ( args == "0" ) {
+		DrawList::s_sort = false;
+	} else if ( args == "1" ) {
+		DrawList::s_sort = true;
+	}
+}
+
+/*
+================================
+Fn_DrawListBenchmark
+	-counts the state changes of a synthetic scene in scene order and sorted, and times the radix
+	 sort against std::sort. Optional arg is the surface count.
+================================
+*/
+void Fn_DrawListBenchmark( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int surfaceCount = 20000;
+	if ( args != "" ) {
+		surfaceCount = ( unsigned int )atoi( args.c_str() );
+		if ( surfaceCount == 0 ) {
+			console->AddError( "drawListBenchmark :: invalid surface count!!!" );
+			return;
+		}
+	}
+
+	const unsigned int materialCount = 500;
+	const unsigned int programCount = 8;
+	std::vector< uint64_t > sceneOrder;
+	DrawList::BuildSyntheticScene( surfaceCount, materialCount, programCount, 1, sceneOrder );
+
+	char line[256];
+	sprintf( line, "surfaces: %u  materials: %u  programs: %u", surfaceCount, materialCount, programCount );
+	console->AddInfo( line );
+	PrintDrawStateChanges( "scene order", DrawList::CountStateChanges( sceneOrder ) );
+
+	//time both sorts on copies of the scene order
+	const unsigned int iterations = 100;
+	std::vector< uint64_t > radixSorted;
+	std::vector< uint64_t > scratch;
+	double radixSeconds = 0.0;
+	for ( unsigned int i = 0; i < iterations; i++ ) {
+		radixSorted = sceneOrder;
+		const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		DrawList::RadixSort( radixSorted, scratch );
+		radixSeconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+	}
+	std::vector< uint64_t > stdSorted;
+	double stdSeconds = 0.0;
+	for ( unsigned int i = 0; i < iterations; i++ ) {
+		stdSorted = sceneOrder;
+		const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		std::sort( stdSorted.begin(), stdSorted.end() );
+		stdSeconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+	}
+
+	PrintDrawStateChanges( "sorted", DrawList::CountStateChanges( radixSorted ) );
+	sprintf( line, "radix sort: %.3f ms  std::sort: %.3f ms  (%u keys)", radixSeconds * 1000.0 / iterations, stdSeconds * 1000.0 / iterations, ( unsigned int )sceneOrder.size() );
+	console->AddInfo( line );
+	if ( radixSorted != stdSorted ) {
+		console->AddError( "drawListBenchmark :: radix sort order differs from std::sort!!!" );
+	}
+}
+
+/*
+================================
+Fn_BindlessTextures
+	-args: "0" binds material textures to slots, "1" reads them from the material table. Programs
+	 are rebuilt, so the scene is reloaded. Without args the current mode is printed.
+================================
+*/
+void Fn_BindlessTextures( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args != "" && args != "0" && args != "1" ) {
+		console->AddError( "bindlessTextures :: requires 0 or 1!!!" );
+		return;
+	}
+
+	if ( args == "" ) {
+		char line[256];
+		sprintf( line, "bindless textures: %s%s  materials: %u  resident handles: %u  multi draws mix materials: %s", MaterialTable::s_bindless ? "on" : "off", MaterialTable::s_supported ? "" : " (not supported)", MaterialTable::EntryCount(), MaterialTable::s_residentHandles, MaterialTable::s_nonuniformHandles ? "yes" : "no" );
+		console->AddInfo( line );
+		return;
+	}
+
+	if ( args == "1" && !MaterialTable::s_supported ) {
+		console->AddError( "bindlessTextures :: ARB_bindless_texture or ARB_shader_draw_parameters is not supported!!!" );
+		return;
+	}
+	MaterialTable::s_bindless = ( args == "1" );
+	ShaderPreprocessor::SetGlobalDefine( "BINDLESS_TEXTURES", MaterialTable::s_bindless ? 1 : 0 );
+	Fn_ReloadScene( "" );
+}
+
+/*
+================================
+FakeTextureHandle
+	-stands in for glGetTextureHandleARB, counts how often handles are made
+================================
+*/
+static unsigned int s_fakeHandleCalls = 0;
+static uint64_t FakeTextureHandle( const unsigned int textureName ) {
+	s_fakeHandleCalls++;
+	return 0x100000000ull | textureName;
+}
+
+/*
+================================
+Fn_MaterialTableTest
+	-packs made up decls into material table entries and checks the layout, the missing texture
+	 fallback and that only changed slots get new handles
+================================
+*/
+void Fn_MaterialTableTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int failures = 0;
+
+	//layout of Material in material_table.glsl
+	if ( sizeof( materialEntry_t ) != 48 || offsetof( materialEntry_t, textures ) != 0 || offsetof( materialEntry_t, emissiveColor ) != 32 ) {
+		console->AddError( "materialTableTest :: materialEntry_t does not match the std430 layout!!!" );
+		failures++;
+	}
+	if ( MaterialTable::TextureSlot( "albedoTexture" ) != 0 || MaterialTable::TextureSlot( "glossTexture" ) != 3 || MaterialTable::TextureSlot( "brdfLUT" ) != -1 ) {
+		console->AddError( "materialTableTest :: wrong texture slots!!!" );
+		failures++;
+	}
+
+	//all slots set, only albedo, nothing
+	const unsigned int missingTexture = 2;
+	std::vector< materialSource_t > sources( 3 );
+	memset( sources.data(), 0, sources.size() * sizeof( materialSource_t ) );
+	for ( unsigned int slot = 0; slot < MATERIAL_TABLE_TEXTURES; slot++ ) {
+		sources[0].textureNames[ slot ] = 10 + slot;
+	}
+	sources[1].textureNames[0] = 20;
+	sources[2].emissiveColor[0] = 1.0f;
+	sources[2].emissiveColor[2] = 0.5f;
+
+	std::vector< materialEntry_t > entries;
+	std::vector< unsigned int > entryNames;
+	s_fakeHandleCalls = 0;
+	unsigned int changed = MaterialTable::Refresh( sources, missingTexture, FakeTextureHandle, entries, entryNames );
+	if ( changed != 3 || entries.size() != 3 || s_fakeHandleCalls != 3 * MATERIAL_TABLE_TEXTURES ) {
+		console->AddError( "materialTableTest :: first refresh did not fill every entry!!!" );
+		failures++;
+	}
+	if ( entries[0].textures[3] != FakeTextureHandle( 13 ) || entries[1].textures[0] != FakeTextureHandle( 20 ) ||
+		 entries[1].textures[1] != FakeTextureHandle( missingTexture ) || entries[2].textures[0] != FakeTextureHandle( missingTexture ) ) {
+		console->AddError( "materialTableTest :: wrong handles!!!" );
+		failures++;
+	}
+	if ( entries[2].emissiveColor[0] != 1.0f || entries[2].emissiveColor[1] != 0.0f || entries[2].emissiveColor[2] != 0.5f || entries[2].emissiveColor[3] != 0.0f ) {
+		console->AddError( "materialTableTest :: wrong emissive color!!!" );
+		failures++;
+	}
+
+	//nothing changed
+	s_fakeHandleCalls = 0;
+	changed = MaterialTable::Refresh( sources, missingTexture, FakeTextureHandle, entries, entryNames );
+	if ( changed != 0 || s_fakeHandleCalls != 0 ) {
+		console->AddError( "materialTableTest :: unchanged sources made new handles!!!" );
+		failures++;
+	}
+
+	//a streamed texture got a new name, and a constant changed
+	sources[0].textureNames[2] = 30;
+	sources[2].emissiveColor[1] = 0.25f;
+	s_fakeHandleCalls = 0;
+	changed = MaterialTable::Refresh( sources, missingTexture, FakeTextureHandle, entries, entryNames );
+	if ( changed != 2 || s_fakeHandleCalls != 1 || entries[0].textures[2] != FakeTextureHandle( 30 ) || entries[2].emissiveColor[1] != 0.25f ) {
+		console->AddError( "materialTableTest :: changed slots were not refreshed!!!" );
+		failures++;
+	}
+
+	//a decl loaded later
+	sources.push_back( sources[1] );
+	s_fakeHandleCalls = 0;
+	changed = MaterialTable::Refresh( sources, missingTexture, FakeTextureHandle, entries, entryNames );
+	if ( changed != 1 || entries.size() != 4 || s_fakeHandleCalls != MATERIAL_TABLE_TEXTURES || entries[3].textures[0] != FakeTextureHandle( 20 ) ) {
+		console->AddError( "materialTableTest :: new decl was not added!!!" );
+		failures++;
+	}
+
+	if ( failures == 0 ) {
+		console->AddInfo( "materialTableTest :: all checks passed" );
+	}
+}
+
+/*
+================================
+Fn_MultiDrawIndirect
+	-args: "0" issues a draw call per indirect command, "1" one multi draw per batch. Without
+	 args the batches of the last frame are printed.
+================================
+*/
+void Fn_MultiDrawIndirect( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args != "" && args != "0" && args != "1" ) {
+		console->AddError( "multiDrawIndirect :: requires 0 or 1!!!" );
+		return;
+	}
+
+	char line[256];
+	sprintf( line, "last frame: main pass %u draws in %u batches, %u draw calls in total", ( unsigned int )g_drawCommands.size(), ( unsigned int )g_drawBatches.size(), GLRecorder::LastFrame( GLCALL_DRAW ) );
+	console->AddInfo( line );
+
+	if ( args == "0" ) {
+		IndirectDraw::s_enabled = false;
+	} else if ( args == "1" ) {
+		IndirectDraw::s_enabled = true;
+	}
+}
+
+/*
+================================
+SumInstances
+	-instances drawn by a list of commands, each counted once per surface
+================================
+*/
+static unsigned int SumInstances( const std::vector< drawElementsCommand_t > & commands ) {
+	unsigned int instanceCount = 0;
+	for ( size_t i = 0; i < commands.size(); i++ ) {
+		instanceCount += commands[i].instanceCount;
+	}
+	return instanceCount;
+}
+
+/*
+================================
+Fn_IndirectDrawTest
+	-checks the merged buffer layout and the commands made from it, then batches the draw keys
+	 of a synthetic scene. Optional arg is the surface count of the synthetic scene.
+================================
+*/
+void Fn_IndirectDrawTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int surfaceCount = 20000;
+	if ( args != "" ) {
+		surfaceCount = ( unsigned int )atoi( args.c_str() );
+		if ( surfaceCount == 0 ) {
+			console->AddError( "indirectDrawTest :: invalid surface count!!!" );
+			return;
+		}
+	}
+	unsigned int failures = 0;
+
+	//three meshes of one surface each. The first has 1 of 3 instances flipped, the last only flipped instances.
+	indirectScene_t scene;
+	std::vector< unsigned int > vertexCounts;
+	std::vector< unsigned int > indexCounts;
+	vertexCounts.push_back( 4 ); indexCounts.push_back( 6 );
+	vertexCounts.push_back( 3 ); indexCounts.push_back( 3 );
+	vertexCounts.push_back( 5 ); indexCounts.push_back( 9 );
+	unsigned int totalVertices = 0;
+	unsigned int totalIndices = 0;
+	IndirectDraw::LayoutGeometry( vertexCounts, indexCounts, scene.surfaces, &totalVertices, &totalIndices );
+	if ( totalVertices != 12 || totalIndices != 18 || scene.surfaces[1].firstIndex != 6 || scene.surfaces[1].baseVertex != 4 || scene.surfaces[2].firstIndex != 9 || scene.surfaces[2].baseVertex != 7 ) {
+		console->AddError( "indirectDrawTest :: wrong geometry layout!!!" );
+		failures++;
+	}
+
+	std::vector< unsigned int > instanceCounts;
+	std::vector< unsigned int > flippedCounts;
+	instanceCounts.push_back( 3 ); flippedCounts.push_back( 1 );
+	instanceCounts.push_back( 1 ); flippedCounts.push_back( 0 );
+	instanceCounts.push_back( 2 ); flippedCounts.push_back( 2 );
+	unsigned int totalInstances = 0;
+	IndirectDraw::LayoutInstances( instanceCounts, flippedCounts, scene.meshInstances, &totalInstances );
+	for ( unsigned int i = 0; i < 3; i++ ) {
+		scene.meshFirstSurface.push_back( i );
+	}
+	const drawElementsCommand_t unflipped = IndirectDraw::MakeCommand( scene.surfaces[0], scene.meshInstances[0], false );
+	const drawElementsCommand_t flipped = IndirectDraw::MakeCommand( scene.surfaces[0], scene.meshInstances[0], true );
+	const drawElementsCommand_t lastFlipped = IndirectDraw::MakeCommand( scene.surfaces[2], scene.meshInstances[2], true );
+	if ( totalInstances != 6 || unflipped.count != 6 || unflipped.instanceCount != 2 || unflipped.baseInstance != 0 ||
+		 flipped.instanceCount != 1 || flipped.baseInstance != 2 || lastFlipped.instanceCount != 2 || lastFlipped.baseInstance != 4 || lastFlipped.baseVertex != 7 ) {
+		console->AddError( "indirectDrawTest :: wrong commands!!!" );
+		failures++;
+	}
+
+	//a pass over the whole scene is two batches and skips empty commands
+	std::vector< drawElementsCommand_t > commands;
+	std::vector< indirectBatch_t > batches;
+	IndirectDraw::BuildPassCommands( scene, commands, batches );
+	if ( commands.size() != 4 || batches.size() != 2 || batches[0].flipped || !batches[1].flipped || batches[1].firstCommand != 2 || SumInstances( commands ) != totalInstances ) {
+		console->AddError( "indirectDrawTest :: wrong pass commands!!!" );
+		failures++;
+	}
+
+	//synthetic scene with the meshes its draw keys reference, every tenth mesh has flipped instances
+	std::vector< uint64_t > keys;
+	DrawList::BuildSyntheticScene( surfaceCount, 500, 8, 1, keys );
+	std::vector< unsigned int > meshSurfaceCounts;
+	for ( size_t i = 0; i < keys.size(); i++ ) {
+		const unsigned int mesh = DrawList::KeyMesh( keys[i] );
+		if ( mesh >= meshSurfaceCounts.size() ) {
+			meshSurfaceCounts.resize( mesh + 1, 0 );
+		}
+		meshSurfaceCounts[ mesh ] = std::max( meshSurfaceCounts[ mesh ], DrawList::KeySurface( keys[i] ) + 1 );
+	}
+	scene = indirectScene_t();
+	vertexCounts.clear();
+	indexCounts.clear();
+	instanceCounts.clear();
+	flippedCounts.clear();
+	unsigned int expectedInstances = 0;
+	for ( unsigned int mesh = 0; mesh < meshSurfaceCounts.size(); mesh++ ) {
+		scene.meshFirstSurface.push_back( ( unsigned int )vertexCounts.size() );
+		for ( unsigned int surface = 0; surface < meshSurfaceCounts[ mesh ]; surface++ ) {
+			vertexCounts.push_back( 24 );
+			indexCounts.push_back( 36 );
+		}
+		instanceCounts.push_back( ( mesh % 10 ) == 9 ? 4 : 3 );
+		flippedCounts.push_back( ( mesh % 10 ) == 9 ? 2 : 0 );
+		expectedInstances += meshSurfaceCounts[ mesh ] * instanceCounts.back();
+	}
+	IndirectDraw::LayoutGeometry( vertexCounts, indexCounts, scene.surfaces, &totalVertices, &totalIndices );
+	IndirectDraw::LayoutInstances( instanceCounts, flippedCounts, scene.meshInstances, &totalInstances );
+
+	//every key is one command, in scene order and sorted
+	const std::vector< uint8_t > noTableMaterials;
+	std::vector< unsigned int > materialIds;
+	IndirectDraw::BuildKeyCommands( scene, keys, noTableMaterials, commands, materialIds, batches );
+	const size_t sceneOrderBatches = batches.size();
+	if ( commands.size() != keys.size() || SumInstances( commands ) != expectedInstances ) {
+		console->AddError( "indirectDrawTest :: scene order keys lost draws!!!" );
+		failures++;
+	}
+	std::vector< uint64_t > scratch;
+	DrawList::RadixSort( keys, scratch );
+	IndirectDraw::BuildKeyCommands( scene, keys, noTableMaterials, commands, materialIds, batches );
+	if ( commands.size() != keys.size() || SumInstances( commands ) != expectedInstances ) {
+		console->AddError( "indirectDrawTest :: sorted keys lost draws!!!" );
+		failures++;
+	}
+
+	//a batch never mixes programs, materials or front faces
+	unsigned int batchedCommands = 0;
+	unsigned int wrongMaterials = 0;
+	for ( size_t b = 0; b < batches.size(); b++ ) {
+		const indirectBatch_t & batch = batches[b];
+		batchedCommands += batch.commandCount;
+		for ( unsigned int c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; c++ ) {
+			wrongMaterials += ( materialIds[c] != DrawList::KeyMaterial( batch.key ) ) ? 1 : 0;
+		}
+		const uint64_t prevKey = ( b > 0 ) ? batches[ b - 1 ].key : 0;
+		if ( b > 0 && batch.flipped == batches[ b - 1 ].flipped && DrawList::KeyProgram( batch.key ) == DrawList::KeyProgram( prevKey ) && DrawList::KeyMaterial( batch.key ) == DrawList::KeyMaterial( prevKey ) ) {
+			console->AddError( "indirectDrawTest :: batches were not merged!!!" );
+			failures++;
+			break;
+		}
+	}
+	if ( batchedCommands != commands.size() ) {
+		console->AddError( "indirectDrawTest :: batches dont cover the commands!!!" );
+		failures++;
+	}
+	if ( wrongMaterials > 0 ) {
+		console->AddError( "indirectDrawTest :: wrong command materials!!!" );
+		failures++;
+	}
+
+	//with every material in the table a batch is only split by program and front face, the commands keep their material
+	std::vector< uint8_t > allTableMaterials;
+	for ( size_t i = 0; i < keys.size(); i++ ) {
+		const unsigned int material = DrawList::KeyMaterial( keys[i] );
+		if ( material >= allTableMaterials.size() ) {
+			allTableMaterials.resize( material + 1, 1 );
+		}
+	}
+	std::vector< drawElementsCommand_t > tableCommands;
+	std::vector< unsigned int > tableMaterialIds;
+	std::vector< indirectBatch_t > tableBatches;
+	IndirectDraw::BuildKeyCommands( scene, keys, allTableMaterials, tableCommands, tableMaterialIds, tableBatches );
+	std::map< unsigned int, unsigned int > programBatches;
+	for ( size_t b = 0; b < tableBatches.size(); b++ ) {
+		programBatches[ DrawList::KeyProgram( tableBatches[b].key ) ]++;
+	}
+	std::map< unsigned int, unsigned int >::iterator programIt = programBatches.begin();
+	while ( programIt != programBatches.end() ) {
+		if ( programIt->second > 2 ) {
+			console->AddError( "indirectDrawTest :: table materials were not merged!!!" );
+			failures++;
+			break;
+		}
+		programIt++;
+	}
+	std::vector< unsigned int > sortedMaterialIds = materialIds;
+	std::sort( sortedMaterialIds.begin(), sortedMaterialIds.end() );
+	std::sort( tableMaterialIds.begin(), tableMaterialIds.end() );
+	if ( tableCommands.size() != commands.size() || tableMaterialIds != sortedMaterialIds ) {
+		console->AddError( "indirectDrawTest :: table materials lost draws!!!" );
+		failures++;
+	}
+
+	std::vector< drawElementsCommand_t > passCommands;
+	std::vector< indirectBatch_t > passBatches;
+	IndirectDraw::BuildPassCommands( scene, passCommands, passBatches );
+
+	char line[256];
+	sprintf( line, "synthetic scene: %u draws. Main pass %u multi draws sorted, %u in scene order, %u with the material table. Whole scene passes %u multi draws.", ( unsigned int )keys.size(), ( unsigned int )batches.size(), ( unsigned int )sceneOrderBatches, ( unsigned int )tableBatches.size(), ( unsigned int )passBatches.size() );
+	console->AddInfo( line );
+	if ( failures == 0 ) {
+		console->AddInfo( "indirectDrawTest :: all checks passed" );
+	}
+}
+
+/*
+================================
+TimeDeclLoads
+	-loads the source of every named decl again, without loading textures
+================================
+*/
+static double TimeDeclLoads( const std::vector< std::string > & names ) {
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < names.size(); i++ ) {
+		declSource_t source;
+		DeclCache::Load( names[i].c_str(), source );
+	}
+	return std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+/*
+================================
+Fn_DeclCache
+	-args: "0" to always parse decl text, "1" to load decls from the decl cache when it has a
+	 current entry, "time" to load every loaded decl again both ways and compare
+	-prints the cache hits and misses and the time spent loading decls so far
+================================
+*/
+void Fn_DeclCache( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	char line[256];
+	if ( args == "0" ) {
+		DeclCache::s_enabled = false;
+	} else if ( args == "1" ) {
+		DeclCache::s_enabled = true;
+	} else if ( args == "time" ) {
+		std::vector< std::string > names;
+		resourceMap_t::iterator it = MaterialDecl::s_matDecls.begin();
+		while ( it != MaterialDecl::s_matDecls.end() ) {
+			names.push_back( it->first );
+			it++;
+		}
+
+		//keep the counters of loading, the timing runs would skew them
+		const bool enabled = DeclCache::s_enabled;
+		const unsigned int hits = DeclCache::s_hits;
+		const unsigned int misses = DeclCache::s_misses;
+		const double loadSeconds = DeclCache::s_loadSeconds;
+
+		DeclCache::s_enabled = false;
+		const double textSeconds = TimeDeclLoads( names );
+		DeclCache::s_enabled = true;
+		TimeDeclLoads( names ); //makes sure every decl has an entry
+		const unsigned int warmHits = DeclCache::s_hits;
+		const double cacheSeconds = TimeDeclLoads( names );
+		const unsigned int timedHits = DeclCache::s_hits - warmHits;
+
+		DeclCache::s_enabled = enabled;
+		DeclCache::s_hits = hits;
+		DeclCache::s_misses = misses;
+		DeclCache::s_loadSeconds = loadSeconds;
+
+		sprintf( line, "%u decls: %.2f ms parsing text, %.2f ms from the cache (%u hits)", ( unsigned int )names.size(), textSeconds * 1000.0, cacheSeconds * 1000.0, timedHits );
+		console->AddInfo( line );
+		return;
+	} else if ( args != "" ) {
+		console->AddError( "declCache :: requires 0, 1 or time!!!" );
+		return;
+	}
+
+	sprintf( line, "decl cache %s: %u hits, %u misses, %.2f ms loading decls", DeclCache::s_enabled ? "on" : "off", DeclCache::s_hits, DeclCache::s_misses, DeclCache::s_loadSeconds * 1000.0 );
+	console->AddInfo( line );
+}
+
+/*
+================================
+DeclSourcesMatch
+================================
+*/
+static bool DeclSourcesMatch( const declSource_t & a, const declSource_t & b ) {
+	if ( a.shaderProg != b.shaderProg || a.shaderDefines != b.shaderDefines || a.textures.size() != b.textures.size() || a.vec3s.size() != b.vec3s.size() ) {
+		return false;
+	}
+	for ( size_t i = 0; i < a.textures.size(); i++ ) {
+		if ( a.textures[i].uniform != b.textures[i].uniform || a.textures[i].type != b.textures[i].type || a.textures[i].path != b.textures[i].path ) {
+			return false;
+		}
+	}
+	for ( size_t i = 0; i < a.vec3s.size(); i++ ) {
+		if ( a.vec3s[i].uniform != b.vec3s[i].uniform || memcmp( a.vec3s[i].value, b.vec3s[i].value, sizeof( a.vec3s[i].value ) ) != 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+================================
+SyntheticDeclText
+	-a decl like the ones of the scene's surfaces, with all four material textures
+================================
+*/
+static std::string SyntheticDeclText( const unsigned int index ) {
+	char text[1024];
+	sprintf( text, "shaderProg :: defaultSurface\r\nshaderDefines :: SHADOWS=1 IBL=1\r\n"
+			"albedoTexture texture2d data/texture/synthetic/m%03u_albedo.tga\r\nspecularTexture texture2d data/texture/synthetic/m%03u_specular.tga\r\n"
+			"normalTexture texture2d data/texture/synthetic/m%03u_normal.tga\r\nglossTexture texture2d data/texture/synthetic/m%03u_gloss.tga\r\n"
+			"emissiveColor %.2f 0.5 0.25\r\n", index, index, index, index, ( float )( index % 100 ) / 100.0f );
+	return text;
+}
+
+/*
+================================
+Fn_DeclCacheTest
+	-parses decl text, round trips it through the binary form and checks entries are only read
+	 back for the decl text they were made from
+================================
+*/
+void Fn_DeclCacheTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	bool passed = true;
+
+	//the framebuffer line has no path, and the second albedoTexture line is kept in file order
+	const std::string text = "shaderProg :: defaultSurface\r\nshaderDefines :: SHADOWS=0 IBL=1\r\n"
+			"albedoTexture texture2d data/texture/a.tga\r\nframebuffer ssaoTexture\r\nemissiveColor 1 0.5 0.25\r\n"
+			"skybox cubemap data/texture/sky.tga\r\nalbedoTexture texture2d data/texture/b.tga";
+	declSource_t source;
+	DeclCache::Parse( text.c_str(), text.size(), source );
+	if ( source.shaderProg != "defaultSurface" || source.shaderDefines != "SHADOWS=0 IBL=1" || source.textures.size() != 4 || source.vec3s.size() != 1 ||
+		 source.textures[1].type != "framebuffer" || source.textures[1].uniform != "ssaoTexture" || !source.textures[1].path.empty() ||
+		 source.textures[2].type != "cubemap" || source.textures[3].path != "data/texture/b.tga" || source.vec3s[0].value[1] != 0.5f ) {
+		console->AddError( "declCacheTest :: decl text parsed wrong!!!" );
+		passed = false;
+	}
+
+	std::vector< uint8_t > data;
+	DeclCache::Serialize( source, data );
+	declSource_t readBack;
+	if ( !DeclCache::Deserialize( data.data(), data.size(), readBack ) || !DeclSourcesMatch( source, readBack ) ) {
+		console->AddError( "declCacheTest :: binary decl didnt read back!!!" );
+		passed = false;
+	}
+	for ( size_t size = 0; size < data.size(); size++ ) {
+		if ( DeclCache::Deserialize( data.data(), size, readBack ) ) {
+			console->AddError( "declCacheTest :: truncated binary decl was read!!!" );
+			passed = false;
+			break;
+		}
+	}
+
+	//entries are tied to the size and write time of the text
+	const char * entryPath = "data\\generated\\decl\\declCacheTest.bin";
+	fileStamp_t stamp;
+	stamp.size = text.size();
+	stamp.writeTime = 0x01d5a0b0c0d0e0f0ULL;
+	if ( !DeclCache::Write( entryPath, stamp, source ) ) {
+		console->AddError( "declCacheTest :: failed to write the entry!!!" );
+		return;
+	}
+	readBack = declSource_t();
+	if ( !DeclCache::Read( entryPath, stamp, readBack ) || !DeclSourcesMatch( source, readBack ) ) {
+		console->AddError( "declCacheTest :: entry didnt read back!!!" );
+		passed = false;
+	}
+	fileStamp_t staleStamps[2] = { stamp, stamp };
+	staleStamps[0].size++;
+	staleStamps[1].writeTime++;
+	for ( unsigned int i = 0; i < 2; i++ ) {
+		if ( DeclCache::Read( entryPath, staleStamps[i], readBack ) ) {
+			console->AddError( i == 0 ? "declCacheTest :: entry still used after the text size changed!!!" : "declCacheTest :: entry still used after the text was written again!!!" );
+			passed = false;
+		}
+	}
+
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( entryPath, fullPath );
+	remove( fullPath );
+	if ( DeclCache::Read( entryPath, stamp, readBack ) ) {
+		console->AddError( "declCacheTest :: missing entry was used!!!" );
+		passed = false;
+	}
+
+	if ( passed ) {
+		console->AddInfo( "declCacheTest :: passed" );
+	}
+}
+
+/*
+================================
+Fn_DeclBenchmark
+	-cpu cost per frame of finding the decls of a synthetic scene by name, as every pass used to,
+	 against indexing them by the ids resolved at load. Also times parsing decl text against
+	 reading the binary form. Optional arg is the surface count.
+================================
+*/
+void Fn_DeclBenchmark( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int surfaceCount = 5000;
+	if ( args != "" ) {
+		surfaceCount = ( unsigned int )atoi( args.c_str() );
+		if ( surfaceCount == 0 ) {
+			console->AddError( "declBenchmark :: invalid surface count!!!" );
+			return;
+		}
+	}
+
+	//the decls stand in for MaterialDecl, the map is keyed the same way as s_matDecls
+	const unsigned int declCount = 500;
+	std::map< std::string, unsigned int > declsByName;
+	std::vector< std::string > declNames;
+	for ( unsigned int i = 0; i < declCount; i++ ) {
+		char name[64];
+		sprintf( name, "material\\synthetic\\m%03u", i );
+		declNames.push_back( name );
+		declsByName[ name ] = i;
+	}
+	std::vector< unsigned int > declsById( declCount );
+	for ( unsigned int i = 0; i < declCount; i++ ) {
+		declsById[i] = i;
+	}
+
+	//surfaces keep the name and the id resolved from it
+	uint32_t seed = 1;
+	std::vector< Str > surfaceNames;
+	std::vector< unsigned int > surfaceIds;
+	for ( unsigned int i = 0; i < surfaceCount; i++ ) {
+		seed = seed * 1664525 + 1013904223;
+		const unsigned int id = ( seed >> 8 ) % declCount;
+		surfaceNames.push_back( Str( declNames[ id ].c_str() ) );
+		surfaceIds.push_back( id );
+	}
+
+	//texture streaming requests and the debug views each looked up every surface's decl by name every frame
+	const unsigned int passes = 2;
+	const unsigned int frames = 100;
+	unsigned int nameSum = 0;
+	const std::chrono::steady_clock::time_point nameStart = std::chrono::steady_clock::now();
+	for ( unsigned int frame = 0; frame < frames; frame++ ) {
+		for ( unsigned int pass = 0; pass < passes; pass++ ) {
+			for ( unsigned int i = 0; i < surfaceCount; i++ ) {
+				nameSum += declsByName.find( surfaceNames[i].c_str() )->second;
+			}
+		}
+	}
+	const double nameSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - nameStart ).count();
+	unsigned int idSum = 0;
+	const std::chrono::steady_clock::time_point idStart = std::chrono::steady_clock::now();
+	for ( unsigned int frame = 0; frame < frames; frame++ ) {
+		for ( unsigned int pass = 0; pass < passes; pass++ ) {
+			for ( unsigned int i = 0; i < surfaceCount; i++ ) {
+				idSum += declsById[ surfaceIds[i] ];
+			}
+		}
+	}
+	const double idSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - idStart ).count();
+
+	char line[256];
+	sprintf( line, "%u surfaces, %u decls, %u passes: %.3f ms per frame by name, %.4f ms by id", surfaceCount, declCount, passes, nameSeconds * 1000.0 / frames, idSeconds * 1000.0 / frames );
+	console->AddInfo( line );
+	if ( nameSum != idSum ) {
+		console->AddError( "declBenchmark :: ids found other decls than the names!!!" );
+	}
+
+	//every decl once, in memory so only parsing and reading are timed
+	std::vector< std::string > texts;
+	std::vector< std::vector< uint8_t > > binaries( declCount );
+	size_t textBytes = 0;
+	size_t binaryBytes = 0;
+	for ( unsigned int i = 0; i < declCount; i++ ) {
+		texts.push_back( SyntheticDeclText( i ) );
+		declSource_t source;
+		DeclCache::Parse( texts[i].c_str(), texts[i].size(), source );
+		DeclCache::Serialize( source, binaries[i] );
+		textBytes += texts[i].size();
+		binaryBytes += binaries[i].size();
+	}
+	const std::chrono::steady_clock::time_point parseStart = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < declCount; i++ ) {
+		declSource_t source;
+		DeclCache::Parse( texts[i].c_str(), texts[i].size(), source );
+	}
+	const double parseSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - parseStart ).count();
+	bool readAll = true;
+	const std::chrono::steady_clock::time_point readStart = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < declCount; i++ ) {
+		declSource_t source;
+		readAll = DeclCache::Deserialize( binaries[i].data(), binaries[i].size(), source ) && readAll;
+	}
+	const double readSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - readStart ).count();
+
+	sprintf( line, "%u decls: %.3f ms parsing %u bytes of text, %.3f ms reading %u bytes of binary", declCount, parseSeconds * 1000.0, ( unsigned int )textBytes, readSeconds * 1000.0, ( unsigned int )binaryBytes );
+	console->AddInfo( line );
+	if ( !readAll ) {
+		console->AddError( "declBenchmark :: binary decls didnt read back!!!" );
+	}
+}
+
+/*
+================================
+Fn_SceneLoadBenchmark
+	-times loading the current scene's decls and textures with 1 thread up to the optional arg,
+	 16 by default. Textures are timed through their upload, into textures that are deleted
+	 again, the loaded decls and textures are left as they are. Streamed textures only upload
+	 their mip tail later, so only their read is timed.
+================================
+*/
+void Fn_SceneLoadBenchmark( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	unsigned int maxThreads = 16;
+	if ( args != "" ) {
+		maxThreads = ( unsigned int )atoi( args.c_str() );
+		if ( maxThreads == 0 ) {
+			console->AddError( "sceneLoadBenchmark :: invalid thread count!!!" );
+			return;
+		}
+	}
+
+	std::vector< std::string > surfaceNames;
+	SceneMaterialNames( Scene::getInstance(), surfaceNames );
+	std::set< std::string > nameSet( surfaceNames.begin(), surfaceNames.end() );
+	const std::vector< std::string > names( nameSet.begin(), nameSet.end() );
+	if ( names.empty() ) {
+		console->AddError( "sceneLoadBenchmark :: load a scene first!!!" );
+		return;
+	}
+
+	//keep the counters of loading, the timing runs would skew them
+	const unsigned int hits = DeclCache::s_hits;
+	const unsigned int misses = DeclCache::s_misses;
+	const double loadSeconds = DeclCache::s_loadSeconds;
+
+	//the textures of every decl, once each
+	std::vector< declSource_t > sources;
+	std::vector< uint8_t > loaded;
+	DeclCache::LoadAll( names, sources, loaded );
+	std::set< std::pair< std::string, bool > > textureSet;
+	for ( size_t i = 0; i < names.size(); i++ ) {
+		std::vector< std::string > uniforms;
+		std::vector< textureRequest_t > requests;
+		MaterialDecl::TextureRequests( sources[i], uniforms, requests );
+		for ( size_t r = 0; r < requests.size(); r++ ) {
+			textureSet.insert( std::make_pair( requests[r].path, requests[r].cubemap ) );
+		}
+	}
+	std::vector< textureLoad_t > loads;
+	std::set< std::pair< std::string, bool > >::iterator it = textureSet.begin();
+	while ( it != textureSet.end() ) {
+		textureLoad_t load;
+		load.path = it->first;
+		load.cubemap = it->second;
+		loads.push_back( load );
+		it++;
+	}
+	Texture::ReadLoads( loads ); //opens every file once so the first timed run isnt the only cold one
+	Texture::UnmapLoads( loads );
+
+	char line[256];
+	sprintf( line, "%u decls, %u textures, %u pool workers", ( unsigned int )names.size(), ( unsigned int )loads.size(), ThreadPool::getInstance()->WorkerCount() );
+	console->AddInfo( line );
+	double singleSeconds = 0.0;
+	for ( unsigned int threads = 1; threads <= maxThreads; threads *= 2 ) {
+		const std::chrono::steady_clock::time_point declStart = std::chrono::steady_clock::now();
+		DeclCache::LoadAll( names, sources, loaded, threads );
+		const double declSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - declStart ).count();
+
+		const std::chrono::steady_clock::time_point textureStart = std::chrono::steady_clock::now();
+		Texture::ReadLoads( loads, threads );
+		const double textureSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - textureStart ).count();
+
+		const std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+		for ( size_t i = 0; i < loads.size(); i++ ) {
+			if ( loads[i].streamed || !loads[i].read ) {
+				continue;
+			}
+			Texture * texture = NULL;
+			if ( loads[i].cubemap ) {
+				texture = new CubemapTexture;
+			} else {
+				texture = new Texture;
+			}
+			texture->InitFromLevels( loads[i].path.c_str(), loads[i].levels, loads[i].file.data );
+			texture->Delete();
+			delete texture;
+		}
+		glFinish(); //the driver may still be copying the levels
+		const double uploadSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - uploadStart ).count();
+		Texture::UnmapLoads( loads );
+
+		const double totalSeconds = declSeconds + textureSeconds + uploadSeconds;
+		if ( threads == 1 ) {
+			singleSeconds = totalSeconds;
+		}
+		sprintf( line, "%2u threads: decls %.2f ms  textures %.2f ms  upload %.2f ms  (%.2fx)", threads, declSeconds * 1000.0, textureSeconds * 1000.0, uploadSeconds * 1000.0, singleSeconds / totalSeconds );
+		console->AddInfo( line );
+	}
+
+	DeclCache::s_hits = hits;
+	DeclCache::s_misses = misses;
+	DeclCache::s_loadSeconds = loadSeconds;
+}
+
+/*
+================================
+Fn_ShaderReload
+	-0 or 1 turns rebuilding programs when their shader files change off or on, no args prints what
+	 is watched
+================================
+*/
+void Fn_ShaderReload( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	if ( args == "0" ) {
+		Shader::s_hotReload = false;
+	} else if ( args == "1" ) {
+		Shader::s_hotReload = true;
+	} else if ( args != "" ) {
+		console->AddError( "shaderReload :: requires 0 or 1!!!" );
+		return;
+	}
+
+	const ShaderWatcher & watcher = Shader::Watcher();
+	char line[256];
+	sprintf( line, "shader reload %s (%s): %u programs use %u files, %u reloads, %u failed", Shader::s_hotReload ? "on" : "off", watcher.IsNotified() ? "change notification" : "polling",
+		watcher.ProgramCount(), watcher.FileCount(), Shader::s_reloads, Shader::s_failedReloads );
+	console->AddInfo( line );
+}
+
+/*
+================================
+WriteTestFile
+================================
+*/
+static bool WriteTestFile( const char * relativePath, const char * text ) {
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+	FILE * fs = fopen( fullPath, "wb" );
+	if ( !fs ) {
+		return false;
+	}
+	fwrite( text, 1, strlen( text ), fs );
+	fclose( fs );
+	return true;
+}
+
+/*
+================================
+NamesMatch
+	-names against expected, separated by spaces
+================================
+*/
+static bool NamesMatch( const std::vector< std::string > & names, const char * expected ) {
+	std::string joined;
+	for ( size_t i = 0; i < names.size(); i++ ) {
+		if ( i > 0 ) {
+			joined += ' ';
+		}
+		joined += names[i];
+	}
+	return joined == expected;
+}
+
+/*
+================================
+Fn_ShaderWatcherTest
+	-checks the dependency graph built from preprocessed stages, then finds changes to files on
+	 disk by polling and, where the directory can be watched, by change notification
+================================
+*/
+void Fn_ShaderWatcherTest( Str args ) {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	bool passed = true;
+
+	//both programs include common, only watch includes lighting
+	ShaderPreprocessor::SetFileText( "test\\watch_vshader.glsl", "#version 430 core\n#include \"inc/common.glsl\"\nvoid main() {}\n" );
+	ShaderPreprocessor::SetFileText( "test\\watch_fshader.glsl", "#version 430 core\n#include \"inc/lighting.glsl\"\nvoid main() {}\n" );
+	ShaderPreprocessor::SetFileText( "test\\other_cshader.glsl", "#version 430 core\n#include \"inc/common.glsl\"\nvoid main() {}\n" );
+	ShaderPreprocessor::SetFileText( "test\\inc\\lighting.glsl", "#include \"common.glsl\"\nfloat lighting;\n" );
+	ShaderPreprocessor::SetFileText( "test\\inc\\common.glsl", "float common;\n" );
+
+	shaderSource_t vertex;
+	shaderSource_t fragment;
+	shaderSource_t compute;
+	if ( !ShaderPreprocessor::Process( "test\\watch_vshader.glsl", NULL, vertex ) || !ShaderPreprocessor::Process( "test\\watch_fshader.glsl", NULL, fragment ) ||
+		 !ShaderPreprocessor::Process( "test\\other_cshader.glsl", NULL, compute ) ) {
+		console->AddError( "shaderWatcherTest :: test stages didnt preprocess!!!" );
+		return;
+	}
+	std::vector< std::string > watchFiles = vertex.files;
+	watchFiles.insert( watchFiles.end(), fragment.files.begin(), fragment.files.end() );
+
+	ShaderWatcher graph;
+	graph.Watch( "watch", watchFiles );
+	graph.Watch( "other", compute.files );
+	std::vector< std::string > changed;
+	std::vector< std::string > programs;
+	changed.push_back( "test\\inc\\lighting.glsl" );
+	graph.Dependents( changed, programs );
+	if ( !NamesMatch( programs, "watch" ) ) {
+		console->AddError( "shaderWatcherTest :: wrong programs for an include of one program!!!" );
+		passed = false;
+	}
+	changed.push_back( "test\\inc\\common.glsl" );
+	graph.Dependents( changed, programs );
+	if ( !NamesMatch( programs, "other watch" ) ) {
+		console->AddError( "shaderWatcherTest :: programs sharing an include werent all found, or found twice!!!" );
+		passed = false;
+	}
+	if ( graph.FileCount() != 5 ) {
+		console->AddError( "shaderWatcherTest :: shared files arent watched once!!!" );
+		passed = false;
+	}
+
+	//the fragment stage stops including lighting
+	ShaderPreprocessor::SetFileText( "test\\watch_fshader.glsl", "#version 430 core\nvoid main() {}\n" );
+	ShaderPreprocessor::Process( "test\\watch_fshader.glsl", NULL, fragment );
+	watchFiles = vertex.files;
+	watchFiles.insert( watchFiles.end(), fragment.files.begin(), fragment.files.end() );
+	graph.Watch( "watch", watchFiles );
+	changed.assign( 1, "test\\inc\\lighting.glsl" );
+	graph.Dependents( changed, programs );
+	if ( !programs.empty() || graph.FileCount() != 4 ) {
+		console->AddError( "shaderWatcherTest :: a file that isnt included anymore is still watched!!!" );
+		passed = false;
+	}
+	graph.Unwatch( "other" );
+	changed.assign( 1, "test\\inc\\common.glsl" );
+	graph.Dependents( changed, programs );
+	if ( !NamesMatch( programs, "watch" ) || graph.FileCount() != 3 || graph.ProgramCount() != 1 ) {
+		console->AddError( "shaderWatcherTest :: unwatched program is still in the graph!!!" );
+		passed = false;
+	}
+	ShaderPreprocessor::ForgetFile( "test\\watch_vshader.glsl" );
+	ShaderPreprocessor::ForgetFile( "test\\watch_fshader.glsl" );
+	ShaderPreprocessor::ForgetFile( "test\\other_cshader.glsl" );
+	ShaderPreprocessor::ForgetFile( "test\\inc\\lighting.glsl" );
+	ShaderPreprocessor::ForgetFile( "test\\inc\\common.glsl" );
+
+	//changes on disk, b doesnt exist at first
+	const char * directory = "data\\generated\\test\\";
+	if ( dirExists( directory ) == false ) {
+		makeDir( directory );
+	}
+	const char * pathA = "data\\generated\\test\\watch_a.glsl";
+	const char * pathB = "data\\generated\\test\\watch_b.glsl";
+	char fullPathA[ 2048 ];
+	char fullPathB[ 2048 ];
+	RelativePathToFullPath( pathA, fullPathA );
+	RelativePathToFullPath( pathB, fullPathB );
+	remove( fullPathB );
+	if ( !WriteTestFile( pathA, "float a;\n" ) ) {
+		console->AddError( "shaderWatcherTest :: failed to write the test file!!!" );
+		return;
+	}
+	ShaderWatcher watcher;
+	std::vector< std::string > files;
+	files.push_back( pathA );
+	files.push_back( pathB );
+	watcher.Watch( "disk", files );
+	watcher.Poll( changed );
+	if ( !changed.empty() ) {
+		console->AddError( "shaderWatcherTest :: unchanged files were reported!!!" );
+		passed = false;
+	}
+	WriteTestFile( pathA, "float a;\nfloat a2;\n" );
+	watcher.Poll( changed );
+	if ( !NamesMatch( changed, pathA ) ) {
+		console->AddError( "shaderWatcherTest :: written file wasnt reported!!!" );
+		passed = false;
+	}
+	watcher.Poll( changed );
+	if ( !changed.empty() ) {
+		console->AddError( "shaderWatcherTest :: a change was reported twice!!!" );
+		passed = false;
+	}
+	WriteTestFile( pathB, "float b;\n" );
+	watcher.Poll( changed );
+	if ( !NamesMatch( changed, pathB ) ) {
+		console->AddError( "shaderWatcherTest :: created file wasnt reported!!!" );
+		passed = false;
+	}
+	remove( fullPathB );
+	watcher.Poll( changed );
+	if ( !NamesMatch( changed, pathB ) ) {
+		console->AddError( "shaderWatcherTest :: deleted file wasnt reported!!!" );
+		passed = false;
+	}
+
+	//without a change notification Update only polls once the interval passed
+	const double pollSeconds = ShaderWatcher::s_pollSeconds;
+	ShaderWatcher::s_pollSeconds = 3600.0;
+	WriteTestFile( pathA, "float a;\n" );
+	if ( watcher.Update( changed ) ) {
+		console->AddError( "shaderWatcherTest :: polled before the interval passed!!!" );
+		passed = false;
+	}
+	ShaderWatcher::s_pollSeconds = 0.0;
+	if ( !watcher.Update( changed ) || !NamesMatch( changed, pathA ) ) {
+		console->AddError( "shaderWatcherTest :: polling didnt find the change!!!" );
+		passed = false;
+	}
+
+	//with one Update polls as soon as the directory is written
+	ShaderWatcher::s_pollSeconds = 3600.0;
+	if ( watcher.Start( directory ) ) {
+		WriteTestFile( pathA, "float a;\nfloat a2;\n" );
+		bool found = false;
+		for ( unsigned int i = 0; i < 200 && !found; i++ ) {
+			found = watcher.Update( changed );
+			if ( !found ) {
+				std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+			}
+		}
+		if ( !found || !NamesMatch( changed, pathA ) ) {
+			console->AddError( "shaderWatcherTest :: change notification didnt find the change!!!" );
+			passed = false;
+		}
+		if ( watcher.Update( changed ) ) {
+			console->AddError( "shaderWatcherTest :: change notification reported a change twice!!!" );
+			passed = false;
+		}
+		watcher.Stop();
+	} else {
+		console->AddInfo( "shaderWatcherTest :: directory cant be watched, only polling was tested" );
+	}
+	ShaderWatcher::s_pollSeconds = pollSeconds;
+	remove( fullPathA );
+
+	//values that were set once survive a reload, even when the edit moves the uniforms
+	ShaderPreprocessor::SetFileText( "data\\shader\\watchTest_vshader.glsl", "#version 430 core\nvoid main() {\n\tgl_Position = vec4( 0.0 );\n}\n" );
+	ShaderPreprocessor::SetFileText( "data\\shader\\watchTest_fshader.glsl", "#version 430 core\nuniform float strength;\nuniform vec3 kernel[4];\nuniform mat4 projection;\nout vec4 color;\n"
+		"void main() {\n\tvec3 sum = vec3( 0.0 );\n\tfor ( int i = 0; i < 4; i++ ) {\n\t\tsum += kernel[i];\n\t}\n\tcolor = projection * vec4( sum * strength, 1.0 );\n}\n" );
+	Shader * reloadShader = NULL;
+	reloadShader = reloadShader->LoadShader( "watchTest" );
+	if ( reloadShader == NULL ) {
+		console->AddError( "shaderWatcherTest :: reload test program didnt build!!!" );
+		passed = false;
+	} else {
+		const float strength = 0.75f;
+		float kernel[ 12 ];
+		for ( unsigned int i = 0; i < 12; i++ ) {
+			kernel[i] = 0.5f * ( float )i;
+		}
+		float projection[ 16 ];
+		for ( unsigned int i = 0; i < 16; i++ ) {
+			projection[i] = ( float )( i + 1 );
+		}
+		reloadShader->UseProgram();
+		reloadShader->SetUniform1f( "strength", 1, &strength );
+		reloadShader->SetUniform3f( "kernel", 4, kernel );
+		reloadShader->SetUniformMatrix4f( "projection", 1, false, projection );
+
+		ShaderPreprocessor::SetFileText( "data\\shader\\watchTest_fshader.glsl", "#version 430 core\nuniform float bias;\nuniform float strength;\nuniform vec3 kernel[4];\nuniform mat4 projection;\nout vec4 color;\n"
+			"void main() {\n\tvec3 sum = vec3( bias );\n\tfor ( int i = 0; i < 4; i++ ) {\n\t\tsum += kernel[i];\n\t}\n\tcolor = projection * vec4( sum * strength, 1.0 );\n}\n" );
+		const unsigned int linkId = reloadShader->GetLinkId();
+		if ( !reloadShader->Reload() || reloadShader->GetLinkId() == linkId ) {
+			console->AddError( "shaderWatcherTest :: reload test program wasnt rebuilt!!!" );
+			passed = false;
+		} else {
+			const GLuint program = reloadShader->GetShaderProgram();
+			float reloadedStrength = 0.0f;
+			float reloadedKernel[ 3 ];
+			float reloadedProjection[ 16 ];
+			glGetUniformfv( program, glGetUniformLocation( program, "strength" ), &reloadedStrength );
+			glGetUniformfv( program, glGetUniformLocation( program, "kernel[3]" ), reloadedKernel );
+			glGetUniformfv( program, glGetUniformLocation( program, "projection" ), reloadedProjection );
+			if ( reloadedStrength != strength || memcmp( reloadedKernel, kernel + 9, sizeof( reloadedKernel ) ) != 0 || memcmp( reloadedProjection, projection, sizeof( projection ) ) != 0 ) {
+				console->AddError( "shaderWatcherTest :: uniform values were lost by the reload!!!" );
+				passed = false;
+			}
+		}
+		reloadShader->DeleteProgram();
+		delete reloadShader;
+	}
+	ShaderPreprocessor::ForgetFile( "data\\shader\\watchTest_vshader.glsl" );
+	ShaderPreprocessor::ForgetFile( "data\\shader\\watchTest_fshader.glsl" );
+
+	if ( passed ) {
+		console->AddInfo( "shaderWatcherTest :: passed" );
+	}
+}
+
+/*
+================================
+CommandSys::getInstance
+================================
+*/
+CommandSys * CommandSys::getInstance() {
+   if ( inst_ == NULL ) {
+      inst_ = new CommandSys();
+   }
+   return( inst_ );
+}
+
+/*
+================================
+CommandSys::BuildCommands
+================================
+*/
+void CommandSys::BuildCommands() {
+	Cmd * testLogCommand = new Cmd;
+	testLogCommand->name = Str( "testLog" );
+	testLogCommand->description = Str( "Prints stuff to the log." );
+	testLogCommand->fn = Fn_TestLog;
+	m_commands.push_back( testLogCommand );
+
+	Cmd * quitCommand = new Cmd;
+	quitCommand->name = Str( "quit" );
+	quitCommand->description = Str( "closes application." );
+	quitCommand->fn = Fn_Quit;
+	m_commands.push_back( quitCommand );
+
+	Cmd * debugLightingCommand = new Cmd;
+	debugLightingCommand->name = Str( "debugLighting" );
+	debugLightingCommand->description = Str( "Sets a rendering mode." );
+	debugLightingCommand->fn = Fn_DebugLighting;
+	m_commands.push_back( debugLightingCommand );
+
+	Cmd * showVertTransformsCommand = new Cmd;
+	showVertTransformsCommand->name = Str( "showVertTransforms" );
+	showVertTransformsCommand->description = Str( "Renders normals, tangents, and bitangents of all rendered vertices." );
+	showVertTransformsCommand->fn = Fn_ShowVertTransforms;
+	m_commands.push_back( showVertTransformsCommand );
+
+	Cmd * renderLightModelsCommand = new Cmd;
+	renderLightModelsCommand->name = Str( "renderLightModels" );
+	renderLightModelsCommand->description = Str( "Render debug models for lights in the scene." );
+	renderLightModelsCommand->fn = Fn_RenderLightModels;
+	m_commands.push_back( renderLightModelsCommand );
+
+	Cmd * createDefaultLUTCommand = new Cmd;
+	createDefaultLUTCommand->name = Str( "createLUT" );
+	createDefaultLUTCommand->description = Str( "Generate the default LUT tga image. Optional arg is filename without file extension." );
+	createDefaultLUTCommand->fn = Fn_GenerateLUT;
+	m_commands.push_back( createDefaultLUTCommand );
+
+	Cmd * showEdgeHighlightsCommand = new Cmd;
+	showEdgeHighlightsCommand->name = Str( "showEdgeHighlights" );
+	showEdgeHighlightsCommand->description = Str( "Render geo as wireframe. Args: 0->off, 1->overlayed, 2->on" );
+	showEdgeHighlightsCommand->fn = Fn_ShowEdgeHighlights;
+	m_commands.push_back( showEdgeHighlightsCommand );
+
+	Cmd * convertEquirectangularToCubemapCommand = new Cmd;
+	convertEquirectangularToCubemapCommand->name = Str( "equirectangularToCubeMap" );
+	convertEquirectangularToCubemapCommand->description = Str( "Converts equirectangular map provided by arg (relative path) to a cubemap texture. Optional face size and supersample count." );
+	convertEquirectangularToCubemapCommand->fn = Fn_EquirectangularToCubeMap;
+	m_commands.push_back( convertEquirectangularToCubemapCommand );
+
+	Cmd * computeIrradianceMapCommand = new Cmd;
+	computeIrradianceMapCommand->name = Str( "computeIrradianceMap" );
+	computeIrradianceMapCommand->description = Str( "Convolutes input cubemap and outputs an irradiance map." );
+	computeIrradianceMapCommand->fn = Fn_ComputeIrradianceMap;
+	m_commands.push_back( computeIrradianceMapCommand );
+
+	Cmd * buildSceneCommand = new Cmd;
+	buildSceneCommand->name = Str( "buildScene" );
+	buildSceneCommand->description = Str( "Pre-generate all required data for the scene." );
+	buildSceneCommand->fn = Fn_BuildScene;
+	m_commands.push_back( buildSceneCommand );
+
+	Cmd * brdfIntegrationLUTCommand = new Cmd;
+	brdfIntegrationLUTCommand->name = Str( "brdfIntegrationLUT" );
+	brdfIntegrationLUTCommand->description = Str( "Pre-compute the BRDF as a LUT." );
+	brdfIntegrationLUTCommand->fn = Fn_BRDFIntegrationLUT;
+	m_commands.push_back( brdfIntegrationLUTCommand );
+
+	Cmd * fpsCommand = new Cmd;
+	fpsCommand->name = Str( "showFPS" );
+	fpsCommand->description = Str( "Toggle FramesPerSecond counter." );
+	fpsCommand->fn = Fn_FPS;
+	m_commands.push_back( fpsCommand );
+
+	Cmd * loadSceneCommand = new Cmd;
+	loadSceneCommand->name = Str( "loadScene" );
+	loadSceneCommand->description = Str( "Load scene file at user-defined location." );
+	loadSceneCommand->fn = Fn_LoadScene;
+	m_commands.push_back( loadSceneCommand );
+
+	Cmd * reloadSceneCommand = new Cmd;
+	reloadSceneCommand->name = Str( "reloadScene" );
+	reloadSceneCommand->description = Str( "Reload current scene." );
+	reloadSceneCommand->fn = Fn_ReloadScene;
+	m_commands.push_back( reloadSceneCommand );
+
+	Cmd * showBloomCommand = new Cmd;
+	showBloomCommand->name = Str( "showBloom" );
 	showBloomCommand->description = Str( "Enable/Disable bloom post process effect." );
 	showBloomCommand->fn = Fn_ShowBloom;
 	m_commands.push_back( showBloomCommand );
@@ -1047,6 +3534,222 @@ void CommandSys::BuildCommands() {
 	screenshotCommand->description = Str( "Take a screenshot." );
 	screenshotCommand->fn = Fn_Screenshot;
 	m_commands.push_back( screenshotCommand );
+
+	Cmd * glStatsCommand = new Cmd;
+	glStatsCommand->name = Str( "glStats" );
+	glStatsCommand->description = Str( "Print GL call counts of the last frame." );
+	glStatsCommand->fn = Fn_GLStats;
+	m_commands.push_back( glStatsCommand );
+
+	Cmd * singlePassCubeShadowsCommand = new Cmd;
+	singlePassCubeShadowsCommand->name = Str( "singlePassCubeShadows" );
+	singlePassCubeShadowsCommand->description = Str( "Render point light shadows in a single pass (1) or 6 passes (0)." );
+	singlePassCubeShadowsCommand->fn = Fn_SinglePassCubeShadows;
+	m_commands.push_back( singlePassCubeShadowsCommand );
+
+	Cmd * shadowBudgetCommand = new Cmd;
+	shadowBudgetCommand->name = Str( "shadowBudget" );
+	shadowBudgetCommand->description = Str( "Set the per frame shadow budget. ex: shadowBudget partitions 12" );
+	shadowBudgetCommand->fn = Fn_ShadowBudget;
+	m_commands.push_back( shadowBudgetCommand );
+
+	Cmd * simShadowScheduleCommand = new Cmd;
+	simShadowScheduleCommand->name = Str( "simShadowSchedule" );
+	simShadowScheduleCommand->description = Str( "Simulate 1000 frames of shadow scheduling with the current budget." );
+	simShadowScheduleCommand->fn = Fn_SimShadowSchedule;
+	m_commands.push_back( simShadowScheduleCommand );
+
+	Cmd * tightLightVolumesCommand = new Cmd;
+	tightLightVolumesCommand->name = Str( "tightLightVolumes" );
+	tightLightVolumesCommand->description = Str( "Bin lights with cone and icosphere hulls instead of boxes. Optional icosphere subdivisions 0 or 1." );
+	tightLightVolumesCommand->fn = Fn_TightLightVolumes;
+	m_commands.push_back( tightLightVolumesCommand );
+
+	Cmd * binningStatsCommand = new Cmd;
+	binningStatsCommand->name = Str( "binningStats" );
+	binningStatsCommand->description = Str( "Print lights per tile for box volumes and tight hulls from the current view." );
+	binningStatsCommand->fn = Fn_BinningStats;
+	m_commands.push_back( binningStatsCommand );
+
+	Cmd * lightCutoffCommand = new Cmd;
+	lightCutoffCommand->name = Str( "lightCutoff" );
+	lightCutoffCommand->description = Str( "Luminance below which lights are not binned to a tile. 0 uses the max radius." );
+	lightCutoffCommand->fn = Fn_LightCutoff;
+	m_commands.push_back( lightCutoffCommand );
+
+	Cmd * compressBenchmarkCommand = new Cmd;
+	compressBenchmarkCommand->name = Str( "compressBenchmark" );
+	compressBenchmarkCommand->description = Str( "Compare single and multithreaded compression of a texture. Reports MPix/s." );
+	compressBenchmarkCommand->fn = Fn_CompressBenchmark;
+	m_commands.push_back( compressBenchmarkCommand );
+
+	Cmd * buildCacheBenchmarkCommand = new Cmd;
+	buildCacheBenchmarkCommand->name = Str( "buildCacheBenchmark" );
+	buildCacheBenchmarkCommand->description = Str( "Time the build manifest check for [count] textures, default 500." );
+	buildCacheBenchmarkCommand->fn = Fn_BuildCacheBenchmark;
+	m_commands.push_back( buildCacheBenchmarkCommand );
+
+	Cmd * textureLoadBenchmarkCommand = new Cmd;
+	textureLoadBenchmarkCommand->name = Str( "textureLoadBenchmark" );
+	textureLoadBenchmarkCommand->description = Str( "Reload the scene's compressed textures. Reports load time and peak memory." );
+	textureLoadBenchmarkCommand->fn = Fn_TextureLoadBenchmark;
+	m_commands.push_back( textureLoadBenchmarkCommand );
+
+	Cmd * textureStreamingCommand = new Cmd;
+	textureStreamingCommand->name = Str( "textureStreaming" );
+	textureStreamingCommand->description = Str( "Stream texture mips loaded from now on. Optional budget in MB. No args prints stats." );
+	textureStreamingCommand->fn = Fn_TextureStreaming;
+	m_commands.push_back( textureStreamingCommand );
+
+	Cmd * simTextureStreamingCommand = new Cmd;
+	simTextureStreamingCommand->name = Str( "simTextureStreaming" );
+	simTextureStreamingCommand->description = Str( "Simulate texture streaming on synthetic textures. Optional texture count." );
+	simTextureStreamingCommand->fn = Fn_SimTextureStreaming;
+	m_commands.push_back( simTextureStreamingCommand );
+
+	Cmd * equirectBenchmarkCommand = new Cmd;
+	equirectBenchmarkCommand->name = Str( "equirectBenchmark" );
+	equirectBenchmarkCommand->description = Str( "Time panorama to cubemap conversion. Synthesizes an 8k hdr panorama if no path is given." );
+	equirectBenchmarkCommand->fn = Fn_EquirectBenchmark;
+	m_commands.push_back( equirectBenchmarkCommand );
+
+	Cmd * computeIrradianceSHCommand = new Cmd;
+	computeIrradianceSHCommand->name = Str( "computeIrradianceSH" );
+	computeIrradianceSHCommand->description = Str( "Project an env probe cubemap onto L2 spherical harmonics. Saves them as _sh.txt next to it." );
+	computeIrradianceSHCommand->fn = Fn_ComputeIrradianceSH;
+	m_commands.push_back( computeIrradianceSHCommand );
+
+	Cmd * irradianceSHErrorCommand = new Cmd;
+	irradianceSHErrorCommand->name = Str( "irradianceSHError" );
+	irradianceSHErrorCommand->description = Str( "Compare an env probe's SH with its convolved irradiance cubemap and time the projection." );
+	irradianceSHErrorCommand->fn = Fn_IrradianceSHError;
+	m_commands.push_back( irradianceSHErrorCommand );
+
+	Cmd * irradianceSHCommand = new Cmd;
+	irradianceSHCommand->name = Str( "irradianceSH" );
+	irradianceSHCommand->description = Str( "Light probes with their SH instead of their irradiance cubemaps. Args: 0 or 1." );
+	irradianceSHCommand->fn = Fn_IrradianceSH;
+	m_commands.push_back( irradianceSHCommand );
+
+	Cmd * prefilterAccuracyCommand = new Cmd;
+	prefilterAccuracyCommand->name = Str( "prefilterAccuracy" );
+	prefilterAccuracyCommand->description = Str( "Compare the cpu GGX prefilter of a linear environment against the analytic result. Optional arg: sample count." );
+	prefilterAccuracyCommand->fn = Fn_PrefilterAccuracy;
+	m_commands.push_back( prefilterAccuracyCommand );
+
+	Cmd * probeArrayTestCommand = new Cmd;
+	probeArrayTestCommand->name = Str( "probeArrayTest" );
+	probeArrayTestCommand->description = Str( "Pack synthetic cubemaps into env probe array layers and check the block layout and nearest probe assignment." );
+	probeArrayTestCommand->fn = Fn_ProbeArrayTest;
+	m_commands.push_back( probeArrayTestCommand );
+
+	Cmd * uniformCacheCommand = new Cmd;
+	uniformCacheCommand->name = Str( "uniformCache" );
+	uniformCacheCommand->description = Str( "0 to look up uniform locations and check for errors on every set, 1 to use the tables reflected at link time. Prints the uniform counts of the last frame." );
+	uniformCacheCommand->fn = Fn_UniformCache;
+	m_commands.push_back( uniformCacheCommand );
+
+	Cmd * reflectTableTestCommand = new Cmd;
+	reflectTableTestCommand->name = Str( "reflectTableTest" );
+	reflectTableTestCommand->description = Str( "Build uniform name tables of several sizes and check every name is found and unknown names arent." );
+	reflectTableTestCommand->fn = Fn_ReflectTableTest;
+	m_commands.push_back( reflectTableTestCommand );
+
+	Cmd * programCacheCommand = new Cmd;
+	programCacheCommand->name = Str( "programCache" );
+	programCacheCommand->description = Str( "Prints program cache hits, misses and load time. Args: 0 or 1 to turn the cache off or on, time to compare loading every program from source and from the cache." );
+	programCacheCommand->fn = Fn_ProgramCache;
+	m_commands.push_back( programCacheCommand );
+
+	Cmd * programCacheTestCommand = new Cmd;
+	programCacheTestCommand->name = Str( "programCacheTest" );
+	programCacheTestCommand->description = Str( "Write a program cache entry and check that changed sources, vendors, drivers and damaged files are misses." );
+	programCacheTestCommand->fn = Fn_ProgramCacheTest;
+	m_commands.push_back( programCacheTestCommand );
+
+	Cmd * shaderPreprocessorTestCommand = new Cmd;
+	shaderPreprocessorTestCommand->name = Str( "shaderPreprocessorTest" );
+	shaderPreprocessorTestCommand->description = Str( "Expand virtual shader files and check includes, #line directives, defines and permutation keys." );
+	shaderPreprocessorTestCommand->fn = Fn_ShaderPreprocessorTest;
+	m_commands.push_back( shaderPreprocessorTestCommand );
+
+	Cmd * shaderPermutationTestCommand = new Cmd;
+	shaderPermutationTestCommand->name = Str( "shaderPermutationTest" );
+	shaderPermutationTestCommand->description = Str( "Draw the loaded scene with every material built as each SHADOWS and IBL permutation." );
+	shaderPermutationTestCommand->fn = Fn_ShaderPermutationTest;
+	m_commands.push_back( shaderPermutationTestCommand );
+
+	Cmd * drawSortCommand = new Cmd;
+	drawSortCommand->name = Str( "drawSort" );
+	drawSortCommand->description = Str( "Arg 0 draws the scene in scene order, 1 in material sorted order. Prints the state changes of the last frame." );
+	drawSortCommand->fn = Fn_DrawSort;
+	m_commands.push_back( drawSortCommand );
+
+	Cmd * drawListBenchmarkCommand = new Cmd;
+	drawListBenchmarkCommand->name = Str( "drawListBenchmark" );
+	drawListBenchmarkCommand->description = Str( "Count state changes of a synthetic scene in scene order and sorted, and time the draw key sort." );
+	drawListBenchmarkCommand->fn = Fn_DrawListBenchmark;
+	m_commands.push_back( drawListBenchmarkCommand );
+
+	Cmd * bindlessTexturesCommand = new Cmd;
+	bindlessTexturesCommand->name = Str( "bindlessTextures" );
+	bindlessTexturesCommand->description = Str( "Arg 1 reads material textures from the bindless material table, 0 binds them to slots. Reloads the scene." );
+	bindlessTexturesCommand->fn = Fn_BindlessTextures;
+	m_commands.push_back( bindlessTexturesCommand );
+
+	Cmd * materialTableTestCommand = new Cmd;
+	materialTableTestCommand->name = Str( "materialTableTest" );
+	materialTableTestCommand->description = Str( "Pack made up materials into the material table and check the layout and handle refreshes." );
+	materialTableTestCommand->fn = Fn_MaterialTableTest;
+	m_commands.push_back( materialTableTestCommand );
+
+	Cmd * multiDrawIndirectCommand = new Cmd;
+	multiDrawIndirectCommand->name = Str( "multiDrawIndirect" );
+	multiDrawIndirectCommand->description = Str( "Arg 1 submits each batch of scene draws with one multi draw indirect, 0 with a draw per surface. Prints the batches of the last frame." );
+	multiDrawIndirectCommand->fn = Fn_MultiDrawIndirect;
+	m_commands.push_back( multiDrawIndirectCommand );
+
+	Cmd * indirectDrawTestCommand = new Cmd;
+	indirectDrawTestCommand->name = Str( "indirectDrawTest" );
+	indirectDrawTestCommand->description = Str( "Check merged geometry offsets and indirect commands, and batch the draws of a synthetic scene." );
+	indirectDrawTestCommand->fn = Fn_IndirectDrawTest;
+	m_commands.push_back( indirectDrawTestCommand );
+
+	Cmd * declCacheCommand = new Cmd;
+	declCacheCommand->name = Str( "declCache" );
+	declCacheCommand->description = Str( "Toggle loading material decls from compiled binaries with 0 or 1, or time both ways with time. Prints cache hits and misses." );
+	declCacheCommand->fn = Fn_DeclCache;
+	m_commands.push_back( declCacheCommand );
+
+	Cmd * declCacheTestCommand = new Cmd;
+	declCacheTestCommand->name = Str( "declCacheTest" );
+	declCacheTestCommand->description = Str( "Parse decl text, round trip it through the binary form and check stale entries are misses." );
+	declCacheTestCommand->fn = Fn_DeclCacheTest;
+	m_commands.push_back( declCacheTestCommand );
+
+	Cmd * declBenchmarkCommand = new Cmd;
+	declBenchmarkCommand->name = Str( "declBenchmark" );
+	declBenchmarkCommand->description = Str( "Time finding the decls of a synthetic scene by name against by id, and parsing decl text against reading binaries. Optional surface count." );
+	declBenchmarkCommand->fn = Fn_DeclBenchmark;
+	m_commands.push_back( declBenchmarkCommand );
+
+	Cmd * sceneLoadBenchmarkCommand = new Cmd;
+	sceneLoadBenchmarkCommand->name = Str( "sceneLoadBenchmark" );
+	sceneLoadBenchmarkCommand->description = Str( "Time loading the current scene's decls and reading and uploading its textures on 1 up to 16 threads, or the thread count given." );
+	sceneLoadBenchmarkCommand->fn = Fn_SceneLoadBenchmark;
+	m_commands.push_back( sceneLoadBenchmarkCommand );
+
+	Cmd * shaderReloadCommand = new Cmd;
+	shaderReloadCommand->name = Str( "shaderReload" );
+	shaderReloadCommand->description = Str( "0 or 1 turns rebuilding programs whose shader files changed off or on. No args prints the programs and files watched and the reloads so far." );
+	shaderReloadCommand->fn = Fn_ShaderReload;
+	m_commands.push_back( shaderReloadCommand );
+
+	Cmd * shaderWatcherTestCommand = new Cmd;
+	shaderWatcherTestCommand->name = Str( "shaderWatcherTest" );
+	shaderWatcherTestCommand->description = Str( "Check the graph of the files each program uses, and that changes to shader files are found by polling and by change notification." );
+	shaderWatcherTestCommand->fn = Fn_ShaderWatcherTest;
+	m_commands.push_back( shaderWatcherTestCommand );
 }
 
 /*
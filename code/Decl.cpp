@@ -1,5 +1,9 @@
 #include "Decl.h"
 #include "Fileio.h"
+#include "MaterialTable.h"
+#include "DeclCache.h"
+
+#include <set>
 
 //#include <stdio.h>
 //#include <sstream>
@@ -9,87 +13,19 @@
 
 //initialize static members
 resourceMap_t MaterialDecl::s_matDecls;
-std::vector< Texture* > Texture::s_textures;
-
-/*
-====================================
-MaterialDecl::LoadPathsFromFile
-====================================
-*/
-bool MaterialDecl::LoadPathsFromFile( const char * decl_relative, std::string &shaderProg, texturePathMap & texturePaths, vec3Map & vec3Uniforms ) {
-	char decl_absolute[ 2048 ];
-	RelativePathToFullPath( decl_relative, decl_absolute );
-	strcat( decl_absolute, ".txt" );
-	
-	FILE * fp = fopen( decl_absolute, "rb" );
-	if ( !fp ) {
-		fprintf( stderr, "Error: couldn't open \"%s\"!\n", decl_absolute );
-		return false;
-    }
-
-	char buff[ 512 ] = { 0 };
-	char strBuffer1[ 1024 ];
-	char strBuffer2[ 1024 ];
-	char strBuffer3[ 1024 ];
-	float floatBuffer1;
-	float floatBuffer2;
-	float floatBuffer3;
-	std::string uniformName;
-	std::string textureType;
-	std::string texturePath;
-	while ( !feof( fp ) ) {
-		fgets( buff, sizeof( buff ), fp );
-		
-		texturePath.clear();
-
-		if ( sscanf( buff, "shaderProg :: %s", strBuffer1 ) == 1 ) { //identifies what shader to compile
-			shaderProg = strBuffer1;
-			findAndReplaceAll( shaderProg, "\r\n", "" );
-
-		} else if ( sscanf( buff, "framebuffer %s", strBuffer1 ) == 1 ) { //identifies a uniform as a framebuffer
-			//when framebuffer keyword is detected, then the texture will later be fetched from a framebuffer of the same name.
-			uniformName = strBuffer1;
-			findAndReplaceAll( uniformName, "\r\n", "" );
-			TextureSpecs * newTextureSpec = new TextureSpecs();
-			newTextureSpec->type = "framebuffer";
-			texturePaths.insert( std::make_pair( uniformName, newTextureSpec ) ); //add to texture resource
-
-		} else if ( sscanf( buff, "emissiveColor %f %f %f", &floatBuffer1, &floatBuffer2, &floatBuffer3 ) == 3 ) {
-			uniformName = "emissiveColor";
-			findAndReplaceAll( uniformName, "\r\n", "" );
-			vec3Uniforms[uniformName] = Vec3( floatBuffer1, floatBuffer2, floatBuffer3 );
-
-		} else if ( sscanf( buff, "%s %s %s", strBuffer1, strBuffer2, strBuffer3 ) == 3 ) { //associates a uniform name with a texture
-			uniformName = strBuffer1;
-			findAndReplaceAll( uniformName, "\r\n", "" );
-
-			textureType = strBuffer2;
-			findAndReplaceAll( textureType, "\r\n", "" );
-
-			texturePath = strBuffer3;
-			findAndReplaceAll( texturePath, "\r\n", "" );
-
-			TextureSpecs * newTextureSpec = new TextureSpecs();
-			newTextureSpec->type = textureType;
-			newTextureSpec->path = texturePath;
-
-			texturePaths.insert( std::make_pair( uniformName, newTextureSpec ) ); //add to texture resource
-		}
-	}
-	fclose( fp );
-
-	return true;
-}
+std::vector< MaterialDecl * > MaterialDecl::s_declsById;
+std::vector< uint8_t > MaterialDecl::s_materialBlockData;
+UniformBlock MaterialDecl::s_materialBlocks;
+bool MaterialDecl::s_materialBlocksDirty = false;
+int MaterialDecl::s_boundMaterialBlock = -1;
 
 /*
 ====================================
 Decl::DeleteAllDecls
+	-textures are freed once no decl uses them
 ====================================
 */
 void MaterialDecl::DeleteAllDecls() {
-	//ERRORR!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	return;
-
     resourceMap_t::iterator it = s_matDecls.begin();
     while ( it != s_matDecls.end() ) {
 		MaterialDecl * currentMatDecl = it->second;
@@ -98,23 +34,30 @@ void MaterialDecl::DeleteAllDecls() {
 		currentMatDecl = nullptr;
 		it++;
     }
+	s_matDecls.clear();
+	s_declsById.clear();
+	MaterialTable::Clear();
+
+	s_materialBlockData.clear();
+	s_materialBlocks.Delete();
+	s_materialBlocksDirty = false;
+	s_boundMaterialBlock = -1;
 }
 
 /*
 ====================================
 MaterialDecl::Delete
-	-deletes Texture member objects
+	-releases Texture member objects
 ====================================
 */
 void MaterialDecl::Delete() {
 	textureMap::iterator it = m_textures.begin();
 	while ( it != m_textures.end() ) {
-		Texture * currentTexture = it->second;
-		currentTexture->Delete();
-		delete it->second;
+		Texture::Release( it->second );
 		it->second = nullptr;
 		it++;
 	}
+	m_textures.clear();
 }
 
 
@@ -134,7 +77,7 @@ MaterialDecl* MaterialDecl::GetMaterialDecl( const char * name ) {
     // Couldn't find pre-loaded material, so load from file
 	MaterialDecl * newDecl = LoadMaterialDecl( name );
     if ( NULL != newDecl ) {
-		s_matDecls[name] = newDecl;
+		AddDecl( newDecl );
 		return newDecl;
 	}
 
@@ -143,88 +86,190 @@ MaterialDecl* MaterialDecl::GetMaterialDecl( const char * name ) {
 
 /*
 ====================================
-MaterialDecl::LoadMaterialDecl
+MaterialDecl::LoadMaterialDecls
+	-loads every decl of names that isnt loaded yet. Their sources are loaded and the textures
+	 they use are read on the thread pool, at most maxThreads at once, 0 for every worker. Only
+	 the gl textures are made on this thread.
+	-decls that fail to load are left for GetMaterialDecl to report
 ====================================
 */
-MaterialDecl * MaterialDecl::LoadMaterialDecl( const char * name ) {
-	char shaderDir[128];
-	strcpy( shaderDir, "data\\decl\\" );
-	strcat( shaderDir, name );
-
-	std::string shaderProg;
-	texturePathMap texturePaths;
-	textureMap textures;
-	vec3Map vec3Uniforms;
+void MaterialDecl::LoadMaterialDecls( const std::vector< std::string > & names, const unsigned int maxThreads ) {
+	std::vector< std::string > pending;
+	std::set< std::string > pendingSet;
+	for ( size_t i = 0; i < names.size(); i++ ) {
+		if ( s_matDecls.find( names[i] ) == s_matDecls.end() && pendingSet.insert( names[i] ).second ) {
+			pending.push_back( names[i] );
+		}
+	}
 
-	// try to load decl, return false if failed
-    if ( !LoadPathsFromFile( shaderDir, shaderProg, texturePaths, vec3Uniforms ) ) {
-		return NULL;
+	std::vector< declSource_t > sources;
+	std::vector< uint8_t > loaded;
+	DeclCache::LoadAll( pending, sources, loaded, maxThreads );
+
+	//one request list for every decl, so the textures they share are only read once
+	std::vector< std::vector< std::string > > uniforms( pending.size() );
+	std::vector< textureRequest_t > requests;
+	std::vector< size_t > firstRequests( pending.size(), 0 );
+	for ( size_t i = 0; i < pending.size(); i++ ) {
+		if ( loaded[i] ) {
+			firstRequests[i] = requests.size();
+			TextureRequests( sources[i], uniforms[i], requests );
+		}
 	}
+	std::vector< Texture * > textures;
+	Texture::AcquireAll( requests, textures, maxThreads );
 
-	texturePathMap::iterator it = texturePaths.begin();
-	while ( it != texturePaths.end() ) {
-		std::string uniformName = it->first;
-		TextureSpecs* textureEntry = it->second;
-
-		Texture * newTexture = new Texture; //create in advance because access to Texture.s_textures is needed
-
-		//check if texture being added already exists in the static member.
-		int textureIndex = -1; //used to identify the index of the texture in the static texture resource
-		for ( unsigned int j = 0; j < newTexture->s_textures.size(); j++ ) {
-			if( strcmp( newTexture->s_textures[j]->mStrName, textureEntry->path.c_str() ) == 0 ) {
-				textureIndex = j;
-				break;
-			}
+	for ( size_t i = 0; i < pending.size(); i++ ) {
+		if ( loaded[i] ) {
+			AddDecl( NewMaterialDecl( pending[i].c_str(), sources[i], uniforms[i], textures.data() + firstRequests[i] ) );
 		}
+	}
+}
+
+/*
+====================================
+MaterialDecl::AddDecl
+====================================
+*/
+void MaterialDecl::AddDecl( MaterialDecl * decl ) {
+	decl->m_id = ( unsigned int )s_declsById.size(); //decls are only removed all at once
+	s_matDecls[ decl->getName() ] = decl;
+	s_declsById.push_back( decl );
+}
 
-		//add the texture.
-		if ( textureIndex < 0 ) {
-			//texture doesnt exist. Load it and add it to static texture list.
-			if ( textureEntry->type == "texture2d" ) {
-				newTexture->InitFromFile( textureEntry->path.c_str() );
-				newTexture->s_textures.push_back( newTexture );
-				textures[uniformName] = newTexture; //add texture to resource
-			} else if ( textureEntry->type == "cubemap" ) {
-				delete newTexture; //since we need a cubemap, delete newTexture and recreate it as a cubemap obj
-				newTexture = nullptr;
-				CubemapTexture * newCubemapTexture = new CubemapTexture;
-
-				newCubemapTexture->InitFromFile( textureEntry->path.c_str() );
-				newCubemapTexture->s_textures.push_back( newCubemapTexture );
-				textures[uniformName] = newCubemapTexture; //add texture to resource
-			}
+/*
+====================================
+MaterialDecl::TextureRequests
+	-appends the textures a decl source loads, one per sampler uniform in the order of m_textures.
+	 The first line for a uniform is used, framebuffers arent textures of the decl.
+====================================
+*/
+void MaterialDecl::TextureRequests( const declSource_t & source, std::vector< std::string > & uniforms, std::vector< textureRequest_t > & requests ) {
+	std::map< std::string, const declTexture_t * > texturePaths;
+	for ( size_t i = 0; i < source.textures.size(); i++ ) {
+		texturePaths.insert( std::make_pair( source.textures[i].uniform, &source.textures[i] ) );
+	}
 
-		} else {
-			//texture already exists. Fetch it to add to decl texture list
-			newTexture = newTexture->s_textures[textureIndex];
-			textures[uniformName] = newTexture; //add texture to resource
+	uniforms.clear();
+	std::map< std::string, const declTexture_t * >::iterator it = texturePaths.begin();
+	while ( it != texturePaths.end() ) {
+		const declTexture_t * textureEntry = it->second;
+		if ( textureEntry->type == "texture2d" || textureEntry->type == "cubemap" ) {
+			textureRequest_t request;
+			request.path = textureEntry->path;
+			request.cubemap = ( textureEntry->type == "cubemap" );
+			requests.push_back( request );
+			uniforms.push_back( it->first );
 		}
-
 		it++;
 	}
+}
+
+/*
+====================================
+MaterialDecl::NewMaterialDecl
+	-textures[i] is the acquired texture of uniforms[i]
+====================================
+*/
+MaterialDecl * MaterialDecl::NewMaterialDecl( const char * name, const declSource_t & source, const std::vector< std::string > & uniforms, Texture * const * textures ) {
+	//the last line for a vec3 is used
+	vec3Map vec3Uniforms;
+	for ( size_t i = 0; i < source.vec3s.size(); i++ ) {
+		vec3Uniforms[ source.vec3s[i].uniform ] = Vec3( source.vec3s[i].value[0], source.vec3s[i].value[1], source.vec3s[i].value[2] );
+	}
 
 	//create and initialize the data for THIS decl obj
 	MaterialDecl * decl = new MaterialDecl;
 	decl->setName( name );
-	decl->m_shaderProg = shaderProg;
-	decl->m_textures = textures;
+	decl->m_shaderProg = source.shaderProg;
+	decl->m_shaderDefines = source.shaderDefines;
+	for ( size_t i = 0; i < uniforms.size(); i++ ) {
+		decl->m_textures[ uniforms[i] ] = textures[i];
+	}
 	decl->m_vec3s = vec3Uniforms;
 	return decl;
 }
 
+/*
+====================================
+MaterialDecl::LoadMaterialDecl
+====================================
+*/
+MaterialDecl * MaterialDecl::LoadMaterialDecl( const char * name ) {
+	// try to load decl, return false if failed
+	declSource_t source;
+	if ( !DeclCache::Load( name, source ) ) {
+		return NULL;
+	}
+
+	std::vector< std::string > uniforms;
+	std::vector< textureRequest_t > requests;
+	TextureRequests( source, uniforms, requests );
+
+	//textures shared with other decls are only loaded once
+	std::vector< Texture * > textures;
+	for ( size_t i = 0; i < requests.size(); i++ ) {
+		textures.push_back( Texture::Acquire( requests[i].path.c_str(), requests[i].cubemap ) ); //add texture to resource
+	}
+	return NewMaterialDecl( name, source, uniforms, textures.data() );
+}
+
 /*
 ====================================
 MaterialDecl::CompileShaders
 ====================================
 */
 bool MaterialDecl::CompileShader() {
-	shader = shader->GetShader( m_shaderProg.c_str() );
+	shader = shader->GetShader( m_shaderProg.c_str(), m_shaderDefines.c_str() );
 	if ( shader != NULL ) {
+		if ( m_blockLinkId != shader->GetLinkId() ) {
+			BakeUniformBlock();
+		}
 		return true;
 	}
 	return false;
 }
 
+/*
+====================================
+MaterialDecl::BakeUniformBlock
+	-writes the vec3s of this decl into its std140 material_block at the offsets reflected from
+	 its program. Members the decl doesnt set are zero.
+====================================
+*/
+void MaterialDecl::BakeUniformBlock() {
+	m_blockLinkId = shader->GetLinkId();
+	const reflectEntry_t * block = shader->FindUniformBlock( "material_block" );
+	if ( block == NULL ) {
+		m_blockOffset = -1;
+		m_blockSize = 0;
+		return;
+	}
+
+	//keep this decl's range when it still fits, otherwise append a new one
+	if ( m_blockOffset < 0 || block->size > m_blockSize ) {
+		const size_t alignment = ( size_t )UniformBlock::OffsetAlignment();
+		const size_t offset = ( s_materialBlockData.size() + alignment - 1 ) / alignment * alignment;
+		s_materialBlockData.resize( offset + block->size, 0 );
+		m_blockOffset = ( int )offset;
+	}
+	m_blockSize = block->size;
+
+	uint8_t * data = &s_materialBlockData[ m_blockOffset ];
+	memset( data, 0, m_blockSize );
+	vec3Map::iterator it = m_vec3s.begin();
+	while ( it != m_vec3s.end() ) {
+		const reflectEntry_t * member = shader->FindBlockMember( it->first.c_str() );
+		if ( member != NULL && member->type == GL_FLOAT_VEC3 ) {
+			memcpy( data + member->value, it->second.as_ptr(), 3 * sizeof( float ) );
+		} else {
+			printf( "Material decl %s: %s is not a vec3 of material_block\n", name.c_str(), it->first.c_str() );
+		}
+		it++;
+	}
+	s_materialBlocksDirty = true;
+}
+
 /*
 ====================================
 MaterialDecl::BindTextures
@@ -232,23 +277,64 @@ MaterialDecl::BindTextures
 */
 void MaterialDecl::BindTextures() {
 	shader->UseProgram();
+	const bool useHandles = Shader::s_uniformCache;
+	if ( useHandles && m_handleLinkId != shader->GetLinkId() ) {
+		ResolveHandles();
+	}
+
+	//the textures are in the material table, the program finds this decl's entry by the draw
+	if ( UsesMaterialTable() ) {
+		return;
+	}
 
 	//pass textures
 	unsigned int slotCount = 0;
 	textureMap::iterator it = m_textures.begin();
 	while ( it != m_textures.end() ) {
-		std::string uniformName = it->first;
+		const std::string & uniformName = it->first;
 		Texture* texture = it->second;
-		if ( texture->GetName() == 2 ) {
-			shader->SetAndBindUniformTexture( uniformName.c_str(), slotCount, GL_TEXTURE_CUBE_MAP, texture->GetName() );
+		const GLenum target = texture->GetTarget();
+		if ( useHandles ) {
+			shader->SetAndBindUniformTexture( m_textureHandles[ slotCount ], slotCount, target, texture->GetName() );
 		} else {
-			shader->SetAndBindUniformTexture( uniformName.c_str(), slotCount, texture->GetTarget(), texture->GetName() );
+			shader->SetAndBindUniformTexture( uniformName.c_str(), slotCount, target, texture->GetName() );
 		}
 		slotCount++;
 		it++;
 	}
 }
 
+/*
+====================================
+MaterialDecl::ResolveHandles
+	-looks up the uniforms of this decl once per program instead of every time they are set
+====================================
+*/
+void MaterialDecl::ResolveHandles() {
+	m_textureHandles.clear();
+	for ( textureMap::iterator it = m_textures.begin(); it != m_textures.end(); it++ ) {
+		m_textureHandles.push_back( shader->GetUniformHandle( it->first.c_str() ) );
+	}
+
+	m_vec3Handles.clear();
+	for ( vec3Map::iterator it = m_vec3s.begin(); it != m_vec3s.end(); it++ ) {
+		m_vec3Handles.push_back( shader->GetUniformHandle( it->first.c_str() ) );
+	}
+
+	m_handleLinkId = shader->GetLinkId();
+}
+
+/*
+====================================
+MaterialDecl::UsesMaterialTable
+	-programs built with BINDLESS_TEXTURES read textures and constants from the material table,
+	 by the material id of each draw command
+====================================
+*/
+bool MaterialDecl::UsesMaterialTable() const {
+	return MaterialTable::s_bindless && shader->HasStorageBlock( "material_buffer" );
+}
+
 /*
 ====================================
 MaterialDecl::PassFloatUniforms
@@ -256,12 +342,43 @@ MaterialDecl::PassFloatUniforms
 */
 void MaterialDecl::PassVec3Uniforms() {
 	shader->UseProgram();
+	if ( UsesMaterialTable() ) {
+		return;
+	}
+	if ( m_blockLinkId != shader->GetLinkId() ) {
+		BakeUniformBlock();
+	}
 
+	//constants were baked into the material blocks, only this decl's range is bound
+	if ( m_blockOffset >= 0 ) {
+		if ( s_materialBlocksDirty ) {
+			s_materialBlocks.Upload( s_materialBlockData.size(), s_materialBlockData.data() );
+			s_materialBlocksDirty = false;
+			s_boundMaterialBlock = -1;
+		}
+		if ( s_boundMaterialBlock != m_blockOffset ) {
+			s_materialBlocks.BindRange( UNIFORM_BLOCK_MATERIAL, m_blockOffset, m_blockSize );
+			s_boundMaterialBlock = m_blockOffset;
+		}
+		return;
+	}
+
+	const bool useHandles = Shader::s_uniformCache;
+	if ( useHandles && m_handleLinkId != shader->GetLinkId() ) {
+		ResolveHandles();
+	}
+
+	unsigned int uniformIdx = 0;
 	vec3Map::iterator it = m_vec3s.begin();
 	while ( it != m_vec3s.end() ) {
-		const std::string uniformName = it->first;
+		const std::string & uniformName = it->first;
 		const Vec3 val = it->second;
-		shader->SetUniform3f( uniformName.c_str(), 1, val.as_ptr() );
+		if ( useHandles ) {
+			shader->SetUniform3f( m_vec3Handles[ uniformIdx ], 1, val.as_ptr() );
+		} else {
+			shader->SetUniform3f( uniformName.c_str(), 1, val.as_ptr() );
+		}
+		uniformIdx++;
 		it++;
 	}
 }
\ No newline at end of file
@@ -3,21 +3,18 @@
 #define __DECL_H_INCLUDE__
 
 #include <map>
+#include <vector>
 
 #include "Shader.h"
 #include "Texture.h"
 #include "String.h"
 #include "Vector.h"
+#include "DeclCache.h"
 
-//in the material decl, a texture entry is a uniform name pointing to a type and a relative path
-struct TextureSpecs {
-	std::string type;
-	std::string path;
-};
+#define DECL_ID_NONE 0xffffffff
 
 class MaterialDecl;
 typedef std::map< std::string, MaterialDecl* > resourceMap_t;
-typedef std::map< std::string, TextureSpecs* > texturePathMap;
 typedef std::map< std::string, Texture* > textureMap;
 typedef std::map< std::string, Vec3 > vec3Map;
 
@@ -33,8 +30,6 @@ class Decl {
 		std::string getType() { return type; }
 		void setType( std::string s ) { type = s; }
 
-		virtual void DeleteAllDecls() {};
-
 		Shader * shader;
 
 	protected:
@@ -49,25 +44,50 @@ Material
 */
 class MaterialDecl : public Decl {
 	public:
-		MaterialDecl() { setType( "material" ); }
+		MaterialDecl() { setType( "material" ); m_handleLinkId = 0; m_blockOffset = -1; m_blockSize = 0; m_blockLinkId = 0; m_id = DECL_ID_NONE; }
 		~MaterialDecl() {};
 		void Delete();
-		void DeleteAllDecls() override;
+		static void DeleteAllDecls();
 
 		static MaterialDecl * GetMaterialDecl( const char * name );
+		static MaterialDecl * DeclById( const unsigned int id ) { return s_declsById[ id ]; }
+		static void LoadMaterialDecls( const std::vector< std::string > & names, const unsigned int maxThreads = 0 );
+		static void TextureRequests( const declSource_t & source, std::vector< std::string > & uniforms, std::vector< textureRequest_t > & requests );
 		bool CompileShader();
 		void BindTextures();
 		void PassVec3Uniforms();
+		bool UsesMaterialTable() const;
 
 		std::string m_shaderProg;
+		std::string m_shaderDefines; //permutation of m_shaderProg, like "SHADOWS=0 IBL=0"
 		textureMap m_textures;
 		vec3Map m_vec3s;
+		unsigned int m_id; //dense, in load order. Surfaces and draw keys refer to decls by it instead of the name.
 
 		static resourceMap_t s_matDecls;
+		static std::vector< MaterialDecl * > s_declsById;
 
 	private:
+		void ResolveHandles();
+
+		std::vector< uniformHandle_t > m_textureHandles; //in the order of m_textures
+		std::vector< uniformHandle_t > m_vec3Handles; //in the order of m_vec3s
+		unsigned int m_handleLinkId; //link of the program the handles were resolved in
+
+		void BakeUniformBlock();
+
+		int m_blockOffset; //of this decl's material_block in s_materialBlockData, -1 if its program has no material_block
+		int m_blockSize;
+		unsigned int m_blockLinkId; //link of the program the block was baked for
+
+		static std::vector< uint8_t > s_materialBlockData; //every baked material_block, each at an aligned offset
+		static UniformBlock s_materialBlocks;
+		static bool s_materialBlocksDirty;
+		static int s_boundMaterialBlock; //offset bound to UNIFORM_BLOCK_MATERIAL, -1 if none
+
 		static MaterialDecl * LoadMaterialDecl( const char * name );
-		static bool LoadPathsFromFile( const char * decl_relative, std::string &shaderProg, texturePathMap & texturePaths, vec3Map & vec3Uniforms );				
+		static MaterialDecl * NewMaterialDecl( const char * name, const declSource_t & source, const std::vector< std::string > & uniforms, Texture * const * textures );
+		static void AddDecl( MaterialDecl * decl );
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "DeclCache.h"
+#include "Fileio.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#define DECL_CACHE_MAGIC	0x43434544 //DECC
+#define DECL_CACHE_VERSION	1
+
+struct declCacheHeader_t {
+	uint32_t magic;
+	uint32_t version;
+	fileStamp_t sourceStamp; //of the decl text the entry was compiled from
+	uint32_t size; //bytes of serialized decl following the header
+	uint32_t pad;
+	uint64_t dataHash; //catches entries cut short or damaged on disk
+};
+
+bool DeclCache::s_enabled = true;
+unsigned int DeclCache::s_hits = 0;
+unsigned int DeclCache::s_misses = 0;
+double DeclCache::s_loadSeconds = 0.0;
+
+/*
+================================
+DeclCache::Parse
+	-one line at a time like fgets into a 512 byte buffer, longer lines are split
+================================
+*/
+void DeclCache::Parse( const char * text, const size_t length, declSource_t & source ) {
+	char buff[ 512 ];
+	char strBuffer1[ 512 ];
+	char strBuffer2[ 512 ];
+	char strBuffer3[ 512 ];
+	float floatBuffer1;
+	float floatBuffer2;
+	float floatBuffer3;
+
+	size_t pos = 0;
+	while ( pos < length ) {
+		size_t lineLength = 0;
+		while ( pos < length && lineLength < sizeof( buff ) - 1 ) {
+			const char c = text[ pos++ ];
+			buff[ lineLength++ ] = c;
+			if ( c == '\n' ) {
+				break;
+			}
+		}
+		buff[ lineLength ] = '\0';
+
+		if ( sscanf( buff, "shaderProg :: %s", strBuffer1 ) == 1 ) { //identifies what shader to compile
+			source.shaderProg = strBuffer1;
+
+		} else if ( strncmp( buff, "shaderDefines :: ", 17 ) == 0 ) { //permutation of the shader, the rest of the line
+			source.shaderDefines = buff + 17;
+			findAndReplaceAll( source.shaderDefines, "\r", "" );
+			findAndReplaceAll( source.shaderDefines, "\n", "" );
+
+		} else if ( sscanf( buff, "framebuffer %s", strBuffer1 ) == 1 ) { //identifies a uniform as a framebuffer
+			//when framebuffer keyword is detected, then the texture will later be fetched from a framebuffer of the same name.
+			declTexture_t texture;
+			texture.uniform = strBuffer1;
+			texture.type = "framebuffer";
+			source.textures.push_back( texture );
+
+		} else if ( sscanf( buff, "emissiveColor %f %f %f", &floatBuffer1, &floatBuffer2, &floatBuffer3 ) == 3 ) {
+			declVec3_t vec3;
+			vec3.uniform = "emissiveColor";
+			vec3.value[0] = floatBuffer1;
+			vec3.value[1] = floatBuffer2;
+			vec3.value[2] = floatBuffer3;
+			source.vec3s.push_back( vec3 );
+
+		} else if ( sscanf( buff, "%s %s %s", strBuffer1, strBuffer2, strBuffer3 ) == 3 ) { //associates a uniform name with a texture
+			declTexture_t texture;
+			texture.uniform = strBuffer1;
+			texture.type = strBuffer2;
+			texture.path = strBuffer3;
+			source.textures.push_back( texture );
+		}
+	}
+}
+
+/*
+================================
+WriteU32
+================================
+*/
+static void WriteU32( std::vector< uint8_t > & data, const uint32_t value ) {
+	const uint8_t * bytes = ( const uint8_t * )&value;
+	data.insert( data.end(), bytes, bytes + sizeof( value ) );
+}
+
+/*
+================================
+WriteString
+	-length then characters, without the terminator
+================================
+*/
+static void WriteString( std::vector< uint8_t > & data, const std::string & value ) {
+	WriteU32( data, ( uint32_t )value.size() );
+	data.insert( data.end(), value.begin(), value.end() );
+}
+
+/*
+================================
+ReadBytes
+	-false when fewer than size bytes are left
+================================
+*/
+static bool ReadBytes( const uint8_t * data, const size_t dataSize, size_t & offset, void * value, const size_t size ) {
+	if ( size > dataSize - offset ) {
+		return false;
+	}
+	memcpy( value, data + offset, size );
+	offset += size;
+	return true;
+}
+
+/*
+================================
+ReadString
+================================
+*/
+static bool ReadString( const uint8_t * data, const size_t dataSize, size_t & offset, std::string & value ) {
+	uint32_t length = 0;
+	if ( !ReadBytes( data, dataSize, offset, &length, sizeof( length ) ) || length > dataSize - offset ) {
+		return false;
+	}
+	value.assign( ( const char * )data + offset, length );
+	offset += length;
+	return true;
+}
+
+/*
+================================
+DeclCache::Serialize
+================================
+*/
+void DeclCache::Serialize( const declSource_t & source, std::vector< uint8_t > & data ) {
+	data.clear();
+	WriteString( data, source.shaderProg );
+	WriteString( data, source.shaderDefines );
+
+	WriteU32( data, ( uint32_t )source.textures.size() );
+	for ( size_t i = 0; i < source.textures.size(); i++ ) {
+		WriteString( data, source.textures[i].uniform );
+		WriteString( data, source.textures[i].type );
+		WriteString( data, source.textures[i].path );
+	}
+
+	WriteU32( data, ( uint32_t )source.vec3s.size() );
+	for ( size_t i = 0; i < source.vec3s.size(); i++ ) {
+		WriteString( data, source.vec3s[i].uniform );
+		const uint8_t * bytes = ( const uint8_t * )source.vec3s[i].value;
+		data.insert( data.end(), bytes, bytes + sizeof( source.vec3s[i].value ) );
+	}
+}
+
+/*
+================================
+DeclCache::Deserialize
+	-false if the data ends early or has bytes left over
+================================
+*/
+bool DeclCache::Deserialize( const uint8_t * data, const size_t size, declSource_t & source ) {
+	size_t offset = 0;
+	if ( !ReadString( data, size, offset, source.shaderProg ) || !ReadString( data, size, offset, source.shaderDefines ) ) {
+		return false;
+	}
+
+	//every texture is at least its three lengths, so a damaged count cant make a huge allocation
+	uint32_t textureCount = 0;
+	if ( !ReadBytes( data, size, offset, &textureCount, sizeof( textureCount ) ) || textureCount > ( size - offset ) / ( 3 * sizeof( uint32_t ) ) ) {
+		return false;
+	}
+	source.textures.resize( textureCount );
+	for ( uint32_t i = 0; i < textureCount; i++ ) {
+		declTexture_t & texture = source.textures[i];
+		if ( !ReadString( data, size, offset, texture.uniform ) || !ReadString( data, size, offset, texture.type ) || !ReadString( data, size, offset, texture.path ) ) {
+			return false;
+		}
+	}
+
+	uint32_t vec3Count = 0;
+	if ( !ReadBytes( data, size, offset, &vec3Count, sizeof( vec3Count ) ) || vec3Count > ( size - offset ) / ( sizeof( uint32_t ) + 3 * sizeof( float ) ) ) {
+		return false;
+	}
+	source.vec3s.resize( vec3Count );
+	for ( uint32_t i = 0; i < vec3Count; i++ ) {
+		declVec3_t & vec3 = source.vec3s[i];
+		if ( !ReadString( data, size, offset, vec3.uniform ) || !ReadBytes( data, size, offset, vec3.value, sizeof( vec3.value ) ) ) {
+			return false;
+		}
+	}
+	return offset == size;
+}
+
+/*
+================================
+DeclCache::TextPath
+================================
+*/
+std::string DeclCache::TextPath( const char * name ) {
+	return "data\\decl\\" + std::string( name ) + ".txt";
+}
+
+/*
+================================
+DeclCache::EntryPath
+	-entries mirror the folders of data\decl\
+================================
+*/
+std::string DeclCache::EntryPath( const char * name ) {
+	return "data\\generated\\decl\\" + std::string( name ) + ".bin";
+}
+
+/*
+================================
+DeclCache::Read
+	-false if there is no entry, it was compiled from another version of the text, or it is damaged
+================================
+*/
+bool DeclCache::Read( const char * relativePath, const fileStamp_t & sourceStamp, declSource_t & source ) {
+	mappedFile_t file;
+	if ( !MapFile( relativePath, file ) ) {
+		return false;
+	}
+
+	bool valid = false;
+	declCacheHeader_t header;
+	if ( file.size >= sizeof( header ) ) {
+		memcpy( &header, file.data, sizeof( header ) );
+		valid = header.magic == DECL_CACHE_MAGIC && header.version == DECL_CACHE_VERSION &&
+				header.sourceStamp.size == sourceStamp.size && header.sourceStamp.writeTime == sourceStamp.writeTime &&
+				file.size == sizeof( header ) + header.size &&
+				BuildManifest::HashBytes( file.data + sizeof( header ), header.size ) == header.dataHash;
+	}
+	if ( valid ) {
+		declSource_t readSource;
+		valid = Deserialize( file.data + sizeof( header ), header.size, readSource );
+		if ( valid ) {
+			source = readSource;
+		}
+	}
+	UnmapFile( file );
+	return valid;
+}
+
+/*
+================================
+DeclCache::Write
+	-writes to a temporary file and renames it over the entry, so a crash never leaves a partial entry
+================================
+*/
+bool DeclCache::Write( const char * relativePath, const fileStamp_t & sourceStamp, const declSource_t & source ) {
+	std::vector< uint8_t > data;
+	Serialize( source, data );
+
+	declCacheHeader_t header;
+	header.magic = DECL_CACHE_MAGIC;
+	header.version = DECL_CACHE_VERSION;
+	header.sourceStamp = sourceStamp;
+	header.size = ( uint32_t )data.size();
+	header.pad = 0;
+	header.dataHash = BuildManifest::HashBytes( data.data(), data.size() );
+
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+
+	//make the directory of the entry
+	std::string directory( relativePath );
+	const size_t slash = directory.find_last_of( "\\/" );
+	if ( slash != std::string::npos ) {
+		directory.erase( slash + 1 );
+		if ( dirExists( directory.c_str() ) == false ) {
+			makeDir( directory.c_str() );
+		}
+	}
+
+	char tempPath[ 2048 + 32 ];
+	sprintf( tempPath, "%s.%lu.tmp", fullPath, GetCurrentProcessId() );
+	FILE * fs = fopen( tempPath, "wb" );
+	if ( !fs ) {
+		printf( "Failed to write decl cache entry: %s\n", tempPath );
+		return false;
+	}
+	fwrite( &header, sizeof( header ), 1, fs );
+	fwrite( data.data(), 1, data.size(), fs );
+	const bool writeFailed = ( ferror( fs ) != 0 );
+	fclose( fs );
+	if ( writeFailed || MoveFileExA( tempPath, fullPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) == 0 ) {
+		printf( "Failed to write decl cache entry: %s\n", fullPath );
+		DeleteFileA( tempPath );
+		return false;
+	}
+	return true;
+}
+
+/*
+================================
+DeclCache::Load
+================================
+*/
+bool DeclCache::Load( const char * name, declSource_t & source ) {
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	bool hit = false;
+	const bool loaded = LoadSource( name, source, hit );
+	if ( loaded ) {
+		s_hits += hit ? 1 : 0;
+		s_misses += hit ? 0 : 1;
+	}
+	s_loadSeconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+	return loaded;
+}
+
+/*
+================================
+DeclCache::LoadAll
+	-Load for every name on the thread pool, at most maxThreads at once, 0 for every worker.
+	 loaded[i] is 0 when names[i] failed.
+================================
+*/
+void DeclCache::LoadAll( const std::vector< std::string > & names, std::vector< declSource_t > & sources, std::vector< uint8_t > & loaded, const unsigned int maxThreads ) {
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	sources.assign( names.size(), declSource_t() );
+	loaded.assign( names.size(), 0 );
+	std::vector< uint8_t > hits( names.size(), 0 );
+	ThreadPool::getInstance()->ParallelFor( ( unsigned int )names.size(), [&names, &sources, &loaded, &hits]( unsigned int i ) {
+		bool hit = false;
+		loaded[i] = LoadSource( names[i].c_str(), sources[i], hit ) ? 1 : 0;
+		hits[i] = hit ? 1 : 0;
+	}, maxThreads );
+
+	for ( size_t i = 0; i < names.size(); i++ ) {
+		if ( loaded[i] ) {
+			s_hits += hits[i];
+			s_misses += 1 - hits[i];
+		}
+	}
+	s_loadSeconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+/*
+================================
+DeclCache::LoadSource
+	-the decl text is only opened when its entry is missing or stale
+================================
+*/
+bool DeclCache::LoadSource( const char * name, declSource_t & source, bool & hit ) {
+	const std::string textPath = TextPath( name );
+	const std::string entryPath = EntryPath( name );
+
+	fileStamp_t stamp;
+	bool loaded = false;
+	hit = false;
+	if ( !BuildManifest::GetFileStamp( textPath.c_str(), stamp ) ) {
+		fprintf( stderr, "Error: couldn't open \"%s\"!\n", textPath.c_str() );
+	} else if ( s_enabled && Read( entryPath.c_str(), stamp, source ) ) {
+		hit = true;
+		loaded = true;
+	} else {
+		mappedFile_t file;
+		if ( stamp.size == 0 ) {
+			loaded = true; //empty files cant be mapped, and say nothing anyway
+		} else if ( MapFile( textPath.c_str(), file ) ) {
+			Parse( ( const char * )file.data, file.size, source );
+			UnmapFile( file );
+			loaded = true;
+		} else {
+			fprintf( stderr, "Error: couldn't open \"%s\"!\n", textPath.c_str() );
+		}
+		if ( loaded && s_enabled ) {
+			Write( entryPath.c_str(), stamp, source );
+		}
+	}
+	return loaded;
+}
\ No newline at end of file
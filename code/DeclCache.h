@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __DECLCACHE_H_INCLUDE__
+#define __DECLCACHE_H_INCLUDE__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "BuildManifest.h"
+
+//a "uniform type path" or "framebuffer uniform" line of a material decl
+struct declTexture_t {
+	std::string uniform;
+	std::string type; //texture2d, cubemap or framebuffer
+	std::string path; //empty for framebuffers
+};
+
+struct declVec3_t {
+	std::string uniform;
+	float value[3];
+};
+
+//what the text of a material decl says, before any of its textures are loaded
+struct declSource_t {
+	std::string shaderProg;
+	std::string shaderDefines; //permutation of shaderProg, like "SHADOWS=0 IBL=0"
+	std::vector< declTexture_t > textures; //in file order
+	std::vector< declVec3_t > vec3s;
+};
+
+/*
+==============================
+DeclCache
+	-material decls compiled to a binary form in data\generated\decl\, one entry per decl. An
+	 entry loads with a single read and no text parsing.
+	-an entry is only used while the size and write time of the decl text it was compiled from
+	 still match. Anything else is a miss, the text is parsed and the entry written again.
+	-LoadSource doesnt touch the counters and may be called from jobs.
+==============================
+*/
+class DeclCache {
+	public:
+		static void Parse( const char * text, const size_t length, declSource_t & source );
+		static void Serialize( const declSource_t & source, std::vector< uint8_t > & data );
+		static bool Deserialize( const uint8_t * data, const size_t size, declSource_t & source );
+
+		static std::string TextPath( const char * name );
+		static std::string EntryPath( const char * name );
+		static bool Read( const char * relativePath, const fileStamp_t & sourceStamp, declSource_t & source );
+		static bool Write( const char * relativePath, const fileStamp_t & sourceStamp, const declSource_t & source );
+		static bool Load( const char * name, declSource_t & source );
+		static bool LoadSource( const char * name, declSource_t & source, bool & hit );
+		static void LoadAll( const std::vector< std::string > & names, std::vector< declSource_t > & sources, std::vector< uint8_t > & loaded, const unsigned int maxThreads = 0 );
+
+		static bool s_enabled;
+		static unsigned int s_hits;
+		static unsigned int s_misses;
+		static double s_loadSeconds; //spent in Load, on hits and misses
+};
+
+#endif
\ No newline at end of file
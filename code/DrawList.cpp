@@ -0,0 +1,204 @@
+#include "DrawList.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define DRAW_KEY_FLIPPED_SHIFT	0
+#define DRAW_KEY_SURFACE_SHIFT	( DRAW_KEY_FLIPPED_SHIFT + DRAW_KEY_FLIPPED_BITS )
+#define DRAW_KEY_MESH_SHIFT		( DRAW_KEY_SURFACE_SHIFT + DRAW_KEY_SURFACE_BITS )
+#define DRAW_KEY_MATERIAL_SHIFT	( DRAW_KEY_MESH_SHIFT + DRAW_KEY_MESH_BITS )
+#define DRAW_KEY_PROGRAM_SHIFT	( DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS )
+
+bool DrawList::s_sort = true;
+
+/*
+================================
+DrawList::MakeKey
+================================
+*/
+uint64_t DrawList::MakeKey( const unsigned int program, const unsigned int material, const unsigned int mesh, const unsigned int surface, const bool flipped ) {
+	assert( program < ( 1u << DRAW_KEY_PROGRAM_BITS ) );
+	assert( material < ( 1u << DRAW_KEY_MATERIAL_BITS ) );
+	assert( mesh < ( 1u << DRAW_KEY_MESH_BITS ) );
+	assert( surface < ( 1u << DRAW_KEY_SURFACE_BITS ) );
+
+	return ( ( uint64_t )program << DRAW_KEY_PROGRAM_SHIFT ) |
+		   ( ( uint64_t )material << DRAW_KEY_MATERIAL_SHIFT ) |
+		   ( ( uint64_t )mesh << DRAW_KEY_MESH_SHIFT ) |
+		   ( ( uint64_t )surface << DRAW_KEY_SURFACE_SHIFT ) |
+		   ( ( uint64_t )( flipped ? 1 : 0 ) << DRAW_KEY_FLIPPED_SHIFT );
+}
+
+/*
+================================
+DrawList::KeyProgram
+================================
+*/
+unsigned int DrawList::KeyProgram( const uint64_t key ) {
+	return ( unsigned int )( ( key >> DRAW_KEY_PROGRAM_SHIFT ) & ( ( 1u << DRAW_KEY_PROGRAM_BITS ) - 1 ) );
+}
+
+/*
+================================
+DrawList::KeyMaterial
+================================
+*/
+unsigned int DrawList::KeyMaterial( const uint64_t key ) {
+	return ( unsigned int )( ( key >> DRAW_KEY_MATERIAL_SHIFT ) & ( ( 1u << DRAW_KEY_MATERIAL_BITS ) - 1 ) );
+}
+
+/*
+================================
+DrawList::KeyMesh
+================================
+*/
+unsigned int DrawList::KeyMesh( const uint64_t key ) {
+	return ( unsigned int )( ( key >> DRAW_KEY_MESH_SHIFT ) & ( ( 1u << DRAW_KEY_MESH_BITS ) - 1 ) );
+}
+
+/*
+================================
+DrawList::KeySurface
+================================
+*/
+unsigned int DrawList::KeySurface( const uint64_t key ) {
+	return ( unsigned int )( ( key >> DRAW_KEY_SURFACE_SHIFT ) & ( ( 1u << DRAW_KEY_SURFACE_BITS ) - 1 ) );
+}
+
+/*
+================================
+DrawList::KeyFlipped
+================================
+*/
+bool DrawList::KeyFlipped( const uint64_t key ) {
+	return ( ( key >> DRAW_KEY_FLIPPED_SHIFT ) & 1 ) != 0;
+}
+
+/*
+================================
+DrawList::RadixSort
+	-lsd radix sort on bytes. Passes over a byte that is the same in every key are skipped, which
+	 is most of the upper bytes of the program and material fields.
+	-stable, so draws with the same key keep scene order
+================================
+*/
+void DrawList::RadixSort( std::vector< uint64_t >& keys, std::vector< uint64_t >& scratch ) {
+	const size_t count = keys.size();
+	if ( count < 2 ) {
+		return;
+	}
+	scratch.resize( count );
+
+	//histogram every byte in one pass over the keys
+	unsigned int histograms[8][256];
+	memset( histograms, 0, sizeof( histograms ) );
+	for ( size_t i = 0; i < count; i++ ) {
+		const uint64_t key = keys[i];
+		for ( unsigned int b = 0; b < 8; b++ ) {
+			histograms[b][ ( key >> ( b * 8 ) ) & 0xff ]++;
+		}
+	}
+
+	uint64_t * src = keys.data();
+	uint64_t * dst = scratch.data();
+	for ( unsigned int b = 0; b < 8; b++ ) {
+		unsigned int * histogram = histograms[b];
+		if ( histogram[ ( src[0] >> ( b * 8 ) ) & 0xff ] == count ) {
+			continue;
+		}
+
+		unsigned int offset = 0;
+		for ( unsigned int i = 0; i < 256; i++ ) {
+			const unsigned int bucketSize = histogram[i];
+			histogram[i] = offset;
+			offset += bucketSize;
+		}
+		for ( size_t i = 0; i < count; i++ ) {
+			dst[ histogram[ ( src[i] >> ( b * 8 ) ) & 0xff ]++ ] = src[i];
+		}
+
+		uint64_t * swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	//an odd number of passes leaves the result in the scratch buffer
+	if ( src != keys.data() ) {
+		keys.swap( scratch );
+	}
+}
+
+/*
+================================
+DrawList::CountStateChanges
+	-the state changes of submitting keys in order the way RenderScene does. A new program also
+	 rebinds the material since samplers and material blocks are set per program.
+================================
+*/
+drawStateChanges_t DrawList::CountStateChanges( const std::vector< uint64_t >& keys ) {
+	drawStateChanges_t changes;
+	changes.draws = ( unsigned int )keys.size();
+	changes.programs = 0;
+	changes.materials = 0;
+	changes.vertexArrays = 0;
+	changes.frontFaces = 0;
+
+	bool flipped = false; //GL_CCW
+	for ( size_t i = 0; i < keys.size(); i++ ) {
+		const uint64_t key = keys[i];
+		const bool newProgram = ( i == 0 ) || KeyProgram( key ) != KeyProgram( keys[ i - 1 ] );
+		const bool newMaterial = newProgram || KeyMaterial( key ) != KeyMaterial( keys[ i - 1 ] );
+		const bool newVertexArray = ( i == 0 ) || KeyMesh( key ) != KeyMesh( keys[ i - 1 ] ) || KeySurface( key ) != KeySurface( keys[ i - 1 ] ) || KeyFlipped( key ) != KeyFlipped( keys[ i - 1 ] );
+		changes.programs += newProgram ? 1 : 0;
+		changes.materials += newMaterial ? 1 : 0;
+		changes.vertexArrays += newVertexArray ? 1 : 0;
+		if ( KeyFlipped( key ) != flipped ) {
+			flipped = KeyFlipped( key );
+			changes.frontFaces++;
+		}
+	}
+	return changes;
+}
+
+/*
+================================
+SyntheticRandom
+	-lcg so that the synthetic scene is the same on every platform
+================================
+*/
+static unsigned int SyntheticRandom( unsigned int * state ) {
+	*state = *state * 1664525u + 1013904223u;
+	return *state >> 8;
+}
+
+/*
+================================
+DrawList::BuildSyntheticScene
+	-keys of a scene in scene order. Meshes have 1 to 8 surfaces with random materials, every
+	 material uses one of the programs. Every tenth mesh also has flipped instances.
+================================
+*/
+void DrawList::BuildSyntheticScene( const unsigned int surfaceCount, const unsigned int materialCount, const unsigned int programCount, const unsigned int seed, std::vector< uint64_t >& keys ) {
+	assert( materialCount > 0 && programCount > 0 );
+	keys.clear();
+
+	unsigned int rng = seed;
+	std::vector< unsigned int > materialPrograms( materialCount );
+	for ( unsigned int i = 0; i < materialCount; i++ ) {
+		materialPrograms[i] = SyntheticRandom( &rng ) % programCount;
+	}
+
+	unsigned int surfacesAdded = 0;
+	for ( unsigned int mesh = 0; surfacesAdded < surfaceCount; mesh++ ) {
+		const unsigned int meshSurfaces = 1 + SyntheticRandom( &rng ) % 8;
+		const bool hasFlipped = ( mesh % 10 ) == 9;
+		for ( unsigned int surface = 0; surface < meshSurfaces && surfacesAdded < surfaceCount; surface++ ) {
+			const unsigned int material = SyntheticRandom( &rng ) % materialCount;
+			keys.push_back( MakeKey( materialPrograms[ material ], material, mesh, surface, false ) );
+			if ( hasFlipped ) {
+				keys.push_back( MakeKey( materialPrograms[ material ], material, mesh, surface, true ) );
+			}
+			surfacesAdded++;
+		}
+	}
+}
\ No newline at end of file
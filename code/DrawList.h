@@ -0,0 +1,60 @@
+#pragma once
+#ifndef __DRAWLIST_H_INCLUDE__
+#define __DRAWLIST_H_INCLUDE__
+
+#include <vector>
+#include <stdint.h>
+
+//bits of a draw key, from the most significant field down
+#define DRAW_KEY_PROGRAM_BITS	16
+#define DRAW_KEY_MATERIAL_BITS	16
+#define DRAW_KEY_MESH_BITS		19
+#define DRAW_KEY_SURFACE_BITS	12
+#define DRAW_KEY_FLIPPED_BITS	1
+
+struct drawStateChanges_t {
+	unsigned int draws;
+	unsigned int programs; //each also re-sends the light data
+	unsigned int materials; //texture and material block binds
+	unsigned int vertexArrays;
+	unsigned int frontFaces;
+};
+
+/*
+==============================
+DrawList
+	-the draws of a frame as 64 bit keys of program, material, mesh, surface and flip state. A
+	 surface with flipped and unflipped instances is two draws.
+	-sorted, draws that share a program and material are next to each other so submission only
+	 changes state when a field of the key changes.
+==============================
+*/
+class DrawList {
+	public:
+		DrawList() {};
+		~DrawList() {};
+
+		void Clear() { m_keys.clear(); }
+		void Add( const uint64_t key ) { m_keys.push_back( key ); }
+		void Sort() { RadixSort( m_keys, m_scratch ); }
+		const std::vector< uint64_t >& Keys() const { return m_keys; }
+
+		static uint64_t MakeKey( const unsigned int program, const unsigned int material, const unsigned int mesh, const unsigned int surface, const bool flipped );
+		static unsigned int KeyProgram( const uint64_t key );
+		static unsigned int KeyMaterial( const uint64_t key );
+		static unsigned int KeyMesh( const uint64_t key );
+		static unsigned int KeySurface( const uint64_t key );
+		static bool KeyFlipped( const uint64_t key );
+
+		static void RadixSort( std::vector< uint64_t >& keys, std::vector< uint64_t >& scratch );
+		static drawStateChanges_t CountStateChanges( const std::vector< uint64_t >& keys );
+		static void BuildSyntheticScene( const unsigned int surfaceCount, const unsigned int materialCount, const unsigned int programCount, const unsigned int seed, std::vector< uint64_t >& keys );
+
+		static bool s_sort; //when false the draws are submitted in scene order
+
+	private:
+		std::vector< uint64_t > m_keys;
+		std::vector< uint64_t > m_scratch; //kept so sorting doesnt allocate every frame
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,810 @@
+#include "EnvMapBaker.h"
+#include "ThreadPool.h"
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ENV_PI		3.14159265f
+#define ENV_ROWS_PER_JOB	8
+#define IRRADIANCE_SH_VERSION	1
+
+/*
+================================
+FaceRowBasis
+	-the unnormalized direction of cross texel coordinate s on row t of a face is base + step * s.
+	 s and t are continuous, texel centers are at half coordinates.
+================================
+*/
+static void FaceRowBasis( const int face, const float t, const int faceSize, float base[3], float step[3] ) {
+	const float h = ( float )faceSize * 0.5f;
+	step[0] = 0.0f;
+	step[1] = 0.0f;
+	step[2] = 0.0f;
+	switch ( face ) {
+		case 0: //front
+			base[0] = -h; base[1] = t - h; base[2] = -h; step[0] = 1.0f;
+			break;
+		case 1: //back
+			base[0] = h; base[1] = t - h; base[2] = h; step[0] = -1.0f;
+			break;
+		case 2: //up
+			base[0] = h - t; base[1] = -h; base[2] = h; step[2] = -1.0f;
+			break;
+		case 3: //down
+			base[0] = t - h; base[1] = h; base[2] = h; step[2] = -1.0f;
+			break;
+		case 4: //right
+			base[0] = -h; base[1] = t - h; base[2] = h; step[2] = -1.0f;
+			break;
+		default: //left
+			base[0] = h; base[1] = t - h; base[2] = -h; step[2] = 1.0f;
+			break;
+	}
+}
+
+/*
+================================
+Atan2_4
+	-four atan2s at once. Max error is about 2e-6 radians, well under a texel of an 8k panorama.
+================================
+*/
+static inline __m128 Atan2_4( const __m128 y, const __m128 x ) {
+	const __m128 signMask = _mm_set1_ps( -0.0f );
+	const __m128 ax = _mm_andnot_ps( signMask, x );
+	const __m128 ay = _mm_andnot_ps( signMask, y );
+	const __m128 mx = _mm_max_ps( ax, ay );
+	const __m128 mn = _mm_min_ps( ax, ay );
+	const __m128 a = _mm_div_ps( mn, _mm_max_ps( mx, _mm_set1_ps( 1e-30f ) ) );
+	const __m128 s = _mm_mul_ps( a, a );
+
+	//atan( a ) for a in [0, 1]
+	__m128 r = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( -0.01172120f ), s ), _mm_set1_ps( 0.05265332f ) );
+	r = _mm_add_ps( _mm_mul_ps( r, s ), _mm_set1_ps( -0.11643287f ) );
+	r = _mm_add_ps( _mm_mul_ps( r, s ), _mm_set1_ps( 0.19354346f ) );
+	r = _mm_add_ps( _mm_mul_ps( r, s ), _mm_set1_ps( -0.33262347f ) );
+	r = _mm_add_ps( _mm_mul_ps( r, s ), _mm_set1_ps( 0.99997726f ) );
+	r = _mm_mul_ps( r, a );
+
+	//back to the full circle
+	const __m128 swapped = _mm_cmpgt_ps( ay, ax );
+	r = _mm_or_ps( _mm_and_ps( swapped, _mm_sub_ps( _mm_set1_ps( ENV_PI * 0.5f ), r ) ), _mm_andnot_ps( swapped, r ) );
+	const __m128 negX = _mm_cmplt_ps( x, _mm_setzero_ps() );
+	r = _mm_or_ps( _mm_and_ps( negX, _mm_sub_ps( _mm_set1_ps( ENV_PI ), r ) ), _mm_andnot_ps( negX, r ) );
+	return _mm_xor_ps( r, _mm_and_ps( y, signMask ) );
+}
+
+/*
+================================
+SampleEquirect
+	-adds the bilinear sample at uv to rgb. Wraps horizontally and clamps vertically.
+================================
+*/
+static inline void SampleEquirect( const envImage_t & equirect, const float u, const float v, float * rgb ) {
+	const int width = equirect.width;
+	const int height = equirect.height;
+
+	const float px = u * ( float )width - 0.5f + ( float )width; //kept positive so truncating floors
+	int x0 = ( int )px;
+	const float fx = px - ( float )x0;
+	x0 %= width;
+	const int x1 = ( x0 + 1 < width ) ? x0 + 1 : 0;
+
+	float py = v * ( float )height - 0.5f;
+	py = ( py < 0.0f ) ? 0.0f : ( ( py > ( float )( height - 1 ) ) ? ( float )( height - 1 ) : py );
+	const int y0 = ( int )py;
+	const float fy = py - ( float )y0;
+	const int y1 = ( y0 + 1 < height ) ? y0 + 1 : y0;
+
+	const float * p00 = &equirect.pixels[ ( ( size_t )y0 * width + x0 ) * 3 ];
+	const float * p10 = &equirect.pixels[ ( ( size_t )y0 * width + x1 ) * 3 ];
+	const float * p01 = &equirect.pixels[ ( ( size_t )y1 * width + x0 ) * 3 ];
+	const float * p11 = &equirect.pixels[ ( ( size_t )y1 * width + x1 ) * 3 ];
+	const float w00 = ( 1.0f - fx ) * ( 1.0f - fy );
+	const float w10 = fx * ( 1.0f - fy );
+	const float w01 = ( 1.0f - fx ) * fy;
+	const float w11 = fx * fy;
+	for ( int c = 0; c < 3; c++ ) {
+		rgb[c] += p00[c] * w00 + p10[c] * w10 + p01[c] * w01 + p11[c] * w11;
+	}
+}
+
+/*
+================================
+ConvertRow
+	-fills one row of the cross image. Every texel averages supersample x supersample bilinear samples.
+================================
+*/
+static void ConvertRow( const envImage_t & equirect, const int faceSize, const int supersample, const int row, float * output, const bool vectorized ) {
+	const float inv2Pi = 1.0f / ( 2.0f * ENV_PI );
+	const float invPi = 1.0f / ENV_PI;
+	const float sampleScale = 1.0f / ( float )( supersample * supersample );
+
+	std::vector< float > rgb( faceSize * 3 );
+	for ( int face = 0; face < 6; face++ ) {
+		memset( rgb.data(), 0, rgb.size() * sizeof( float ) );
+
+		for ( int a = 0; a < supersample; a++ ) {
+			const float t = ( float )row + ( ( float )a + 0.5f ) / ( float )supersample;
+			float base[3];
+			float step[3];
+			FaceRowBasis( face, t, faceSize, base, step );
+
+			for ( int b = 0; b < supersample; b++ ) {
+				const float sOffset = ( ( float )b + 0.5f ) / ( float )supersample;
+				if ( vectorized ) {
+					const __m128 laneOffsets = _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f );
+					for ( int k = 0; k < faceSize; k += 4 ) {
+						const __m128 s = _mm_add_ps( laneOffsets, _mm_set1_ps( ( float )k + sOffset ) );
+						const __m128 dx = _mm_add_ps( _mm_set1_ps( base[0] ), _mm_mul_ps( _mm_set1_ps( step[0] ), s ) );
+						const __m128 dy = _mm_set1_ps( base[1] ); //step[1] is 0 for every face
+						const __m128 dz = _mm_add_ps( _mm_set1_ps( base[2] ), _mm_mul_ps( _mm_set1_ps( step[2] ), s ) );
+						const __m128 horizontal = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dz, dz ) ) );
+
+						//asin( y / length ) is atan2( y, horizontal length ), so the direction never needs normalizing
+						const __m128 u = _mm_add_ps( _mm_mul_ps( Atan2_4( dz, dx ), _mm_set1_ps( inv2Pi ) ), _mm_set1_ps( 0.5f ) );
+						const __m128 v = _mm_add_ps( _mm_mul_ps( Atan2_4( dy, horizontal ), _mm_set1_ps( invPi ) ), _mm_set1_ps( 0.5f ) );
+						float us[4];
+						float vs[4];
+						_mm_storeu_ps( us, u );
+						_mm_storeu_ps( vs, v );
+
+						const int laneCount = ( faceSize - k < 4 ) ? faceSize - k : 4;
+						for ( int lane = 0; lane < laneCount; lane++ ) {
+							SampleEquirect( equirect, us[lane], vs[lane], &rgb[ ( k + lane ) * 3 ] );
+						}
+					}
+				} else {
+					for ( int k = 0; k < faceSize; k++ ) {
+						const float s = ( float )k + sOffset;
+						Vec3 dir = Vec3( base[0] + step[0] * s, base[1] + step[1] * s, base[2] + step[2] * s );
+						dir.normalize();
+						const float u = atan2f( dir.z, dir.x ) * inv2Pi + 0.5f;
+						const float v = asinf( dir.y ) * invPi + 0.5f;
+						SampleEquirect( equirect, u, v, &rgb[ k * 3 ] );
+					}
+				}
+			}
+		}
+
+		float * faceOutput = output + face * faceSize * 3;
+		for ( int i = 0; i < faceSize * 3; i++ ) {
+			faceOutput[i] = rgb[i] * sampleScale;
+		}
+	}
+}
+
+/*
+================================
+EnvMapBaker::LoadEnvImage
+	-loads a tga or hdr image as rgb floats. tga values are scaled to [0, 1].
+================================
+*/
+bool EnvMapBaker::LoadEnvImage( const char * fullPath, envImage_t & image ) {
+	const size_t pathLength = strlen( fullPath );
+	if ( pathLength < 4 ) {
+		return false;
+	}
+	const char * ext = fullPath + pathLength - 4;
+
+	int chanCount = 0;
+	stbi_set_flip_vertically_on_load( false );
+	if ( strcmp( ext, ".hdr" ) == 0 ) {
+		float * data = stbi_loadf( fullPath, &image.width, &image.height, &chanCount, 3 );
+		if ( data == NULL ) {
+			return false;
+		}
+		image.pixels.assign( data, data + ( size_t )image.width * image.height * 3 );
+		stbi_image_free( data );
+	} else if ( strcmp( ext, ".tga" ) == 0 ) {
+		unsigned char * data = stbi_load( fullPath, &image.width, &image.height, &chanCount, 3 );
+		if ( data == NULL ) {
+			return false;
+		}
+		const size_t valueCount = ( size_t )image.width * image.height * 3;
+		image.pixels.resize( valueCount );
+		for ( size_t i = 0; i < valueCount; i++ ) {
+			image.pixels[i] = ( float )data[i] / 255.0f;
+		}
+		stbi_image_free( data );
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/*
+================================
+EnvMapBaker::SaveEnvImage
+	-the format is picked from the extension, tga values are clamped to [0, 1]
+================================
+*/
+bool EnvMapBaker::SaveEnvImage( const char * fullPath, const envImage_t & image ) {
+	const size_t pathLength = strlen( fullPath );
+	if ( pathLength < 4 ) {
+		return false;
+	}
+	const char * ext = fullPath + pathLength - 4;
+
+	if ( strcmp( ext, ".hdr" ) == 0 ) {
+		return stbi_write_hdr( fullPath, image.width, image.height, 3, image.pixels.data() ) != 0;
+	} else if ( strcmp( ext, ".tga" ) == 0 ) {
+		std::vector< unsigned char > data( image.pixels.size() );
+		for ( size_t i = 0; i < data.size(); i++ ) {
+			const float value = image.pixels[i] * 255.0f + 0.5f;
+			data[i] = ( unsigned char )( ( value < 0.0f ) ? 0.0f : ( ( value > 255.0f ) ? 255.0f : value ) );
+		}
+		return stbi_write_tga( fullPath, image.width, image.height, 3, data.data() ) != 0;
+	}
+	return false;
+}
+
+/*
+================================
+EnvMapBaker::CrossTexelDirection
+	-unit direction through continuous coordinate s, t of a face of a cross image
+================================
+*/
+Vec3 EnvMapBaker::CrossTexelDirection( const int face, const float s, const float t, const int faceSize ) {
+	float base[3];
+	float step[3];
+	FaceRowBasis( face, t, faceSize, base, step );
+	Vec3 dir = Vec3( base[0] + step[0] * s, base[1] + step[1] * s, base[2] + step[2] * s );
+	dir.normalize();
+	return dir;
+}
+
+/*
+================================
+EnvMapBaker::EquirectToCubemap
+	-resamples an equirectangular panorama into a cross image of faceSize faces.
+	-supersample > 1 averages several bilinear samples per texel, for faces much smaller than the panorama.
+	-the vectorized path does the direction to uv math four texels at a time. The scalar path uses
+	 the libm trig functions and is kept as a reference.
+================================
+*/
+void EnvMapBaker::EquirectToCubemap( const envImage_t & equirect, const int faceSize, const int supersample, envImage_t & cubemap, const bool vectorized, const bool multithreaded ) {
+	cubemap.width = faceSize * 6;
+	cubemap.height = faceSize;
+	cubemap.pixels.resize( ( size_t )cubemap.width * cubemap.height * 3 );
+
+	const int samples = ( supersample > 0 ) ? supersample : 1;
+	const unsigned int jobCount = ( unsigned int )( ( faceSize + ENV_ROWS_PER_JOB - 1 ) / ENV_ROWS_PER_JOB );
+	auto convertRows = [&]( unsigned int job ) {
+		const int firstRow = ( int )job * ENV_ROWS_PER_JOB;
+		const int endRow = ( firstRow + ENV_ROWS_PER_JOB < faceSize ) ? firstRow + ENV_ROWS_PER_JOB : faceSize;
+		for ( int row = firstRow; row < endRow; row++ ) {
+			ConvertRow( equirect, faceSize, samples, row, &cubemap.pixels[ ( size_t )row * cubemap.width * 3 ], vectorized );
+		}
+	};
+
+	if ( multithreaded ) {
+		ThreadPool::getInstance()->ParallelFor( jobCount, convertRows );
+	} else {
+		for ( unsigned int job = 0; job < jobCount; job++ ) {
+			convertRows( job );
+		}
+	}
+}
+
+/*
+================================
+CubeFaceRowBasis
+	-gl cubemap face layout. The unnormalized direction at sc on row tc of a face is base + step * sc,
+	 with sc and tc in [-1, 1].
+================================
+*/
+static void CubeFaceRowBasis( const int face, const float tc, float base[3], float step[3] ) {
+	step[0] = 0.0f;
+	step[1] = 0.0f;
+	step[2] = 0.0f;
+	switch ( face ) {
+		case 0: //+x
+			base[0] = 1.0f; base[1] = -tc; base[2] = 0.0f; step[2] = -1.0f;
+			break;
+		case 1: //-x
+			base[0] = -1.0f; base[1] = -tc; base[2] = 0.0f; step[2] = 1.0f;
+			break;
+		case 2: //+y
+			base[0] = 0.0f; base[1] = 1.0f; base[2] = tc; step[0] = 1.0f;
+			break;
+		case 3: //-y
+			base[0] = 0.0f; base[1] = -1.0f; base[2] = -tc; step[0] = 1.0f;
+			break;
+		case 4: //+z
+			base[0] = 0.0f; base[1] = -tc; base[2] = 1.0f; step[0] = 1.0f;
+			break;
+		default: //-z
+			base[0] = 0.0f; base[1] = -tc; base[2] = -1.0f; step[0] = -1.0f;
+			break;
+	}
+}
+
+/*
+================================
+EnvMapBaker::CubeTexelDirection
+	-unit direction through continuous texel coordinate s, t of a face, texel centers are at half coordinates
+================================
+*/
+Vec3 EnvMapBaker::CubeTexelDirection( const int face, const float s, const float t, const int faceSize ) {
+	float base[3];
+	float step[3];
+	const float sc = s * 2.0f / ( float )faceSize - 1.0f;
+	const float tc = t * 2.0f / ( float )faceSize - 1.0f;
+	CubeFaceRowBasis( face, tc, base, step );
+	Vec3 dir = Vec3( base[0] + step[0] * sc, base[1] + step[1] * sc, base[2] + step[2] * sc );
+	dir.normalize();
+	return dir;
+}
+
+/*
+================================
+ProjectRow
+	-sums radiance * basis * solid angle over one row of every face. sums gets the 27 coefficient
+	 sums followed by the summed solid angle weights.
+	-the solid angle of a texel is proportional to 1 / |direction|^3 of its unnormalized direction
+================================
+*/
+static void ProjectRow( const envImage_t & cubemap, const int row, double * sums ) {
+	const int faceSize = cubemap.height;
+	const float texelSize = 2.0f / ( float )faceSize;
+	const float tc = ( ( float )row + 0.5f ) * texelSize - 1.0f;
+
+	__m128 acc[28];
+	for ( int i = 0; i < 28; i++ ) {
+		acc[i] = _mm_setzero_ps();
+	}
+
+	const __m128 one = _mm_set1_ps( 1.0f );
+	const __m128 laneOffsets = _mm_set_ps( 3.5f, 2.5f, 1.5f, 0.5f );
+	for ( int face = 0; face < 6; face++ ) {
+		float base[3];
+		float step[3];
+		CubeFaceRowBasis( face, tc, base, step );
+		const float * facePixels = &cubemap.pixels[ ( ( size_t )row * cubemap.width + ( size_t )face * faceSize ) * 3 ];
+
+		for ( int k = 0; k < faceSize; k += 4 ) {
+			const __m128 sc = _mm_sub_ps( _mm_mul_ps( _mm_add_ps( laneOffsets, _mm_set1_ps( ( float )k ) ), _mm_set1_ps( texelSize ) ), one );
+			const __m128 rx = _mm_add_ps( _mm_set1_ps( base[0] ), _mm_mul_ps( _mm_set1_ps( step[0] ), sc ) );
+			const __m128 ry = _mm_add_ps( _mm_set1_ps( base[1] ), _mm_mul_ps( _mm_set1_ps( step[1] ), sc ) );
+			const __m128 rz = _mm_add_ps( _mm_set1_ps( base[2] ), _mm_mul_ps( _mm_set1_ps( step[2] ), sc ) );
+			const __m128 lengthSqr = _mm_add_ps( _mm_add_ps( _mm_mul_ps( rx, rx ), _mm_mul_ps( ry, ry ) ), _mm_mul_ps( rz, rz ) );
+			const __m128 invLength = _mm_div_ps( one, _mm_sqrt_ps( lengthSqr ) ); //not rsqrt, its precision differs between cpus
+			const __m128 x = _mm_mul_ps( rx, invLength );
+			const __m128 y = _mm_mul_ps( ry, invLength );
+			const __m128 z = _mm_mul_ps( rz, invLength );
+
+			//texels past the end of the face get no weight
+			float laneWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			float r[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float g[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float b[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for ( int lane = 0; lane < 4; lane++ ) {
+				if ( k + lane < faceSize ) {
+					r[lane] = facePixels[ ( k + lane ) * 3 + 0 ];
+					g[lane] = facePixels[ ( k + lane ) * 3 + 1 ];
+					b[lane] = facePixels[ ( k + lane ) * 3 + 2 ];
+				} else {
+					laneWeights[lane] = 0.0f;
+				}
+			}
+			const __m128 weight = _mm_mul_ps( _mm_loadu_ps( laneWeights ), _mm_mul_ps( invLength, _mm_mul_ps( invLength, invLength ) ) );
+			const __m128 wr = _mm_mul_ps( weight, _mm_loadu_ps( r ) );
+			const __m128 wg = _mm_mul_ps( weight, _mm_loadu_ps( g ) );
+			const __m128 wb = _mm_mul_ps( weight, _mm_loadu_ps( b ) );
+
+			__m128 basis[9];
+			basis[0] = _mm_set1_ps( 0.282095f );
+			basis[1] = _mm_mul_ps( _mm_set1_ps( 0.488603f ), y );
+			basis[2] = _mm_mul_ps( _mm_set1_ps( 0.488603f ), z );
+			basis[3] = _mm_mul_ps( _mm_set1_ps( 0.488603f ), x );
+			basis[4] = _mm_mul_ps( _mm_set1_ps( 1.092548f ), _mm_mul_ps( x, y ) );
+			basis[5] = _mm_mul_ps( _mm_set1_ps( 1.092548f ), _mm_mul_ps( y, z ) );
+			basis[6] = _mm_mul_ps( _mm_set1_ps( 0.315392f ), _mm_sub_ps( _mm_mul_ps( _mm_set1_ps( 3.0f ), _mm_mul_ps( z, z ) ), one ) );
+			basis[7] = _mm_mul_ps( _mm_set1_ps( 1.092548f ), _mm_mul_ps( x, z ) );
+			basis[8] = _mm_mul_ps( _mm_set1_ps( 0.546274f ), _mm_sub_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ) );
+			for ( int i = 0; i < 9; i++ ) {
+				acc[ i * 3 + 0 ] = _mm_add_ps( acc[ i * 3 + 0 ], _mm_mul_ps( basis[i], wr ) );
+				acc[ i * 3 + 1 ] = _mm_add_ps( acc[ i * 3 + 1 ], _mm_mul_ps( basis[i], wg ) );
+				acc[ i * 3 + 2 ] = _mm_add_ps( acc[ i * 3 + 2 ], _mm_mul_ps( basis[i], wb ) );
+			}
+			acc[27] = _mm_add_ps( acc[27], weight );
+		}
+	}
+
+	for ( int i = 0; i < 28; i++ ) {
+		float lanes[4];
+		_mm_storeu_ps( lanes, acc[i] );
+		sums[i] = ( double )lanes[0] + ( double )lanes[1] + ( double )lanes[2] + ( double )lanes[3];
+	}
+}
+
+/*
+================================
+EnvMapBaker::ProjectIrradianceSH
+	-projects the radiance of a cubemap onto L2 spherical harmonics and convolves them with the
+	 cosine lobe (Ramamoorthi and Hanrahan 2001).
+	-rows are summed in order, so the result doesnt depend on the thread count.
+================================
+*/
+void EnvMapBaker::ProjectIrradianceSH( const envImage_t & cubemap, irradianceSH_t & sh, const bool multithreaded ) {
+	const int faceSize = cubemap.height;
+	std::vector< double > rowSums( ( size_t )faceSize * 28 );
+	auto projectRow = [&]( unsigned int row ) {
+		ProjectRow( cubemap, ( int )row, &rowSums[ ( size_t )row * 28 ] );
+	};
+	if ( multithreaded ) {
+		ThreadPool::getInstance()->ParallelFor( ( unsigned int )faceSize, projectRow );
+	} else {
+		for ( int row = 0; row < faceSize; row++ ) {
+			projectRow( ( unsigned int )row );
+		}
+	}
+
+	double sums[28] = { 0.0 };
+	for ( int row = 0; row < faceSize; row++ ) {
+		for ( int i = 0; i < 28; i++ ) {
+			sums[i] += rowSums[ ( size_t )row * 28 + i ];
+		}
+	}
+
+	//the weights are scaled so the texels cover exactly 4 pi, then each band is convolved with the
+	//cosine lobe and divided by pi: A0 = pi, A1 = 2pi / 3, A2 = pi / 4
+	const double bandScale[3] = { 1.0, 2.0 / 3.0, 1.0 / 4.0 };
+	const int coeffBand[9] = { 0, 1, 1, 1, 2, 2, 2, 2, 2 };
+	const double solidAngleScale = ( sums[27] > 0.0 ) ? 4.0 * 3.14159265358979 / sums[27] : 0.0;
+	for ( int i = 0; i < 9; i++ ) {
+		for ( int c = 0; c < 3; c++ ) {
+			sh.coeffs[i][c] = ( float )( sums[ i * 3 + c ] * solidAngleScale * bandScale[ coeffBand[i] ] );
+		}
+	}
+}
+
+/*
+================================
+EnvMapBaker::EvaluateIrradianceSH
+	-same math as IrradianceSH in the cook-torrance shader
+================================
+*/
+Vec3 EnvMapBaker::EvaluateIrradianceSH( const irradianceSH_t & sh, const Vec3 & normal ) {
+	const float x = normal.x;
+	const float y = normal.y;
+	const float z = normal.z;
+	const float basis[9] = {
+		0.282095f,
+		0.488603f * y,
+		0.488603f * z,
+		0.488603f * x,
+		1.092548f * x * y,
+		1.092548f * y * z,
+		0.315392f * ( 3.0f * z * z - 1.0f ),
+		1.092548f * x * z,
+		0.546274f * ( x * x - y * y )
+	};
+	float rgb[3] = { 0.0f, 0.0f, 0.0f };
+	for ( int i = 0; i < 9; i++ ) {
+		for ( int c = 0; c < 3; c++ ) {
+			rgb[c] += sh.coeffs[i][c] * basis[i];
+		}
+	}
+	return Vec3( rgb[0] > 0.0f ? rgb[0] : 0.0f, rgb[1] > 0.0f ? rgb[1] : 0.0f, rgb[2] > 0.0f ? rgb[2] : 0.0f );
+}
+
+/*
+================================
+EnvMapBaker::LoadIrradianceSH
+================================
+*/
+bool EnvMapBaker::LoadIrradianceSH( const char * fullPath, irradianceSH_t & sh ) {
+	FILE * fs = fopen( fullPath, "r" );
+	if ( !fs ) {
+		return false;
+	}
+	int version = 0;
+	bool success = ( fscanf( fs, "irradianceSH %d\n", &version ) == 1 && version == IRRADIANCE_SH_VERSION );
+	for ( int i = 0; i < 9 && success; i++ ) {
+		success = ( fscanf( fs, "%f %f %f\n", &sh.coeffs[i][0], &sh.coeffs[i][1], &sh.coeffs[i][2] ) == 3 );
+	}
+	fclose( fs );
+	return success;
+}
+
+/*
+================================
+EnvMapBaker::SaveIrradianceSH
+================================
+*/
+bool EnvMapBaker::SaveIrradianceSH( const char * fullPath, const irradianceSH_t & sh ) {
+	FILE * fs = fopen( fullPath, "w" );
+	if ( !fs ) {
+		return false;
+	}
+	fprintf( fs, "irradianceSH %d\n", IRRADIANCE_SH_VERSION );
+	for ( int i = 0; i < 9; i++ ) {
+		fprintf( fs, "%.9g %.9g %.9g\n", sh.coeffs[i][0], sh.coeffs[i][1], sh.coeffs[i][2] );
+	}
+	const bool success = ( ferror( fs ) == 0 );
+	fclose( fs );
+	return success;
+}
+
+/*
+================================
+DirectionToCubeUV
+	-inverse of CubeTexelDirection. u and v are in [0, 1] across the returned face.
+================================
+*/
+static int DirectionToCubeUV( const float x, const float y, const float z, float & u, float & v ) {
+	const float ax = fabsf( x );
+	const float ay = fabsf( y );
+	const float az = fabsf( z );
+	int face;
+	float sc;
+	float tc;
+	float ma;
+	if ( ax >= ay && ax >= az ) {
+		ma = ax;
+		face = ( x > 0.0f ) ? 0 : 1;
+		sc = ( x > 0.0f ) ? -z : z;
+		tc = -y;
+	} else if ( ay >= az ) {
+		ma = ay;
+		face = ( y > 0.0f ) ? 2 : 3;
+		sc = x;
+		tc = ( y > 0.0f ) ? z : -z;
+	} else {
+		ma = az;
+		face = ( z > 0.0f ) ? 4 : 5;
+		sc = ( z > 0.0f ) ? x : -x;
+		tc = -y;
+	}
+	u = ( sc / ma + 1.0f ) * 0.5f;
+	v = ( tc / ma + 1.0f ) * 0.5f;
+	return face;
+}
+
+/*
+================================
+SampleCubeLevel
+	-bilinear sample of one level of a gl order cubemap. Samples are clamped to the face they land on.
+================================
+*/
+static void SampleCubeLevel( const envImage_t & level, const int face, const float u, const float v, float * rgb ) {
+	const int faceSize = level.height;
+	float x = u * ( float )faceSize - 0.5f;
+	float y = v * ( float )faceSize - 0.5f;
+	x = ( x < 0.0f ) ? 0.0f : ( ( x > ( float )( faceSize - 1 ) ) ? ( float )( faceSize - 1 ) : x );
+	y = ( y < 0.0f ) ? 0.0f : ( ( y > ( float )( faceSize - 1 ) ) ? ( float )( faceSize - 1 ) : y );
+	const int x0 = ( int )x;
+	const int y0 = ( int )y;
+	const int x1 = ( x0 + 1 < faceSize ) ? x0 + 1 : x0;
+	const int y1 = ( y0 + 1 < faceSize ) ? y0 + 1 : y0;
+	const float fx = x - ( float )x0;
+	const float fy = y - ( float )y0;
+
+	const float * row0 = &level.pixels[ ( ( size_t )y0 * level.width + ( size_t )face * faceSize ) * 3 ];
+	const float * row1 = &level.pixels[ ( ( size_t )y1 * level.width + ( size_t )face * faceSize ) * 3 ];
+	for ( int c = 0; c < 3; c++ ) {
+		const float top = row0[ x0 * 3 + c ] + ( row0[ x1 * 3 + c ] - row0[ x0 * 3 + c ] ) * fx;
+		const float bottom = row1[ x0 * 3 + c ] + ( row1[ x1 * 3 + c ] - row1[ x0 * 3 + c ] ) * fx;
+		rgb[c] = top + ( bottom - top ) * fy;
+	}
+}
+
+/*
+================================
+BuildCubeMips
+	-box filtered mip chain of a gl order cubemap down to 1x1 faces, each face filtered on its own
+================================
+*/
+static void BuildCubeMips( const envImage_t & cubemap, std::vector< envImage_t > & mips ) {
+	mips.assign( 1, cubemap );
+	while ( mips.back().height > 1 ) {
+		const envImage_t & src = mips.back();
+		envImage_t dst;
+		dst.height = src.height / 2;
+		dst.width = dst.height * 6;
+		dst.pixels.resize( ( size_t )dst.width * dst.height * 3 );
+		for ( int y = 0; y < dst.height; y++ ) {
+			const float * row0 = &src.pixels[ ( size_t )( y * 2 ) * src.width * 3 ];
+			const float * row1 = &src.pixels[ ( size_t )( y * 2 + 1 ) * src.width * 3 ];
+			float * dstRow = &dst.pixels[ ( size_t )y * dst.width * 3 ];
+			for ( int x = 0; x < dst.width; x++ ) {
+				for ( int c = 0; c < 3; c++ ) {
+					dstRow[ x * 3 + c ] = ( row0[ x * 6 + c ] + row0[ x * 6 + 3 + c ] + row1[ x * 6 + c ] + row1[ x * 6 + 3 + c ] ) * 0.25f;
+				}
+			}
+		}
+		mips.push_back( dst );
+	}
+}
+
+/*
+================================
+ggxSample_t
+	-light direction of a GGX sample in the tangent space of the normal, with V = N
+================================
+*/
+struct ggxSample_t {
+	float x;
+	float y;
+	float z; //NdotL, also the weight of the sample
+	float lod; //source level covering the solid angle of the sample
+};
+
+/*
+================================
+RadicalInverse
+	-Van der Corpus sequence, same as the prefilter_envMap shader
+================================
+*/
+static float RadicalInverse( unsigned int bits ) {
+	bits = ( bits << 16u ) | ( bits >> 16u );
+	bits = ( ( bits & 0x55555555u ) << 1u ) | ( ( bits & 0xAAAAAAAAu ) >> 1u );
+	bits = ( ( bits & 0x33333333u ) << 2u ) | ( ( bits & 0xCCCCCCCCu ) >> 2u );
+	bits = ( ( bits & 0x0F0F0F0Fu ) << 4u ) | ( ( bits & 0xF0F0F0F0u ) >> 4u );
+	bits = ( ( bits & 0x00FF00FFu ) << 8u ) | ( ( bits & 0xFF00FF00u ) >> 8u );
+	return ( float )bits * 2.3283064365386963e-10f;
+}
+
+/*
+================================
+BuildGGXSamples
+	-importance samples the GGX lobe of roughness with a Hammersley set. The lobe doesnt depend on
+	 the normal, so it is built once per level. Samples below the horizon are dropped.
+================================
+*/
+static void BuildGGXSamples( const float roughness, const unsigned int sampleCount, const float sourceSize, std::vector< ggxSample_t > & samples ) {
+	samples.clear();
+	if ( roughness <= 0.0f ) {
+		ggxSample_t mirror = { 0.0f, 0.0f, 1.0f, 0.0f };
+		samples.push_back( mirror );
+		return;
+	}
+
+	const float alpha = roughness * roughness;
+	const float alphaSqr = alpha * alpha;
+	const float texelSolidAngle = 4.0f * ENV_PI / ( 6.0f * sourceSize * sourceSize );
+	for ( unsigned int i = 0; i < sampleCount; i++ ) {
+		const float phi = 2.0f * ENV_PI * ( float )i / ( float )sampleCount;
+		const float xi = RadicalInverse( i );
+		const float cosTheta = sqrtf( ( 1.0f - xi ) / ( 1.0f + ( alphaSqr - 1.0f ) * xi ) );
+		const float sinTheta = sqrtf( 1.0f - cosTheta * cosTheta );
+
+		//reflect V = N about H
+		ggxSample_t sample;
+		sample.x = 2.0f * cosTheta * cosf( phi ) * sinTheta;
+		sample.y = 2.0f * cosTheta * sinf( phi ) * sinTheta;
+		sample.z = 2.0f * cosTheta * cosTheta - 1.0f;
+		if ( sample.z <= 0.0f ) {
+			continue;
+		}
+
+		//pdf of L is D * NdotH / ( 4 * VdotH ) and NdotH == VdotH here
+		const float denom = cosTheta * cosTheta * ( alphaSqr - 1.0f ) + 1.0f;
+		const float pdf = alphaSqr / ( ENV_PI * denom * denom ) * 0.25f;
+		const float sampleSolidAngle = 1.0f / ( ( float )sampleCount * pdf );
+		sample.lod = 0.5f * log2f( sampleSolidAngle / texelSolidAngle );
+		if ( sample.lod < 0.0f ) {
+			sample.lod = 0.0f;
+		}
+		samples.push_back( sample );
+	}
+}
+
+/*
+================================
+EnvMapBaker::PrefilterGGX
+	-prefilters the specular levels of an env probe offline. Level i of levels is prefiltered
+	 with roughness i / ( levelCount - 1 ) and has faces of faceSize >> i.
+	-samples read the box filtered mip of the source that matches their solid angle, which
+	 keeps bright texels from showing up as noise at high roughness.
+	-each row of a face is a job, so the result doesnt depend on the thread count.
+================================
+*/
+void EnvMapBaker::PrefilterGGX( const envImage_t & cubemap, const int faceSize, const unsigned int levelCount, const unsigned int sampleCount, std::vector< envImage_t > & levels, const bool multithreaded ) {
+	std::vector< envImage_t > sourceMips;
+	BuildCubeMips( cubemap, sourceMips );
+	const float maxLod = ( float )( sourceMips.size() - 1 );
+
+	levels.resize( levelCount );
+	for ( unsigned int level = 0; level < levelCount; level++ ) {
+		const int levelSize = ( faceSize >> level > 0 ) ? faceSize >> level : 1;
+		const float roughness = ( levelCount > 1 ) ? ( float )level / ( float )( levelCount - 1 ) : 0.0f;
+		std::vector< ggxSample_t > samples;
+		BuildGGXSamples( roughness, sampleCount, ( float )cubemap.height, samples );
+
+		envImage_t & output = levels[ level ];
+		output.width = levelSize * 6;
+		output.height = levelSize;
+		output.pixels.resize( ( size_t )output.width * output.height * 3 );
+
+		auto filterRow = [&]( unsigned int job ) {
+			const int face = ( int )job / levelSize;
+			const int row = ( int )job % levelSize;
+			float * outputRow = &output.pixels[ ( ( size_t )row * output.width + ( size_t )face * levelSize ) * 3 ];
+			for ( int s = 0; s < levelSize; s++ ) {
+				const Vec3 normal = CubeTexelDirection( face, ( float )s + 0.5f, ( float )row + 0.5f, levelSize );
+
+				//same tangent frame as the prefilter_envMap shader
+				const Vec3 up = ( fabsf( normal.z ) < 0.999f ) ? Vec3( 0.0f, 0.0f, 1.0f ) : Vec3( 1.0f, 0.0f, 0.0f );
+				Vec3 tangent = up.cross( normal );
+				tangent.normalize();
+				const Vec3 bitangent = normal.cross( tangent );
+
+				float sum[3] = { 0.0f, 0.0f, 0.0f };
+				float totalWeight = 0.0f;
+				for ( size_t i = 0; i < samples.size(); i++ ) {
+					const ggxSample_t & sample = samples[i];
+					const float lx = tangent.x * sample.x + bitangent.x * sample.y + normal.x * sample.z;
+					const float ly = tangent.y * sample.x + bitangent.y * sample.y + normal.y * sample.z;
+					const float lz = tangent.z * sample.x + bitangent.z * sample.y + normal.z * sample.z;
+					float u;
+					float v;
+					const int sampleFace = DirectionToCubeUV( lx, ly, lz, u, v );
+
+					//trilinear between the two closest source levels
+					const float lod = ( sample.lod < maxLod ) ? sample.lod : maxLod;
+					const int lod0 = ( int )lod;
+					const int lod1 = ( lod0 + 1 < ( int )sourceMips.size() ) ? lod0 + 1 : lod0;
+					const float blend = lod - ( float )lod0;
+					float rgb0[3];
+					float rgb1[3];
+					SampleCubeLevel( sourceMips[ lod0 ], sampleFace, u, v, rgb0 );
+					SampleCubeLevel( sourceMips[ lod1 ], sampleFace, u, v, rgb1 );
+					for ( int c = 0; c < 3; c++ ) {
+						sum[c] += ( rgb0[c] + ( rgb1[c] - rgb0[c] ) * blend ) * sample.z;
+					}
+					totalWeight += sample.z;
+				}
+				for ( int c = 0; c < 3; c++ ) {
+					outputRow[ s * 3 + c ] = sum[c] / totalWeight;
+				}
+			}
+		};
+
+		const unsigned int jobCount = ( unsigned int )levelSize * 6;
+		if ( multithreaded ) {
+			ThreadPool::getInstance()->ParallelFor( jobCount, filterRow );
+		} else {
+			for ( unsigned int job = 0; job < jobCount; job++ ) {
+				filterRow( job );
+			}
+		}
+	}
+}
+
+/*
+================================
+EnvMapBaker::GGXLobeCosine
+	-NdotL weighted mean of NdotL over the GGX lobe of roughness, with V = N. Prefiltering an
+	 environment that is linear in the direction, a + b.L, gives a + b.N * GGXLobeCosine.
+	-integrated over the half vector angle with Simpson's rule in doubles, so it is independent
+	 of the sampling PrefilterGGX does.
+================================
+*/
+float EnvMapBaker::GGXLobeCosine( const float roughness ) {
+	if ( roughness <= 0.0f ) {
+		return 1.0f;
+	}
+	const double alphaSqr = ( double )roughness * roughness * roughness * roughness;
+	const int steps = 8192; //even
+	const double maxTheta = 3.14159265358979323846 * 0.25; //L drops below the horizon past 45 degrees
+	const double stepSize = maxTheta / ( double )steps;
+	double weighted = 0.0;
+	double total = 0.0;
+	for ( int i = 0; i <= steps; i++ ) {
+		const double theta = stepSize * ( double )i;
+		const double cosTheta = cos( theta );
+		const double denom = cosTheta * cosTheta * ( alphaSqr - 1.0 ) + 1.0;
+		const double pdf = alphaSqr / ( denom * denom ) * cosTheta * sin( theta ); //D * NdotH * sin over the half vector angle
+		const double NdotL = 2.0 * cosTheta * cosTheta - 1.0;
+		const double simpson = ( i == 0 || i == steps ) ? 1.0 : ( ( i % 2 == 1 ) ? 4.0 : 2.0 );
+		weighted += simpson * pdf * NdotL * NdotL;
+		total += simpson * pdf * NdotL;
+	}
+	return ( float )( weighted / total );
+}
\ No newline at end of file
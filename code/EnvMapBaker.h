@@ -0,0 +1,65 @@
+#pragma once
+#ifndef __ENVMAPBAKER_H_INCLUDE__
+#define __ENVMAPBAKER_H_INCLUDE__
+
+#include <vector>
+#include "Vector.h"
+
+#define ENV_PROBE_SIZE		128
+#define ENV_PROBE_LEVELS	5 //roughness levels of a prefiltered probe, the shaders sample up to lod 4
+#define ENV_PROBE_SAMPLES	1024
+
+/*
+==============================
+envImage_t
+	-rgb float image, rows from top to bottom. Cubemaps are stored as the six faces side by side
+	 in the order front, back, up, down, right, left.
+==============================
+*/
+struct envImage_t {
+	envImage_t() { width = 0; height = 0; }
+	int width;
+	int height;
+	std::vector< float > pixels;
+};
+
+/*
+==============================
+irradianceSH_t
+	-L2 spherical harmonics of the irradiance around a probe, already divided by pi so evaluating
+	 them gives the same values as the convolved irradiance cubemap. Coefficients are in the order
+	 Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22.
+==============================
+*/
+struct irradianceSH_t {
+	float coeffs[9][3];
+};
+
+/*
+==============================
+EnvMapBaker
+	-cpu conversions of environment maps. They run on the thread pool, and without a window from
+	 the command line, see BakeEnvOffline in winmain.cpp.
+==============================
+*/
+class EnvMapBaker {
+	public:
+		static bool LoadEnvImage( const char * fullPath, envImage_t & image );
+		static bool SaveEnvImage( const char * fullPath, const envImage_t & image );
+
+		static Vec3 CrossTexelDirection( const int face, const float s, const float t, const int faceSize );
+		static void EquirectToCubemap( const envImage_t & equirect, const int faceSize, const int supersample, envImage_t & cubemap, const bool vectorized, const bool multithreaded );
+
+		//cubemaps with the faces in gl order, as rendered for env probes
+		static Vec3 CubeTexelDirection( const int face, const float s, const float t, const int faceSize );
+		static void ProjectIrradianceSH( const envImage_t & cubemap, irradianceSH_t & sh, const bool multithreaded );
+		static Vec3 EvaluateIrradianceSH( const irradianceSH_t & sh, const Vec3 & normal );
+		static bool LoadIrradianceSH( const char * fullPath, irradianceSH_t & sh );
+		static bool SaveIrradianceSH( const char * fullPath, const irradianceSH_t & sh );
+
+		//prefiltered specular levels of an env probe, from roughness 0 at level 0 to 1 at the last level
+		static void PrefilterGGX( const envImage_t & cubemap, const int faceSize, const unsigned int levelCount, const unsigned int sampleCount, std::vector< envImage_t > & levels, const bool multithreaded );
+		static float GGXLobeCosine( const float roughness );
+};
+
+#endif
\ No newline at end of file
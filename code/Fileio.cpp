@@ -206,4 +206,86 @@ void makeDir( const char * dirName ) {
 
 	delete[] buff;
 	buff = nullptr;
+}
+
+/*
+=================================
+MapFile
+	-maps a file into memory read only. Pages are read from disk when they are first touched.
+	-the file and mapping handles are closed right away, the view keeps the file open until UnmapFile.
+=================================
+*/
+bool MapFile( const char * relativePath, mappedFile_t & file ) {
+	file.data = NULL;
+	file.size = 0;
+
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+	HANDLE fileHandle = CreateFileA( fullPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( fileHandle == INVALID_HANDLE_VALUE ) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if ( GetFileSizeEx( fileHandle, &fileSize ) == 0 || fileSize.QuadPart == 0 ) {
+		CloseHandle( fileHandle ); //empty files cant be mapped
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA( fileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( fileHandle );
+	if ( mappingHandle == NULL ) {
+		return false;
+	}
+
+	void * view = MapViewOfFile( mappingHandle, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mappingHandle );
+	if ( view == NULL ) {
+		return false;
+	}
+
+	file.data = ( const unsigned char * )view;
+	file.size = ( size_t )fileSize.QuadPart;
+	return true;
+}
+
+/*
+=================================
+PrefaultFile
+	-reads every page of a mapped file from disk now, so later reads of it dont block on i/o.
+	 PrefetchVirtualMemory starts one large read, touching a byte of each page waits for it.
+=================================
+*/
+void PrefaultFile( const mappedFile_t & file ) {
+	if ( file.data == NULL ) {
+		return;
+	}
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = ( void * )file.data;
+	range.NumberOfBytes = file.size;
+	PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	const size_t pageSize = info.dwPageSize;
+	unsigned char sum = 0;
+	for ( size_t offset = 0; offset < file.size; offset += pageSize ) {
+		sum += file.data[ offset ];
+	}
+	volatile unsigned char touched = sum; //keeps the reads from being optimized away
+	( void )touched;
+}
+
+/*
+=================================
+UnmapFile
+=================================
+*/
+void UnmapFile( mappedFile_t & file ) {
+	if ( file.data != NULL ) {
+		UnmapViewOfFile( file.data );
+	}
+	file.data = NULL;
+	file.size = 0;
 }
\ No newline at end of file
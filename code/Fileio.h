@@ -1,9 +1,18 @@
 #pragma once
 #include <string>
 
+//read only view of a whole file. The file handle is already released once MapFile returns.
+struct mappedFile_t {
+	const unsigned char * data;
+	size_t size;
+};
+
 void findAndReplaceAll( std::string & data, std::string toSearch, std::string replaceStr );
 bool GetFileData( const char * fileName, unsigned char ** data, unsigned int & size );
 bool RelativePathToFullPath( const char * relativePath, char fullPath[ 2048 ] );
 std::string GetExtension( std::string path );
 bool dirExists( const char * dirName_in );
-void makeDir( const char * dirName );
\ No newline at end of file
+void makeDir( const char * dirName );
+bool MapFile( const char * relativePath, mappedFile_t & file );
+void UnmapFile( mappedFile_t & file );
+void PrefaultFile( const mappedFile_t & file );
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "GLRecorder.h"
+#include "Console.h"
+
+#include <string>
+
+unsigned int GLRecorder::s_current[GLCALL_COUNT] = { 0 };
+unsigned int GLRecorder::s_lastFrame[GLCALL_COUNT] = { 0 };
+
+/*
+================================
+GLRecorder::CallName
+================================
+*/
+const char * GLRecorder::CallName( const glCall_t type ) {
+	switch ( type ) {
+		case GLCALL_DRAW:
+			return "draw calls";
+		case GLCALL_UNIFORM:
+			return "uniform sets";
+		case GLCALL_UNIFORM_LOOKUP:
+			return "uniform and block lookups";
+		case GLCALL_ERROR_CHECK:
+			return "error checks";
+		case GLCALL_UNIFORM_BLOCK:
+			return "uniform block updates and binds";
+		case GLCALL_PROGRAM:
+			return "program binds";
+		case GLCALL_TEXTURE:
+			return "texture binds";
+		case GLCALL_VERTEX_ARRAY:
+			return "vertex array binds";
+		default:
+			return "unknown";
+	}
+}
+
+/*
+================================
+GLRecorder::NewFrame
+	-stores the counts of the frame that just finished and resets the running counts
+================================
+*/
+void GLRecorder::NewFrame() {
+	for ( unsigned int i = 0; i < GLCALL_COUNT; i++ ) {
+		s_lastFrame[i] = s_current[i];
+		s_current[i] = 0;
+	}
+}
+
+/*
+================================
+GLRecorder::Report
+	-prints the counts of the last finished frame to the console
+================================
+*/
+void GLRecorder::Report() {
+	Console * console = Console::getInstance(); //retrieve console singleton
+	for ( unsigned int i = 0; i < GLCALL_COUNT; i++ ) {
+		std::string line = std::string( CallName( ( glCall_t )i ) ) + ": " + std::to_string( s_lastFrame[i] );
+		console->AddInfo( line.c_str() );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#ifndef __GLRECORDER_H_INCLUDE__
+#define __GLRECORDER_H_INCLUDE__
+
+enum glCall_t {
+	GLCALL_DRAW = 0,
+	GLCALL_UNIFORM,
+	GLCALL_UNIFORM_LOOKUP,
+	GLCALL_ERROR_CHECK,
+	GLCALL_UNIFORM_BLOCK,
+	GLCALL_PROGRAM,
+	GLCALL_TEXTURE,
+	GLCALL_VERTEX_ARRAY,
+	GLCALL_COUNT
+};
+
+/*
+==============================
+GLRecorder
+	-counts GL calls by category so that render paths can be compared.
+	-call sites record themselves. NewFrame() is called once at the end of every frame.
+==============================
+*/
+class GLRecorder {
+	public:
+		static void Record( const glCall_t type, const unsigned int count = 1 ) { s_current[type] += count; }
+		static const unsigned int LastFrame( const glCall_t type ) { return s_lastFrame[type]; }
+		static const char * CallName( const glCall_t type );
+
+		static void NewFrame();
+		static void Report();
+
+	private:
+		static unsigned int s_current[GLCALL_COUNT];
+		static unsigned int s_lastFrame[GLCALL_COUNT];
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "IndirectDraw.h"
+#include "DrawList.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+bool IndirectDraw::s_enabled = true;
+
+/*
+================================
+IndirectDraw::LayoutGeometry
+	-surfaces are packed one after another
+================================
+*/
+void IndirectDraw::LayoutGeometry( const std::vector< unsigned int > & vertexCounts, const std::vector< unsigned int > & indexCounts, std::vector< geometryRange_t > & ranges, unsigned int * totalVertices, unsigned int * totalIndices ) {
+	assert( vertexCounts.size() == indexCounts.size() );
+	ranges.resize( vertexCounts.size() );
+
+	unsigned int vertexCount = 0;
+	unsigned int indexCount = 0;
+	for ( size_t i = 0; i < vertexCounts.size(); i++ ) {
+		ranges[i].firstIndex = indexCount;
+		ranges[i].indexCount = indexCounts[i];
+		ranges[i].baseVertex = ( int )vertexCount;
+		vertexCount += vertexCounts[i];
+		indexCount += indexCounts[i];
+	}
+	*totalVertices = vertexCount;
+	*totalIndices = indexCount;
+}
+
+/*
+================================
+IndirectDraw::LayoutInstances
+	-meshes are packed one after another, flippedCounts of each are its last instances
+================================
+*/
+void IndirectDraw::LayoutInstances( const std::vector< unsigned int > & instanceCounts, const std::vector< unsigned int > & flippedCounts, std::vector< instanceRange_t > & ranges, unsigned int * totalInstances ) {
+	assert( instanceCounts.size() == flippedCounts.size() );
+	ranges.resize( instanceCounts.size() );
+
+	unsigned int instanceCount = 0;
+	for ( size_t i = 0; i < instanceCounts.size(); i++ ) {
+		assert( flippedCounts[i] <= instanceCounts[i] );
+		ranges[i].firstInstance = instanceCount;
+		ranges[i].instanceCount = instanceCounts[i];
+		ranges[i].firstFlipped = instanceCounts[i] - flippedCounts[i];
+		instanceCount += instanceCounts[i];
+	}
+	*totalInstances = instanceCount;
+}
+
+/*
+================================
+IndirectDraw::MakeCommand
+	-draws the unflipped or the flipped instances of a surface
+================================
+*/
+drawElementsCommand_t IndirectDraw::MakeCommand( const geometryRange_t & geometry, const instanceRange_t & instances, const bool flipped ) {
+	drawElementsCommand_t command;
+	command.count = geometry.indexCount;
+	command.instanceCount = flipped ? instances.instanceCount - instances.firstFlipped : instances.firstFlipped;
+	command.firstIndex = geometry.firstIndex;
+	command.baseVertex = geometry.baseVertex;
+	command.baseInstance = instances.firstInstance + ( flipped ? instances.firstFlipped : 0 );
+	return command;
+}
+
+/*
+================================
+IndirectDraw::BuildPassCommands
+	-every surface of the scene, for passes that draw all of it with one program. The unflipped
+	 instances are the first batch and the flipped ones the second.
+================================
+*/
+void IndirectDraw::BuildPassCommands( const indirectScene_t & scene, std::vector< drawElementsCommand_t > & commands, std::vector< indirectBatch_t > & batches ) {
+	commands.clear();
+	batches.clear();
+
+	for ( unsigned int f = 0; f < 2; f++ ) {
+		const bool flipped = ( f == 1 );
+		indirectBatch_t batch;
+		batch.firstCommand = ( unsigned int )commands.size();
+		batch.commandCount = 0;
+		batch.flipped = flipped;
+		batch.key = 0;
+
+		for ( size_t mesh = 0; mesh < scene.meshInstances.size(); mesh++ ) {
+			const unsigned int firstSurface = scene.meshFirstSurface[ mesh ];
+			const unsigned int endSurface = ( mesh + 1 < scene.meshFirstSurface.size() ) ? scene.meshFirstSurface[ mesh + 1 ] : ( unsigned int )scene.surfaces.size();
+			for ( unsigned int surface = firstSurface; surface < endSurface; surface++ ) {
+				const drawElementsCommand_t command = MakeCommand( scene.surfaces[ surface ], scene.meshInstances[ mesh ], flipped );
+				if ( command.instanceCount > 0 ) {
+					commands.push_back( command );
+					batch.commandCount++;
+				}
+			}
+		}
+
+		if ( batch.commandCount > 0 ) {
+			batches.push_back( batch );
+		}
+	}
+}
+
+/*
+================================
+InMaterialTable
+================================
+*/
+static bool InMaterialTable( const std::vector< uint8_t > & tableMaterials, const unsigned int material ) {
+	return material < tableMaterials.size() && tableMaterials[ material ] != 0;
+}
+
+/*
+================================
+IndirectDraw::BuildKeyCommands
+	-commands for sorted draw keys. A run of keys with the same program and material becomes up
+	 to two batches, its unflipped draws then its flipped ones. Flipped is the lowest bit of a
+	 key, so without splitting the run this way every surface with flipped instances would
+	 end a batch.
+	-tableMaterials is non zero for the material ids whose program reads them from the material
+	 table. A run continues over those, so it is one run per program. materialIds is the
+	 material of each command.
+================================
+*/
+void IndirectDraw::BuildKeyCommands( const indirectScene_t & scene, const std::vector< uint64_t > & keys, const std::vector< uint8_t > & tableMaterials, std::vector< drawElementsCommand_t > & commands, std::vector< unsigned int > & materialIds, std::vector< indirectBatch_t > & batches ) {
+	commands.clear();
+	materialIds.clear();
+	batches.clear();
+
+	size_t runStart = 0;
+	while ( runStart < keys.size() ) {
+		const unsigned int program = DrawList::KeyProgram( keys[ runStart ] );
+		const unsigned int material = DrawList::KeyMaterial( keys[ runStart ] );
+		const bool shared = InMaterialTable( tableMaterials, material );
+		size_t runEnd = runStart + 1;
+		while ( runEnd < keys.size() && DrawList::KeyProgram( keys[ runEnd ] ) == program ) {
+			const unsigned int nextMaterial = DrawList::KeyMaterial( keys[ runEnd ] );
+			if ( nextMaterial != material && !( shared && InMaterialTable( tableMaterials, nextMaterial ) ) ) {
+				break;
+			}
+			runEnd++;
+		}
+
+		for ( unsigned int f = 0; f < 2; f++ ) {
+			const bool flipped = ( f == 1 );
+			indirectBatch_t batch;
+			batch.firstCommand = ( unsigned int )commands.size();
+			batch.commandCount = 0;
+			batch.flipped = flipped;
+			batch.key = 0;
+
+			for ( size_t k = runStart; k < runEnd; k++ ) {
+				const uint64_t key = keys[k];
+				if ( DrawList::KeyFlipped( key ) != flipped ) {
+					continue;
+				}
+				const unsigned int mesh = DrawList::KeyMesh( key );
+				assert( mesh < scene.meshInstances.size() );
+				const unsigned int surface = scene.meshFirstSurface[ mesh ] + DrawList::KeySurface( key );
+				const drawElementsCommand_t command = MakeCommand( scene.surfaces[ surface ], scene.meshInstances[ mesh ], flipped );
+				if ( command.instanceCount == 0 ) {
+					continue;
+				}
+				if ( batch.commandCount == 0 ) {
+					batch.key = key;
+				}
+				commands.push_back( command );
+				materialIds.push_back( DrawList::KeyMaterial( key ) );
+				batch.commandCount++;
+			}
+
+			if ( batch.commandCount > 0 ) {
+				batches.push_back( batch );
+			}
+		}
+		runStart = runEnd;
+	}
+}
\ No newline at end of file
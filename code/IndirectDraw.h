@@ -0,0 +1,70 @@
+#pragma once
+#ifndef __INDIRECTDRAW_H_INCLUDE__
+#define __INDIRECTDRAW_H_INCLUDE__
+
+#include <vector>
+#include <stdint.h>
+
+//matches the command glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER: 20 bytes
+struct drawElementsCommand_t {
+	unsigned int count; //indices
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance; //offsets the instance attributes, gl_InstanceID still starts at 0
+};
+
+//where a surface is in the merged vertex and index buffers
+struct geometryRange_t {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	int baseVertex; //the indices of a surface start at 0
+};
+
+//where the instances of a mesh are in the merged instance buffers, flipped instances are last
+struct instanceRange_t {
+	unsigned int firstInstance;
+	unsigned int instanceCount; //including the flipped ones
+	unsigned int firstFlipped; //relative to firstInstance
+};
+
+//commands submitted with one glMultiDrawElementsIndirect, they all share a program and front face. Only
+//materials in the material table are mixed, the others are a batch of their own.
+struct indirectBatch_t {
+	unsigned int firstCommand;
+	unsigned int commandCount;
+	bool flipped;
+	uint64_t key; //draw key of the first command, for the program and material of the batch, or the program and first material when it mixes them
+};
+
+//the merged geometry of a scene
+struct indirectScene_t {
+	std::vector< geometryRange_t > surfaces; //of every mesh, in mesh order
+	std::vector< unsigned int > meshFirstSurface; //index of each mesh's first surface in surfaces
+	std::vector< instanceRange_t > meshInstances;
+};
+
+/*
+==============================
+IndirectDraw
+	-scene geometry is merged into one vertex, index and instance buffer. A surface is then just
+	 a range of those, and a draw of it is a command instead of a VAO bind and a draw call.
+	-passes without materials are two batches, unflipped and flipped instances. The main pass is
+	 one batch per program, material and front face of the sorted draw list. Materials that are
+	 read from the material table dont end a batch when the caller allows it, the shader looks
+	 up the material of each command by gl_DrawIDARB instead.
+==============================
+*/
+class IndirectDraw {
+	public:
+		static void LayoutGeometry( const std::vector< unsigned int > & vertexCounts, const std::vector< unsigned int > & indexCounts, std::vector< geometryRange_t > & ranges, unsigned int * totalVertices, unsigned int * totalIndices );
+		static void LayoutInstances( const std::vector< unsigned int > & instanceCounts, const std::vector< unsigned int > & flippedCounts, std::vector< instanceRange_t > & ranges, unsigned int * totalInstances );
+		static drawElementsCommand_t MakeCommand( const geometryRange_t & geometry, const instanceRange_t & instances, const bool flipped );
+
+		static void BuildPassCommands( const indirectScene_t & scene, std::vector< drawElementsCommand_t > & commands, std::vector< indirectBatch_t > & batches );
+		static void BuildKeyCommands( const indirectScene_t & scene, const std::vector< uint64_t > & keys, const std::vector< uint8_t > & tableMaterials, std::vector< drawElementsCommand_t > & commands, std::vector< unsigned int > & materialIds, std::vector< indirectBatch_t > & batches );
+
+		static bool s_enabled; //when false every command is its own draw call
+};
+
+#endif
\ No newline at end of file
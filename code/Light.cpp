@@ -1,13 +1,21 @@
 #include "Light.h"
+#include <float.h>
 
 unsigned int Light::s_lightCount = 0;
 unsigned int Light::s_shadowCastingLightCount = 0;
 Shader * Light::s_debugShader = new Shader();
 Shader * Light::s_depthShader = new Shader();
+Shader * Light::s_depthCubeShader = NULL;
 Framebuffer * Light::s_depthBufferAtlas = new Framebuffer( "depthMap" );
 unsigned int Light::s_partitionSize = s_depthBufferAtlasSize_min;
+bool Light::s_cubeShadowsSinglePass = true;
+bool Light::s_cubeShadowsSinglePassSupported = false;
 
 float Light::s_lightAttenuationBias = 0.005f;
+bool Light::s_tightVolumes = true;
+unsigned int Light::s_pointVolumeSubdivisions = 0;
+unsigned int Light::s_spotVolumeSegments = 12;
+float Light::s_cutoffLuminance = 0.01f;
 
 Mesh * Light::s_debugModel = new Mesh();
 Mesh * DirectionalLight::s_debugModel_directional = new Mesh();
@@ -15,6 +23,10 @@ Mesh * SpotLight::s_debugModel_spot = new Mesh();
 Mesh * PointLight::s_debugModel_point = new Mesh();
 
 Texture EnvProbe::s_brdfIntegrationMap = Texture();
+CubemapArrayTexture EnvProbe::s_irradianceMaps = CubemapArrayTexture();
+CubemapArrayTexture EnvProbe::s_environmentMaps = CubemapArrayTexture();
+std::vector< ProbeStorage > EnvProbe::s_probeStorage;
+bool EnvProbe::s_useIrradianceSH = true;
 
 /*
 ================================
@@ -84,7 +96,7 @@ void Light::Initialize() {
 	//initialize members
 	m_shadowCaster = false;
 	m_cachedShadows = true;
-	m_firstFrameRendered = false;
+	m_shadowDirty = true;
 	m_near_plane = 0.1f;
 	m_far_plane = 10.0f;
 	m_xfrm = Mat4();
@@ -99,6 +111,7 @@ void Light::Initialize() {
 	m_uniformBlock.shadowIdx = -1;
 	m_boundsUniformBlock = LightEffectStorage();
 	lightEffectStorage_cached = false;
+	m_debugModel_VAO = 0;
 }
 
 /*
@@ -143,6 +156,21 @@ void Light::InitShadowAtlas() {
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
 		glBindTexture( GL_TEXTURE_2D, 0 );
 	}
+
+	//point lights can render all 6 faces in one pass if the geometry shader can select a viewport
+	GLint maxViewports = 0;
+	if ( GLEW_VERSION_4_1 || GLEW_ARB_viewport_array ) {
+		glGetIntegerv( GL_MAX_VIEWPORTS, &maxViewports );
+	}
+	s_cubeShadowsSinglePassSupported = maxViewports >= 6;
+	if ( s_cubeShadowsSinglePassSupported && s_depthCubeShader == NULL ) {
+		s_depthCubeShader = s_depthCubeShader->GetShader( "depth_cube" );
+		if ( s_depthCubeShader != NULL ) {
+			s_depthCubeShader->PinShader(); //must survive scene reloads just like the atlas shader
+		} else {
+			s_cubeShadowsSinglePassSupported = false;
+		}
+	}
 }
 
 /*
@@ -239,35 +267,109 @@ void Light::UpdateDepthBuffer( Scene * scene ) {
 	assert(  s_depthBufferAtlas->GetID() != 0 );
 
 	s_depthBufferAtlas->Bind();
-	if ( m_uniformBlock.shadowIdx == 0 ) {
-		glClear( GL_DEPTH_BUFFER_BIT ); //Clear previous frame values
-	}
 
 	s_depthShader->UseProgram();
 	s_depthShader->SetUniformMatrix4f( "lightSpaceMatrix", 1, false, LightMatrix() );
 
 	//set rendering for this light's portion of the depthBufferAtlas
+	BindShadowPartition( m_uniformBlock.shadowIdx );
 	const float mapsPerRow = ceil( sqrt( ( float )s_shadowCastingLightCount ) );
 	float currentRow = floor( ( float )m_uniformBlock.shadowIdx / mapsPerRow );
 	unsigned int stepsUp = ( unsigned int )currentRow;
 	unsigned int stepsRight = m_uniformBlock.shadowIdx - ( unsigned int )( mapsPerRow * currentRow );
-	glViewport( stepsRight * s_partitionSize, stepsUp * s_partitionSize, s_partitionSize, s_partitionSize );
 
 	//store the position of this shadowMap in the shadowMapAtlas
 	float x = ( float )stepsRight / ( float )mapsPerRow;
 	float y = ( float )stepsUp / ( float )mapsPerRow;
 	m_PosInShadowAtlas = Vec2( x, y );
 
-	//iterate through each surface of each mesh in the scene and render it with m_depthShader active
-	for ( int i = 0; i < scene->MeshCount(); i++ ) {			
-		Mesh * mesh = NULL;
-		scene->MeshByIndex( i, &mesh );
-		for ( unsigned int j = 0; j < mesh->m_surfaces.size(); j++ ) {
-			mesh->DrawSurface( j );
+	//render every surface of every mesh in the scene with m_depthShader active
+	scene->DrawAll();
+
+	s_depthBufferAtlas->Unbind();
+	m_shadowDirty = false;
+}
+
+/*
+================================
+Light::BindShadowPartition
+	-sets the viewport to a partition of the depthBufferAtlas and clears only that partition.
+	 Other partitions may hold cached depth that is still valid.
+	-viewportIdx > 0 sets an indexed viewport that a geometry shader selects with gl_ViewportIndex
+================================
+*/
+void Light::BindShadowPartition( const unsigned int shadowIdx, const unsigned int viewportIdx ) const {
+	const float mapsPerRow = ceil( sqrt( ( float )s_shadowCastingLightCount ) );
+	float currentRow = floor( ( float )shadowIdx / mapsPerRow );
+	unsigned int stepsUp = ( unsigned int )currentRow;
+	unsigned int stepsRight = shadowIdx - ( ( unsigned int )mapsPerRow * stepsUp );
+	if ( viewportIdx == 0 ) {
+		glViewport( stepsRight * s_partitionSize, stepsUp * s_partitionSize, s_partitionSize, s_partitionSize ); //also resets all indexed viewports
+	} else {
+		glViewportIndexedf( viewportIdx, ( float )( stepsRight * s_partitionSize ), ( float )( stepsUp * s_partitionSize ), ( float )s_partitionSize, ( float )s_partitionSize );
+	}
+
+	glEnable( GL_SCISSOR_TEST );
+	glScissor( stepsRight * s_partitionSize, stepsUp * s_partitionSize, s_partitionSize, s_partitionSize );
+	glClear( GL_DEPTH_BUFFER_BIT ); //Clear previous values of this partition only
+	glDisable( GL_SCISSOR_TEST );
+}
+
+/*
+================================
+Light::InfluenceBounds
+	-world space aabb of the volume this light can affect
+================================
+*/
+bbox Light::InfluenceBounds() const {
+	bbox bounds;
+	if ( !lightEffectStorage_cached ) {
+		//effect volume isnt built yet. Its half extent is maxRadius * d and rotation can grow the aabb by another d.
+		const float d = Vec3( 1.0f, 1.0f, 1.0f ).length();
+		const float maxDist = GetMaxRadius() * d * d;
+		bounds.min = m_uniformBlock.position - maxDist;
+		bounds.max = m_uniformBlock.position + maxDist;
+		return bounds;
+	}
+
+	bounds.min = m_boundsUniformBlock.vPos[0];
+	bounds.max = m_boundsUniformBlock.vPos[0];
+	for ( unsigned int i = 1; i < m_boundsUniformBlock.vCount; i++ ) {
+		const Vec3 v = m_boundsUniformBlock.vPos[i];
+		for ( unsigned int j = 0; j < 3; j++ ) {
+			if ( v[j] < bounds.min[j] ) {
+				bounds.min[j] = v[j];
+			}
+			if ( v[j] > bounds.max[j] ) {
+				bounds.max[j] = v[j];
+			}
 		}
 	}
+	return bounds;
+}
 
-	s_depthBufferAtlas->Unbind();
+/*
+================================
+Light::NeedsShadowUpdate
+	-non cached lights render every frame
+	-cached lights render when the light changed or when a moved instance overlaps the light's volume
+================================
+*/
+bool Light::NeedsShadowUpdate( const std::vector< bbox >& movedBounds ) const {
+	if ( !m_shadowCaster ) {
+		return false;
+	}
+	if ( !m_cachedShadows || m_shadowDirty ) {
+		return true;
+	}
+
+	const bbox influence = InfluenceBounds();
+	for ( unsigned int i = 0; i < movedBounds.size(); i++ ) {
+		if ( influence.Intersects( movedBounds[i] ) ) {
+			return true;
+		}
+	}
+	return false;
 }
 
 /*
@@ -278,6 +380,7 @@ Light::SetRadius
 */
 void Light::SetRadius( float radius ) {
 	m_uniformBlock.light_radius = radius;
+	m_shadowDirty = true;
 	const float att = MaxAttenuationDist();
 	m_far_plane = att;
 	if ( m_uniformBlock.max_radius >= att ) {
@@ -292,6 +395,7 @@ Light::SetRadius
 ================================
 */
 void Light::SetMaxRadius( float radius ) {
+	m_shadowDirty = true;
 	const float att = MaxAttenuationDist();
 	if ( radius <= att ) {
 		m_uniformBlock.max_radius = radius;
@@ -313,6 +417,65 @@ float Light::MaxAttenuationDist() const {
 	return maxDist;
 }
 
+/*
+================================
+Light::LuminanceAtDistance
+	-luminance of the light's radiance at a distance from its center. Matches LightAttenuation in the
+	 cook-torrance shader, where brightness is applied to both the attenuation and the radiance.
+	-spot cone falloff and NdotL are left out so the result is an upper bound.
+================================
+*/
+float Light::LuminanceAtDistance( const float dist ) const {
+	const Vec3 color = m_uniformBlock.color;
+	const float luminance = 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+	const float lightRadius = GetRadius();
+	const float brightness = m_uniformBlock.brightness;
+
+	const float distToSurface = dist > lightRadius ? dist - lightRadius : 0.0f;
+	const float denom = distToSurface / lightRadius + 1.0f;
+	float attenuation = brightness / ( denom * denom );
+
+	float window = 1.0f - dist / GetMaxRadius();
+	if ( window < 0.0f ) {
+		window = 0.0f;
+	} else if ( window > 1.0f ) {
+		window = 1.0f;
+	}
+	attenuation *= window;
+	return luminance * attenuation * brightness;
+}
+
+/*
+================================
+Light::EffectRadius
+	-distance at which the light's luminance drops below s_cutoffLuminance. Never larger than the max radius.
+	-the light volumes used for binning are built with this radius
+================================
+*/
+float Light::EffectRadius() const {
+	const float maxRadius = GetMaxRadius();
+	const float lightRadius = GetRadius();
+	if ( s_cutoffLuminance <= 0.0f || lightRadius <= 0.0f || maxRadius <= lightRadius ) {
+		return maxRadius;
+	}
+	if ( LuminanceAtDistance( lightRadius ) <= s_cutoffLuminance ) {
+		return lightRadius; //never bright enough to matter outside the bulb
+	}
+
+	//luminance only falls off past the light's surface so bisect between the surface and the max radius
+	float nearDist = lightRadius;
+	float farDist = maxRadius;
+	for ( unsigned int i = 0; i < 32; i++ ) {
+		const float mid = ( nearDist + farDist ) / 2.0f;
+		if ( LuminanceAtDistance( mid ) > s_cutoffLuminance ) {
+			nearDist = mid;
+		} else {
+			farDist = mid;
+		}
+	}
+	return farDist;
+}
+
 /*
 ================================
 Light::SetShadows
@@ -329,6 +492,7 @@ void Light::SetShadow( const bool shadowCasting ) {
 	}
 
 	m_shadowCaster = shadowCasting;
+	m_shadowDirty = true;
 }
 
 /*
@@ -360,8 +524,8 @@ void Light::PassUniforms( Shader * shader, int idx ) const {
 		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
 	}
 
-	//if shadowcasting copy shadow data
-	if ( m_uniformBlock.shadowIdx > -1 ) {
+	//if shadowcasting copy shadow data. Permutations without shadows have no shadow_buffer.
+	if ( m_uniformBlock.shadowIdx > -1 && shader->HasStorageBlock( "shadow_buffer" ) ) {
 		ShadowStorage shadowUniformBlock;
 		shadowUniformBlock.xfrm = m_xfrm;
 		shadowUniformBlock.loc = m_PosInShadowAtlas.as_Vec4();
@@ -415,68 +579,242 @@ float distanceToPlane( Vec3 v, Vec3 N, Vec3 P ) {
 	return N.dot( v - P );
 }
 
-void Light::InitBoundsVolume() {
+/*
+================================
+Light::InitBoundsVolume
+	-unit cube. Triangles are wound counter clockwise when viewed from outside.
+================================
+*/
+void Light::InitBoundsVolume( LightEffectStorage & volume ) {
 	//create the boundMVPs
-	m_boundsUniformBlock.vCount = 8;
-	m_boundsUniformBlock.tCount = 12;	
+	volume.vCount = 8;
+	volume.tCount = 12;	
 	
-	m_boundsUniformBlock.vPos[0] = Vec3( -1.0f, -1.0f, -1.0f );
-	m_boundsUniformBlock.vPos[1] = Vec3( -1.0f, 1.0f, -1.0f );
-	m_boundsUniformBlock.vPos[2] = Vec3( 1.0f, 1.0f, -1.0f );
-	m_boundsUniformBlock.vPos[3] = Vec3( 1.0f, -1.0f, -1.0f );
-	m_boundsUniformBlock.vPos[4] = Vec3( -1.0f, -1.0f, 1.0f );
-	m_boundsUniformBlock.vPos[5] = Vec3( -1.0f, 1.0f, 1.0f );
-	m_boundsUniformBlock.vPos[6] = Vec3( 1.0f, 1.0f, 1.0f );
-	m_boundsUniformBlock.vPos[7] = Vec3( 1.0f, -1.0f, 1.0f );	
-
-	m_boundsUniformBlock.tris[0] = Tri{ 4, 7, 5 };
-	m_boundsUniformBlock.tris[1] = Tri{ 6, 5, 7 };
-	m_boundsUniformBlock.tris[2] = Tri{ 7, 4, 3 };
-	m_boundsUniformBlock.tris[3] = Tri{ 0, 3, 4 };
-	m_boundsUniformBlock.tris[4] = Tri{ 6, 7, 2 };
-	m_boundsUniformBlock.tris[5] = Tri{ 3, 2, 7 };
-	m_boundsUniformBlock.tris[6] = Tri{ 5, 6, 1 };
-	m_boundsUniformBlock.tris[7] = Tri{ 2, 1, 6 };
-	m_boundsUniformBlock.tris[8] = Tri{ 4, 5, 0 };
-	m_boundsUniformBlock.tris[9] = Tri{ 1, 0, 5 };
-	m_boundsUniformBlock.tris[10] = Tri{ 0, 1, 3 };
-	m_boundsUniformBlock.tris[11] = Tri{ 2, 3, 1 };
+	volume.vPos[0] = Vec3( -1.0f, -1.0f, -1.0f );
+	volume.vPos[1] = Vec3( -1.0f, 1.0f, -1.0f );
+	volume.vPos[2] = Vec3( 1.0f, 1.0f, -1.0f );
+	volume.vPos[3] = Vec3( 1.0f, -1.0f, -1.0f );
+	volume.vPos[4] = Vec3( -1.0f, -1.0f, 1.0f );
+	volume.vPos[5] = Vec3( -1.0f, 1.0f, 1.0f );
+	volume.vPos[6] = Vec3( 1.0f, 1.0f, 1.0f );
+	volume.vPos[7] = Vec3( 1.0f, -1.0f, 1.0f );	
+
+	volume.tris[0] = Tri{ 4, 7, 5 };
+	volume.tris[1] = Tri{ 6, 5, 7 };
+	volume.tris[2] = Tri{ 7, 4, 3 };
+	volume.tris[3] = Tri{ 0, 3, 4 };
+	volume.tris[4] = Tri{ 6, 7, 2 };
+	volume.tris[5] = Tri{ 3, 2, 7 };
+	volume.tris[6] = Tri{ 5, 6, 1 };
+	volume.tris[7] = Tri{ 2, 1, 6 };
+	volume.tris[8] = Tri{ 4, 5, 0 };
+	volume.tris[9] = Tri{ 1, 0, 5 };
+	volume.tris[10] = Tri{ 0, 1, 3 };
+	volume.tris[11] = Tri{ 2, 3, 1 };
 }
 
 /*
 ================================
-Light::InitLightEffectStorage
-	-calculate the max bounds of light effect
+IcosphereMidpoint
+	-returns the idx of the normalized midpoint of edge a b. Adds it to the volume if it doesnt exist yet.
 ================================
 */
-void Light::InitLightEffectStorage() {
-	//makes sure bounds are calculated only once.
-	if ( lightEffectStorage_cached ) {
-		return;
+static unsigned int IcosphereMidpoint( LightEffectStorage & volume, unsigned int a, unsigned int b ) {
+	const Vec3 mid = ( ( volume.vPos[a] + volume.vPos[b] ) / 2.0f ).normal();
+	for ( unsigned int i = 0; i < volume.vCount; i++ ) {
+		if ( ( volume.vPos[i] - mid ).length() < 0.0001f ) {
+			return i;
+		}
 	}
-	lightEffectStorage_cached = true;
+	assert( volume.vCount < LIGHT_VOLUME_MAX_VERTS );
+	volume.vPos[volume.vCount] = mid;
+	volume.vCount += 1;
+	return volume.vCount - 1;
+}
+
+/*
+================================
+InitIcosphereVolume
+	-icosahedron subdivided and scaled so that its faces circumscribe the unit sphere
+================================
+*/
+static void InitIcosphereVolume( LightEffectStorage & volume, const unsigned int subdivisions ) {
+	const float t = ( 1.0f + sqrtf( 5.0f ) ) / 2.0f;
+	const Vec3 icoVerts[12] = {
+		Vec3( -1.0f, t, 0.0f ), Vec3( 1.0f, t, 0.0f ), Vec3( -1.0f, -t, 0.0f ), Vec3( 1.0f, -t, 0.0f ),
+		Vec3( 0.0f, -1.0f, t ), Vec3( 0.0f, 1.0f, t ), Vec3( 0.0f, -1.0f, -t ), Vec3( 0.0f, 1.0f, -t ),
+		Vec3( t, 0.0f, -1.0f ), Vec3( t, 0.0f, 1.0f ), Vec3( -t, 0.0f, -1.0f ), Vec3( -t, 0.0f, 1.0f )
+	};
+	const Tri icoTris[20] = {
+		Tri{ 0, 11, 5 }, Tri{ 0, 5, 1 }, Tri{ 0, 1, 7 }, Tri{ 0, 7, 10 }, Tri{ 0, 10, 11 },
+		Tri{ 1, 5, 9 }, Tri{ 5, 11, 4 }, Tri{ 11, 10, 2 }, Tri{ 10, 7, 6 }, Tri{ 7, 1, 8 },
+		Tri{ 3, 9, 4 }, Tri{ 3, 4, 2 }, Tri{ 3, 2, 6 }, Tri{ 3, 6, 8 }, Tri{ 3, 8, 9 },
+		Tri{ 4, 9, 5 }, Tri{ 2, 4, 11 }, Tri{ 6, 2, 10 }, Tri{ 8, 6, 7 }, Tri{ 9, 8, 1 }
+	};
+
+	volume.vCount = 12;
+	volume.tCount = 20;
+	for ( unsigned int i = 0; i < 12; i++ ) {
+		volume.vPos[i] = icoVerts[i].normal();
+	}
+	for ( unsigned int i = 0; i < 20; i++ ) {
+		volume.tris[i] = icoTris[i];
+	}
+
+	//each subdivision splits every triangle in 4. Stop before exceeding the storage budget.
+	for ( unsigned int s = 0; s < subdivisions; s++ ) {
+		if ( volume.tCount * 4 > LIGHT_VOLUME_MAX_TRIS ) {
+			break;
+		}
+		Tri tris[LIGHT_VOLUME_MAX_TRIS];
+		unsigned int tCount = 0;
+		for ( unsigned int i = 0; i < volume.tCount; i++ ) {
+			const Tri tri = volume.tris[i];
+			const unsigned int a = IcosphereMidpoint( volume, tri.idx0, tri.idx1 );
+			const unsigned int b = IcosphereMidpoint( volume, tri.idx1, tri.idx2 );
+			const unsigned int c = IcosphereMidpoint( volume, tri.idx2, tri.idx0 );
+			tris[tCount++] = Tri{ tri.idx0, a, c };
+			tris[tCount++] = Tri{ tri.idx1, b, a };
+			tris[tCount++] = Tri{ tri.idx2, c, b };
+			tris[tCount++] = Tri{ a, b, c };
+		}
+		volume.tCount = tCount;
+		for ( unsigned int i = 0; i < tCount; i++ ) {
+			volume.tris[i] = tris[i];
+		}
+	}
+
+	//the verts lie on the unit sphere so the faces cut into it. Push them out until the closest face touches it.
+	float minPlaneDist = 1.0f;
+	for ( unsigned int i = 0; i < volume.tCount; i++ ) {
+		const Vec3 p0 = volume.vPos[volume.tris[i].idx0];
+		const Vec3 p1 = volume.vPos[volume.tris[i].idx1];
+		const Vec3 p2 = volume.vPos[volume.tris[i].idx2];
+		const Vec3 N = ( p1 - p0 ).cross( p2 - p0 ).normal();
+		const float planeDist = fabs( N.dot( p0 ) );
+		if ( planeDist < minPlaneDist ) {
+			minPlaneDist = planeDist;
+		}
+	}
+	for ( unsigned int i = 0; i < volume.vCount; i++ ) {
+		volume.vPos[i] /= minPlaneDist;
+	}
+}
+
+/*
+================================
+InitConeVolume
+	-cone along +y with its apex at the origin and a length of 1.
+	-a cone as long as the light's radius also contains the spherical cap at the end of the spot light
+	-the ring is pushed out so that its polygon circumscribes the circle of the cone
+================================
+*/
+static void InitConeVolume( LightEffectStorage & volume, const float halfAngle, unsigned int segments ) {
+	if ( segments + 2 > LIGHT_VOLUME_MAX_VERTS ) {
+		segments = LIGHT_VOLUME_MAX_VERTS - 2;
+	}
+	if ( segments * 2 > LIGHT_VOLUME_MAX_TRIS ) {
+		segments = LIGHT_VOLUME_MAX_TRIS / 2;
+	}
+	if ( segments < 3 ) {
+		segments = 3;
+	}
+
+	const float ringRadius = tanf( halfAngle ) / cosf( ( float )PI / ( float )segments );
+	const unsigned int apexIdx = 0;
+	const unsigned int capIdx = segments + 1;
+
+	volume.vCount = segments + 2;
+	volume.tCount = segments * 2;
+	volume.vPos[apexIdx] = Vec3( 0.0f, 0.0f, 0.0f );
+	volume.vPos[capIdx] = Vec3( 0.0f, 1.0f, 0.0f );
+	for ( unsigned int i = 0; i < segments; i++ ) {
+		const float theta = 2.0f * ( float )PI * ( float )i / ( float )segments;
+		volume.vPos[i + 1] = Vec3( cosf( theta ) * ringRadius, 1.0f, sinf( theta ) * ringRadius );
+	}
+	for ( unsigned int i = 0; i < segments; i++ ) {
+		const unsigned int ring0 = i + 1;
+		const unsigned int ring1 = ( ( i + 1 ) % segments ) + 1;
+		volume.tris[i * 2 + 0] = Tri{ apexIdx, ring1, ring0 };
+		volume.tris[i * 2 + 1] = Tri{ capIdx, ring0, ring1 };
+	}
+}
+
+/*
+================================
+OrientVolumeOutward
+	-the binning shaders treat a triangle's counter clockwise side as the outside of the volume.
+	 Rotations built from cross products can mirror the volume, so fix the winding after transforming it.
+================================
+*/
+static void OrientVolumeOutward( LightEffectStorage & volume ) {
+	Vec3 center = Vec3( 0.0f );
+	for ( unsigned int i = 0; i < volume.vCount; i++ ) {
+		center += volume.vPos[i];
+	}
+	center /= ( float )volume.vCount;
+
+	for ( unsigned int i = 0; i < volume.tCount; i++ ) {
+		Tri & tri = volume.tris[i];
+		const Vec3 p0 = volume.vPos[tri.idx0];
+		const Vec3 p1 = volume.vPos[tri.idx1];
+		const Vec3 p2 = volume.vPos[tri.idx2];
+		const Vec3 N = ( p1 - p0 ).cross( p2 - p0 );
+		if ( distanceToPlane( center, N, p0 ) > 0.0f ) {
+			const unsigned int temp = tri.idx1;
+			tri.idx1 = tri.idx2;
+			tri.idx2 = temp;
+		}
+	}
+}
+
+/*
+================================
+Light::BuildEffectVolume
+	-builds the world space volume that bounds the light's effect
+	-tightHull: icosphere hull for point lights and cone hull for spot lights. Otherwise the oriented box
+	 scaled by radius * sqrt( 3 ) that every light type used before.
+	-radius is the distance the light reaches. Either the max radius or the EffectRadius
+================================
+*/
+void Light::BuildEffectVolume( LightEffectStorage & volume, const bool tightHull, const float radius ) const {
+	const float spotLight_halfAngle = acos( m_uniformBlock.angle ); //m_uniformBlock.angle isnt the actual angle.
+	const float maxConeHalfAngle = to_radians( 60.0f ); //wider cones are better bound by the icosphere
 
 	//build normalized volume
-	InitBoundsVolume();
-	if ( TypeIndex() == 1 ) { //directional light
-		m_boundsUniformBlock.vPos[0].y = 0.0f;
-		m_boundsUniformBlock.vPos[3].y = 0.0f;
-		m_boundsUniformBlock.vPos[4].y = 0.0f;
-		m_boundsUniformBlock.vPos[7].y = 0.0f;
-	} else if ( TypeIndex() == 2 ) { //spot light
-		const float min = 0.001f;
-		m_boundsUniformBlock.vPos[0] = Vec3( -min, 0.0f, -min );
-		m_boundsUniformBlock.vPos[3] = Vec3( min, 0.0f, -min );
-		m_boundsUniformBlock.vPos[4] = Vec3( -min, 0.0f, min );
-		m_boundsUniformBlock.vPos[7] = Vec3( min, 0.0f, min );
-
-		const float spotLight_angle = 2.0f * acos( m_uniformBlock.angle ); //m_uniformBlock.angle isnt the actual angle.
-		const float m = min / tanf( spotLight_angle / 2.0f );
-		const float normalizedWidth = tanf( spotLight_angle / 2.0f ) * ( 1.0f + m );
-		m_boundsUniformBlock.vPos[1] = Vec3( -normalizedWidth, 1.0f, -normalizedWidth );
-		m_boundsUniformBlock.vPos[2] = Vec3( normalizedWidth, 1.0f, -normalizedWidth );
-		m_boundsUniformBlock.vPos[5] = Vec3( -normalizedWidth, 1.0f, normalizedWidth );
-		m_boundsUniformBlock.vPos[6] = Vec3( normalizedWidth, 1.0f, normalizedWidth );	
+	float volumeScale = radius * Vec3( 1.0f, 1.0f, 1.0f ).length();
+	bool orientVolume = ( TypeIndex() != 3 ); //if not a point light
+	if ( tightHull && TypeIndex() == 3 ) { //point light
+		InitIcosphereVolume( volume, s_pointVolumeSubdivisions );
+		volumeScale = radius;
+	} else if ( tightHull && TypeIndex() == 2 && spotLight_halfAngle <= maxConeHalfAngle ) { //spot light
+		InitConeVolume( volume, spotLight_halfAngle, s_spotVolumeSegments );
+		volumeScale = radius;
+	} else if ( tightHull && TypeIndex() == 2 ) { //wide spot light
+		InitIcosphereVolume( volume, s_pointVolumeSubdivisions );
+		volumeScale = radius;
+		orientVolume = false;
+	} else {
+		InitBoundsVolume( volume );
+		if ( TypeIndex() == 1 ) { //directional light
+			volume.vPos[0].y = 0.0f;
+			volume.vPos[3].y = 0.0f;
+			volume.vPos[4].y = 0.0f;
+			volume.vPos[7].y = 0.0f;
+		} else if ( TypeIndex() == 2 ) { //spot light
+			const float min = 0.001f;
+			volume.vPos[0] = Vec3( -min, 0.0f, -min );
+			volume.vPos[3] = Vec3( min, 0.0f, -min );
+			volume.vPos[4] = Vec3( -min, 0.0f, min );
+			volume.vPos[7] = Vec3( min, 0.0f, min );
+
+			const float m = min / tanf( spotLight_halfAngle );
+			const float normalizedWidth = tanf( spotLight_halfAngle ) * ( 1.0f + m );
+			volume.vPos[1] = Vec3( -normalizedWidth, 1.0f, -normalizedWidth );
+			volume.vPos[2] = Vec3( normalizedWidth, 1.0f, -normalizedWidth );
+			volume.vPos[5] = Vec3( -normalizedWidth, 1.0f, normalizedWidth );
+			volume.vPos[6] = Vec3( normalizedWidth, 1.0f, normalizedWidth );	
+		}
 	}
 
 	//transform it to light position, orientation, and size
@@ -484,11 +822,8 @@ void Light::InitLightEffectStorage() {
 	translation.Translate( m_uniformBlock.position );
 
 	Mat4 scale = Mat4();
-	const float d = Vec3( 1.0f, 1.0f, 1.0f ).length();
-	const float r = GetMaxRadius();
-	const float maxDist = GetMaxRadius() * d;
 	for ( int i = 0; i < 3; i++ ) {
-		scale[i][i] = maxDist;
+		scale[i][i] = volumeScale;
 	}
 
 	Vec3 axis = Vec3( 1.0, 0.0, 0.0 );
@@ -500,7 +835,7 @@ void Light::InitLightEffectStorage() {
 		crossVec.normalize();
 	}
 	Mat4 rotation = Mat4();
-	if ( TypeIndex() != 3 ) { //if not a point light
+	if ( orientVolume ) {
 		rotation[0] = Vec4( m_uniformBlock.direction.cross( crossVec ).normal(), 0.0 );
 		rotation[1] = Vec4( m_uniformBlock.direction.normal(), 0.0 );
 		rotation[2] = Vec4( crossVec, 0.0 );
@@ -508,11 +843,35 @@ void Light::InitLightEffectStorage() {
 	}
 		
 	Mat4 lightMat = translation * rotation * scale;
-	for ( unsigned int i = 0; i < m_boundsUniformBlock.vCount; i++ ) {
-		m_boundsUniformBlock.vPos[i] *= lightMat;
+	for ( unsigned int i = 0; i < volume.vCount; i++ ) {
+		volume.vPos[i] *= lightMat;
+	}
+
+	if ( tightHull ) {
+		OrientVolumeOutward( volume );
 	}
+}
+
+/*
+================================
+Light::InitLightEffectStorage
+	-calculate the max bounds of light effect
+================================
+*/
+void Light::InitLightEffectStorage() {
+	//makes sure bounds are calculated only once.
+	if ( lightEffectStorage_cached ) {
+		return;
+	}
+	lightEffectStorage_cached = true;
+
+	m_boundsUniformBlock = LightEffectStorage();
+	BuildEffectVolume( m_boundsUniformBlock, s_tightVolumes, EffectRadius() );
 
 	//create VAO to render light bounds as geo in debug view
+	if ( m_debugModel_VAO != 0 ) {
+		glDeleteVertexArrays( 1, &m_debugModel_VAO );
+	}
     unsigned int VBO, EBO;
     glGenVertexArrays( 1, &m_debugModel_VAO );
     glGenBuffers( 1, &VBO );
@@ -716,40 +1075,70 @@ const float * PointLight::LightMatrix() {
 ================================
 PointLight::UpdateDepthBuffer
 	-render the depth of the scene to lights piece of the depthbuffer
+	-uses the single pass path when the driver supports indexed viewports
 ================================
 */
 void PointLight::UpdateDepthBuffer( Scene * scene ) {
+	if ( s_cubeShadowsSinglePass && s_cubeShadowsSinglePassSupported ) {
+		UpdateDepthBuffer_SinglePass( scene );
+	} else {
+		UpdateDepthBuffer_MultiPass( scene );
+	}
+}
+
+/*
+================================
+PointLight::UpdateDepthBuffer_SinglePass
+	-every surface is drawn once. The geometry shader runs one invocation per face and routes
+	 each triangle to that face's partition of the atlas through gl_ViewportIndex.
+================================
+*/
+void PointLight::UpdateDepthBuffer_SinglePass( Scene * scene ) {
 	assert(  s_depthBufferAtlas->GetID() != 0 );
 
 	s_depthBufferAtlas->Bind();
-	if ( m_uniformBlock.shadowIdx == 0 ) {
-		glClear( GL_DEPTH_BUFFER_BIT ); //Clear previous frame values
+
+	//clear each face's partition and set the indexed viewports
+	for ( unsigned int i = 0; i < 6; i++ ) {
+		BindShadowPartition( m_uniformBlock.shadowIdx + i, i );
 	}
 
+	LightMatrix(); //update m_xfrms
+	s_depthCubeShader->UseProgram();
+	s_depthCubeShader->SetUniformMatrix4f( "lightSpaceMatrix", 6, false, m_xfrms[0].as_ptr() );
+
+	//render every surface of every mesh in the scene with s_depthCubeShader active
+	scene->DrawAll();
+
+	s_depthBufferAtlas->Unbind();
+	m_shadowDirty = false;
+}
+
+/*
+================================
+PointLight::UpdateDepthBuffer_MultiPass
+	-fallback that re-issues every draw for each of the 6 faces
+================================
+*/
+void PointLight::UpdateDepthBuffer_MultiPass( Scene * scene ) {
+	assert(  s_depthBufferAtlas->GetID() != 0 );
+
+	s_depthBufferAtlas->Bind();
+
 	LightMatrix(); //update m_xfrms
 	for ( unsigned int i = 0; i < 6; i++ ) {
 		s_depthShader->UseProgram();
 		s_depthShader->SetUniformMatrix4f( "lightSpaceMatrix", 1, false, m_xfrms[i].as_ptr() );
 
 		//set rendering for this light's portion of the depthBufferAtlas
-		const unsigned int shadowIdx = m_uniformBlock.shadowIdx + i;
-		const float mapsPerRow = ceil( sqrt( ( float )s_shadowCastingLightCount ) );
-		float currentRow = floor( ( float )shadowIdx / mapsPerRow );
-		unsigned int stepsDown = ( unsigned int )currentRow;
-		unsigned int stepsRight = shadowIdx - ( ( unsigned int )mapsPerRow * stepsDown );
-		glViewport( stepsRight * s_partitionSize, stepsDown * s_partitionSize, s_partitionSize, s_partitionSize );
-
-		//iterate through each surface of each mesh in the scene and render it with m_depthShader active
-		for ( int i = 0; i < scene->MeshCount(); i++ ) {			
-			Mesh * mesh = NULL;
-			scene->MeshByIndex( i, &mesh );
-			for ( unsigned int j = 0; j < mesh->m_surfaces.size(); j++ ) {
-				mesh->DrawSurface( j );
-			}
-		}
+		BindShadowPartition( m_uniformBlock.shadowIdx + i );
+
+		//render every surface of every mesh in the scene with m_depthShader active
+		scene->DrawAll();
 	}
 
 	s_depthBufferAtlas->Unbind();
+	m_shadowDirty = false;
 }
 
 /*
@@ -796,8 +1185,8 @@ void PointLight::PassUniforms( Shader * shader, int idx ) const {
 		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
 	}
 
-	//if shadowcasting send shadow data
-	if ( m_uniformBlock.shadowIdx > -1 ) {
+	//if shadowcasting send shadow data. Permutations without shadows have no shadow_buffer.
+	if ( m_uniformBlock.shadowIdx > -1 && shader->HasStorageBlock( "shadow_buffer" ) ) {
 		ShadowStorage shadowUniformBlock[6];
 		for ( unsigned int i = 0; i < 6; i++ ) {
 			shadowUniformBlock[i].xfrm = m_xfrms[i];
@@ -841,8 +1230,7 @@ EnvProbe::EnvProbe
 */
 EnvProbe::EnvProbe() {
 	m_position = Vec3();
-	m_irradianceMap = CubemapTexture();
-	m_environmentMap = CubemapTexture();
+	m_hasIrradianceSH = false;
 	m_meshCount = 0;
 
 	if ( s_brdfIntegrationMap.m_empty ) {
@@ -857,8 +1245,7 @@ EnvProbe::EnvProbe
 */
 EnvProbe::EnvProbe( Vec3 pos ) {
 	m_position = pos;
-	m_irradianceMap = CubemapTexture();
-	m_environmentMap = CubemapTexture();
+	m_hasIrradianceSH = false;
 	m_meshCount = 0;
 
 	if ( s_brdfIntegrationMap.m_empty ) {
@@ -866,24 +1253,6 @@ EnvProbe::EnvProbe( Vec3 pos ) {
 	}
 }
 
-/*
-================================
-EnvProbe::Delete
-	-Delete textures from gpu
-================================
-*/
-void EnvProbe::Delete() {
-	const unsigned int id1 = m_irradianceMap.GetName();
-	if ( id1 != CubemapTexture::s_errorCube ) {
-		glDeleteTextures( 1, &id1 );
-	}
-
-	const unsigned int id2 = m_environmentMap.GetName();
-	if ( id1 != CubemapTexture::s_errorCube ) {
-		glDeleteTextures( 1, &id2 );
-	}
-}
-
 /*
 ================================
 EnvProbe::MeshByIndex
@@ -914,7 +1283,8 @@ bool EnvProbe::MeshByIndex( unsigned int index, Mesh ** obj ) {
 /*
 ================================
 EnvProbe::BuildProbe
-	-load cubemap texture files for this probe
+	-finds the cubemap files of this probe and loads its irradiance SH. The cubemaps are loaded
+	 into the probe arrays by BuildArrays once every probe is built.
 ================================
 */
 bool EnvProbe::BuildProbe( unsigned int probeIdx ) {
@@ -931,31 +1301,156 @@ bool EnvProbe::BuildProbe( unsigned int probeIdx ) {
 	probeName.Replace( "data\\scenes\\", "data\\generated\\envprobes\\", false );
 	probeName = probeName.Substring( 0, probeName.Length() - 4 );
 
-	//load env map and generate mips
+	//load env map and its prefiltered levels
 	Str environment_relativePath = Str( probeName.c_str() );
 	environment_relativePath.Append( "\\env_" );
 	environment_relativePath.Append( probe_suffix );
 	environment_relativePath.Append( ".hdr" );
-	m_environmentMap.InitFromFile( environment_relativePath.c_str() );
-	m_environmentMap.PrefilterSpeculateProbe();
+	m_environmentPath = environment_relativePath;
 
-	//load irradiance map
-	Str irradiance_relativePath = environment_relativePath.Substring( 0, environment_relativePath.Length() - 4 );
-	irradiance_relativePath.Append( "_irr.hdr" );
-	m_irradianceMap.InitFromFile( irradiance_relativePath.c_str() );
+	//load irradiance SH, 108 bytes in place of the irradiance cubemap
+	Str sh_relativePath = environment_relativePath.Substring( 0, environment_relativePath.Length() - 4 );
+	sh_relativePath.Append( "_sh.txt" );
+	char sh_fullPath[ 2048 ];
+	RelativePathToFullPath( sh_relativePath.c_str(), sh_fullPath );
+	m_hasIrradianceSH = s_useIrradianceSH && EnvMapBaker::LoadIrradianceSH( sh_fullPath, m_irradianceSH );
 
 	return true;
 }
 
+/*
+================================
+EnvProbe::BuildArrays
+	-packs the env maps and prefiltered levels of every probe into one cubemap array, layer i is
+	 probes[i]. The irradiance cubemaps are only loaded when a probe has no SH.
+	-fills the probe storage passed to the shaders
+================================
+*/
+bool EnvProbe::BuildArrays( EnvProbe ** probes, const unsigned int probeCount ) {
+	DeleteArrays();
+	if ( probeCount == 0 ) {
+		return false;
+	}
+
+	std::vector< Str > environmentPaths( probeCount );
+	std::vector< Str > irradiancePaths( probeCount );
+	bool needIrradianceMaps = false;
+	s_probeStorage.resize( probeCount );
+	for ( unsigned int i = 0; i < probeCount; i++ ) {
+		const EnvProbe * probe = probes[ i ];
+		environmentPaths[ i ] = probe->m_environmentPath;
+		irradiancePaths[ i ] = probe->m_environmentPath.Substring( 0, probe->m_environmentPath.Length() - 4 );
+		irradiancePaths[ i ].Append( "_irr.hdr" );
+		needIrradianceMaps = needIrradianceMaps || !probe->m_hasIrradianceSH;
+
+		ProbeStorage & storage = s_probeStorage[ i ];
+		memset( &storage, 0, sizeof( ProbeStorage ) );
+		storage.hasIrradianceSH = probe->m_hasIrradianceSH ? 1 : 0;
+		if ( probe->m_hasIrradianceSH ) {
+			for ( unsigned int c = 0; c < 9; c++ ) {
+				storage.irradianceSH[ c ][ 0 ] = probe->m_irradianceSH.coeffs[ c ][ 0 ];
+				storage.irradianceSH[ c ][ 1 ] = probe->m_irradianceSH.coeffs[ c ][ 1 ];
+				storage.irradianceSH[ c ][ 2 ] = probe->m_irradianceSH.coeffs[ c ][ 2 ];
+			}
+		}
+	}
+
+	unsigned int missingCount = 0;
+	bool success = s_environmentMaps.InitFromFiles( environmentPaths, ENV_PROBE_LEVELS, &missingCount );
+	if ( missingCount > 0 ) {
+		printf( "%u env probes are missing, rebuild the scene\n", missingCount );
+	}
+	if ( needIrradianceMaps ) {
+		success = s_irradianceMaps.InitFromFiles( irradiancePaths, 1 ) && success;
+	}
+	return success;
+}
+
+/*
+================================
+EnvProbe::DeleteArrays
+================================
+*/
+void EnvProbe::DeleteArrays() {
+	s_environmentMaps.Delete();
+	s_environmentMaps.UseErrorTexture();
+	s_irradianceMaps.Delete();
+	s_irradianceMaps.UseErrorTexture();
+	s_probeStorage.clear();
+}
+
+/*
+================================
+EnvProbe::BindTextures
+	-binds the brdf LUT and the probe arrays to slot, slot + 1 and slot + 2. Once a frame, they
+	 are shared by every instance.
+================================
+*/
+void EnvProbe::BindTextures( const unsigned int slot ) {
+	glActiveTexture( GL_TEXTURE0 + slot );
+	glBindTexture( s_brdfIntegrationMap.GetTarget(), s_brdfIntegrationMap.GetName() );
+	glActiveTexture( GL_TEXTURE0 + slot + 1 );
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARRAY, s_irradianceMaps.GetName() );
+	glActiveTexture( GL_TEXTURE0 + slot + 2 );
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARRAY, s_environmentMaps.GetName() );
+	glActiveTexture( GL_TEXTURE0 );
+}
+
 /*
 ================================
 EnvProbe::PassUniforms
+	-once per program, points the samplers at the slots of BindTextures and binds the probe storage
+================================
+*/
+void EnvProbe::PassUniforms( Shader * shader, const unsigned int slot ) {
+	//permutations without IBL have none of the samplers and no probe_buffer
+	static const char * samplers[ 3 ] = { "brdfLUT", "irradianceMaps", "prefilteredEnvMaps" };
+	for ( unsigned int i = 0; i < 3; i++ ) {
+		if ( shader->HasUniform( samplers[i] ) ) {
+			const int samplerSlot = ( int )( slot + i );
+			shader->SetUniform1i( samplers[i], 1, &samplerSlot );
+		}
+	}
+
+	if ( s_probeStorage.empty() || !shader->HasStorageBlock( "probe_buffer" ) ) {
+		return;
+	}
+
+	//fetch the buffer object from the shader. If its not present, the create and add it.
+	const GLsizeiptr totalSize = s_probeStorage.size() * sizeof( ProbeStorage );
+	const int block_index = shader->BufferBlockIndexByName( "probe_buffer" );
+	Buffer * ssbo = NULL;
+	if ( block_index == GL_INVALID_INDEX ) {
+		//create it if it doesnt exist
+		ssbo = ssbo->GetBuffer( "probe_buffer" );
+		ssbo->Initialize( totalSize, s_probeStorage.data(), GL_STATIC_DRAW );
+		shader->AddBuffer( ssbo );
+	} else {
+		ssbo = shader->BufferByBlockIndex( block_index );
+	}
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, ssbo->GetBindingPoint(), ssbo->GetID() );
+}
+
+/*
+================================
+EnvProbe::AssignNearestProbes
+	-probeIndices[i] is the index of the probe position nearest to points[i], on a tie the first
 ================================
 */
-void EnvProbe::PassUniforms( Shader* shader, unsigned int slot ) const {
-	shader->SetAndBindUniformTexture( "brdfLUT", slot, s_brdfIntegrationMap.GetTarget(), s_brdfIntegrationMap.GetName() );
-	shader->SetAndBindUniformTexture( "irradianceMap", slot + 1, m_irradianceMap.GetTarget(), m_irradianceMap.GetName() );
-	shader->SetAndBindUniformTexture( "prefilteredEnvMap", slot + 2, m_environmentMap.GetTarget(), m_environmentMap.GetName() );
+void EnvProbe::AssignNearestProbes( const std::vector< Vec3 > & points, const std::vector< Vec3 > & probePositions, std::vector< unsigned int > & probeIndices ) {
+	probeIndices.assign( points.size(), 0 );
+	for ( unsigned int i = 0; i < points.size(); i++ ) {
+		float minDistSq = FLT_MAX;
+		for ( unsigned int p = 0; p < probePositions.size(); p++ ) {
+			const Vec3 delta = points[ i ] - probePositions[ p ];
+			const float distSq = delta.dot( delta );
+			if ( distSq < minDistSq ) {
+				minDistSq = distSq;
+				probeIndices[ i ] = p;
+			}
+		}
+	}
 }
 
 /*
@@ -998,7 +1493,7 @@ std::vector< unsigned int > EnvProbe::RenderCubemaps( Shader * shader, const uns
 	glDisable( GL_BLEND );
 	MaterialDecl* skyMat;
 	const Cube * sceneSkybox = scene->GetSkybox();
-	skyMat = MaterialDecl::GetMaterialDecl( sceneSkybox->m_surface->materialName.c_str() );
+	skyMat = MaterialDecl::DeclById( sceneSkybox->m_surface->declId );
 	skyMat->BindTextures();
 	for ( int faceIdx = 0; faceIdx < 6; faceIdx++ ) {
 		fbos[faceIdx].Bind();
@@ -1024,7 +1519,7 @@ std::vector< unsigned int > EnvProbe::RenderCubemaps( Shader * shader, const uns
 			scene->MeshByIndex( i, &mesh );
 
 			for ( unsigned int j = 0; j < mesh->m_surfaces.size(); j++ ) {
-				matDecl = MaterialDecl::GetMaterialDecl( mesh->m_surfaces[j]->materialName.c_str() );
+				matDecl = MaterialDecl::DeclById( mesh->m_surfaces[j]->declId );
 
 				//exit early if this material is errored out
 				if ( matDecl->m_shaderProg == "error" ) {
@@ -6,17 +6,22 @@
 #include "Framebuffer.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "EnvMapBaker.h"
 
 class Scene;
 
+//the LightEffect struct of include/light_volume.glsl is sized with these, they are set as global shader defines
+#define LIGHT_VOLUME_MAX_VERTS 42
+#define LIGHT_VOLUME_MAX_TRIS 80
+
 struct Tri {
 	unsigned int idx0, idx1, idx2;
 };
 struct LightEffectStorage {
 	unsigned int vCount;
 	unsigned int tCount;
-	Vec3 vPos[8];
-	Tri tris[12];
+	Vec3 vPos[LIGHT_VOLUME_MAX_VERTS];
+	Tri tris[LIGHT_VOLUME_MAX_TRIS];
 };
 
 struct LightStorage {
@@ -57,9 +62,10 @@ class Light {
 		virtual const float * LightMatrix() { return m_xfrm.as_ptr(); }
 
 		const unsigned int GetShadowIndex() const { return m_uniformBlock.shadowIdx; }
+		virtual const unsigned int ShadowPartitionCount() const { return 1; }
 
 		const Vec3 GetPosition() const { return m_uniformBlock.position; }
-		void SetPosition( Vec3 pos ) { m_uniformBlock.position = pos; }
+		void SetPosition( Vec3 pos ) { m_uniformBlock.position = pos; m_shadowDirty = true; }
 
 		const Vec3 GetColor() const { return m_uniformBlock.color; }
 		void SetColor( Vec3 col ) { m_uniformBlock.color = col.normal(); }
@@ -68,7 +74,7 @@ class Light {
 		void SetBrightness( float brt ) { m_uniformBlock.brightness = brt; }
 
 		const Vec3 GetDirection() const { return m_uniformBlock.direction; }
-		void SetDirection( Vec3 dir ) { m_uniformBlock.direction = dir.normal(); }
+		void SetDirection( Vec3 dir ) { m_uniformBlock.direction = dir.normal(); m_shadowDirty = true; }
 
 		const float GetRadius() const { return m_uniformBlock.light_radius; }
 		void SetRadius( float radius );
@@ -80,8 +86,17 @@ class Light {
 		virtual void SetShadow( const bool shadowCasting );
 
 		float MaxAttenuationDist() const;
+		float LuminanceAtDistance( const float dist ) const;
+		float EffectRadius() const;
 
 		void InitLightEffectStorage();
+		void InvalidateLightEffectStorage() { lightEffectStorage_cached = false; }
+		void BuildEffectVolume( LightEffectStorage & volume, const bool tightHull, const float radius ) const;
+		const LightEffectStorage& GetEffectVolume() const { return m_boundsUniformBlock; }
+
+		bbox InfluenceBounds() const;
+		bool NeedsShadowUpdate( const std::vector< bbox >& movedBounds ) const;
+		void MarkShadowDirty() { m_shadowDirty = true; }
 
 		virtual void PassUniforms( Shader* shader, int idx ) const;
 		void PassDepthAttribute( Shader* shader, const unsigned int slot ) const;
@@ -89,20 +104,26 @@ class Light {
 		
 		int m_idx;
 		bool m_cachedShadows;
-		bool m_firstFrameRendered;
 
 		static float s_lightAttenuationBias;
+		static bool s_tightVolumes; //convex hulls instead of boxes for point and spot lights
+		static unsigned int s_pointVolumeSubdivisions; //icosphere subdivisions. 0 -> 20 tris, 1 -> 80 tris
+		static unsigned int s_spotVolumeSegments; //sides of the cone hull
+		static float s_cutoffLuminance; //lights are binned only where they are brighter than this. 0 -> use the max radius
 
 		static unsigned int s_lightCount;
 		static unsigned int s_shadowCastingLightCount;
 		static Shader * s_debugShader;
 		static Shader * s_depthShader;
+		static Shader * s_depthCubeShader;
 
 		static void InitShadowAtlas();
 		static Framebuffer * s_depthBufferAtlas;
 		static unsigned int s_partitionSize;
 		static const unsigned int s_depthBufferAtlasSize_min = 512;
 		static const unsigned int s_depthBufferAtlasSize_max = 4096;
+		static bool s_cubeShadowsSinglePass; //user preference. Only used if s_cubeShadowsSinglePassSupported
+		static bool s_cubeShadowsSinglePassSupported;
 
 	protected:
 		Light();
@@ -110,12 +131,14 @@ class Light {
 		LightStorage m_uniformBlock;
 		LightEffectStorage m_boundsUniformBlock;
 		bool m_shadowCaster;		
+		bool m_shadowDirty; //light changed since its partition of the atlas was last rendered
 		float m_near_plane, m_far_plane;
 		Mat4 m_xfrm;
 		Vec2 m_PosInShadowAtlas;
 		bool lightEffectStorage_cached;
 
-		void InitBoundsVolume();
+		static void InitBoundsVolume( LightEffectStorage & volume );
+		void BindShadowPartition( const unsigned int shadowIdx, const unsigned int viewportIdx = 0 ) const;
 
 	private:		
 		virtual Mesh * GetDebugMesh() const { return s_debugModel; }
@@ -167,7 +190,7 @@ class SpotLight : public Light {
 
 		//cos(angle/2) is an optimization. rather than performing this in the frag shader
 		const float GetAngle() const { return 2.0f * acos( m_uniformBlock.angle ); }
-		void SetAngle( float radians ) { m_uniformBlock.angle = cos( radians / 2.0f ); }
+		void SetAngle( float radians ) { m_uniformBlock.angle = cos( radians / 2.0f ); m_shadowDirty = true; }
 
 	private:
 		Mesh * GetDebugMesh() const { return s_debugModel_spot; }
@@ -191,6 +214,7 @@ class PointLight : public Light {
 
 		void SetShadow( const bool shadowCasting );
 		const Vec2 GetShadowMapLoc( unsigned int faceIdx ) const;
+		const unsigned int ShadowPartitionCount() const { return 6; }
 
 		const float * LightMatrix();
 
@@ -199,6 +223,9 @@ class PointLight : public Light {
 		void PassUniforms( Shader* shader, int idx ) const;
 
 	private:
+		void UpdateDepthBuffer_SinglePass( Scene * scene );
+		void UpdateDepthBuffer_MultiPass( Scene * scene );
+
 		Mesh * GetDebugMesh() const { return s_debugModel_point; }
 		Mat4 m_xfrms[6];
 
@@ -207,11 +234,25 @@ class PointLight : public Light {
 	friend Scene;
 };
 
+/*
+==============================
+ProbeStorage
+	-per probe data in the probe_buffer ssbo, indexed by the probe index of an instance
+==============================
+*/
+struct ProbeStorage {
+	float irradianceSH[9][4]; //rgb, std430 pads the elements of a vec3 array to 16 bytes
+	int hasIrradianceSH;
+	int pad[3];
+};
+
 /*
 ==============================
 EnvProbe
 	-cubemaps are generated via cvar
-	-the scene populates the m_meshes array and calls BuildProbe member function
+	-the scene populates the m_meshes array and calls BuildProbe member function, then packs the
+	 cubemaps of every probe into cubemap arrays with BuildArrays. Layer i of the arrays is probe i.
+	-instances pick their probe with a per instance probe index, so the arrays are bound once a frame
 ==============================
 */
 class EnvProbe {
@@ -219,7 +260,6 @@ class EnvProbe {
 		EnvProbe();
 		EnvProbe( Vec3 pos );
 		~EnvProbe() {};
-		void Delete();
 
 		const Vec3 GetPosition() { return m_position; }
 		void SetPosition( Vec3 pos ) { m_position = pos; }
@@ -230,19 +270,30 @@ class EnvProbe {
 		void AddMesh( Mesh * mesh ) { m_meshes[m_meshCount] = mesh; m_meshCount += 1; }
 
 		bool BuildProbe( unsigned int probeIdx );
-		void PassUniforms( Shader* shader, unsigned int slot ) const;
 		std::vector<unsigned int> RenderCubemaps( Shader * shader, const unsigned int cubemapSize );
 
+		static bool BuildArrays( EnvProbe ** probes, const unsigned int probeCount );
+		static void DeleteArrays();
+		static void BindTextures( const unsigned int slot );
+		static void PassUniforms( Shader * shader, const unsigned int slot );
+		static void AssignNearestProbes( const std::vector< Vec3 > & points, const std::vector< Vec3 > & probePositions, std::vector< unsigned int > & probeIndices );
+
+		static bool s_useIrradianceSH; //probes with baked SH dont need the irradiance cubemap array, applied when the probes are built
+
 	private:
 		Vec3 m_position;
 
-		CubemapTexture m_irradianceMap;
-		CubemapTexture m_environmentMap;
+		Str m_environmentPath; //set by BuildProbe
+		irradianceSH_t m_irradianceSH;
+		bool m_hasIrradianceSH;
 
 		unsigned int m_meshCount;
 		Mesh * m_meshes [256];
 
 		static Texture s_brdfIntegrationMap;
+		static CubemapArrayTexture s_irradianceMaps;
+		static CubemapArrayTexture s_environmentMaps;
+		static std::vector< ProbeStorage > s_probeStorage;
 
 	friend Scene;
 };
@@ -0,0 +1,170 @@
+#include "LightBinning.h"
+#include "Light.h"
+
+#include <algorithm>
+#include <math.h>
+
+const unsigned int LightBinning::s_maxLightsPerTile = 32; //MAX_LIGHTS_PER_TILE of the shaders, set as a global shader define
+
+/*
+================================
+PlaneLineIntersection
+================================
+*/
+static Vec3 PlaneLineIntersection( const Vec3& v0, const Vec3& v1, const Vec3& N, const Vec3& P ) {
+	const Vec3 Pv0 = v0 - P;
+	const Vec3 v0v1 = v1 - v0;
+	return v0 - v0v1 * ( Pv0.dot( N ) / v0v1.dot( N ) );
+}
+
+/*
+================================
+ProjectToNDC
+================================
+*/
+static Vec2 ProjectToNDC( const Vec3& p, const Mat4& VP ) {
+	const Vec4 clip = Vec4( p.x, p.y, p.z, 1.0f ) * VP;
+	return Vec2( clip.x / clip.w, clip.y / clip.w );
+}
+
+/*
+================================
+MarkCorners
+	-marks every tile corner that lies within the ndc triangle a b c
+================================
+*/
+static void MarkCorners( const Vec2& a, const Vec2& b, const Vec2& c, const int cornersX, const int cornersY, std::vector< bool >& corners ) {
+	const float denom = ( a.x - c.x ) * ( b.y - a.y ) - ( a.x - b.x ) * ( c.y - a.y );
+	if ( denom == 0.0f ) {
+		return; //degenerate triangle
+	}
+
+	//only visit the corners inside the triangle's screen bounds
+	const float minX = std::min( a.x, std::min( b.x, c.x ) );
+	const float maxX = std::max( a.x, std::max( b.x, c.x ) );
+	const float minY = std::min( a.y, std::min( b.y, c.y ) );
+	const float maxY = std::max( a.y, std::max( b.y, c.y ) );
+	const int x0 = std::max( 0, ( int )ceil( ( minX + 1.0f ) * 0.5f * ( cornersX - 1 ) ) );
+	const int x1 = std::min( cornersX - 1, ( int )floor( ( maxX + 1.0f ) * 0.5f * ( cornersX - 1 ) ) );
+	const int y0 = std::max( 0, ( int )ceil( ( minY + 1.0f ) * 0.5f * ( cornersY - 1 ) ) );
+	const int y1 = std::min( cornersY - 1, ( int )floor( ( maxY + 1.0f ) * 0.5f * ( cornersY - 1 ) ) );
+
+	for ( int y = y0; y <= y1; y++ ) {
+		for ( int x = x0; x <= x1; x++ ) {
+			const float px = 2.0f * ( float )x / ( float )( cornersX - 1 ) - 1.0f;
+			const float py = 2.0f * ( float )y / ( float )( cornersY - 1 ) - 1.0f;
+			const float b0 = ( px * ( b.y - c.y ) + py * ( c.x - b.x ) + ( b.x * c.y - c.x * b.y ) ) / denom;
+			const float b1 = ( px * ( c.y - a.y ) + py * ( a.x - c.x ) + ( c.x * a.y - a.x * c.y ) ) / denom;
+			const float b2 = ( px * ( a.y - b.y ) + py * ( b.x - a.x ) + ( a.x * b.y - b.x * a.y ) ) / denom;
+			if ( b0 >= 0.0f && b1 >= 0.0f && b2 >= 0.0f ) {
+				corners[y * cornersX + x] = true;
+			}
+		}
+	}
+}
+
+/*
+================================
+LightBinning::BinLights
+	-returns how many lights each tile would be assigned
+================================
+*/
+binningStats_t LightBinning::BinLights( const std::vector< const LightEffectStorage * >& volumes, const Mat4& view, const Mat4& projection, const Vec3& camPos, const Vec3& camLook, const int screenWidth, const int screenHeight, const int tileSize ) {
+	binningStats_t stats = binningStats_t();
+
+	const int tilesX = screenWidth / tileSize;
+	const int tilesY = screenHeight / tileSize;
+	const int cornersX = tilesX + 1;
+	const int cornersY = tilesY + 1;
+	stats.tileCount = ( unsigned int )( tilesX * tilesY );
+	if ( stats.tileCount == 0 ) {
+		return stats;
+	}
+
+	const Mat4 VP = projection * view;
+	const Vec3 clipPlanePos = camPos + ( camLook * 0.0001f ); //same offset as the tilePrepass shader
+
+	std::vector< unsigned int > tileLightCounts( stats.tileCount, 0 );
+	std::vector< bool > corners( cornersX * cornersY );
+	for ( unsigned int i = 0; i < volumes.size(); i++ ) {
+		const LightEffectStorage * volume = volumes[i];
+		std::fill( corners.begin(), corners.end(), false );
+
+		for ( unsigned int j = 0; j < volume->tCount; j++ ) {
+			Vec3 p0 = volume->vPos[volume->tris[j].idx0];
+			Vec3 p1 = volume->vPos[volume->tris[j].idx1];
+			Vec3 p2 = volume->vPos[volume->tris[j].idx2];
+
+			const float p0_dis = camLook.dot( p0 - clipPlanePos );
+			const float p1_dis = camLook.dot( p1 - clipPlanePos );
+			const float p2_dis = camLook.dot( p2 - clipPlanePos );
+
+			//in cases where only one vert is clipped, an extra tri needs to be created
+			bool twoVertsInFront = false;
+			Vec3 p3 = Vec3( 0.0f );
+
+			//clip triangle
+			if ( p0_dis < 0.0f && p1_dis < 0.0f && p2_dis < 0.0f ) {
+				continue;
+			} else if ( p0_dis < 0.0f && p1_dis < 0.0f ) {
+				p0 = PlaneLineIntersection( p2, p0, camLook, clipPlanePos );
+				p1 = PlaneLineIntersection( p2, p1, camLook, clipPlanePos );
+			} else if ( p1_dis < 0.0f && p2_dis < 0.0f ) {
+				p1 = PlaneLineIntersection( p0, p1, camLook, clipPlanePos );
+				p2 = PlaneLineIntersection( p0, p2, camLook, clipPlanePos );
+			} else if ( p2_dis < 0.0f && p0_dis < 0.0f ) {
+				p2 = PlaneLineIntersection( p1, p2, camLook, clipPlanePos );
+				p0 = PlaneLineIntersection( p1, p0, camLook, clipPlanePos );
+			} else if ( p0_dis < 0.0f ) {
+				twoVertsInFront = true;
+				const Vec3 temp = p2;
+				p2 = PlaneLineIntersection( p0, p1, camLook, clipPlanePos );
+				p3 = PlaneLineIntersection( p0, temp, camLook, clipPlanePos );
+				p0 = p1;
+				p1 = temp;
+			} else if ( p1_dis < 0.0f ) {
+				twoVertsInFront = true;
+				const Vec3 temp = p2;
+				p2 = PlaneLineIntersection( p1, p2, camLook, clipPlanePos );
+				p3 = PlaneLineIntersection( p1, p0, camLook, clipPlanePos );
+				p1 = p0;
+				p0 = temp;
+			} else if ( p2_dis < 0.0f ) {
+				twoVertsInFront = true;
+				const Vec3 temp = p2;
+				p2 = PlaneLineIntersection( p2, p0, camLook, clipPlanePos );
+				p3 = PlaneLineIntersection( temp, p1, camLook, clipPlanePos );
+			}
+
+			const Vec2 ndc0 = ProjectToNDC( p0, VP );
+			const Vec2 ndc1 = ProjectToNDC( p1, VP );
+			const Vec2 ndc2 = ProjectToNDC( p2, VP );
+			MarkCorners( ndc0, ndc1, ndc2, cornersX, cornersY, corners );
+			if ( twoVertsInFront ) {
+				const Vec2 ndc3 = ProjectToNDC( p3, VP );
+				MarkCorners( ndc1, ndc3, ndc2, cornersX, cornersY, corners );
+			}
+		}
+
+		//a tile bins the light if any of its four corners was covered
+		for ( int y = 0; y < tilesY; y++ ) {
+			for ( int x = 0; x < tilesX; x++ ) {
+				if ( corners[y * cornersX + x] || corners[y * cornersX + x + 1] || corners[( y + 1 ) * cornersX + x] || corners[( y + 1 ) * cornersX + x + 1] ) {
+					tileLightCounts[y * tilesX + x] += 1;
+				}
+			}
+		}
+	}
+
+	for ( unsigned int i = 0; i < stats.tileCount; i++ ) {
+		stats.binnedPairs += tileLightCounts[i];
+		if ( tileLightCounts[i] > stats.maxLightsPerTile ) {
+			stats.maxLightsPerTile = tileLightCounts[i];
+		}
+		if ( tileLightCounts[i] > s_maxLightsPerTile ) {
+			stats.overflowTiles += 1;
+		}
+	}
+	stats.avgLightsPerTile = ( float )stats.binnedPairs / ( float )stats.tileCount;
+	return stats;
+}
\ No newline at end of file
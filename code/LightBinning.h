@@ -0,0 +1,36 @@
+#pragma once
+#ifndef __LIGHTBINNING_H_INCLUDE__
+#define __LIGHTBINNING_H_INCLUDE__
+
+#include <vector>
+#include "Vector.h"
+#include "Matrix.h"
+
+struct LightEffectStorage;
+
+struct binningStats_t {
+	unsigned int tileCount;
+	unsigned int binnedPairs; //light tile pairs
+	unsigned int maxLightsPerTile;
+	unsigned int overflowTiles; //tiles with more lights than fit in a tile's light list
+	float avgLightsPerTile;
+};
+
+/*
+==============================
+LightBinning
+	-cpu version of the light binning done by the tilePrepass compute shader.
+	-a light is binned to a tile when one of the tile's corners lies within one of the light volume's
+	 projected triangles. Triangles are clipped against the camera plane the same way the shader does.
+	-the depth test against the tile's min/max depth is skipped so the results are an upper bound
+	 of what the shader bins.
+==============================
+*/
+class LightBinning {
+	public:
+		static binningStats_t BinLights( const std::vector< const LightEffectStorage * >& volumes, const Mat4& view, const Mat4& projection, const Vec3& camPos, const Vec3& camLook, const int screenWidth, const int screenHeight, const int tileSize );
+
+		static const unsigned int s_maxLightsPerTile;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "MaterialTable.h"
+#include "Decl.h"
+#include "Shader.h"
+#include "Texture.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+bool MaterialTable::s_supported = false;
+bool MaterialTable::s_bindless = false;
+bool MaterialTable::s_nonuniformHandles = false;
+unsigned int MaterialTable::s_residentHandles = 0;
+std::vector< const Texture * > MaterialTable::s_slotTextures;
+std::vector< materialSource_t > MaterialTable::s_sources;
+std::vector< materialEntry_t > MaterialTable::s_entries;
+std::vector< unsigned int > MaterialTable::s_entryNames;
+bool MaterialTable::s_dirty = false;
+std::vector< unsigned int > MaterialTable::s_drawMaterials;
+bool MaterialTable::s_drawMaterialsDirty = false;
+
+//sampler uniforms of the decls by table slot, the order of Material::textures in the shaders
+static const char * s_slotUniforms[ MATERIAL_TABLE_TEXTURES ] = { "albedoTexture", "specularTexture", "normalTexture", "glossTexture" };
+
+/*
+================================
+MaterialTable::TextureSlot
+	-slot of a decl's sampler uniform, -1 if the table has no slot for it
+================================
+*/
+int MaterialTable::TextureSlot( const char * uniformName ) {
+	for ( int i = 0; i < MATERIAL_TABLE_TEXTURES; i++ ) {
+		if ( strcmp( uniformName, s_slotUniforms[i] ) == 0 ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+================================
+MaterialTable::Refresh
+	-packs sources into entries. Handles are only made for slots whose gl name differs from
+	 entryNames, unset slots use the handle of missingTextureName.
+	-returns the number of entries that changed
+================================
+*/
+unsigned int MaterialTable::Refresh( const std::vector< materialSource_t > & sources, const unsigned int missingTextureName, textureHandleFn_t handleFn, std::vector< materialEntry_t > & entries, std::vector< unsigned int > & entryNames ) {
+	const size_t oldCount = entries.size();
+	entries.resize( sources.size() );
+	entryNames.resize( sources.size() * MATERIAL_TABLE_TEXTURES, 0 );
+
+	unsigned int changedCount = 0;
+	for ( size_t i = 0; i < sources.size(); i++ ) {
+		const materialSource_t & source = sources[i];
+		materialEntry_t & entry = entries[i];
+		bool changed = ( i >= oldCount );
+		if ( changed ) {
+			memset( &entry, 0, sizeof( entry ) );
+		}
+
+		for ( unsigned int slot = 0; slot < MATERIAL_TABLE_TEXTURES; slot++ ) {
+			const unsigned int name = ( source.textureNames[ slot ] != 0 ) ? source.textureNames[ slot ] : missingTextureName;
+			unsigned int & entryName = entryNames[ i * MATERIAL_TABLE_TEXTURES + slot ];
+			if ( name != entryName || entry.textures[ slot ] == 0 ) {
+				entry.textures[ slot ] = handleFn( name );
+				entryName = name;
+				changed = true;
+			}
+		}
+		for ( unsigned int c = 0; c < 3; c++ ) {
+			if ( entry.emissiveColor[c] != source.emissiveColor[c] ) {
+				entry.emissiveColor[c] = source.emissiveColor[c];
+				changed = true;
+			}
+		}
+		entry.emissiveColor[3] = 0.0f;
+		changedCount += changed ? 1 : 0;
+	}
+	return changedCount;
+}
+
+/*
+================================
+ResidentHandle
+	-a texture always gets the same handle, it only has to be made resident the first time
+================================
+*/
+static uint64_t ResidentHandle( const unsigned int textureName ) {
+	const GLuint64 handle = glGetTextureHandleARB( textureName );
+	if ( !glIsTextureHandleResidentARB( handle ) ) {
+		glMakeTextureHandleResidentARB( handle );
+		MaterialTable::s_residentHandles++;
+	}
+	return ( uint64_t )handle;
+}
+
+/*
+================================
+MaterialTable::Init
+	-after glewInit
+================================
+*/
+void MaterialTable::Init() {
+	s_supported = GLEW_ARB_bindless_texture != 0 && GLEW_ARB_shader_draw_parameters != 0;
+	s_bindless = s_supported;
+	s_nonuniformHandles = GLEW_NV_gpu_shader5 != 0;
+	printf( "Bindless textures: %s\n", s_supported ? "supported" : "not supported, binding material textures to slots" );
+	if ( s_supported && !s_nonuniformHandles ) {
+		printf( "NV_gpu_shader5 not supported, multi draws are split at every material\n" );
+	}
+}
+
+/*
+================================
+MaterialTable::CollectTextures
+	-the textures of every decl by slot, redone whenever decls were loaded since
+================================
+*/
+void MaterialTable::CollectTextures() {
+	const size_t declCount = MaterialDecl::s_declsById.size();
+	s_slotTextures.assign( declCount * MATERIAL_TABLE_TEXTURES, NULL );
+	s_sources.resize( declCount );
+
+	for ( size_t i = 0; i < declCount; i++ ) {
+		MaterialDecl * decl = MaterialDecl::s_declsById[i];
+		assert( decl->m_id == i );
+		textureMap::iterator texIt = decl->m_textures.begin();
+		while ( texIt != decl->m_textures.end() ) {
+			const int slot = TextureSlot( texIt->first.c_str() );
+			if ( slot >= 0 && texIt->second->GetTarget() == GL_TEXTURE_2D ) {
+				s_slotTextures[ i * MATERIAL_TABLE_TEXTURES + slot ] = texIt->second;
+			}
+			texIt++;
+		}
+
+		materialSource_t & source = s_sources[i];
+		vec3Map::iterator emissive = decl->m_vec3s.find( "emissiveColor" );
+		const Vec3 emissiveColor = ( emissive != decl->m_vec3s.end() ) ? emissive->second : Vec3( 0.0f, 0.0f, 0.0f );
+		memcpy( source.emissiveColor, emissiveColor.as_ptr(), sizeof( source.emissiveColor ) );
+	}
+}
+
+/*
+================================
+MaterialTable::Update
+	-once per frame before drawing. Picks up new decls and textures that were streamed since.
+================================
+*/
+void MaterialTable::Update() {
+	if ( !s_bindless ) {
+		return;
+	}
+	if ( s_sources.size() != MaterialDecl::s_declsById.size() ) {
+		CollectTextures();
+	}
+
+	for ( size_t i = 0; i < s_slotTextures.size(); i++ ) {
+		const Texture * texture = s_slotTextures[i];
+		s_sources[ i / MATERIAL_TABLE_TEXTURES ].textureNames[ i % MATERIAL_TABLE_TEXTURES ] = ( texture != NULL ) ? texture->GetName() : 0;
+	}
+	if ( Refresh( s_sources, Texture::s_errorTexture, ResidentHandle, s_entries, s_entryNames ) > 0 ) {
+		s_dirty = true;
+	}
+}
+
+/*
+================================
+MaterialTable::SetDrawMaterials
+	-once per frame with the material of every draw command, before the first Bind
+================================
+*/
+void MaterialTable::SetDrawMaterials( const std::vector< unsigned int > & materialIds ) {
+	if ( !s_bindless ) {
+		return;
+	}
+	s_drawMaterials = materialIds;
+	s_drawMaterialsDirty = true;
+}
+
+/*
+================================
+MaterialTable::StorageBuffer
+	-fetch the buffer object from the shader. If its not present, then create and add it.
+================================
+*/
+Buffer * MaterialTable::StorageBuffer( Shader * shader, const char * blockName ) {
+	const int block_index = shader->BufferBlockIndexByName( blockName );
+	Buffer * ssbo = NULL;
+	if ( block_index == GL_INVALID_INDEX ) {
+		ssbo = ssbo->GetBuffer( blockName );
+		shader->AddBuffer( ssbo );
+	} else {
+		ssbo = shader->BufferByBlockIndex( block_index );
+	}
+	return ssbo;
+}
+
+/*
+================================
+MaterialTable::Bind
+	-once per program, binds the table to the program's material_buffer and the frame's draw
+	 materials to its draw_material_buffer
+================================
+*/
+void MaterialTable::Bind( Shader * shader ) {
+	if ( s_entries.empty() || !shader->HasStorageBlock( "material_buffer" ) ) {
+		return;
+	}
+
+	Buffer * ssbo = StorageBuffer( shader, "material_buffer" );
+	if ( s_dirty ) {
+		ssbo->Upload( s_entries.size() * sizeof( materialEntry_t ), s_entries.data() );
+		s_dirty = false;
+	}
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, ssbo->GetBindingPoint(), ssbo->GetID() );
+
+	if ( s_drawMaterials.empty() || !shader->HasStorageBlock( "draw_material_buffer" ) ) {
+		return;
+	}
+	Buffer * drawSsbo = StorageBuffer( shader, "draw_material_buffer" );
+	if ( s_drawMaterialsDirty ) {
+		drawSsbo->Upload( s_drawMaterials.size() * sizeof( unsigned int ), s_drawMaterials.data() );
+		s_drawMaterialsDirty = false;
+	}
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, drawSsbo->GetBindingPoint(), drawSsbo->GetID() );
+}
+
+/*
+================================
+MaterialTable::Clear
+	-with the decls. Their buffer goes with the programs, so the next Bind uploads everything.
+================================
+*/
+void MaterialTable::Clear() {
+	s_slotTextures.clear();
+	s_sources.clear();
+	s_entries.clear();
+	s_entryNames.clear();
+	s_dirty = true;
+	s_drawMaterials.clear();
+	s_drawMaterialsDirty = true;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef __MATERIALTABLE_H_INCLUDE__
+#define __MATERIALTABLE_H_INCLUDE__
+
+#include <vector>
+#include <stdint.h>
+
+#define MATERIAL_TABLE_TEXTURES 4
+
+class Buffer;
+class Shader;
+class Texture;
+
+//one material of material_buffer, matches the std430 layout of Material in data\shader\include\material_table.glsl: 48 bytes
+struct materialEntry_t {
+	uint64_t textures[ MATERIAL_TABLE_TEXTURES ]; //bindless handles, read as uvec2 by the shaders
+	float emissiveColor[4];
+};
+
+//what a decl puts in its entry
+struct materialSource_t {
+	unsigned int textureNames[ MATERIAL_TABLE_TEXTURES ]; //gl names by slot, 0 for slots the decl doesnt set
+	float emissiveColor[3];
+};
+
+typedef uint64_t ( *textureHandleFn_t )( const unsigned int textureName );
+
+/*
+==============================
+MaterialTable
+	-every material decl as an entry of the material_buffer storage block, indexed by the decl's
+	 m_id. Programs that read it only need the material id of a draw instead of texture binds.
+	-the material ids of the frame's draw commands are in draw_material_buffer. A vertex shader
+	 reads its command's id at firstDraw + gl_DrawIDARB. The id then differs between the draws of
+	 a multi draw, and ARB_bindless_texture alone only allows sampling through dynamically uniform
+	 handles. Multi draws only mix materials with NV_gpu_shader5, otherwise they are split at
+	 every material.
+	-textures are bindless handles. Without ARB_bindless_texture and ARB_shader_draw_parameters
+	 the shaders are built with BINDLESS_TEXTURES 0 and decls bind their textures to slots instead.
+	-streamed textures get a new gl name when their levels change. Refresh only makes handles for
+	 the slots whose name changed.
+==============================
+*/
+class MaterialTable {
+	public:
+		static int TextureSlot( const char * uniformName );
+		static unsigned int Refresh( const std::vector< materialSource_t > & sources, const unsigned int missingTextureName, textureHandleFn_t handleFn, std::vector< materialEntry_t > & entries, std::vector< unsigned int > & entryNames );
+
+		static void Init();
+		static void Update();
+		static void SetDrawMaterials( const std::vector< unsigned int > & materialIds );
+		static void Bind( Shader * shader );
+		static void Clear();
+		static unsigned int EntryCount() { return ( unsigned int )s_entries.size(); }
+
+		static bool s_supported; //ARB_bindless_texture and ARB_shader_draw_parameters
+		static bool s_bindless; //shaders are built with BINDLESS_TEXTURES, only when supported
+		static bool s_nonuniformHandles; //NV_gpu_shader5, the draws of one multi draw may sample different handles
+		static unsigned int s_residentHandles; //made resident so far
+
+	private:
+		static void CollectTextures();
+		static Buffer * StorageBuffer( Shader * shader, const char * blockName );
+
+		static std::vector< const Texture * > s_slotTextures; //MATERIAL_TABLE_TEXTURES per decl, NULL for unset slots
+		static std::vector< materialSource_t > s_sources;
+		static std::vector< materialEntry_t > s_entries;
+		static std::vector< unsigned int > s_entryNames; //gl names the handles of s_entries were made from
+		static bool s_dirty; //s_entries changed since the last upload
+		static std::vector< unsigned int > s_drawMaterials; //material id of every draw command of the frame
+		static bool s_drawMaterialsDirty;
+};
+
+#endif
\ No newline at end of file
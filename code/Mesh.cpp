@@ -1,6 +1,8 @@
 #pragma once
 #include "Mesh.h"
+#include "Scene.h"
 #include "Fileio.h"
+#include "GLRecorder.h"
 #include <assert.h>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
@@ -129,6 +131,35 @@ bool Transform::IsFlipped() {
 	return true;
 }
 
+ /*
+ ================================
+ Transform::UpdateWorldBounds
+	-transforms the 8 corners of the mesh bounds and stores the world space aabb of this instance
+ ================================
+ */
+void Transform::UpdateWorldBounds( const bbox& localBounds ) {
+	Mat4 model;
+	WorldXfrm( &model );
+
+	m_worldBounds.min = Vec3( 99999999.9, 99999999.9, 99999999.9 );
+	m_worldBounds.max = Vec3( -99999999.9, -99999999.9, -99999999.9 );
+	for ( unsigned int i = 0; i < 8; i++ ) {
+		Vec3 corner;
+		corner.x = ( i & 1 ) ? localBounds.max.x : localBounds.min.x;
+		corner.y = ( i & 2 ) ? localBounds.max.y : localBounds.min.y;
+		corner.z = ( i & 4 ) ? localBounds.max.z : localBounds.min.z;
+		corner *= model;
+		for ( unsigned int j = 0; j < 3; j++ ) {
+			if ( corner[j] < m_worldBounds.min[j] ) {
+				m_worldBounds.min[j] = corner[j];
+			}
+			if ( corner[j] > m_worldBounds.max[j] ) {
+				m_worldBounds.max[j] = corner[j];
+			}
+		}
+	}
+}
+
 /*
 ================================
 combine
@@ -293,6 +324,7 @@ bool Mesh::LoadMSHFromFile( const char * msh_relative ) {
 				std::vector<Str> splitLine = line.Split( ' ' );
 				currentSurface->VAO = 0;
 				currentSurface->materialName = splitLine[1];
+				currentSurface->declId = DECL_ID_NONE;
 				std::vector< vert_t > surfaceVerts;
 				currentSurface->verts = surfaceVerts;
 				currentSurface->vCount = atoi( splitLine[2].c_str() );
@@ -618,12 +650,12 @@ void Mesh::AddSurface() {
 		//create and init new surface
 		surface * newSurface = new surface;
 		newSurface->materialName = m_materials[ m_materials.size() - 1 ];
+		newSurface->declId = DECL_ID_NONE;
 		newSurface->verts = m_surfaceVerts;
 		newSurface->vCount = m_surfaceVerts.size();
 		newSurface->tris = m_surfaceTris;
 		newSurface->triCount = m_surfaceTris.size();
 		newSurface->VAO = 0;
-		newSurface->VAO_flipped = 0;
 
 		//Generate Mikk Tangent Space and initialize tangents for verts in newSurface
 		SMikkTSpaceInterface mikk_interface = { mikk_getNumFaces,
@@ -702,24 +734,48 @@ unsigned int Mesh::LoadVAO( const unsigned int surfaceIdx ) {
 void Mesh::DrawSurface( unsigned int surfaceIdx ) {
 	assert( surfaceIdx < m_surfaces.size() );
 
+	glBindVertexArray( Scene::getInstance()->GeometryVAO() );
+	GLRecorder::Record( GLCALL_VERTEX_ARRAY );
+
 	//draw instances with non-inverted orientations
-	if ( m_firstFlippedTransformIdx > 0 ) {
-		glBindVertexArray( m_surfaces[surfaceIdx]->VAO );
-		glDrawElementsInstanced( GL_TRIANGLES, m_surfaces[surfaceIdx]->triCount * 3, GL_UNSIGNED_INT, 0, m_firstFlippedTransformIdx );
-	}
+	DrawInstances( surfaceIdx, false );
 
 	//draw instances with inverted orientations
-	const unsigned int flippedInstanceCount = m_transforms.size() - m_firstFlippedTransformIdx;
-	if ( flippedInstanceCount > 0 ) {
-		glBindVertexArray( m_surfaces[surfaceIdx]->VAO_flipped );
+	if ( InstanceCount( true ) > 0 ) {
 		glFrontFace( GL_CW );
-		glDrawElementsInstanced( GL_TRIANGLES, m_surfaces[surfaceIdx]->triCount * 3, GL_UNSIGNED_INT, 0, flippedInstanceCount );
+		DrawInstances( surfaceIdx, true );
 		glFrontFace( GL_CCW );
 	}
 
 	glBindVertexArray( 0 );
 }
 
+/*
+ ================================
+ Mesh::DrawInstances
+	-draws the instances of one orientation. The caller binds the scene's geometry VAO and sets
+	 the front face.
+ ================================
+ */
+void Mesh::DrawInstances( const unsigned int surfaceIdx, const bool flipped ) const {
+	assert( surfaceIdx < m_surfaces.size() );
+	const drawElementsCommand_t command = IndirectDraw::MakeCommand( m_surfaces[surfaceIdx]->range, m_instances, flipped );
+	if ( command.instanceCount > 0 ) {
+		glDrawElementsInstancedBaseVertexBaseInstance( GL_TRIANGLES, command.count, GL_UNSIGNED_INT, ( void* )( command.firstIndex * sizeof( unsigned int ) ), command.instanceCount, command.baseVertex, command.baseInstance );
+		GLRecorder::Record( GLCALL_DRAW );
+	}
+}
+
+/*
+ ================================
+ Mesh::InstanceCount
+	-flipped instances are sorted after the others, starting at m_firstFlippedTransformIdx
+ ================================
+ */
+unsigned int Mesh::InstanceCount( const bool flipped ) const {
+	return flipped ? ( unsigned int )m_transforms.size() - m_firstFlippedTransformIdx : m_firstFlippedTransformIdx;
+}
+
 /*
  ================================
  Cube::Cube
@@ -730,6 +786,7 @@ Cube::Cube( Str matName ) {
 	m_surface->VAO = LoadVAO();
 	m_surface->triCount = 6; //is case of Cube, triCount is more of a quadCount
 	m_surface->materialName = matName;
+	m_surface->declId = DECL_ID_NONE;
 	if( !matName.IsEmpty() ) { //allow cubes with no materials
 		LoadDecl();
 	}
@@ -742,7 +799,6 @@ Cube::Delete
 */
 void Cube::Delete() {
 	glDeleteVertexArrays( 1, &( m_surface->VAO ) );
-	glDeleteVertexArrays( 1, &( m_surface->VAO_flipped ) );
 	delete m_surface;
 	m_surface = nullptr;
 }
@@ -757,6 +813,7 @@ bool Cube::LoadDecl() {
 	if ( matDecl == NULL ) {
 		return false;
 	}
+	m_surface->declId = matDecl->m_id;
 	if( matDecl->CompileShader() ) {
 		matDecl->BindTextures();
 	} else {
@@ -830,6 +887,7 @@ void Cube::DrawSurface( bool flip ) const {
 	}
 	glBindVertexArray( m_surface->VAO );
 	glDrawArrays( GL_QUADS, 0, m_surface->triCount * 4 );
+	GLRecorder::Record( GLCALL_DRAW );
 	glBindVertexArray( 0 );
 	glFrontFace( GL_CCW );
 }
@@ -6,9 +6,7 @@
 #include "Vector.h"
 #include "Matrix.h"
 #include "Decl.h"
-
-class EnvProbe;
-
+#include "IndirectDraw.h"
 
 struct tri_t {
 	unsigned int a;
@@ -26,8 +24,10 @@ struct vert_t {
 };
 
 struct surface {
-	unsigned int VAO, VAO_flipped;
+	unsigned int VAO; //only for meshes outside the scene, scene surfaces are drawn from the scene's merged buffers
+	geometryRange_t range; //in the scene's merged buffers, set when the scene loads
 	Str materialName;
+	unsigned int declId; //MaterialDecl::m_id of materialName, resolved when the scene loads. DECL_ID_NONE until then.
 	std::vector< vert_t > verts;
 	unsigned int vCount;
 	std::vector< tri_t > tris;
@@ -37,6 +37,12 @@ struct surface {
 struct bbox {
 	Vec3 min;
 	Vec3 max;
+
+	bool Intersects( const bbox& other ) const {
+		return ( min.x <= other.max.x && max.x >= other.min.x ) &&
+			   ( min.y <= other.max.y && max.y >= other.min.y ) &&
+			   ( min.z <= other.max.z && max.z >= other.min.z );
+	}
 };
 
 /*
@@ -46,20 +52,29 @@ Transform
 */
 class Transform {
 	public:
-		Transform() {};
+		Transform() { m_moved = true; };
 		~Transform() {};
 
-		void SetPosition( Vec3 pos ) { m_position = pos; }
-		void SetRotation( Mat3 rot ) { m_rotation = rot; }
-		void SetScale( Vec3 scl ) { m_scale = scl; }
+		void SetPosition( Vec3 pos ) { m_position = pos; m_moved = true; }
+		void SetRotation( Mat3 rot ) { m_rotation = rot; m_moved = true; }
+		void SetScale( Vec3 scl ) { m_scale = scl; m_moved = true; }
 		bool WorldXfrm( Mat4* model );
 		bool IsFlipped();
 
+		//moved flag is raised by the setters and cleared by the scene once shadows have been invalidated
+		const bool HasMoved() const { return m_moved; }
+		void ClearMoved() { m_moved = false; }
+
+		void UpdateWorldBounds( const bbox& localBounds );
+		const bbox& GetWorldBounds() const { return m_worldBounds; }
+
 	private:
 		Vec3 m_position;
 		Mat3 m_rotation;
 		Vec3 m_scale;
 		Mat4 m_xfrm;
+		bbox m_worldBounds;
+		bool m_moved;
 };
 
 /*
@@ -69,13 +84,15 @@ Mesh
 */
 class Mesh {
 	public:
-		Mesh() { m_probe = NULL; m_firstFlippedTransformIdx = 0; };
+		Mesh() { m_firstFlippedTransformIdx = 0; m_instances.firstInstance = 0; m_instances.instanceCount = 0; m_instances.firstFlipped = 0; };
 		~Mesh() {};
 		void Delete();
 
 		bool LoadMSHFromFile( const char * msh_relative );
 		bool LoadOBJFromFile( const char * obj_relative );
 		void DrawSurface( unsigned int surfaceIdx );
+		void DrawInstances( const unsigned int surfaceIdx, const bool flipped ) const;
+		unsigned int InstanceCount( const bool flipped ) const;
 		unsigned int LoadVAO( const unsigned int surfaceIdx );
 				
 		Str m_name;
@@ -83,21 +100,17 @@ class Mesh {
 		const bbox& GetBounds() { return m_bounds; }
 		const Vec3 GetCenter() { return ( m_bounds.max + m_bounds.min ) / 2.0f; }
 
-		const EnvProbe * GetProbe() const { return m_probe; }
-		void SetProbe( EnvProbe * probe ) { m_probe = probe; }
-
 		std::vector< surface* > m_surfaces; //geometry data for mesh.
 		std::vector< Str > m_materials; //list of materials used in mesh
 		std::vector< Transform * > m_transforms; //each entry is an instance of this mesh with unique transforms
 		unsigned int m_firstFlippedTransformIdx;
+		instanceRange_t m_instances; //in the scene's merged instance buffers, set when the scene loads
 
 	private:
 		void AddSurface();
 
 		bbox m_bounds;
 
-		EnvProbe * m_probe;
-
 		std::vector< vert_t > m_surfaceVerts; //the vertices of the surface being loaded
 		std::vector< tri_t > m_surfaceTris; //vert indexes (every 3 represents a triangle) of the surface being loaded
 		std::vector< unsigned int > m_surfaceVIDs; //unique id numbers for each vertex for the currently loading surface
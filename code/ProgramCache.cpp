@@ -0,0 +1,143 @@
+#include "ProgramCache.h"
+#include "BuildManifest.h"
+#include "Fileio.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#define PROGRAM_CACHE_MAGIC		0x43475250 //PRGC
+#define PROGRAM_CACHE_VERSION	1
+
+struct programCacheHeader_t {
+	uint32_t magic;
+	uint32_t version;
+	programKey_t key;
+	uint32_t format;
+	uint32_t size; //bytes of binary following the header
+	uint64_t dataHash; //catches entries cut short or damaged on disk
+};
+
+bool ProgramCache::s_enabled = true;
+unsigned int ProgramCache::s_hits = 0;
+unsigned int ProgramCache::s_misses = 0;
+double ProgramCache::s_loadSeconds = 0.0;
+
+/*
+================================
+ProgramCache::MakeKey
+	-the stage types are hashed with the sources so that the same text used for a different
+	 stage doesnt share an entry
+================================
+*/
+programKey_t ProgramCache::MakeKey( const unsigned int stageCount, const unsigned int * stageTypes, const char * const * sources, const char * vendor, const char * renderer, const char * version ) {
+	programKey_t key;
+	key.sourceHash = BuildManifest::HashBytes( &stageCount, sizeof( stageCount ) );
+	for ( unsigned int i = 0; i < stageCount; i++ ) {
+		const uint64_t length = strlen( sources[i] );
+		key.sourceHash = BuildManifest::HashBytes( &stageTypes[i], sizeof( stageTypes[i] ), key.sourceHash );
+		key.sourceHash = BuildManifest::HashBytes( &length, sizeof( length ), key.sourceHash );
+		key.sourceHash = BuildManifest::HashBytes( sources[i], ( size_t )length, key.sourceHash );
+	}
+
+	//the terminators keep "ab" + "c" and "a" + "bc" apart
+	key.vendorHash = BuildManifest::HashBytes( vendor, strlen( vendor ) + 1 );
+	key.vendorHash = BuildManifest::HashBytes( renderer, strlen( renderer ) + 1, key.vendorHash );
+	key.driverHash = BuildManifest::HashBytes( version, strlen( version ) + 1 );
+	return key;
+}
+
+/*
+================================
+ProgramCache::EntryPath
+	-permutations of a prefix get their own entries, named by a hash of their defines
+================================
+*/
+std::string ProgramCache::EntryPath( const char * sprefix, const char * permutation ) {
+	if ( permutation == NULL || permutation[0] == '\0' ) {
+		return "data\\generated\\shader\\" + std::string( sprefix ) + ".bin";
+	}
+	char suffix[32];
+	sprintf( suffix, "_%016llx.bin", ( unsigned long long )BuildManifest::HashBytes( permutation, strlen( permutation ) ) );
+	return "data\\generated\\shader\\" + std::string( sprefix ) + suffix;
+}
+
+/*
+================================
+ProgramCache::Read
+	-false if there is no entry, it was made from other sources or by another driver, or it is damaged
+================================
+*/
+bool ProgramCache::Read( const char * relativePath, const programKey_t & key, programBinary_t & binary ) {
+	mappedFile_t file;
+	if ( !MapFile( relativePath, file ) ) {
+		return false;
+	}
+
+	bool valid = false;
+	programCacheHeader_t header;
+	if ( file.size >= sizeof( header ) ) {
+		memcpy( &header, file.data, sizeof( header ) );
+		valid = header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION &&
+				header.key.sourceHash == key.sourceHash && header.key.vendorHash == key.vendorHash && header.key.driverHash == key.driverHash &&
+				header.size > 0 && file.size == sizeof( header ) + header.size &&
+				BuildManifest::HashBytes( file.data + sizeof( header ), header.size ) == header.dataHash;
+	}
+	if ( valid ) {
+		binary.format = header.format;
+		binary.data.assign( file.data + sizeof( header ), file.data + file.size );
+	}
+	UnmapFile( file );
+	return valid;
+}
+
+/*
+================================
+ProgramCache::Write
+	-writes to a temporary file and renames it over the entry, so a crash never leaves a partial entry
+================================
+*/
+bool ProgramCache::Write( const char * relativePath, const programKey_t & key, const programBinary_t & binary ) {
+	if ( binary.data.empty() ) {
+		return false;
+	}
+
+	programCacheHeader_t header;
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.format = binary.format;
+	header.size = ( uint32_t )binary.data.size();
+	header.dataHash = BuildManifest::HashBytes( binary.data.data(), binary.data.size() );
+
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativePath, fullPath );
+
+	//make the directory of the entry
+	std::string directory( relativePath );
+	const size_t slash = directory.find_last_of( "\\/" );
+	if ( slash != std::string::npos ) {
+		directory.erase( slash + 1 );
+		if ( dirExists( directory.c_str() ) == false ) {
+			makeDir( directory.c_str() );
+		}
+	}
+
+	char tempPath[ 2048 + 32 ];
+	sprintf( tempPath, "%s.%lu.tmp", fullPath, GetCurrentProcessId() );
+	FILE * fs = fopen( tempPath, "wb" );
+	if ( !fs ) {
+		printf( "Failed to write program cache entry: %s\n", tempPath );
+		return false;
+	}
+	fwrite( &header, sizeof( header ), 1, fs );
+	fwrite( binary.data.data(), 1, binary.data.size(), fs );
+	const bool writeFailed = ( ferror( fs ) != 0 );
+	fclose( fs );
+	if ( writeFailed || MoveFileExA( tempPath, fullPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) == 0 ) {
+		printf( "Failed to write program cache entry: %s\n", fullPath );
+		DeleteFileA( tempPath );
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
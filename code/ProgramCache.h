@@ -0,0 +1,43 @@
+#pragma once
+#ifndef __PROGRAMCACHE_H_INCLUDE__
+#define __PROGRAMCACHE_H_INCLUDE__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct programKey_t {
+	uint64_t sourceHash; //stage types and sources of every stage, in link order
+	uint64_t vendorHash; //GL_VENDOR and GL_RENDERER
+	uint64_t driverHash; //GL_VERSION, drivers put their version in it
+};
+
+struct programBinary_t {
+	programBinary_t() { format = 0; }
+	unsigned int format; //as returned by glGetProgramBinary
+	std::vector< uint8_t > data;
+};
+
+/*
+==============================
+ProgramCache
+	-disk cache of linked program binaries in data\generated\shader\, one entry per shader prefix.
+	-an entry is only used when the sources, the vendor and the driver version it was made with
+	 all still match. Anything else is a miss, the program is compiled from source and the entry
+	 is written again.
+==============================
+*/
+class ProgramCache {
+	public:
+		static programKey_t MakeKey( const unsigned int stageCount, const unsigned int * stageTypes, const char * const * sources, const char * vendor, const char * renderer, const char * version );
+		static std::string EntryPath( const char * sprefix, const char * permutation );
+		static bool Read( const char * relativePath, const programKey_t & key, programBinary_t & binary );
+		static bool Write( const char * relativePath, const programKey_t & key, const programBinary_t & binary );
+
+		static bool s_enabled;
+		static unsigned int s_hits;
+		static unsigned int s_misses;
+		static double s_loadSeconds; //spent in Shader::LoadShader, on hits and misses
+};
+
+#endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Scene.h"
 #include "Fileio.h"
+#include "GLRecorder.h"
 
 /*
 ================================
@@ -42,6 +43,23 @@ bool Scene::MeshByIndex( unsigned int index, Mesh ** obj ) {
 	return true;
 }
 
+/*
+================================
+Scene::InstancedTriangleCount
+	-number of triangles submitted when every surface of every instance is drawn once
+================================
+*/
+const unsigned int Scene::InstancedTriangleCount() const {
+	unsigned int triCount = 0;
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		const Mesh * mesh = m_meshes[i];
+		for ( unsigned int j = 0; j < mesh->m_surfaces.size(); j++ ) {
+			triCount += mesh->m_surfaces[j]->triCount * mesh->m_transforms.size();
+		}
+	}
+	return triCount;
+}
+
 /*
 ================================
 Scene::AddLight
@@ -306,7 +324,7 @@ bool Scene::LoadFromFile( const char * scn_relative ) {
 	fclose( fp );
 
 	//pass models and instances to the GPU
-	LoadVAOs();
+	LoadGeometry();
 
 	//build shadowmap atlas for shadowcasting lights
 	Light::InitShadowAtlas();
@@ -328,22 +346,34 @@ void Scene::Unload() {
 		Mesh * currentMesh;
 		MeshByIndex( i, &currentMesh );
 
-		//delete all VAOs for current mesh
-		const unsigned int flippedInstanceCount = currentMesh->m_transforms.size() - currentMesh->m_firstFlippedTransformIdx;
-		for ( unsigned int i = 0; i < currentMesh->m_surfaces.size(); i++ ) {
-			surface * currentSurface = currentMesh->m_surfaces[ i ];
-			glDeleteVertexArrays( 1, &( currentSurface->VAO ) );			
-			if ( flippedInstanceCount > 0 ) {
-				glDeleteVertexArrays( 1, &( currentSurface->VAO_flipped ) );
-			}
-		}
-
 		currentMesh->Delete();
 		delete currentMesh;
 		currentMesh = nullptr;
 	}
 	m_meshCount = 0;
 
+	//unload merged geometry
+	glDeleteVertexArrays( 1, &m_geometryVAO );
+	glDeleteBuffers( 1, &m_vertexBuffer );
+	glDeleteBuffers( 1, &m_indexBuffer );
+	glDeleteBuffers( 1, &m_instanceBuffer );
+	glDeleteBuffers( 1, &m_probeIndexBuffer );
+	glDeleteBuffers( 1, &m_passIndirectBuffer );
+	glDeleteBuffers( 1, &m_frameIndirectBuffer );
+	m_geometryVAO = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_instanceBuffer = 0;
+	m_probeIndexBuffer = 0;
+	m_passIndirectBuffer = 0;
+	m_frameIndirectBuffer = 0;
+	m_frameIndirectSize = 0;
+	m_indirectScene.surfaces.clear();
+	m_indirectScene.meshFirstSurface.clear();
+	m_indirectScene.meshInstances.clear();
+	m_passCommands.clear();
+	m_passBatches.clear();
+
 	//unload light resources
 	for ( unsigned int i = 0; i < m_lightCount; i++ ) {
 		Light * currentLight;
@@ -360,11 +390,11 @@ void Scene::Unload() {
 	for ( unsigned int i = 0; i < m_envProbeCount; i++ ) {
 		EnvProbe * currentProbe;
 		EnvProbeByIndex( i, &currentProbe );
-		currentProbe->Delete();
 		delete currentProbe;
 		currentProbe = nullptr;
 	}
 	m_envProbeCount = 0;
+	EnvProbe::DeleteArrays();
 
 	//unload skybox
 	if ( m_skybox != NULL ) {
@@ -376,29 +406,86 @@ void Scene::Unload() {
 
 /*
 ================================
-Scene::CreateVAO
+Scene::LoadGeometry
+	-merges the surfaces of every mesh into one vertex and index buffer, and the instances of
+	 every mesh into one transform and probe index buffer. m_geometryVAO reads all of them, a
+	 draw selects its surface with firstIndex and baseVertex and its instances with baseInstance.
 ================================
 */
-const unsigned int Scene::CreateVAO( const surface * s, const unsigned int transformCount, const float * transforms ) const {
-	//create VAO to bind/configure the corresponding VBO(s) and attribute pointer(s)
-	unsigned int VAO, VBO, EBO;
-	glGenVertexArrays( 1, &VAO );
-	glGenBuffers( 1, &VBO );
-	glGenBuffers( 1, &EBO );	
-	
-	//put openGL in the state to bind/configure the VAO FIRST
-	glBindVertexArray( VAO );
+void Scene::LoadGeometry() {
+	std::vector< unsigned int > vertexCounts;
+	std::vector< unsigned int > indexCounts;
+	std::vector< unsigned int > instanceCounts;
+	std::vector< unsigned int > flippedCounts;
+	m_indirectScene.meshFirstSurface.clear();
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		Mesh * currentMesh = m_meshes[i];
+
+		//sort the list of transforms so that flipped transforms are at the end of the list
+		const unsigned int instanceCount = currentMesh->m_transforms.size();
+		int end = instanceCount - 1;
+		int n = 0;
+		while( n <= end ) {
+			Transform * currentTransform = currentMesh->m_transforms[n];
+			if ( currentTransform->IsFlipped() ) {
+				for ( int m = end; m >= n; m-- ) {
+					end = m - 1;
+
+					Transform * switchTransform = currentMesh->m_transforms[m];
+					if ( !switchTransform->IsFlipped() ) {
+						//swap n and m
+						Transform * temp = currentMesh->m_transforms[n];
+						currentMesh->m_transforms[n] = currentMesh->m_transforms[m];
+						currentMesh->m_transforms[m] = temp;						
+						break;
+					}
+				}
+			}
+			n += 1;
+		}
+		const unsigned int flippedStartIndex = end + 1;
+		currentMesh->m_firstFlippedTransformIdx = flippedStartIndex;
+		instanceCounts.push_back( instanceCount );
+		flippedCounts.push_back( instanceCount - flippedStartIndex );
+
+		m_indirectScene.meshFirstSurface.push_back( ( unsigned int )vertexCounts.size() );
+		for ( unsigned int j = 0; j < currentMesh->m_surfaces.size(); j++ ) {
+			vertexCounts.push_back( currentMesh->m_surfaces[j]->vCount );
+			indexCounts.push_back( currentMesh->m_surfaces[j]->triCount * 3 );
+		}
+	}
 
-	//create BVO
-	glBindBuffer( GL_ARRAY_BUFFER, VBO ); //bind it to GL_ARRAY_BUFFER target. This effectively sets the buffer type.
-	glBufferData( GL_ARRAY_BUFFER, s->vCount * sizeof( vert_t ), &s->verts[0], GL_STATIC_DRAW ); //load vert data into it as static data (wont change)
+	unsigned int totalVertices = 0;
+	unsigned int totalIndices = 0;
+	unsigned int totalInstances = 0;
+	IndirectDraw::LayoutGeometry( vertexCounts, indexCounts, m_indirectScene.surfaces, &totalVertices, &totalIndices );
+	IndirectDraw::LayoutInstances( instanceCounts, flippedCounts, m_indirectScene.meshInstances, &totalInstances );
 
-	//create EBO for indexed drawing of tris
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, EBO );
-	glBufferData( GL_ELEMENT_ARRAY_BUFFER, s->triCount * sizeof( tri_t ), &s->tris[0], GL_STATIC_DRAW );
+	//put openGL in the state to bind/configure the VAO FIRST
+	glGenVertexArrays( 1, &m_geometryVAO );
+	glBindVertexArray( m_geometryVAO );
+
+	//vertices and tris of every surface, the tris keep their surface relative indices
+	glGenBuffers( 1, &m_vertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, m_vertexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, totalVertices * sizeof( vert_t ), NULL, GL_STATIC_DRAW );
+	glGenBuffers( 1, &m_indexBuffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, totalIndices * sizeof( unsigned int ), NULL, GL_STATIC_DRAW );
+	unsigned int surfaceIdx = 0;
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		Mesh * currentMesh = m_meshes[i];
+		for ( unsigned int j = 0; j < currentMesh->m_surfaces.size(); j++ ) {
+			surface * currentSurface = currentMesh->m_surfaces[j];
+			currentSurface->range = m_indirectScene.surfaces[ surfaceIdx ];
+			if ( currentSurface->vCount > 0 && currentSurface->triCount > 0 ) {
+				glBufferSubData( GL_ARRAY_BUFFER, currentSurface->range.baseVertex * sizeof( vert_t ), currentSurface->vCount * sizeof( vert_t ), &currentSurface->verts[0] );
+				glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, currentSurface->range.firstIndex * sizeof( unsigned int ), currentSurface->triCount * sizeof( tri_t ), &currentSurface->tris[0] );
+			}
+			surfaceIdx++;
+		}
+	}
 
-	//Each vertex attribute takes its data from memory managed by a VBO.
-	//Since the previously defined VBO is still bound before calling glVertexAttribPointer vertex attribute 0 is now associated with its(the VBOs) vertex data.
 	glEnableVertexAttribArray( 0 );
 	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( vert_t ), ( void* )0 ); //position
 	glEnableVertexAttribArray( 1 );
@@ -410,13 +497,20 @@ const unsigned int Scene::CreateVAO( const surface * s, const unsigned int trans
 	glEnableVertexAttribArray( 4 );
 	glVertexAttribPointer( 4, 1, GL_FLOAT, GL_FALSE, sizeof( vert_t ), ( void* )offsetof( vert_t, tSign ) ); //fSign
 
-	//configure instanced array
-	unsigned int transfomrBuffer;
-	glGenBuffers( 1, &transfomrBuffer );
-	glBindBuffer( GL_ARRAY_BUFFER, transfomrBuffer );
-	glBufferData( GL_ARRAY_BUFFER, transformCount * sizeof( Mat4 ), transforms, GL_STATIC_DRAW );
+	//transforms of every instance
+	std::vector< Mat4 > instanceXfrms( totalInstances );
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		Mesh * currentMesh = m_meshes[i];
+		currentMesh->m_instances = m_indirectScene.meshInstances[i];
+		for ( unsigned int j = 0; j < currentMesh->m_transforms.size(); j++ ) {
+			currentMesh->m_transforms[j]->WorldXfrm( &instanceXfrms[ currentMesh->m_instances.firstInstance + j ] );
+		}
+	}
+	glGenBuffers( 1, &m_instanceBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, m_instanceBuffer );
+	glBufferData( GL_ARRAY_BUFFER, totalInstances * sizeof( Mat4 ), instanceXfrms.data(), GL_STATIC_DRAW );
 
-	//set transformation matrices as an instance vertex attribute for the currently bound VAO
+	//use divisor 1 cuz we want to update the content of the vertex attribute when we start to render a new instance
 	glEnableVertexAttribArray( 5 );
 	glVertexAttribPointer( 5, 4, GL_FLOAT, GL_FALSE, sizeof( Mat4 ), ( void* )0 );
 	glEnableVertexAttribArray( 6 );
@@ -425,80 +519,174 @@ const unsigned int Scene::CreateVAO( const surface * s, const unsigned int trans
 	glVertexAttribPointer( 7, 4, GL_FLOAT, GL_FALSE, sizeof( Mat4 ), ( void* )( 2 * sizeof( Vec4 ) ) );
 	glEnableVertexAttribArray( 8 );
 	glVertexAttribPointer( 8, 4, GL_FLOAT, GL_FALSE, sizeof( Mat4 ), ( void* )( 3 * sizeof( Vec4 ) ) );
-
-	//use divisor 1 cuz we want to update the content of the vertex attribute when we start to render a new instance
 	glVertexAttribDivisor( 5, 1 );
 	glVertexAttribDivisor( 6, 1 );
 	glVertexAttribDivisor( 7, 1 );
 	glVertexAttribDivisor( 8, 1 );
 
+	//every instance uses probe 0 until BuildProbes assigns the nearest one
+	const std::vector< unsigned int > probeIndices( totalInstances, 0 );
+	glGenBuffers( 1, &m_probeIndexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, m_probeIndexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, totalInstances * sizeof( unsigned int ), probeIndices.data(), GL_STATIC_DRAW );
+	glEnableVertexAttribArray( 9 );
+	glVertexAttribIPointer( 9, 1, GL_UNSIGNED_INT, sizeof( unsigned int ), ( void* )0 );
+	glVertexAttribDivisor( 9, 1 );
+
 	//unbind VBO, EBO, and VAO
 	glBindBuffer( GL_ARRAY_BUFFER, 0 );
 	glBindVertexArray( 0 );
 	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
 
-	glDeleteBuffers( 1, &VBO );
-	glDeleteBuffers( 1, &EBO );
+	//the commands of passes that draw the whole scene only change when the scene does
+	IndirectDraw::BuildPassCommands( m_indirectScene, m_passCommands, m_passBatches );
+	glGenBuffers( 1, &m_passIndirectBuffer );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, m_passIndirectBuffer );
+	glBufferData( GL_DRAW_INDIRECT_BUFFER, m_passCommands.size() * sizeof( drawElementsCommand_t ), m_passCommands.data(), GL_STATIC_DRAW );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
 
-	return VAO;
+	//cache world bounds of every instance. Lights start out dirty so the moved flags can be dropped here.
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		Mesh * currentMesh = m_meshes[i];
+		for ( unsigned int j = 0; j < currentMesh->m_transforms.size(); j++ ) {
+			Transform * currentTransform = currentMesh->m_transforms[j];
+			currentTransform->UpdateWorldBounds( currentMesh->GetBounds() );
+			currentTransform->ClearMoved();
+		}
+	}
 }
 
 /*
 ================================
-Scene::LoadVAOs
+Scene::UploadFrameCommands
+	-commands of the main pass, the buffer is only reallocated when it has to grow
 ================================
 */
-void Scene::LoadVAOs() {
-	for ( int i = 0; i < MeshCount(); i++ ) {
-		Mesh * currentMesh = MeshByIndex( i );
+void Scene::UploadFrameCommands( const std::vector< drawElementsCommand_t > & commands ) {
+	if ( !IndirectDraw::s_enabled || commands.empty() ) {
+		return;
+	}
+	if ( m_frameIndirectBuffer == 0 ) {
+		glGenBuffers( 1, &m_frameIndirectBuffer );
+	}
 
-		//sort the list of transforms so that flipped transforms are at the end of the list
-		const unsigned int instanceCount = currentMesh->m_transforms.size();
-		int end = instanceCount - 1;
-		int n = 0;
-		while( n <= end ) {
-			Transform * currentTransform = currentMesh->m_transforms[n];
-			if ( currentTransform->IsFlipped() ) {
-				for ( int m = end; m >= n; m-- ) {
-					end = m - 1;
+	const unsigned int size = ( unsigned int )( commands.size() * sizeof( drawElementsCommand_t ) );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, m_frameIndirectBuffer );
+	if ( size > m_frameIndirectSize ) {
+		glBufferData( GL_DRAW_INDIRECT_BUFFER, size, commands.data(), GL_DYNAMIC_DRAW );
+		m_frameIndirectSize = size;
+	} else {
+		glBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, size, commands.data() );
+	}
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
 
-					Transform * switchTransform = currentMesh->m_transforms[m];
-					if ( !switchTransform->IsFlipped() ) {
-						//swap n and m
-						Transform * temp = currentMesh->m_transforms[n];
-						currentMesh->m_transforms[n] = currentMesh->m_transforms[m];
-						currentMesh->m_transforms[m] = temp;						
-						break;
-					}
-				}
-			}
-			n += 1;
-		}
-		const unsigned int flippedStartIndex = end + 1;
-		const unsigned int flippedCount = instanceCount - flippedStartIndex;
-		currentMesh->m_firstFlippedTransformIdx = flippedStartIndex;
+/*
+================================
+Scene::BindGeometry
+	-binds the merged geometry and the commands batches are drawn from, the frame's or the ones
+	 of passes that draw the whole scene
+================================
+*/
+void Scene::BindGeometry( const bool frameCommands ) const {
+	glBindVertexArray( m_geometryVAO );
+	GLRecorder::Record( GLCALL_VERTEX_ARRAY );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, frameCommands ? m_frameIndirectBuffer : m_passIndirectBuffer );
+}
 
-		//build list of transforms for each instance		
-		Mat4* instanceXfrms;
-		instanceXfrms = new Mat4[instanceCount];
-		for ( unsigned int j = 0; j < instanceCount; j++ ) {
-			Transform * currentTransform = currentMesh->m_transforms[j];
-			Mat4 newXfrm;
-			currentTransform->WorldXfrm( &newXfrm );
-			instanceXfrms[j] = newXfrm;
-		}
+/*
+================================
+Scene::DrawBatch
+	-one multi draw for the batch, or a draw per command when multi draw indirect is off. The
+	 caller binds the geometry and sets the front face.
+================================
+*/
+void Scene::DrawBatch( const std::vector< drawElementsCommand_t > & commands, const indirectBatch_t & batch ) const {
+	if ( IndirectDraw::s_enabled ) {
+		glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, ( void* )( batch.firstCommand * sizeof( drawElementsCommand_t ) ), batch.commandCount, 0 );
+		GLRecorder::Record( GLCALL_DRAW );
+		return;
+	}
 
-		//pass each surface (one instance per transform) to the GPU
-		for ( unsigned int j = 0; j < currentMesh->m_surfaces.size(); j++ ) {
-			surface * currentSurface = currentMesh->m_surfaces[j];
-			currentSurface->VAO = CreateVAO( currentSurface, flippedStartIndex, instanceXfrms[0].as_ptr() );
-			if ( flippedCount > 0 ) {
-				currentSurface->VAO_flipped = CreateVAO( currentSurface, flippedCount, instanceXfrms[flippedStartIndex].as_ptr() );
+	for ( unsigned int i = 0; i < batch.commandCount; i++ ) {
+		const drawElementsCommand_t & command = commands[ batch.firstCommand + i ];
+		glDrawElementsInstancedBaseVertexBaseInstance( GL_TRIANGLES, command.count, GL_UNSIGNED_INT, ( void* )( command.firstIndex * sizeof( unsigned int ) ), command.instanceCount, command.baseVertex, command.baseInstance );
+		GLRecorder::Record( GLCALL_DRAW );
+	}
+}
+
+/*
+================================
+Scene::DrawAll
+	-every surface of every instance with the bound program, for passes without materials
+================================
+*/
+void Scene::DrawAll() const {
+	BindGeometry( false );
+	for ( unsigned int i = 0; i < m_passBatches.size(); i++ ) {
+		const indirectBatch_t & batch = m_passBatches[i];
+		glFrontFace( batch.flipped ? GL_CW : GL_CCW );
+		DrawBatch( m_passCommands, batch );
+	}
+	glFrontFace( GL_CCW );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+	glBindVertexArray( 0 );
+}
+
+/*
+================================
+Scene::UpdateInstanceBuffers
+	-re-uploads the instance transforms of a mesh. Flipped instances must stay flipped.
+================================
+*/
+void Scene::UpdateInstanceBuffers( Mesh * mesh ) {
+	const unsigned int instanceCount = mesh->m_transforms.size();
+	const unsigned int flippedStartIndex = mesh->m_firstFlippedTransformIdx;
+
+	Mat4* instanceXfrms;
+	instanceXfrms = new Mat4[instanceCount];
+	for ( unsigned int i = 0; i < instanceCount; i++ ) {
+		Transform * currentTransform = mesh->m_transforms[i];
+		assert( currentTransform->IsFlipped() == ( i >= flippedStartIndex ) );
+		currentTransform->WorldXfrm( &instanceXfrms[i] );
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, m_instanceBuffer );
+	glBufferSubData( GL_ARRAY_BUFFER, mesh->m_instances.firstInstance * sizeof( Mat4 ), instanceCount * sizeof( Mat4 ), instanceXfrms[0].as_ptr() );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	delete[] instanceXfrms;
+	instanceXfrms = nullptr;
+}
+
+/*
+================================
+Scene::UpdateMovedInstances
+	-gathers the world bounds of every instance that moved since the last call. Both the old and the new bounds
+	 are added so that shadows are invalidated where the instance was and where it is now.
+	-the instance buffers of meshes with moved instances are re-uploaded
+================================
+*/
+void Scene::UpdateMovedInstances( std::vector< bbox >& movedBounds ) {
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		Mesh * mesh = m_meshes[i];
+
+		bool meshMoved = false;
+		for ( unsigned int j = 0; j < mesh->m_transforms.size(); j++ ) {
+			Transform * currentTransform = mesh->m_transforms[j];
+			if ( !currentTransform->HasMoved() ) {
+				continue;
 			}
+			movedBounds.push_back( currentTransform->GetWorldBounds() );
+			currentTransform->UpdateWorldBounds( mesh->GetBounds() );
+			movedBounds.push_back( currentTransform->GetWorldBounds() );
+			currentTransform->ClearMoved();
+			meshMoved = true;
 		}
 
-		delete[] instanceXfrms;
-		instanceXfrms = nullptr;
+		if ( meshMoved ) {
+			UpdateInstanceBuffers( mesh );
+		}
 	}
 }
 
@@ -506,7 +694,8 @@ void Scene::LoadVAOs() {
 ================================
 Scene::BuildProbes
 	-associate all meshes with one envProbe via the EnvProbe::AddMesh function.
-	-call EnvProbe::BuildProbe function.
+	-every instance gets the index of its nearest envProbe, which selects its layer of the probe arrays
+	-call EnvProbe::BuildProbe function, then pack the cubemaps of all probes into the probe arrays.
 ================================
 */
 void Scene::BuildProbes() {
@@ -515,31 +704,43 @@ void Scene::BuildProbes() {
 		m_envProbes[ m_envProbeCount - 1 ] = new EnvProbe();
 	}
 
+	std::vector< Vec3 > probePositions( m_envProbeCount );
+	for ( unsigned int i = 0; i < m_envProbeCount; i++ ) {
+		probePositions[i] = m_envProbes[i]->GetPosition();
+	}
+
 	//associate all meshes with one envProbe
+	std::vector< Vec3 > meshCenters( m_meshCount );
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		meshCenters[i] = m_meshes[i]->GetCenter();
+	}
+	std::vector< unsigned int > nearestProbes;
+	EnvProbe::AssignNearestProbes( meshCenters, probePositions, nearestProbes );
+	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
+		m_envProbes[ nearestProbes[i] ]->AddMesh( m_meshes[i] );
+	}
+
+	//instances of one mesh may be far apart, so each instance uses the probe nearest to its own bounds
 	for ( unsigned int i = 0; i < m_meshCount; i++ ) {
 		Mesh * mesh = m_meshes[i];
 
-		const bbox meshBounds = mesh->GetBounds();
-		const Vec3 meshCenter = ( meshBounds.min + meshBounds.max ) / 2.0f;
-
-		unsigned int nearestProbeIdx = 0;
-		float minDist = 99999999.0;
-		for ( unsigned int j = nearestProbeIdx; j < m_envProbeCount; j++ ) {
-			EnvProbe * probe = m_envProbes[j];
-			const float dist = ( meshCenter - probe->GetPosition() ).length();
-			if ( dist < minDist ) {
-				minDist = dist;
-				nearestProbeIdx = j;
-			}
+		std::vector< Vec3 > instanceCenters( mesh->m_transforms.size() );
+		for ( unsigned int j = 0; j < mesh->m_transforms.size(); j++ ) {
+			const bbox & worldBounds = mesh->m_transforms[j]->GetWorldBounds();
+			instanceCenters[j] = ( worldBounds.min + worldBounds.max ) / 2.0f;
+		}
+		EnvProbe::AssignNearestProbes( instanceCenters, probePositions, nearestProbes );
+		if ( !nearestProbes.empty() ) {
+			glBindBuffer( GL_ARRAY_BUFFER, m_probeIndexBuffer );
+			glBufferSubData( GL_ARRAY_BUFFER, mesh->m_instances.firstInstance * sizeof( unsigned int ), nearestProbes.size() * sizeof( unsigned int ), nearestProbes.data() );
 		}
-		EnvProbe * nearestProbe = m_envProbes[nearestProbeIdx];
-		nearestProbe->AddMesh( mesh );
-		mesh->SetProbe( nearestProbe );
 	}
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
 
-	//call EnvProbe::BuildProbe function which fetches env and irradiance cubemap images and generates specular mips.
+	//call EnvProbe::BuildProbe function which finds the cubemap files and loads the irradiance SH of each probe.
 	for ( unsigned int i = 0; i < m_envProbeCount; i++ ) {
 		EnvProbe * probe = m_envProbes[i];
 		probe->BuildProbe( i );
 	}
+	EnvProbe::BuildArrays( m_envProbes, m_envProbeCount );
 }
\ No newline at end of file
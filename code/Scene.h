@@ -28,6 +28,7 @@ class Scene {
 		int MeshCount() const { return m_meshCount; }
 		bool MeshByIndex( unsigned int index, Mesh ** obj );
 		Mesh * MeshByIndex( unsigned int index );
+		const unsigned int InstancedTriangleCount() const;
 
 		const unsigned int AddLight( Light * newLight );
 		int LightCount() { return m_lightCount; }
@@ -36,6 +37,16 @@ class Scene {
 		int EnvProbeCount() { return m_envProbeCount; }
 		bool EnvProbeByIndex( unsigned int index, EnvProbe ** obj );
 
+		void UpdateMovedInstances( std::vector< bbox >& movedBounds );
+
+		//merged geometry of every mesh, see IndirectDraw
+		unsigned int GeometryVAO() const { return m_geometryVAO; }
+		const indirectScene_t & GetIndirectScene() const { return m_indirectScene; }
+		void UploadFrameCommands( const std::vector< drawElementsCommand_t > & commands );
+		void BindGeometry( const bool frameCommands ) const;
+		void DrawBatch( const std::vector< drawElementsCommand_t > & commands, const indirectBatch_t & batch ) const;
+		void DrawAll() const;
+
 		const Cube * GetSkybox() { return m_skybox; }
 		void SetSkybox( Cube * skybox ) { m_skybox = skybox; }
 
@@ -43,19 +54,32 @@ class Scene {
 
 	private:
 		static Scene* inst_; //single instance
-		Scene() { m_name = Str(); m_meshCount = 0; m_lightCount = 0; m_envProbeCount = 0; m_skybox = NULL; }
+		Scene() { m_name = Str(); m_meshCount = 0; m_lightCount = 0; m_envProbeCount = 0; m_skybox = NULL;
+				  m_geometryVAO = 0; m_vertexBuffer = 0; m_indexBuffer = 0; m_instanceBuffer = 0; m_probeIndexBuffer = 0;
+				  m_passIndirectBuffer = 0; m_frameIndirectBuffer = 0; m_frameIndirectSize = 0; }
         Scene( const Scene& ); //don't implement
         Scene& operator=( const Scene& ); //don't implement
 
-		const unsigned int CreateVAO( const surface * s, const unsigned int transformCount, const float * transforms ) const;
-
 		Str m_name; //also the relative path to the scene file
 
 		Cube * m_skybox;
 
-		void LoadVAOs();
+		void LoadGeometry();
+		void UpdateInstanceBuffers( Mesh * mesh );
 		void BuildProbes();
 
+		unsigned int m_geometryVAO;
+		unsigned int m_vertexBuffer;
+		unsigned int m_indexBuffer;
+		unsigned int m_instanceBuffer; //transform of every instance, flipped instances last within each mesh
+		unsigned int m_probeIndexBuffer; //env probe index of every instance
+		unsigned int m_passIndirectBuffer; //m_passCommands, the same for every pass that draws the whole scene
+		unsigned int m_frameIndirectBuffer; //commands of the main pass, rewritten every frame
+		unsigned int m_frameIndirectSize;
+		indirectScene_t m_indirectScene;
+		std::vector< drawElementsCommand_t > m_passCommands;
+		std::vector< indirectBatch_t > m_passBatches;
+
 		unsigned int m_meshCount;
 		unsigned int m_lightCount;
 		unsigned int m_envProbeCount;
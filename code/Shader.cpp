@@ -1,13 +1,28 @@
 #include "Shader.h"
 #include <stdio.h>
 #include "Fileio.h"
+#include "GLRecorder.h"
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+#include "ShaderWatcher.h"
 #include <assert.h>
+#include <algorithm>
+#include <chrono>
 
 unsigned int Buffer::s_count = 0;
 resourceMap_b Buffer::s_buffers;
 
 //initialize static members
 resourceMap_s Shader::s_shaders;
+bool Shader::s_uniformCache = true;
+unsigned int Shader::s_linkCount = 0;
+bool Shader::s_hotReload = true;
+unsigned int Shader::s_reloads = 0;
+unsigned int Shader::s_failedReloads = 0;
+ShaderWatcher Shader::s_watcher;
+static bool gWatchStarted = false;
+
+#define REFLECT_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
 
 /*
  ===================================
@@ -39,6 +54,27 @@ void Buffer::Initialize( GLsizeiptr size, const void * data, GLenum usage ) {
 	}
 }
 
+/*
+ ===================================
+ Buffer::Upload
+	-replaces the contents of the buffer, it is only reallocated when it has to grow
+ ===================================
+ */
+void Buffer::Upload( const GLsizeiptr size, const void * data ) {
+	if ( !m_initialized ) {
+		Initialize( size, data, GL_DYNAMIC_DRAW );
+		return;
+	}
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, m_id );
+	if ( size > m_size ) {
+		glBufferData( GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW );
+		m_size = size;
+	} else {
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, size, data );
+	}
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
 /*
  ===================================
  Buffer::GetBuffer
@@ -60,6 +96,213 @@ Buffer * Buffer::GetBuffer( const char *name ) {
 	return buffer;
 }
 
+/*
+ ===================================
+ UniformBlock::Upload
+	-replaces the contents of the buffer, it is only reallocated when it has to grow
+ ===================================
+ */
+void UniformBlock::Upload( const GLsizeiptr size, const void * data ) {
+	if ( m_id == 0 ) {
+		glGenBuffers( 1, &m_id );
+	}
+	glBindBuffer( GL_UNIFORM_BUFFER, m_id );
+	if ( size > m_size ) {
+		glBufferData( GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW );
+		m_size = size;
+	} else {
+		glBufferSubData( GL_UNIFORM_BUFFER, 0, size, data );
+	}
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+	GLRecorder::Record( GLCALL_UNIFORM_BLOCK );
+}
+
+/*
+ ===================================
+ UniformBlock::BindBase
+ ===================================
+ */
+void UniformBlock::BindBase( const GLuint bindingPoint ) const {
+	glBindBufferBase( GL_UNIFORM_BUFFER, bindingPoint, m_id );
+	GLRecorder::Record( GLCALL_UNIFORM_BLOCK );
+}
+
+/*
+ ===================================
+ UniformBlock::BindRange
+	-offset has to be a multiple of OffsetAlignment
+ ===================================
+ */
+void UniformBlock::BindRange( const GLuint bindingPoint, const GLintptr offset, const GLsizeiptr size ) const {
+	assert( offset % OffsetAlignment() == 0 );
+	glBindBufferRange( GL_UNIFORM_BUFFER, bindingPoint, m_id, offset, size );
+	GLRecorder::Record( GLCALL_UNIFORM_BLOCK );
+}
+
+/*
+ ===================================
+ UniformBlock::Delete
+ ===================================
+ */
+void UniformBlock::Delete() {
+	if ( m_id != 0 ) {
+		glDeleteBuffers( 1, &m_id );
+	}
+	m_id = 0;
+	m_size = 0;
+}
+
+/*
+ ===================================
+ UniformBlock::OffsetAlignment
+ ===================================
+ */
+GLint UniformBlock::OffsetAlignment() {
+	static GLint alignment = 0;
+	if ( alignment == 0 ) {
+		glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+	}
+	return alignment;
+}
+
+/*
+ ===================================
+ reflectTable_t::HashName
+	-64 bit fnv-1a of the name, never 0 so that 0 can mark empty slots
+ ===================================
+ */
+uint64_t reflectTable_t::HashName( const char * name ) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for ( const char * c = name; *c != '\0'; c++ ) {
+		hash ^= ( uint8_t )*c;
+		hash *= 0x100000001b3ULL;
+	}
+	return ( hash == 0 ) ? 1 : hash;
+}
+
+/*
+ ===================================
+ ReflectSlot
+	-bucket and slot hashes of a name hash, seed 0 picks the bucket
+ ===================================
+ */
+static inline uint64_t ReflectSlot( const uint64_t hash, const uint64_t seed ) {
+	uint64_t mixed = ( hash ^ seed ) * REFLECT_HASH_MULTIPLIER;
+	return mixed ^ ( mixed >> 29 );
+}
+
+/*
+ ===================================
+ reflectTable_t::Build
+	-hash and displace: names are grouped into buckets, then each bucket, largest first, searches
+	 for a displacement that puts all of its names into free slots. The table has about twice as
+	 many slots as names and grows if a bucket cant be placed.
+ ===================================
+ */
+void reflectTable_t::Build( const std::vector< reflectEntry_t > & entries ) {
+	slots.clear();
+	displacements.clear();
+	slotMask = 0;
+	bucketMask = 0;
+
+	//the same name can be reflected twice
+	std::vector< reflectEntry_t > unique;
+	for ( unsigned int i = 0; i < entries.size(); i++ ) {
+		bool duplicate = false;
+		for ( unsigned int j = 0; j < unique.size() && !duplicate; j++ ) {
+			duplicate = ( unique[j].hash == entries[i].hash );
+		}
+		if ( !duplicate ) {
+			unique.push_back( entries[i] );
+		}
+	}
+	if ( unique.empty() ) {
+		return;
+	}
+
+	size_t bucketCount = 1;
+	while ( bucketCount * 2 < unique.size() ) {
+		bucketCount *= 2;
+	}
+	bucketMask = bucketCount - 1;
+	std::vector< std::vector< unsigned int > > buckets( bucketCount );
+	for ( unsigned int i = 0; i < unique.size(); i++ ) {
+		buckets[ ReflectSlot( unique[i].hash, 0 ) & bucketMask ].push_back( i );
+	}
+	std::vector< unsigned int > order( bucketCount );
+	for ( unsigned int i = 0; i < bucketCount; i++ ) {
+		order[i] = i;
+	}
+	std::stable_sort( order.begin(), order.end(), [&]( const unsigned int a, const unsigned int b ) { return buckets[a].size() > buckets[b].size(); } );
+
+	size_t slotCount = 2;
+	while ( slotCount < unique.size() * 2 ) {
+		slotCount *= 2;
+	}
+	for ( ; ; slotCount *= 2 ) {
+		slots.assign( slotCount, reflectEntry_t() );
+		displacements.assign( bucketCount, 0 );
+		slotMask = slotCount - 1;
+
+		bool placedAll = true;
+		for ( unsigned int b = 0; b < bucketCount && placedAll; b++ ) {
+			const std::vector< unsigned int > & bucket = buckets[ order[b] ];
+			bool placed = bucket.empty();
+			for ( uint32_t displacement = 1; displacement < 4096 && !placed; displacement++ ) {
+				placed = true;
+				for ( unsigned int k = 0; k < bucket.size() && placed; k++ ) {
+					const uint64_t slot = ReflectSlot( unique[ bucket[k] ].hash, displacement ) & slotMask;
+					placed = ( slots[ slot ].hash == 0 );
+					for ( unsigned int m = 0; m < k && placed; m++ ) {
+						placed = ( ( ReflectSlot( unique[ bucket[m] ].hash, displacement ) & slotMask ) != slot );
+					}
+				}
+				if ( placed ) {
+					displacements[ order[b] ] = displacement;
+					for ( unsigned int k = 0; k < bucket.size(); k++ ) {
+						slots[ ReflectSlot( unique[ bucket[k] ].hash, displacement ) & slotMask ] = unique[ bucket[k] ];
+					}
+				}
+			}
+			placedAll = placed;
+		}
+		if ( placedAll ) {
+			return;
+		}
+	}
+}
+
+/*
+ ===================================
+ reflectTable_t::Find
+	-returns NULL if the name isnt in the table
+ ===================================
+ */
+const reflectEntry_t * reflectTable_t::Find( const char * name ) const {
+	if ( slots.empty() ) {
+		return NULL;
+	}
+	const uint64_t hash = HashName( name );
+	const uint32_t displacement = displacements[ ReflectSlot( hash, 0 ) & bucketMask ];
+	const reflectEntry_t & slot = slots[ ReflectSlot( hash, displacement ) & slotMask ];
+	return ( slot.hash == hash ) ? &slot : NULL;
+}
+
+/*
+ ===================================
+ reflectTable_t::Count
+ ===================================
+ */
+unsigned int reflectTable_t::Count() const {
+	unsigned int count = 0;
+	for ( unsigned int i = 0; i < slots.size(); i++ ) {
+		if ( slots[i].hash != 0 ) {
+			count++;
+		}
+	}
+	return count;
+}
+
 /*
  ===================================
  myglGetError
@@ -68,6 +311,7 @@ Buffer * Buffer::GetBuffer( const char *name ) {
 void Shader::myglGetError() {
 	// check for up to 10 errors pending
 	for ( int i = 0 ; i < 10 ; i++ ) {
+		GLRecorder::Record( GLCALL_ERROR_CHECK );
 		const int err = glGetError();
 		if ( err == GL_NO_ERROR ) {
 			return;
@@ -108,6 +352,7 @@ static GLuint gCurrentProgram = 0;
 Shader::Shader() :
 mShaderProgram( 0 ) {
 	m_pinned = false;
+	m_linkId = 0;
 }
 
 /*
@@ -116,9 +361,16 @@ mShaderProgram( 0 ) {
  ================================
  */
 void Shader::DeleteProgram() {
+	if ( gCurrentProgram == mShaderProgram ) {
+		gCurrentProgram = 0;
+	}
 	glDeleteProgram( mShaderProgram );
 	m_buffers.clear();
 	mShaderProgram = 0;
+	m_uniforms = reflectTable_t();
+	m_storageBlocks = reflectTable_t();
+	m_uniformBlocks = reflectTable_t();
+	m_blockMembers = reflectTable_t();
 }
 
 /*
@@ -136,6 +388,7 @@ void Shader::DeleteAllPrograms() {
 				delete delShader->m_buffers[i];
 				delShader->m_buffers[i] = nullptr;
 			}
+			s_watcher.Unwatch( it->first.c_str() );
 			resourceMap_s::iterator toErase = it;
 			++it;
 			s_shaders.erase( toErase );
@@ -160,6 +413,285 @@ void Shader::DeleteAllPrograms() {
 	Buffer::s_buffers.clear();
 }
 
+/*
+ ================================
+ Shader::LoadedPermutations
+	-prefixes and permutations of every program loaded through GetShader
+ ================================
+ */
+void Shader::LoadedPermutations( std::vector< std::string > & prefixes, std::vector< std::string > & permutations ) {
+	prefixes.clear();
+	permutations.clear();
+	resourceMap_s::iterator it = s_shaders.begin();
+	while ( it != s_shaders.end() ) {
+		prefixes.push_back( it->second->m_prefix );
+		permutations.push_back( it->second->m_permutation );
+		++it;
+	}
+}
+
+/*
+ ================================
+ Shader::ReloadChanged
+	-called once a frame before anything is drawn. Every program using a shader file that changed
+	 is built again from source and, if that worked, replaces the program of its Shader. Shader
+	 pointers stay valid, and a program that fails to build keeps running the previous one.
+	-values set in the default uniform block carry over to the new program, the link id changes,
+	 see GetLinkId.
+	-returns the programs that were replaced
+ ================================
+ */
+unsigned int Shader::ReloadChanged() {
+	if ( !s_hotReload ) {
+		return 0;
+	}
+	if ( !gWatchStarted ) {
+		s_watcher.Start( "data\\shader" );
+		gWatchStarted = true;
+	}
+
+	std::vector< std::string > changedFiles;
+	if ( !s_watcher.Update( changedFiles ) ) {
+		return 0;
+	}
+	for ( unsigned int i = 0; i < changedFiles.size(); i++ ) {
+		ShaderPreprocessor::ForgetFile( changedFiles[i].c_str() );
+	}
+
+	std::vector< std::string > programs;
+	s_watcher.Dependents( changedFiles, programs );
+	unsigned int reloaded = 0;
+	for ( unsigned int i = 0; i < programs.size(); i++ ) {
+		resourceMap_s::iterator it = s_shaders.find( programs[i] );
+		if ( it == s_shaders.end() ) {
+			continue;
+		}
+		Shader * shader = it->second;
+		if ( !shader->Reload() ) {
+			printf( "Shader reload failed, keeping the previous program: %s\n", programs[i].c_str() );
+			s_failedReloads++;
+			continue;
+		}
+
+		//the program may include other files now
+		s_watcher.Watch( programs[i].c_str(), shader->m_sourceFiles );
+		printf( "Reloaded shader: %s\n", programs[i].c_str() );
+		reloaded++;
+	}
+	s_reloads += reloaded;
+	return reloaded;
+}
+
+/*
+ ================================
+ Shader::Watcher
+ ================================
+ */
+const ShaderWatcher & Shader::Watcher() {
+	return s_watcher;
+}
+
+/*
+ ================================
+ Shader::Reload
+	-builds the program again from its source files, false keeps the current one
+ ================================
+ */
+bool Shader::Reload() {
+	Shader * rebuilt = LoadShader( m_prefix.c_str(), m_permutation.c_str() );
+	if ( rebuilt == NULL ) {
+		return false;
+	}
+	TakeProgram( rebuilt );
+	delete rebuilt;
+	rebuilt = nullptr;
+	return true;
+}
+
+/*
+ ================================
+ CopyUniform
+	-one uniform or array element, false for types that arent copied
+ ================================
+ */
+static bool CopyUniform( const GLuint from, const GLint fromLocation, const GLuint to, const GLint toLocation, const GLenum type ) {
+	GLfloat floats[ 16 ];
+	GLint ints[ 4 ];
+	GLuint uints[ 4 ];
+	switch ( type ) {
+		case GL_FLOAT:
+		case GL_FLOAT_VEC2:
+		case GL_FLOAT_VEC3:
+		case GL_FLOAT_VEC4:
+		case GL_FLOAT_MAT2:
+		case GL_FLOAT_MAT3:
+		case GL_FLOAT_MAT4:
+			glGetUniformfv( from, fromLocation, floats );
+			break;
+		case GL_INT:
+		case GL_INT_VEC2:
+		case GL_INT_VEC3:
+		case GL_INT_VEC4:
+		case GL_BOOL:
+		case GL_BOOL_VEC2:
+		case GL_BOOL_VEC3:
+		case GL_BOOL_VEC4:
+			glGetUniformiv( from, fromLocation, ints );
+			break;
+		case GL_UNSIGNED_INT:
+		case GL_UNSIGNED_INT_VEC2:
+		case GL_UNSIGNED_INT_VEC3:
+		case GL_UNSIGNED_INT_VEC4:
+			glGetUniformuiv( from, fromLocation, uints );
+			break;
+		case GL_DOUBLE:
+		case GL_DOUBLE_VEC2:
+		case GL_DOUBLE_VEC3:
+		case GL_DOUBLE_VEC4:
+		case GL_FLOAT_MAT2x3:
+		case GL_FLOAT_MAT2x4:
+		case GL_FLOAT_MAT3x2:
+		case GL_FLOAT_MAT3x4:
+		case GL_FLOAT_MAT4x2:
+		case GL_FLOAT_MAT4x3:
+			return false; //not used by any shader
+		default:
+			glGetUniformiv( from, fromLocation, ints ); //samplers and images hold their slot
+			break;
+	}
+
+	switch ( type ) {
+		case GL_FLOAT:				glProgramUniform1fv( to, toLocation, 1, floats ); break;
+		case GL_FLOAT_VEC2:			glProgramUniform2fv( to, toLocation, 1, floats ); break;
+		case GL_FLOAT_VEC3:			glProgramUniform3fv( to, toLocation, 1, floats ); break;
+		case GL_FLOAT_VEC4:			glProgramUniform4fv( to, toLocation, 1, floats ); break;
+		case GL_FLOAT_MAT2:			glProgramUniformMatrix2fv( to, toLocation, 1, GL_FALSE, floats ); break;
+		case GL_FLOAT_MAT3:			glProgramUniformMatrix3fv( to, toLocation, 1, GL_FALSE, floats ); break;
+		case GL_FLOAT_MAT4:			glProgramUniformMatrix4fv( to, toLocation, 1, GL_FALSE, floats ); break;
+		case GL_INT_VEC2:
+		case GL_BOOL_VEC2:			glProgramUniform2iv( to, toLocation, 1, ints ); break;
+		case GL_INT_VEC3:
+		case GL_BOOL_VEC3:			glProgramUniform3iv( to, toLocation, 1, ints ); break;
+		case GL_INT_VEC4:
+		case GL_BOOL_VEC4:			glProgramUniform4iv( to, toLocation, 1, ints ); break;
+		case GL_UNSIGNED_INT:		glProgramUniform1uiv( to, toLocation, 1, uints ); break;
+		case GL_UNSIGNED_INT_VEC2:	glProgramUniform2uiv( to, toLocation, 1, uints ); break;
+		case GL_UNSIGNED_INT_VEC3:	glProgramUniform3uiv( to, toLocation, 1, uints ); break;
+		case GL_UNSIGNED_INT_VEC4:	glProgramUniform4uiv( to, toLocation, 1, uints ); break;
+		default:					glProgramUniform1iv( to, toLocation, 1, ints ); break; //int, bool, samplers and images
+	}
+	return true;
+}
+
+/*
+ ================================
+ ActiveUniformTypes
+	-type of every active default block uniform of a program, arrays by their name without [0]
+ ================================
+ */
+static void ActiveUniformTypes( const GLuint program, std::map< std::string, std::pair< GLenum, GLint > > & types ) {
+	GLint uniformCount = 0;
+	GLint maxLength = 0;
+	glGetProgramiv( program, GL_ACTIVE_UNIFORMS, &uniformCount );
+	glGetProgramiv( program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength );
+	std::vector< char > name( maxLength + 1, '\0' );
+	for ( GLint i = 0; i < uniformCount; i++ ) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform( program, ( GLuint )i, maxLength + 1, &length, &size, &type, name.data() );
+		if ( glGetUniformLocation( program, name.data() ) < 0 ) {
+			continue; //block members and built ins
+		}
+		if ( length > 3 && strcmp( name.data() + length - 3, "[0]" ) == 0 ) {
+			name[ length - 3 ] = '\0';
+		}
+		types[ name.data() ] = std::make_pair( type, size );
+	}
+}
+
+/*
+ ================================
+ CopyUniformValues
+	-copies the values of every default block uniform of from to the uniform of the same name
+	 and type in to, so values that are only set once survive a rebuild. Returns the values copied.
+ ================================
+ */
+static unsigned int CopyUniformValues( const GLuint from, const GLuint to ) {
+	std::map< std::string, std::pair< GLenum, GLint > > fromTypes;
+	std::map< std::string, std::pair< GLenum, GLint > > toTypes;
+	ActiveUniformTypes( from, fromTypes );
+	ActiveUniformTypes( to, toTypes );
+
+	unsigned int copied = 0;
+	std::map< std::string, std::pair< GLenum, GLint > >::iterator it = fromTypes.begin();
+	while ( it != fromTypes.end() ) {
+		std::map< std::string, std::pair< GLenum, GLint > >::iterator toIt = toTypes.find( it->first );
+		if ( toIt == toTypes.end() || toIt->second.first != it->second.first ) {
+			++it;
+			continue;
+		}
+
+		//arrays element by element, the new program may have a different length
+		const GLint size = std::min( it->second.second, toIt->second.second );
+		const bool isArray = it->second.second > 1 || toIt->second.second > 1;
+		for ( GLint e = 0; e < size; e++ ) {
+			std::string elementName = it->first;
+			if ( isArray ) {
+				char index[ 16 ];
+				sprintf( index, "[%d]", e );
+				elementName += index;
+			}
+			const GLint fromLocation = glGetUniformLocation( from, elementName.c_str() );
+			const GLint toLocation = glGetUniformLocation( to, elementName.c_str() );
+			if ( fromLocation >= 0 && toLocation >= 0 && CopyUniform( from, fromLocation, to, toLocation, it->second.first ) ) {
+				copied++;
+			}
+		}
+		++it;
+	}
+	return copied;
+}
+
+/*
+ ================================
+ Shader::TakeProgram
+	-replaces the program by the one of rebuilt, which is left without one. The storage block
+	 buffers added to the old program are added again since their block indices may have moved.
+	-the uniform values of the old program are copied to the new one, so values that were only set
+	 when the program was first loaded survive
+ ================================
+ */
+void Shader::TakeProgram( Shader * rebuilt ) {
+	std::vector< Buffer * > buffers;
+	bufferMap::iterator it = m_buffers.begin();
+	while ( it != m_buffers.end() ) {
+		buffers.push_back( it->second );
+		++it;
+	}
+
+	CopyUniformValues( mShaderProgram, rebuilt->mShaderProgram );
+	if ( gCurrentProgram == mShaderProgram ) {
+		gCurrentProgram = 0;
+	}
+	glDeleteProgram( mShaderProgram );
+	mShaderProgram = rebuilt->mShaderProgram;
+	rebuilt->mShaderProgram = 0;
+	m_uniforms = rebuilt->m_uniforms;
+	m_storageBlocks = rebuilt->m_storageBlocks;
+	m_uniformBlocks = rebuilt->m_uniformBlocks;
+	m_blockMembers = rebuilt->m_blockMembers;
+	m_linkId = rebuilt->m_linkId;
+	m_sourceFiles = rebuilt->m_sourceFiles;
+
+	m_buffers.clear();
+	for ( unsigned int i = 0; i < buffers.size(); i++ ) {
+		if ( HasStorageBlock( buffers[i]->GetName() ) ) {
+			AddBuffer( buffers[i] );
+		}
+	}
+}
+
 /*
  ================================
  Shader::PinShader
@@ -206,6 +738,12 @@ void Shader::AddBuffer( Buffer * buffer ) {
  */
 Buffer * Shader::BufferByBlockIndex( GLuint blockIdx ) {
 	Buffer * buffer = m_buffers[blockIdx];
+#ifndef _DEBUG
+	if ( s_uniformCache ) {
+		return buffer;
+	}
+#endif
+	GLRecorder::Record( GLCALL_UNIFORM_LOOKUP );
 	GLuint block_index = glGetProgramResourceIndex( mShaderProgram, GL_SHADER_STORAGE_BLOCK, buffer->GetName() );
 	assert( block_index != GL_INVALID_INDEX );
 	assert( blockIdx == block_index );
@@ -220,19 +758,22 @@ Buffer * Shader::BufferByBlockIndex( GLuint blockIdx ) {
  ================================
  */
 const GLuint Shader::BufferBlockIndexByName( const char * name ) {
-	//GLuint block_index = glGetUniformBlockIndex( mShaderProgram, name );
-	GLuint block_index = glGetProgramResourceIndex( mShaderProgram, GL_SHADER_STORAGE_BLOCK, name );
+	GLuint block_index = GL_INVALID_INDEX;
+	if ( s_uniformCache ) {
+		const reflectEntry_t * entry = m_storageBlocks.Find( name );
+		if ( entry != NULL ) {
+			block_index = entry->value;
+		}
+	} else {
+		GLRecorder::Record( GLCALL_UNIFORM_LOOKUP );
+		block_index = glGetProgramResourceIndex( mShaderProgram, GL_SHADER_STORAGE_BLOCK, name );
+	}
 	assert( block_index != GL_INVALID_INDEX ); //name must be present in shader to begine with
 
 	//only return block_index if the buffer is included in m_buffer member map
-	bufferMap::iterator it = m_buffers.begin();
-	while ( it != m_buffers.end() ) {
-		GLuint blkIdx = it->first;
-		Buffer * buffer = it->second;
-		if ( strcmp( name, buffer->GetName() ) == 0 ) {
-			return block_index;
-		}
-		it++;
+	bufferMap::iterator it = m_buffers.find( block_index );
+	if ( it != m_buffers.end() && strcmp( name, it->second->GetName() ) == 0 ) {
+		return block_index;
 	}
 
 	return GL_INVALID_INDEX;
@@ -260,19 +801,24 @@ void Shader::PrintLog( const GLuint shader, const char * logname ) const {
  ================================
  Shader::GetShader
 	-Function either fetches an existing shader or loads a new one.
+	-every permutation of a prefix is its own program, defines are like "SHADOWS=0 IBL=0"
  ================================
  */
-Shader * Shader::GetShader( const char *sprefix ) {
+Shader * Shader::GetShader( const char *sprefix, const char * defines ) {
+	const std::string permutation = ShaderPreprocessor::PermutationKey( defines );
+	const std::string name = permutation.empty() ? std::string( sprefix ) : std::string( sprefix ) + " " + permutation;
+
     // Search for preexisting shader and return if found
-    resourceMap_s::iterator it = s_shaders.find( sprefix );
+    resourceMap_s::iterator it = s_shaders.find( name );
     if ( it != s_shaders.end() ) {
         return it->second;
     }
 
     // Couldn't find pre-loaded material, so load from file
-	Shader * newShader = LoadShader( sprefix );
+	Shader * newShader = LoadShader( sprefix, permutation.c_str() );
     if ( newShader != NULL ) {
-		s_shaders[sprefix] = newShader;
+		s_shaders[name] = newShader;
+		s_watcher.Watch( name.c_str(), newShader->m_sourceFiles );
 		return newShader;
 	}
 
@@ -285,7 +831,9 @@ Shader * Shader::GetShader( const char *sprefix ) {
 	-Compile shaders from sprefix and create a new Shader object
  ================================
  */
-Shader * Shader::LoadShader( const char * sprefix ) {
+Shader * Shader::LoadShader( const char * sprefix, const char * defines ) {
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
 	std::string relative_vertex = "data\\shader\\" + std::string( sprefix ) + "_vshader.glsl";
 	std::string relative_geometry = "data\\shader\\" + std::string( sprefix ) + "_gshader.glsl";
 	std::string relative_fragment = "data\\shader\\" + std::string( sprefix ) + "_fshader.glsl";
@@ -308,296 +856,171 @@ Shader * Shader::LoadShader( const char * sprefix ) {
 	file = fopen( absolutePath_geometry, "rb" );
 	const bool g_exists = file != NULL;
 	if ( g_exists ) {
-		fclose( file );
-	}
-	
-	Shader * shader = new Shader;
-	if ( c_exists ) {
-		if( shader->CompileShaderFromFile( relative_compute.c_str() ) ) {
-			return shader;
-		}
-	} else {
-		if ( g_exists ) {
-			if( shader->CompileShaderFromFile( relative_vertex.c_str(), relative_geometry.c_str(), relative_fragment.c_str() ) ) {
-				return shader;
-			}
-		} else {
-			if( shader->CompileShaderFromFile( relative_vertex.c_str(), relative_fragment.c_str() ) ) {
-				return shader;
-			}
-		}
-	}
-	delete shader;
-	shader = nullptr;
-
-	return NULL;
-}
-
-/*
-================================
-Shader::IDByName
-================================
-*/
-const GLuint Shader::IDByName( const char * sprefix ) {
-    // Search for preexisting shader and return if found
-    resourceMap_s::iterator it = s_shaders.find( sprefix );
-    if ( it != s_shaders.end() ) {
-        return it->second->mShaderProgram;
-    }
-	return 0;
-}
-
-/*
-================================
-Shader::CompileVertexShader
-	Loads and compiles geometry shader file.
-================================
-*/
-unsigned int Shader::CompileVertexShader( const char *vshaderFile ) {
-	GLchar *source_v = NULL;
-	int success;
-	char infoLog[512];
-	unsigned int size( 0 );
-
-	//load source of vertex shader	
-	GetFileData( vshaderFile, ( unsigned char** )&source_v, size );
-	if ( !source_v ) {
-		printf( "Failed to load vertex shader file!!!\n" );
-		return false;
-	}
-	const GLchar * source_const_v = ( const GLchar * )source_v;
-
-	//create vertex shader
-	unsigned int vertexShader;
-	vertexShader = glCreateShader( GL_VERTEX_SHADER ); //create vertex shader object
-	glShaderSource( vertexShader, 1, &source_const_v, NULL ); //load in source code
-	glCompileShader( vertexShader ); //compile
-
-	//check if shader compiled successfully
-	glGetShaderiv( vertexShader, GL_COMPILE_STATUS, &success );
-	if ( !success ) {
-		glGetShaderInfoLog( vertexShader, 512, NULL, infoLog );
-		printf( "ERROR::SHADER::VERTEX::COMPILATION_FAILED:: %s\n", ( const char * )infoLog );
-		return 0;
-	}
-
-	return vertexShader;
-}
-
-/*
-================================
-Shader::CompileGeometryShader
-	Loads and compiles geometry shader file.
-================================
-*/
-unsigned int Shader::CompileGeometryShader( const char *gshaderFile ) {
-	GLchar *source_g = NULL;
-	int success;
-	char infoLog[512];
-	unsigned int size( 0 );
-
-	//load source of geometry shader	
-	GetFileData( gshaderFile, ( unsigned char** )&source_g, size );
-	if ( !source_g ) {
-		printf( "Failed to load geometry shader file!!!\n" );
-		return false;
-	}
-	const GLchar * source_const_g = ( const GLchar * )source_g;
-
-	//create geometry shader
-	unsigned int geometryShader;
-	geometryShader = glCreateShader( GL_GEOMETRY_SHADER ); //create geometry shader object
-	glShaderSource( geometryShader, 1, &source_const_g, NULL ); //load in source code
-	glCompileShader( geometryShader ); //compile
-
-	//check if shader compiled successfully
-	glGetShaderiv( geometryShader, GL_COMPILE_STATUS, &success );
-	if ( !success ) {
-		glGetShaderInfoLog( geometryShader, 512, NULL, infoLog );
-		printf( "ERROR::SHADER::GEOMETRY::COMPILATION_FAILED:: %s\n", ( const char * )infoLog );
-		return 0;
-	}
-
-	return geometryShader;
-}
-
-/*
-================================
-Shader::CompileFragmentShader
-	Loads and compiles fragment shader file.
-================================
-*/
-unsigned int Shader::CompileFragmentShader( const char *fshaderFile ) {
-	GLchar *source_f = NULL;
-	int success;
-	char infoLog[512];
-	unsigned int size( 0 );
+		fclose( file );
+	}
 
-	//load source of fragment shader
-	GetFileData( fshaderFile, ( unsigned char** )&source_f, size );
-	if ( !source_f ) {
-		printf( "Failed to load fragment shader file!!!\n" );
-		return false;
+	//stages in link order
+	unsigned int stageCount = 0;
+	unsigned int stageTypes[ 3 ];
+	std::string stagePaths[ 3 ];
+	if ( c_exists ) {
+		stageTypes[ stageCount ] = GL_COMPUTE_SHADER;
+		stagePaths[ stageCount++ ] = relative_compute;
+	} else {
+		stageTypes[ stageCount ] = GL_VERTEX_SHADER;
+		stagePaths[ stageCount++ ] = relative_vertex;
+		if ( g_exists ) {
+			stageTypes[ stageCount ] = GL_GEOMETRY_SHADER;
+			stagePaths[ stageCount++ ] = relative_geometry;
+		}
+		stageTypes[ stageCount ] = GL_FRAGMENT_SHADER;
+		stagePaths[ stageCount++ ] = relative_fragment;
 	}
-	const GLchar * source_const_f = ( const GLchar * )source_f;
 
-	//create fragment shader
-	unsigned int fragmentShader;
-	fragmentShader = glCreateShader( GL_FRAGMENT_SHADER ); //create fragment shader object
-	glShaderSource( fragmentShader, 1, &source_const_f, NULL ); //load in source code
-	glCompileShader( fragmentShader ); //compile
+	//the sources are preprocessed even on a cache hit, they are the cache key
+	const std::string permutation = ShaderPreprocessor::PermutationKey( defines );
+	shaderSource_t sources[ 3 ];
+	const char * sourcePtrs[ 3 ];
+	for ( unsigned int i = 0; i < stageCount; i++ ) {
+		if ( !ShaderPreprocessor::Process( stagePaths[i].c_str(), permutation.c_str(), sources[i] ) ) {
+			printf( "Failed to load shader file: %s\n", stagePaths[i].c_str() );
+			return NULL;
+		}
+		sourcePtrs[i] = sources[i].text.c_str();
+	}
 
-	//check if shader compiled successfully
-	glGetShaderiv( fragmentShader, GL_COMPILE_STATUS, &success );
+	Shader * shader = new Shader;
+	shader->m_prefix = sprefix;
+	shader->m_permutation = permutation;
+	for ( unsigned int i = 0; i < stageCount; i++ ) {
+		for ( unsigned int j = 0; j < sources[i].files.size(); j++ ) {
+			if ( std::find( shader->m_sourceFiles.begin(), shader->m_sourceFiles.end(), sources[i].files[j] ) == shader->m_sourceFiles.end() ) {
+				shader->m_sourceFiles.push_back( sources[i].files[j] );
+			}
+		}
+	}
+	bool success = false;
+	const bool useCache = ProgramCache::s_enabled && ProgramBinariesSupported();
+	const std::string entryPath = ProgramCache::EntryPath( sprefix, permutation.c_str() );
+	programKey_t key = { 0, 0, 0 };
+	if ( useCache ) {
+		key = ProgramCache::MakeKey( stageCount, stageTypes, sourcePtrs,
+			( const char * )glGetString( GL_VENDOR ), ( const char * )glGetString( GL_RENDERER ), ( const char * )glGetString( GL_VERSION ) );
+		success = shader->LoadProgramBinary( entryPath.c_str(), key );
+		if ( success ) {
+			ProgramCache::s_hits++;
+		} else {
+			ProgramCache::s_misses++;
+		}
+	}
 	if ( !success ) {
-		glGetShaderInfoLog( fragmentShader, 512, NULL, infoLog );
-		printf( "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED:: %s\n", ( const char * )infoLog );
-		return 0;
+		if ( stageCount == 1 ) {
+			success = shader->CompileShaderFromCSTR( sourcePtrs[0] );
+		} else if ( stageCount == 2 ) {
+			success = shader->CompileShaderFromCSTR( sourcePtrs[0], sourcePtrs[1] );
+		} else {
+			success = shader->CompileShaderFromCSTR( sourcePtrs[0], sourcePtrs[1], sourcePtrs[2] );
+		}
+		if ( success && useCache ) {
+			shader->SaveProgramBinary( entryPath.c_str(), key );
+		}
+	}
+	ProgramCache::s_loadSeconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+
+	if ( success ) {
+		return shader;
+	}
+
+	//compile errors name files by their source string number
+	for ( unsigned int i = 0; i < stageCount; i++ ) {
+		for ( unsigned int j = 0; j < sources[i].files.size(); j++ ) {
+			printf( "%s source string %u: %s\n", stagePaths[i].c_str(), j, sources[i].files[j].c_str() );
+		}
 	}
+	delete shader;
+	shader = nullptr;
 
-	return fragmentShader;
+	return NULL;
 }
 
 /*
 ================================
-Shader::CompileComputeShader
-	Loads and compiles compute shader file.
+Shader::ProgramBinariesSupported
+	-some drivers expose glProgramBinary but have no binary formats, nothing can be cached then
 ================================
 */
-unsigned int Shader::CompileComputeShader( const char *cshaderFile ) {
-	GLchar *source_c = NULL;
-	int success;
-	char infoLog[512];
-	unsigned int size( 0 );
-
-	//load source of compute shader
-	GetFileData( cshaderFile, ( unsigned char** )&source_c, size );
-	if ( !source_c ) {
-		printf( "Failed to load compute shader file!!!\n" );
-		return false;
-	}
-	const GLchar * source_const_c = ( const GLchar * )source_c;
-
-	//create compute shader
-	unsigned int computeShader;
-	computeShader = glCreateShader( GL_COMPUTE_SHADER ); //create compute shader object
-	glShaderSource( computeShader, 1, &source_const_c, NULL ); //load in source code
-	glCompileShader( computeShader ); //compile
-
-	//check if shader compiled successfully
-	glGetShaderiv( computeShader, GL_COMPILE_STATUS, &success );
-	if ( !success ) {
-		glGetShaderInfoLog( computeShader, 512, NULL, infoLog );
-		printf( "ERROR::SHADER::COMPUTE::COMPILATION_FAILED:: %s\n", ( const char * )infoLog );
-		return 0;
+bool Shader::ProgramBinariesSupported() {
+	static GLint formatCount = -1;
+	if ( formatCount < 0 ) {
+		formatCount = 0;
+		glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount );
 	}
-
-	return computeShader;
+	return formatCount > 0;
 }
 
 /*
 ================================
-Shader::CompileShaderFromFile
-	Compiles a compute shader and links it to a shader program.
+Shader::LoadProgramBinary
+	-links the program from its cache entry. False on a miss, or if the driver rejects the binary.
 ================================
 */
-bool Shader::CompileShaderFromFile( const char *cshaderFile ) {
-	int success;
-	char infoLog[512];
-
-	//load and compile shader code
-	unsigned int computeShader = CompileComputeShader( cshaderFile );
+bool Shader::LoadProgramBinary( const char * relativePath, const programKey_t & key ) {
+	programBinary_t binary;
+	if ( !ProgramCache::Read( relativePath, key, binary ) ) {
+		return false;
+	}
 
-	//create shader program and link together the vertex and fragment shader
 	mShaderProgram = glCreateProgram();
-	glAttachShader( mShaderProgram, computeShader );
-	glLinkProgram( mShaderProgram );
-	
-	//check if linking failed
+	glProgramBinary( mShaderProgram, binary.format, binary.data.data(), ( GLsizei )binary.data.size() );
+
+	//drivers may still refuse a binary they made, e.g. after an update that kept the version string
+	GLint success = 0;
 	glGetProgramiv( mShaderProgram, GL_LINK_STATUS, &success );
-	if( !success ) {
-		glGetProgramInfoLog( mShaderProgram, 512, NULL, infoLog );
-		printf( "ERROR::SHADER::PROGRAM::LINKING_FAILED:: %s\n", ( const char * )infoLog );
+	if ( !success ) {
+		printf( "Driver rejected cached program, compiling from source: %s\n", relativePath );
+		glDeleteProgram( mShaderProgram );
+		mShaderProgram = 0;
 		return false;
 	}
 
-	//once linked shader programs should be deleted
-	glDeleteShader( computeShader );
+	//loading a binary resets block bindings like a link does
+	Reflect();
 
 	return true;
 }
 
 /*
 ================================
-Shader::CompileShaderFromFile
-	Compiles a vertex and fragment shader and links them to a shader program.
+Shader::SaveProgramBinary
 ================================
 */
-bool Shader::CompileShaderFromFile( const char *vshaderFile, const char *fshaderFile ) {
-	int success;
-	char infoLog[512];
-
-	//load and compile shader code
-	unsigned int vertexShader = CompileVertexShader( vshaderFile );
-	unsigned int fragmentShader = CompileFragmentShader( fshaderFile );
-
-	//create shader program and link together the vertex and fragment shader
-	mShaderProgram = glCreateProgram();
-	glAttachShader( mShaderProgram, vertexShader );
-	glAttachShader( mShaderProgram, fragmentShader );
-	glLinkProgram( mShaderProgram );
-	
-	//check if linking failed
-	glGetProgramiv( mShaderProgram, GL_LINK_STATUS, &success );
-	if( !success ) {
-		glGetProgramInfoLog( mShaderProgram, 512, NULL, infoLog );
-		printf( "ERROR::SHADER::PROGRAM::LINKING_FAILED:: %s\n", ( const char * )infoLog );
-		return false;
+void Shader::SaveProgramBinary( const char * relativePath, const programKey_t & key ) const {
+	GLint length = 0;
+	glGetProgramiv( mShaderProgram, GL_PROGRAM_BINARY_LENGTH, &length );
+	if ( length <= 0 ) {
+		return;
 	}
 
-	//once linked shader programs should be deleted
-	glDeleteShader( vertexShader );
-	glDeleteShader( fragmentShader );
-
-	return true;
+	programBinary_t binary;
+	binary.data.resize( length );
+	GLenum format = 0;
+	glGetProgramBinary( mShaderProgram, length, NULL, &format, binary.data.data() );
+	binary.format = format;
+	ProgramCache::Write( relativePath, key, binary );
 }
 
 /*
 ================================
-Shader::CompileShaderFromFile
-	Compiles a vertex, geometry, and fragment shader and links them to a shader program.
+Shader::IDByName
 ================================
 */
-bool Shader::CompileShaderFromFile( const char *vshaderFile, const char *gshaderFile, const char *fshaderFile ) {
-	int success;
-	char infoLog[512];
-
-	//load and compile shader code
-	unsigned int vertexShader = CompileVertexShader( vshaderFile );
-	unsigned int geometryShader = CompileGeometryShader( gshaderFile );
-	unsigned int fragmentShader = CompileFragmentShader( fshaderFile );
-
-	//create shader program and link together the vertex and fragment shader
-	mShaderProgram = glCreateProgram();
-	glAttachShader( mShaderProgram, vertexShader );
-	glAttachShader( mShaderProgram, geometryShader );
-	glAttachShader( mShaderProgram, fragmentShader );
-	glLinkProgram( mShaderProgram );
-	
-	//check if linking failed
-	glGetProgramiv( mShaderProgram, GL_LINK_STATUS, &success );
-	if( !success ) {
-		glGetProgramInfoLog( mShaderProgram, 512, NULL, infoLog );
-		printf( "ERROR::SHADER::PROGRAM::LINKING_FAILED:: %s\n", ( const char * )infoLog );
-		return false;
-	}
-
-	//once linked shader programs should be deleted
-	glDeleteShader( vertexShader );
-	glDeleteShader( geometryShader );
-	glDeleteShader( fragmentShader );
-
-	return true;
+const GLuint Shader::IDByName( const char * sprefix ) {
+    // Search for preexisting shader and return if found
+    resourceMap_s::iterator it = s_shaders.find( sprefix );
+    if ( it != s_shaders.end() ) {
+        return it->second->mShaderProgram;
+    }
+	return 0;
 }
 
 /*
@@ -626,6 +1049,7 @@ bool Shader::CompileShaderFromCSTR( const char * cshaderSource ) {
 
 	//create shader program and link together the vertex and fragment shader
 	mShaderProgram = glCreateProgram();
+	glProgramParameteri( mShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
 	glAttachShader( mShaderProgram, computeShader );
 	glLinkProgram( mShaderProgram );
 
@@ -640,6 +1064,9 @@ bool Shader::CompileShaderFromCSTR( const char * cshaderSource ) {
 	//once linked shader programs should be deleted
 	glDeleteShader( computeShader );
 
+	//build the uniform and block tables from the linked program
+	Reflect();
+
 	return true;
 }
 
@@ -684,6 +1111,7 @@ bool Shader::CompileShaderFromCSTR( const char * vshaderSource, const char * fsh
 
 	//create shader program and link together the vertex and fragment shader
 	mShaderProgram = glCreateProgram();
+	glProgramParameteri( mShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
 	glAttachShader( mShaderProgram, vertexShader );
 	glAttachShader( mShaderProgram, fragmentShader );
 	glLinkProgram( mShaderProgram );
@@ -700,6 +1128,9 @@ bool Shader::CompileShaderFromCSTR( const char * vshaderSource, const char * fsh
 	glDeleteShader( vertexShader );
 	glDeleteShader( fragmentShader );
 
+	//build the uniform and block tables from the linked program
+	Reflect();
+
 	return true;
 }
 
@@ -757,6 +1188,7 @@ bool Shader::CompileShaderFromCSTR( const char * vshaderSource, const char * gsh
 
 	//create shader program and link together the vertex and fragment shader
 	mShaderProgram = glCreateProgram();
+	glProgramParameteri( mShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
 	glAttachShader( mShaderProgram, vertexShader );
 	glAttachShader( mShaderProgram, geometryShader );
 	glAttachShader( mShaderProgram, fragmentShader );
@@ -775,6 +1207,9 @@ bool Shader::CompileShaderFromCSTR( const char * vshaderSource, const char * gsh
 	glDeleteShader( geometryShader );
 	glDeleteShader( fragmentShader );
 
+	//build the uniform and block tables from the linked program
+	Reflect();
+
 	return true;
 }
 
@@ -784,12 +1219,138 @@ bool Shader::CompileShaderFromCSTR( const char * vshaderSource, const char * gsh
  ================================
  */
 GLuint Shader::GetUniform( const char * name ) {
-	// didn't find this uniform... find it the slow way and store
+	if ( s_uniformCache ) {
+		const reflectEntry_t * entry = m_uniforms.Find( name );
+		if ( entry != NULL ) {
+			return entry->value;
+		}
+	}
+
+	// didn't find this uniform, like array elements after the first... find it the slow way
+	GLRecorder::Record( GLCALL_UNIFORM_LOOKUP );
 	const int val = glGetUniformLocation( mShaderProgram, name );
 	assert( val != -1 );
 	return val;
 }
 
+/*
+ ================================
+ Shader::GetUniformHandle
+	-resolve once, then set with the handle setters. The handle is only valid for this program.
+ ================================
+ */
+uniformHandle_t Shader::GetUniformHandle( const char * name ) const {
+	uniformHandle_t handle;
+	const reflectEntry_t * entry = m_uniforms.Find( name );
+	if ( entry != NULL ) {
+		handle.location = entry->value;
+	} else {
+		GLRecorder::Record( GLCALL_UNIFORM_LOOKUP );
+		handle.location = glGetUniformLocation( mShaderProgram, name );
+	}
+	return handle;
+}
+
+/*
+ ================================
+ Shader::Reflect
+	-enumerates the active uniforms, samplers included, and storage blocks of the linked program into
+	 perfect hash tables, so setting a uniform by name doesnt query the driver
+ ================================
+ */
+void Shader::Reflect() {
+	std::vector< reflectEntry_t > entries;
+	s_linkCount++;
+	m_linkId = s_linkCount;
+
+	GLint uniformCount = 0;
+	GLint maxLength = 0;
+	glGetProgramiv( mShaderProgram, GL_ACTIVE_UNIFORMS, &uniformCount );
+	glGetProgramiv( mShaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength );
+	std::vector< char > name( maxLength + 1, '\0' );
+	std::vector< reflectEntry_t > members;
+	for ( GLint i = 0; i < uniformCount; i++ ) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform( mShaderProgram, ( GLuint )i, maxLength + 1, &length, &size, &type, name.data() );
+
+		reflectEntry_t entry;
+		entry.hash = reflectTable_t::HashName( name.data() );
+		entry.type = type;
+		entry.size = size;
+
+		//members of uniform blocks dont have a location, they are written at their offset in the block
+		const GLint location = glGetUniformLocation( mShaderProgram, name.data() );
+		if ( location < 0 ) {
+			const GLuint index = ( GLuint )i;
+			GLint blockIndex = -1;
+			glGetActiveUniformsiv( mShaderProgram, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex );
+			if ( blockIndex >= 0 ) {
+				glGetActiveUniformsiv( mShaderProgram, 1, &index, GL_UNIFORM_OFFSET, &entry.value );
+				members.push_back( entry );
+			}
+			continue;
+		}
+
+		entry.value = location;
+		entries.push_back( entry );
+
+		//arrays are reported as name[0] but are set by their plain name
+		if ( length > 3 && strcmp( name.data() + length - 3, "[0]" ) == 0 ) {
+			name[ length - 3 ] = '\0';
+			entry.hash = reflectTable_t::HashName( name.data() );
+			entries.push_back( entry );
+		}
+	}
+	m_uniforms.Build( entries );
+	m_blockMembers.Build( members );
+
+	//uniform blocks with a shared binding point are bound to it here, once
+	GLint blockCount = 0;
+	maxLength = 0;
+	glGetProgramiv( mShaderProgram, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount );
+	glGetProgramiv( mShaderProgram, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength );
+	name.assign( maxLength + 1, '\0' );
+	entries.clear();
+	for ( GLint i = 0; i < blockCount; i++ ) {
+		glGetActiveUniformBlockName( mShaderProgram, ( GLuint )i, maxLength + 1, NULL, name.data() );
+
+		reflectEntry_t entry;
+		entry.hash = reflectTable_t::HashName( name.data() );
+		entry.value = i;
+		entry.type = GL_UNIFORM_BLOCK;
+		glGetActiveUniformBlockiv( mShaderProgram, ( GLuint )i, GL_UNIFORM_BLOCK_DATA_SIZE, &entry.size );
+		entries.push_back( entry );
+
+		if ( strcmp( name.data(), "frame_block" ) == 0 ) {
+			glUniformBlockBinding( mShaderProgram, ( GLuint )i, UNIFORM_BLOCK_FRAME );
+		} else if ( strcmp( name.data(), "material_block" ) == 0 ) {
+			glUniformBlockBinding( mShaderProgram, ( GLuint )i, UNIFORM_BLOCK_MATERIAL );
+		}
+	}
+	m_uniformBlocks.Build( entries );
+
+	//storage blocks, their index is their position in the program interface
+	blockCount = 0;
+	maxLength = 0;
+	glGetProgramInterfaceiv( mShaderProgram, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &blockCount );
+	glGetProgramInterfaceiv( mShaderProgram, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &maxLength );
+	name.assign( maxLength + 1, '\0' );
+	entries.clear();
+	for ( GLint i = 0; i < blockCount; i++ ) {
+		glGetProgramResourceName( mShaderProgram, GL_SHADER_STORAGE_BLOCK, ( GLuint )i, maxLength + 1, NULL, name.data() );
+
+		reflectEntry_t entry;
+		entry.hash = reflectTable_t::HashName( name.data() );
+		entry.value = i;
+		entry.type = GL_SHADER_STORAGE_BLOCK;
+		entry.size = 0;
+		entries.push_back( entry );
+	}
+	m_storageBlocks.Build( entries );
+}
+
 /*
  ================================
  Shader::GetAttribute
@@ -811,6 +1372,7 @@ void Shader::UseProgram() {
 	if ( gCurrentProgram != mShaderProgram ) {
 		glUseProgram( mShaderProgram );
 		gCurrentProgram = mShaderProgram;
+		GLRecorder::Record( GLCALL_PROGRAM );
 	}
 }
 
@@ -823,6 +1385,22 @@ bool Shader::IsCurrentProgram() const {
 	return ( mShaderProgram == gCurrentProgram );
 }
 
+/*
+ ================================
+ Shader::CheckSetterErrors
+	-glGetError is a round trip to the driver, the setters only check in debug builds
+ ================================
+ */
+void Shader::CheckSetterErrors() const {
+#ifdef _DEBUG
+	myglGetError();
+#else
+	if ( !s_uniformCache ) {
+		myglGetError();
+	}
+#endif
+}
+
 /*
  ================================
  Shader::DispatchCompute
@@ -844,10 +1422,11 @@ void Shader::SetUniform1i( const char * uniform, const int count, const int * va
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID   = GetUniform( uniform );
 	glUniform1iv( uniformID, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -859,10 +1438,11 @@ void Shader::SetUniform2i( const char * uniform, const int count, const int * va
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID   = GetUniform( uniform );
 	glUniform2iv( uniformID, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -874,10 +1454,11 @@ void Shader::SetUniform3i( const char * uniform, const int count, const int * va
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID   = GetUniform( uniform );
 	glUniform3iv( uniformID, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -889,10 +1470,11 @@ void Shader::SetUniform4i( const char * uniform, const int count, const int * va
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID   = GetUniform( uniform );
 	glUniform4iv( uniformID, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -904,11 +1486,11 @@ void Shader::SetUniform1f( const char * uniform, const int count, const float *
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID = GetUniform( uniform );
 	glUniform1fv( uniformID, count, values );
-	myglGetError();
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -920,10 +1502,11 @@ void Shader::SetUniform2f( const char * uniform, const int count, const float *
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID   = GetUniform( uniform );
 	glUniform2fv( uniformID, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -935,10 +1518,11 @@ void Shader::SetUniform3f( const char * uniform, const int count, const float *
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID   = GetUniform( uniform );
 	glUniform3fv( uniformID, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -950,10 +1534,11 @@ void Shader::SetUniform4f( const char * uniform, const int count, const float *
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID   = GetUniform( uniform );
 	glUniform4fv( uniformID, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -965,10 +1550,11 @@ void Shader::SetUniformMatrix2f( const char * uniform, const int count, const bo
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID = GetUniform( uniform );
 	glUniformMatrix2fv( uniformID, count, transpose, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -980,10 +1566,11 @@ void Shader::SetUniformMatrix3f( const char * uniform, const int count, const bo
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID = GetUniform( uniform );
 	glUniformMatrix3fv( uniformID, count, transpose, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -995,10 +1582,11 @@ void Shader::SetUniformMatrix4f( const char * uniform, const int count, const bo
 	assert( IsCurrentProgram() );
 	assert( uniform );
 	assert( values );
-	myglGetError();
-	
+	CheckSetterErrors();
+
 	const int uniformID = GetUniform( uniform );
 	glUniformMatrix4fv( uniformID, count, transpose, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
 }
 
 /*
@@ -1013,12 +1601,14 @@ void Shader::SetAndBindUniformTexture(    const char * uniform,
 	assert( IsCurrentProgram() );
 	assert( textureSlot >= 0 );
 	assert( uniform );
-	myglGetError();
+	CheckSetterErrors();
 
 	const int uniformID = GetUniform( uniform );
 	glActiveTexture( GL_TEXTURE0 + textureSlot);
 	glUniform1i( uniformID, textureSlot );
+	GLRecorder::Record( GLCALL_UNIFORM );
 	glBindTexture( textureTarget, textureID );
+	GLRecorder::Record( GLCALL_TEXTURE );
 }
 
 /*
@@ -1043,3 +1633,96 @@ void Shader::SetVertexAttribPointer(  const char * attribute,
 	glVertexAttribPointer( attributeID, size, type, normalized, stride, pointer );
 	myglGetError();
 }
+
+/*
+ ================================
+ Shader::SetUniform1i
+	-handle version
+ ================================
+ */
+void Shader::SetUniform1i( const uniformHandle_t handle, const int count, const int * values ) {
+	assert( IsCurrentProgram() );
+	assert( values );
+	CheckSetterErrors();
+
+	glUniform1iv( handle.location, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
+}
+
+/*
+ ================================
+ Shader::SetUniform1f
+	-handle version
+ ================================
+ */
+void Shader::SetUniform1f( const uniformHandle_t handle, const int count, const float * values ) {
+	assert( IsCurrentProgram() );
+	assert( values );
+	CheckSetterErrors();
+
+	glUniform1fv( handle.location, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
+}
+
+/*
+ ================================
+ Shader::SetUniform3f
+	-handle version
+ ================================
+ */
+void Shader::SetUniform3f( const uniformHandle_t handle, const int count, const float * values ) {
+	assert( IsCurrentProgram() );
+	assert( values );
+	CheckSetterErrors();
+
+	glUniform3fv( handle.location, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
+}
+
+/*
+ ================================
+ Shader::SetUniform4f
+	-handle version
+ ================================
+ */
+void Shader::SetUniform4f( const uniformHandle_t handle, const int count, const float * values ) {
+	assert( IsCurrentProgram() );
+	assert( values );
+	CheckSetterErrors();
+
+	glUniform4fv( handle.location, count, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
+}
+
+/*
+ ================================
+ Shader::SetUniformMatrix4f
+	-handle version
+ ================================
+ */
+void Shader::SetUniformMatrix4f( const uniformHandle_t handle, const int count, const bool transpose, const float * values ) {
+	assert( IsCurrentProgram() );
+	assert( values );
+	CheckSetterErrors();
+
+	glUniformMatrix4fv( handle.location, count, transpose, values );
+	GLRecorder::Record( GLCALL_UNIFORM );
+}
+
+/*
+ ================================
+ Shader::SetAndBindUniformTexture
+	-handle version
+ ================================
+ */
+void Shader::SetAndBindUniformTexture( const uniformHandle_t handle, const int textureSlot, const GLenum textureTarget, const GLuint textureID ) {
+	assert( IsCurrentProgram() );
+	assert( textureSlot >= 0 );
+	CheckSetterErrors();
+
+	glActiveTexture( GL_TEXTURE0 + textureSlot );
+	glUniform1i( handle.location, textureSlot );
+	GLRecorder::Record( GLCALL_UNIFORM );
+	glBindTexture( textureTarget, textureID );
+	GLRecorder::Record( GLCALL_TEXTURE );
+}
@@ -3,6 +3,7 @@
 #define __SHADER_H_INCLUDE__
 
 #include <stdio.h>
+#include <stdint.h>
 #include <map>
 #include <vector>
 #include <string>
@@ -12,11 +13,60 @@
 
 class Buffer;
 class Shader;
+class ShaderWatcher;
+struct programKey_t;
 
 typedef std::map< std::string, Shader * > resourceMap_s;
 typedef std::map< std::string, Buffer * > resourceMap_b;
 typedef std::map< GLuint, Buffer * > bufferMap;
 
+//binding points of the std140 uniform blocks shared by every program that declares them
+#define UNIFORM_BLOCK_FRAME		0
+#define UNIFORM_BLOCK_MATERIAL	1
+
+//per frame constants, matches the std140 layout of frame_block in the shaders: 144 bytes
+struct FrameStorage {
+	float view[16];
+	float projection[16];
+	float camPos[3];
+	int screenWidth;
+};
+
+//location of a uniform in one program, resolved once with Shader::GetUniformHandle. -1 if the uniform isnt active.
+struct uniformHandle_t {
+	GLint location;
+};
+
+struct reflectEntry_t {
+	uint64_t hash; //of the name, 0 for an empty slot
+	GLint value; //uniform location, block index or offset of a uniform block member
+	GLenum type;
+	GLint size; //array length of a uniform, data size of a uniform block
+};
+
+/*
+==============================
+reflectTable_t
+	-perfect hash table of the names reflected from a linked program. Each bucket of names has a
+	 displacement picked when the table is built so that every name gets its own slot, a lookup is
+	 two hashes and one compare.
+==============================
+*/
+struct reflectTable_t {
+	reflectTable_t() { slotMask = 0; bucketMask = 0; }
+
+	void Build( const std::vector< reflectEntry_t > & entries );
+	const reflectEntry_t * Find( const char * name ) const;
+	unsigned int Count() const;
+
+	static uint64_t HashName( const char * name );
+
+	std::vector< reflectEntry_t > slots;
+	std::vector< uint32_t > displacements; //per bucket
+	uint64_t slotMask;
+	uint64_t bucketMask;
+};
+
 class Buffer {
 	public:
 		Buffer() { m_initialized = false; m_pinned = false; };
@@ -25,6 +75,7 @@ class Buffer {
 		void DeleteBuffer();
 
 		void Initialize( GLsizeiptr size, const void * data, GLenum usage );
+		void Upload( const GLsizeiptr size, const void * data );
 		Buffer * GetBuffer( const char *name );
 		const GLuint GetID() const { return m_id; }
 		const char * GetName() const { return m_name; }
@@ -45,6 +96,31 @@ class Buffer {
 	friend Shader;
 };
 
+/*
+==============================
+UniformBlock
+	-buffer backing std140 uniform blocks. Ranges of one buffer can be bound to a binding point,
+	 so many small blocks can share it.
+==============================
+*/
+class UniformBlock {
+	public:
+		UniformBlock() { m_id = 0; m_size = 0; }
+		~UniformBlock() {};
+
+		void Upload( const GLsizeiptr size, const void * data );
+		void BindBase( const GLuint bindingPoint ) const;
+		void BindRange( const GLuint bindingPoint, const GLintptr offset, const GLsizeiptr size ) const;
+		void Delete();
+		GLuint GetID() const { return m_id; }
+
+		static GLint OffsetAlignment();
+
+	private:
+		GLuint m_id;
+		GLsizeiptr m_size;
+};
+
 /*
 ==============================
 Shader
@@ -57,8 +133,8 @@ public:
 
 	static void myglGetError();
 	
-	Shader * GetShader( const char *sprefix );
-	Shader * LoadShader( const char *sprefix );
+	Shader * GetShader( const char *sprefix, const char * defines = NULL );
+	Shader * LoadShader( const char *sprefix, const char * defines = NULL );
 	const GLuint IDByName( const char * sprefix );
 
 	bool CompileShaderFromCSTR( const char * cshaderSource );
@@ -72,12 +148,24 @@ public:
 
 	void DeleteProgram();
 	static void DeleteAllPrograms();
+	static void LoadedPermutations( std::vector< std::string > & prefixes, std::vector< std::string > & permutations );
+	static unsigned int ReloadChanged();
+	bool Reload();
+	static const ShaderWatcher & Watcher();
 
 	void PinShader();
 	void UnpinShader();
 
 	GLuint GetUniform( const char * name );
+	uniformHandle_t GetUniformHandle( const char * name ) const;
 	int GetAttribute( const char * name );
+	const std::string & GetPrefix() const { return m_prefix; }
+	const std::string & GetPermutation() const { return m_permutation; } //defines it was built with, see ShaderPreprocessor::PermutationKey
+	unsigned int GetLinkId() const { return m_linkId; } //changes whenever the program is relinked, handles resolved before are stale
+	const reflectEntry_t * FindUniformBlock( const char * name ) const { return m_uniformBlocks.Find( name ); }
+	const reflectEntry_t * FindBlockMember( const char * name ) const { return m_blockMembers.Find( name ); }
+	bool HasStorageBlock( const char * name ) const { return m_storageBlocks.Find( name ) != NULL; }
+	bool HasUniform( const char * name ) const { return m_uniforms.Find( name ) != NULL; } //active in the default block
 
 	void AddBuffer( Buffer * buffer );
 	unsigned int BufferCount() const { return m_buffers.size(); }
@@ -97,22 +185,45 @@ public:
 	void SetUniformMatrix4f( const char * uniform, const int count, const bool transpose, const float * values );
 	void SetAndBindUniformTexture( const char * uniform, const int textureSlot, const GLenum textureTarget, const GLuint textureID );
 	void SetVertexAttribPointer( const char * attribute, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid * pointer );
+
+	//setters taking a handle skip the name lookup
+	void SetUniform1i( const uniformHandle_t handle, const int count, const int * values );
+	void SetUniform1f( const uniformHandle_t handle, const int count, const float * values );
+	void SetUniform3f( const uniformHandle_t handle, const int count, const float * values );
+	void SetUniform4f( const uniformHandle_t handle, const int count, const float * values );
+	void SetUniformMatrix4f( const uniformHandle_t handle, const int count, const bool transpose, const float * values );
+	void SetAndBindUniformTexture( const uniformHandle_t handle, const int textureSlot, const GLenum textureTarget, const GLuint textureID );
+
+	static bool s_uniformCache; //when off, every set queries the location and checks for errors like before the cache
+	static bool s_hotReload; //rebuild programs whose shader files changed, see ReloadChanged
+	static unsigned int s_reloads;
+	static unsigned int s_failedReloads; //the previous program was kept
 	
 private:
 	GLuint mShaderProgram;
 	void PrintLog( const GLuint shader, const char * logname ) const;
+	void Reflect();
+	void CheckSetterErrors() const;
+	void TakeProgram( Shader * rebuilt );
+
+	reflectTable_t m_uniforms; //active uniforms, arrays by their name with and without [0]
+	reflectTable_t m_storageBlocks; //shader storage block indices
+	reflectTable_t m_uniformBlocks; //uniform block indices and sizes
+	reflectTable_t m_blockMembers; //offsets of the members of uniform blocks
+	unsigned int m_linkId;
+	static unsigned int s_linkCount;
+	std::string m_prefix;
+	std::string m_permutation;
+	std::vector< std::string > m_sourceFiles; //every file of every stage, includes too
 
 	bufferMap m_buffers;
 
-	unsigned int CompileVertexShader( const char *vshaderFile );
-	unsigned int CompileGeometryShader( const char *gshaderFile );
-	unsigned int CompileFragmentShader( const char *fshaderFile );
-	unsigned int CompileComputeShader( const char *cshaderFile );
-	bool CompileShaderFromFile( const char *cshaderFile );
-	bool CompileShaderFromFile( const char *vshaderFile, const char *fshaderFile );
-	bool CompileShaderFromFile( const char *vshaderFile, const char *gshaderFile, const char *fshaderFile );
+	bool LoadProgramBinary( const char * relativePath, const programKey_t & key );
+	void SaveProgramBinary( const char * relativePath, const programKey_t & key ) const;
+	static bool ProgramBinariesSupported();
 
 	static resourceMap_s s_shaders;
+	static ShaderWatcher s_watcher; //files of every program in s_shaders, by its s_shaders name
 
 	bool m_pinned;
 };
@@ -0,0 +1,295 @@
+#include "ShaderPreprocessor.h"
+#include "Fileio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+std::map< std::string, std::string > ShaderPreprocessor::s_files;
+std::map< std::string, std::string > ShaderPreprocessor::s_globalDefines;
+unsigned int ShaderPreprocessor::s_fileReads = 0;
+
+/*
+================================
+ShaderPreprocessor::NormalizePath
+	-lower case with back slashes and without . or .. parts, so every spelling of a path is one file
+================================
+*/
+std::string ShaderPreprocessor::NormalizePath( const std::string & path ) {
+	std::vector< std::string > parts;
+	std::string part;
+	for ( unsigned int i = 0; i <= path.size(); i++ ) {
+		const char c = ( i < path.size() ) ? path[i] : '\\';
+		if ( c == '\\' || c == '/' ) {
+			if ( part == ".." && !parts.empty() && parts.back() != ".." ) {
+				parts.pop_back();
+			} else if ( !part.empty() && part != "." ) {
+				parts.push_back( part );
+			}
+			part.clear();
+		} else {
+			part += ( char )tolower( ( unsigned char )c );
+		}
+	}
+
+	std::string normalized;
+	for ( unsigned int i = 0; i < parts.size(); i++ ) {
+		if ( i > 0 ) {
+			normalized += '\\';
+		}
+		normalized += parts[i];
+	}
+	return normalized;
+}
+
+/*
+================================
+ShaderPreprocessor::ParseDefines
+	-splits "NAME=VALUE NAME2" on spaces and commas, a define without a value is 1. Later defines
+	 replace earlier ones of the same name.
+================================
+*/
+void ShaderPreprocessor::ParseDefines( const char * defines, std::map< std::string, std::string > & parsed ) {
+	if ( defines == NULL ) {
+		return;
+	}
+
+	const char * c = defines;
+	while ( *c != '\0' ) {
+		while ( *c == ' ' || *c == '\t' || *c == ',' ) {
+			c++;
+		}
+		std::string token;
+		while ( *c != '\0' && *c != ' ' && *c != '\t' && *c != ',' ) {
+			token += *c++;
+		}
+		if ( token.empty() ) {
+			continue;
+		}
+
+		const size_t equals = token.find( '=' );
+		const std::string name = token.substr( 0, equals );
+		const std::string value = ( equals == std::string::npos ) ? "1" : token.substr( equals + 1 );
+		bool validName = !name.empty() && !isdigit( ( unsigned char )name[0] );
+		for ( unsigned int i = 0; i < name.size(); i++ ) {
+			validName = validName && ( isalnum( ( unsigned char )name[i] ) || name[i] == '_' );
+		}
+		if ( !validName || value.empty() ) {
+			printf( "Ignoring bad shader define: %s\n", token.c_str() );
+			continue;
+		}
+		parsed[ name ] = value;
+	}
+}
+
+/*
+================================
+ShaderPreprocessor::PermutationKey
+	-the defines sorted by name, so the same permutation always gets the same key
+================================
+*/
+std::string ShaderPreprocessor::PermutationKey( const char * defines ) {
+	std::map< std::string, std::string > parsed;
+	ParseDefines( defines, parsed );
+
+	std::string key;
+	std::map< std::string, std::string >::iterator it = parsed.begin();
+	while ( it != parsed.end() ) {
+		if ( !key.empty() ) {
+			key += ' ';
+		}
+		key += it->first + "=" + it->second;
+		it++;
+	}
+	return key;
+}
+
+/*
+================================
+ShaderPreprocessor::SetGlobalDefine
+	-defined for every stage processed afterwards
+================================
+*/
+void ShaderPreprocessor::SetGlobalDefine( const char * name, const int value ) {
+	char valueStr[32];
+	sprintf( valueStr, "%d", value );
+	s_globalDefines[ name ] = valueStr;
+}
+
+/*
+================================
+ShaderPreprocessor::SetFileText
+================================
+*/
+void ShaderPreprocessor::SetFileText( const char * relativePath, const char * text ) {
+	s_files[ NormalizePath( relativePath ) ] = text;
+}
+
+/*
+================================
+ShaderPreprocessor::ClearFiles
+	-forgets every file read so far, they are read again the next time they are used
+================================
+*/
+void ShaderPreprocessor::ClearFiles() {
+	s_files.clear();
+}
+
+/*
+================================
+ShaderPreprocessor::ForgetFile
+================================
+*/
+void ShaderPreprocessor::ForgetFile( const char * relativePath ) {
+	s_files.erase( NormalizePath( relativePath ) );
+}
+
+/*
+================================
+ShaderPreprocessor::FileText
+	-NULL if the file cant be read
+================================
+*/
+const std::string * ShaderPreprocessor::FileText( const std::string & relativePath ) {
+	std::map< std::string, std::string >::iterator it = s_files.find( relativePath );
+	if ( it != s_files.end() ) {
+		return &it->second;
+	}
+
+	unsigned char * data = NULL;
+	unsigned int size = 0;
+	if ( !GetFileData( relativePath.c_str(), &data, size ) || data == NULL ) {
+		return NULL;
+	}
+	s_fileReads++;
+	std::string & text = s_files[ relativePath ];
+	text.assign( ( const char * )data, size );
+	free( data );
+	return &text;
+}
+
+/*
+================================
+ShaderPreprocessor::Expand
+	-appends the lines of relativePath to source, replacing includes by the included text. The
+	 defines go after the #version line of the stage file.
+================================
+*/
+bool ShaderPreprocessor::Expand( const std::string & relativePath, const unsigned int depth, const std::string & defineLines, shaderSource_t & source, std::set< std::string > & included, bool & definesInserted ) {
+	const std::string * text = FileText( relativePath );
+	if ( text == NULL ) {
+		printf( "Failed to read shader file: %s\n", relativePath.c_str() );
+		return false;
+	}
+
+	const unsigned int fileIndex = ( unsigned int )source.files.size();
+	source.files.push_back( relativePath );
+	included.insert( relativePath );
+	const size_t slash = relativePath.find_last_of( '\\' );
+	const std::string directory = ( slash == std::string::npos ) ? "" : relativePath.substr( 0, slash + 1 );
+
+	char lineDirective[64];
+	if ( depth > 0 ) {
+		sprintf( lineDirective, "#line 1 %u\n", fileIndex );
+		source.text += lineDirective;
+	}
+
+	unsigned int lineNumber = 0;
+	bool resyncLines = false;
+	size_t lineStart = 0;
+	while ( lineStart < text->size() ) {
+		size_t lineEnd = text->find( '\n', lineStart );
+		if ( lineEnd == std::string::npos ) {
+			lineEnd = text->size();
+		}
+		std::string line = text->substr( lineStart, lineEnd - lineStart );
+		if ( !line.empty() && line.back() == '\r' ) {
+			line.pop_back();
+		}
+		lineStart = lineEnd + 1;
+		lineNumber++;
+
+		const size_t first = line.find_first_not_of( " \t" );
+		const char * directive = ( first == std::string::npos ) ? "" : line.c_str() + first;
+
+		if ( strncmp( directive, "#include", 8 ) == 0 ) {
+			const char * open = strchr( directive + 8, '"' );
+			const char * close = ( open != NULL ) ? strchr( open + 1, '"' ) : NULL;
+			if ( close == NULL || close == open + 1 ) {
+				printf( "%s(%u): #include needs a quoted file name\n", relativePath.c_str(), lineNumber );
+				return false;
+			}
+			const std::string includePath = NormalizePath( directory + std::string( open + 1, close ) );
+			if ( included.count( includePath ) != 0 ) {
+				source.text += "\n"; //already in this stage, the blank line keeps the line numbers
+				continue;
+			}
+			if ( !Expand( includePath, depth + 1, defineLines, source, included, definesInserted ) ) {
+				printf( "%s(%u): included from here\n", relativePath.c_str(), lineNumber );
+				return false;
+			}
+			sprintf( lineDirective, "#line %u %u\n", lineNumber + 1, fileIndex );
+			source.text += lineDirective;
+			resyncLines = true;
+			continue;
+		}
+
+		//an include in a group the compiler skips also skips the #line after it, so set it again
+		if ( resyncLines && ( strncmp( directive, "#else", 5 ) == 0 || strncmp( directive, "#elif", 5 ) == 0 || strncmp( directive, "#endif", 6 ) == 0 ) ) {
+			sprintf( lineDirective, "#line %u %u\n", lineNumber + 1, fileIndex );
+			source.text += line + "\n" + lineDirective;
+			continue;
+		}
+
+		if ( strncmp( directive, "#version", 8 ) == 0 ) {
+			if ( depth > 0 ) {
+				printf( "%s(%u): #version is only allowed in the stage file\n", relativePath.c_str(), lineNumber );
+				return false;
+			}
+			source.text += line + "\n";
+			if ( !definesInserted ) {
+				source.text += defineLines;
+				sprintf( lineDirective, "#line %u 0\n", lineNumber + 1 );
+				source.text += lineDirective;
+				definesInserted = true;
+			}
+			continue;
+		}
+
+		source.text += line + "\n";
+	}
+	return true;
+}
+
+/*
+================================
+ShaderPreprocessor::Process
+	-source of one stage with its includes expanded and the global and permutation defines set
+================================
+*/
+bool ShaderPreprocessor::Process( const char * relativePath, const char * defines, shaderSource_t & source ) {
+	source.text.clear();
+	source.files.clear();
+
+	std::map< std::string, std::string > merged = s_globalDefines;
+	ParseDefines( defines, merged );
+	std::string defineLines;
+	std::map< std::string, std::string >::iterator it = merged.begin();
+	while ( it != merged.end() ) {
+		defineLines += "#define " + it->first + " " + it->second + "\n";
+		it++;
+	}
+
+	std::set< std::string > included;
+	bool definesInserted = false;
+	if ( !Expand( NormalizePath( relativePath ), 0, defineLines, source, included, definesInserted ) ) {
+		return false;
+	}
+
+	//without a #version line the defines go first
+	if ( !definesInserted && !defineLines.empty() ) {
+		source.text = defineLines + "#line 1 0\n" + source.text;
+	}
+	return true;
+}
\ No newline at end of file
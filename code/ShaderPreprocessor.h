@@ -0,0 +1,49 @@
+#pragma once
+#ifndef __SHADERPREPROCESSOR_H_INCLUDE__
+#define __SHADERPREPROCESSOR_H_INCLUDE__
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+struct shaderSource_t {
+	std::string text;
+	std::vector< std::string > files; //indexed by the source string number of the #line directives, 0 is the stage file
+};
+
+/*
+==============================
+ShaderPreprocessor
+	-expands #include "file" in GLSL, relative to the including file. A file is only expanded the
+	 first time it is included by a stage, so shared files need no guards and cycles end.
+	-#line directives are emitted around every include so compile errors point at the right file
+	 and line. The source string numbers index shaderSource_t::files.
+	-a permutation is a list of defines like "SHADOWS=0 IBL=0". They are inserted after #version
+	 together with the global defines, a permutation overrides a global define of the same name.
+	-files are read once and kept.
+==============================
+*/
+class ShaderPreprocessor {
+	public:
+		static bool Process( const char * relativePath, const char * defines, shaderSource_t & source );
+		static std::string PermutationKey( const char * defines );
+
+		static void SetGlobalDefine( const char * name, const int value );
+		static void SetFileText( const char * relativePath, const char * text ); //used instead of the file on disk
+		static void ClearFiles();
+		static void ForgetFile( const char * relativePath ); //read again the next time it is used
+
+		static unsigned int s_fileReads; //files read from disk so far
+
+	private:
+		static bool Expand( const std::string & relativePath, const unsigned int depth, const std::string & defineLines, shaderSource_t & source, std::set< std::string > & included, bool & definesInserted );
+		static const std::string * FileText( const std::string & relativePath );
+		static std::string NormalizePath( const std::string & path );
+		static void ParseDefines( const char * defines, std::map< std::string, std::string > & parsed );
+
+		static std::map< std::string, std::string > s_files; //text of every file read, by normalized path
+		static std::map< std::string, std::string > s_globalDefines;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "ShaderWatcher.h"
+#include "Fileio.h"
+
+#include <stdio.h>
+#include <windows.h>
+
+double ShaderWatcher::s_pollSeconds = 0.5;
+
+/*
+================================
+ShaderWatcher::Stamp
+	-all 0 for a file that doesnt exist
+================================
+*/
+fileStamp_t ShaderWatcher::Stamp( const std::string & relativePath ) {
+	fileStamp_t stamp;
+	if ( !BuildManifest::GetFileStamp( relativePath.c_str(), stamp ) ) {
+		stamp.size = 0;
+		stamp.writeTime = 0;
+	}
+	return stamp;
+}
+
+/*
+================================
+ShaderWatcher::Watch
+	-replaces the files of program. Files that were already watched keep their stamp, so a change
+	 made before the program was rebuilt is still found by the next poll.
+================================
+*/
+void ShaderWatcher::Watch( const char * program, const std::vector< std::string > & files ) {
+	std::vector< std::string > & watched = m_programFiles[ program ];
+	const std::vector< std::string > previous = watched;
+	watched = files;
+
+	for ( size_t i = 0; i < files.size(); i++ ) {
+		if ( m_stamps.find( files[i] ) == m_stamps.end() ) {
+			m_stamps[ files[i] ] = Stamp( files[i] );
+		}
+		m_fileDependents[ files[i] ].insert( program );
+	}
+
+	//files the program doesnt include anymore
+	for ( size_t i = 0; i < previous.size(); i++ ) {
+		bool kept = false;
+		for ( size_t j = 0; j < files.size() && !kept; j++ ) {
+			kept = ( files[j] == previous[i] );
+		}
+		if ( kept ) {
+			continue;
+		}
+		std::map< std::string, std::set< std::string > >::iterator it = m_fileDependents.find( previous[i] );
+		if ( it == m_fileDependents.end() ) {
+			continue;
+		}
+		it->second.erase( program );
+		if ( it->second.empty() ) {
+			m_stamps.erase( previous[i] );
+			m_fileDependents.erase( it );
+		}
+	}
+}
+
+/*
+================================
+ShaderWatcher::Unwatch
+================================
+*/
+void ShaderWatcher::Unwatch( const char * program ) {
+	std::map< std::string, std::vector< std::string > >::iterator programIt = m_programFiles.find( program );
+	if ( programIt == m_programFiles.end() ) {
+		return;
+	}
+	const std::vector< std::string > & files = programIt->second;
+	for ( size_t i = 0; i < files.size(); i++ ) {
+		std::map< std::string, std::set< std::string > >::iterator it = m_fileDependents.find( files[i] );
+		if ( it == m_fileDependents.end() ) {
+			continue;
+		}
+		it->second.erase( program );
+		if ( it->second.empty() ) {
+			m_stamps.erase( files[i] );
+			m_fileDependents.erase( it );
+		}
+	}
+	m_programFiles.erase( programIt );
+}
+
+/*
+================================
+ShaderWatcher::Clear
+================================
+*/
+void ShaderWatcher::Clear() {
+	m_programFiles.clear();
+	m_fileDependents.clear();
+	m_stamps.clear();
+}
+
+/*
+================================
+ShaderWatcher::Dependents
+	-every program using one of the changed files, once each and sorted by name
+================================
+*/
+void ShaderWatcher::Dependents( const std::vector< std::string > & changedFiles, std::vector< std::string > & programs ) const {
+	std::set< std::string > dependents;
+	for ( size_t i = 0; i < changedFiles.size(); i++ ) {
+		std::map< std::string, std::set< std::string > >::const_iterator it = m_fileDependents.find( changedFiles[i] );
+		if ( it != m_fileDependents.end() ) {
+			dependents.insert( it->second.begin(), it->second.end() );
+		}
+	}
+	programs.assign( dependents.begin(), dependents.end() );
+}
+
+/*
+================================
+ShaderWatcher::Start
+	-false if the directory cant be watched, Update polls on the timer then
+================================
+*/
+bool ShaderWatcher::Start( const char * relativeDirectory ) {
+	Stop();
+
+	char fullPath[ 2048 ];
+	RelativePathToFullPath( relativeDirectory, fullPath );
+	HANDLE notification = FindFirstChangeNotificationA( fullPath, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE );
+	if ( notification == INVALID_HANDLE_VALUE ) {
+		printf( "Couldn't watch %s, polling shader files every %.2fs\n", fullPath, s_pollSeconds );
+		return false;
+	}
+	m_notification = notification;
+	return true;
+}
+
+/*
+================================
+ShaderWatcher::Stop
+================================
+*/
+void ShaderWatcher::Stop() {
+	if ( m_notification != NULL ) {
+		FindCloseChangeNotification( ( HANDLE )m_notification );
+		m_notification = NULL;
+	}
+}
+
+/*
+================================
+ShaderWatcher::Poll
+	-the watched files whose stamp changed since the last poll
+================================
+*/
+void ShaderWatcher::Poll( std::vector< std::string > & changedFiles ) {
+	changedFiles.clear();
+	m_lastPoll = std::chrono::steady_clock::now();
+
+	std::map< std::string, fileStamp_t >::iterator it = m_stamps.begin();
+	while ( it != m_stamps.end() ) {
+		const fileStamp_t stamp = Stamp( it->first );
+		if ( stamp.size != it->second.size || stamp.writeTime != it->second.writeTime ) {
+			it->second = stamp;
+			changedFiles.push_back( it->first );
+		}
+		it++;
+	}
+}
+
+/*
+================================
+ShaderWatcher::Update
+	-called once a frame, polls when the directory changed or the poll interval passed. True if
+	 a watched file changed.
+================================
+*/
+bool ShaderWatcher::Update( std::vector< std::string > & changedFiles ) {
+	changedFiles.clear();
+	if ( m_notification != NULL ) {
+		if ( WaitForSingleObject( ( HANDLE )m_notification, 0 ) != WAIT_OBJECT_0 ) {
+			return false;
+		}
+
+		//rearmed before the poll so a write during it signals again
+		if ( FindNextChangeNotification( ( HANDLE )m_notification ) == 0 ) {
+			printf( "Shader change notification failed, polling shader files every %.2fs\n", s_pollSeconds );
+			Stop();
+		}
+	} else if ( std::chrono::duration< double >( std::chrono::steady_clock::now() - m_lastPoll ).count() < s_pollSeconds ) {
+		return false;
+	}
+
+	Poll( changedFiles );
+	return !changedFiles.empty();
+}
\ No newline at end of file
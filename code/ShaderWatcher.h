@@ -0,0 +1,54 @@
+#pragma once
+#ifndef __SHADERWATCHER_H_INCLUDE__
+#define __SHADERWATCHER_H_INCLUDE__
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "BuildManifest.h"
+
+/*
+==============================
+ShaderWatcher
+	-which programs use which shader files, stage files and everything they include. Built from
+	 shaderSource_t::files, so a program is only rebuilt when one of its own files changed.
+	-changes are found by comparing the size and write time of every watched file against the last
+	 poll. Start registers a change notification on the shader directory so the files are only
+	 polled after something in it was written. Without one they are polled every s_pollSeconds.
+	-missing files are watched too, their stamp is all 0 until they are written again.
+==============================
+*/
+class ShaderWatcher {
+	public:
+		ShaderWatcher() { m_notification = NULL; }
+		~ShaderWatcher() { Stop(); }
+
+		void Watch( const char * program, const std::vector< std::string > & files );
+		void Unwatch( const char * program );
+		void Clear();
+		void Dependents( const std::vector< std::string > & changedFiles, std::vector< std::string > & programs ) const;
+		unsigned int ProgramCount() const { return ( unsigned int )m_programFiles.size(); }
+		unsigned int FileCount() const { return ( unsigned int )m_stamps.size(); }
+
+		bool Start( const char * relativeDirectory );
+		void Stop();
+		bool IsNotified() const { return m_notification != NULL; }
+		void Poll( std::vector< std::string > & changedFiles );
+		bool Update( std::vector< std::string > & changedFiles );
+
+		static double s_pollSeconds; //between polls without a change notification
+
+	private:
+		static fileStamp_t Stamp( const std::string & relativePath );
+
+		std::map< std::string, std::vector< std::string > > m_programFiles;
+		std::map< std::string, std::set< std::string > > m_fileDependents; //programs by file
+		std::map< std::string, fileStamp_t > m_stamps; //of every watched file at the last poll
+		void * m_notification; //HANDLE of the directory change notification, NULL when polling
+		std::chrono::steady_clock::time_point m_lastPoll;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "ShadowScheduler.h"
+
+#include <algorithm>
+#include <math.h>
+
+shadowBudget_t ShadowScheduler::s_budgetType = SHADOW_BUDGET_PARTITIONS;
+unsigned int ShadowScheduler::s_budget = 12; //two point lights worth of partitions
+unsigned int ShadowScheduler::s_maxStaleness = 30;
+
+struct scheduleEntry_t {
+	const shadowRequest_t * request;
+	float key; //sorted descending
+	unsigned int tie; //sorted ascending
+};
+
+/*
+================================
+CompareScheduleEntries
+================================
+*/
+static bool CompareScheduleEntries( const scheduleEntry_t& a, const scheduleEntry_t& b ) {
+	if ( a.key != b.key ) {
+		return a.key > b.key;
+	}
+	return a.tie < b.tie;
+}
+
+/*
+================================
+ShadowScheduler::RequestCost
+================================
+*/
+unsigned int ShadowScheduler::RequestCost( const shadowRequest_t& request ) const {
+	if ( s_budgetType == SHADOW_BUDGET_TRIANGLES ) {
+		return request.triangles;
+	}
+	return request.partitions;
+}
+
+/*
+================================
+ShadowScheduler::Staleness
+================================
+*/
+unsigned int ShadowScheduler::Staleness( const unsigned int lightIdx ) const {
+	if ( lightIdx >= m_staleness.size() ) {
+		return 0;
+	}
+	return m_staleness[lightIdx];
+}
+
+/*
+================================
+ShadowScheduler::MaxStaleness
+	-most frames a light can wait. It is overdue after s_maxStaleness frames, then at most every
+	 other light is ahead of it since overdue lights go oldest first and the first one is always
+	 rendered.
+================================
+*/
+unsigned int ShadowScheduler::MaxStaleness( const unsigned int lightCount ) {
+	return s_maxStaleness + ( ( lightCount > 0 ) ? lightCount - 1 : 0 );
+}
+
+/*
+================================
+ShadowScheduler::Schedule
+	-requests are the lights that need their shadows rendered this frame.
+	-scheduled is filled with the light idxs that fit in this frame's budget.
+	-requests that werent scheduled age by one frame. The caller is responsible for keeping them dirty.
+================================
+*/
+void ShadowScheduler::Schedule( const std::vector< shadowRequest_t >& requests, std::vector< unsigned int >& scheduled ) {
+	scheduled.clear();
+
+	for ( unsigned int i = 0; i < requests.size(); i++ ) {
+		if ( requests[i].lightIdx >= m_staleness.size() ) {
+			m_staleness.resize( requests[i].lightIdx + 1, 0 );
+		}
+	}
+	const unsigned int lightCount = m_staleness.size();
+	if ( lightCount > 0 ) {
+		m_cursor = m_cursor % lightCount;
+	}
+
+	//split requests into tiers
+	std::vector< scheduleEntry_t > overdue;
+	std::vector< scheduleEntry_t > onScreen;
+	std::vector< scheduleEntry_t > offScreen;
+	for ( unsigned int i = 0; i < requests.size(); i++ ) {
+		const shadowRequest_t * request = &requests[i];
+		const unsigned int staleness = m_staleness[request->lightIdx];
+
+		scheduleEntry_t entry;
+		entry.request = request;
+		if ( staleness >= s_maxStaleness ) {
+			entry.key = ( float )staleness;
+			entry.tie = request->lightIdx;
+			overdue.push_back( entry );
+		} else if ( request->coverage > 0.0f ) {
+			entry.key = request->coverage * ( 1.0f + ( float )staleness );
+			entry.tie = request->lightIdx;
+			onScreen.push_back( entry );
+		} else {
+			entry.key = 0.0f;
+			entry.tie = ( request->lightIdx + lightCount - m_cursor ) % lightCount; //distance from the round robin cursor
+			offScreen.push_back( entry );
+		}
+	}
+	std::sort( overdue.begin(), overdue.end(), CompareScheduleEntries );
+	std::sort( onScreen.begin(), onScreen.end(), CompareScheduleEntries );
+	std::sort( offScreen.begin(), offScreen.end(), CompareScheduleEntries );
+
+	std::vector< scheduleEntry_t > ordered;
+	ordered.insert( ordered.end(), overdue.begin(), overdue.end() );
+	ordered.insert( ordered.end(), onScreen.begin(), onScreen.end() );
+	ordered.insert( ordered.end(), offScreen.begin(), offScreen.end() );
+
+	//fill the budget
+	std::vector< bool > isScheduled( lightCount, false );
+	unsigned int remaining = s_budget;
+	bool scheduledOffScreen = false;
+	unsigned int lastOffScreenIdx = 0;
+	for ( unsigned int i = 0; i < ordered.size(); i++ ) {
+		const shadowRequest_t * request = ordered[i].request;
+		const unsigned int cost = RequestCost( *request );
+		if ( !scheduled.empty() && cost > remaining ) {
+			continue;
+		}
+		remaining -= std::min( cost, remaining );
+		scheduled.push_back( request->lightIdx );
+		isScheduled[request->lightIdx] = true;
+
+		if ( i >= overdue.size() + onScreen.size() ) {
+			scheduledOffScreen = true;
+			lastOffScreenIdx = request->lightIdx;
+		}
+	}
+
+	//age requests that didnt make it. Lights without a request have nothing to wait for.
+	std::vector< unsigned int > staleness( lightCount, 0 );
+	for ( unsigned int i = 0; i < requests.size(); i++ ) {
+		const unsigned int lightIdx = requests[i].lightIdx;
+		if ( !isScheduled[lightIdx] ) {
+			staleness[lightIdx] = m_staleness[lightIdx] + 1;
+		}
+	}
+	m_staleness = staleness;
+
+	//continue the round robin after the last off screen light that was rendered
+	if ( scheduledOffScreen ) {
+		m_cursor = ( lastOffScreenIdx + 1 ) % lightCount;
+	}
+}
+
+/*
+================================
+ShadowScheduler::EstimateCoverage
+	-rough fraction of the screen covered by a sphere. fovy is in radians.
+================================
+*/
+float ShadowScheduler::EstimateCoverage( const Vec3& center, const float radius, const Vec3& camPos, const Vec3& camLook, const float fovy, const float aspect ) {
+	const Vec3 toCenter = center - camPos;
+	const float dist = toCenter.length();
+	if ( dist <= radius ) {
+		return 1.0f; //camera is inside the volume
+	}
+
+	const float depth = toCenter.dot( camLook );
+	if ( depth < -radius ) {
+		return 0.0f; //behind the camera
+	}
+
+	//projected radius in ndc units (the screen is 2 units tall)
+	const float tanHalfFov = tanf( fovy / 2.0f );
+	const float projRadius = radius / ( sqrtf( dist * dist - radius * radius ) * tanHalfFov );
+
+	//reject spheres that are entirely to the side of the screen
+	if ( depth > 0.0f ) {
+		Vec3 right = camLook.cross( Vec3( 0.0f, 1.0f, 0.0f ) );
+		if ( right.length() <= EPSILON ) {
+			right = camLook.cross( Vec3( 1.0f, 0.0f, 0.0f ) );
+		}
+		right.normalize();
+		const Vec3 up = right.cross( camLook ).normal();
+		const float x = toCenter.dot( right ) / ( depth * tanHalfFov * aspect );
+		const float y = toCenter.dot( up ) / ( depth * tanHalfFov );
+		if ( fabs( x ) > 1.0f + projRadius / aspect || fabs( y ) > 1.0f + projRadius ) {
+			return 0.0f;
+		}
+	}
+
+	const float coverage = ( float )PI * projRadius * projRadius / ( 4.0f * aspect );
+	return std::min( coverage, 1.0f );
+}
+
+/*
+================================
+SimRandom
+	-lcg so that the simulation gives the same results on every platform
+================================
+*/
+static unsigned int SimRandom( unsigned int * state ) {
+	*state = *state * 1664525u + 1013904223u;
+	return *state >> 8;
+}
+
+/*
+================================
+ShadowScheduler::Simulate
+	-runs the scheduler against a synthetic scene using the current budget settings.
+	-every third light is a point light. Every eighth light doesnt cache its shadows.
+	-cached lights get dirtied by moving casters, and the camera moves every 100 frames.
+================================
+*/
+shadowSimStats_t ShadowScheduler::Simulate( const unsigned int lightCount, const unsigned int frameCount, const unsigned int seed ) {
+	const unsigned int trianglesPerPartition = 20000;
+
+	unsigned int rng = seed;
+	std::vector< bool > pending( lightCount, false );
+	std::vector< unsigned int > dirtySince( lightCount, 0 );
+	std::vector< float > coverage( lightCount, 0.0f );
+	for ( unsigned int i = 0; i < lightCount; i++ ) {
+		pending[i] = true; //every light starts out dirty
+	}
+
+	shadowSimStats_t stats;
+	stats.frames = frameCount;
+	stats.maxCost = 0;
+	stats.overBudgetFrames = 0;
+	stats.avgCost = 0.0f;
+	stats.maxStaleness = 0;
+	stats.avgLatency = 0.0f;
+	stats.starvedLights = 0;
+	stats.checksum = 2166136261u;
+
+	ShadowScheduler scheduler;
+	std::vector< shadowRequest_t > requests;
+	std::vector< unsigned int > scheduled;
+	double totalCost = 0.0;
+	double totalLatency = 0.0;
+	unsigned int renderCount = 0;
+	for ( unsigned int frame = 0; frame < frameCount; frame++ ) {
+		//move the camera
+		if ( frame % 100 == 0 ) {
+			for ( unsigned int i = 0; i < lightCount; i++ ) {
+				const bool visible = ( SimRandom( &rng ) % 2 ) == 0;
+				coverage[i] = visible ? ( float )( SimRandom( &rng ) % 1000 ) / 1000.0f * 0.3f : 0.0f;
+			}
+		}
+
+		//move shadow casters
+		for ( unsigned int i = 0; i < lightCount; i++ ) {
+			const bool cached = ( i % 8 ) != 7;
+			const bool moved = ( SimRandom( &rng ) % 100 ) < 5;
+			if ( ( !cached || moved ) && !pending[i] ) {
+				pending[i] = true;
+				dirtySince[i] = frame;
+			}
+		}
+
+		requests.clear();
+		for ( unsigned int i = 0; i < lightCount; i++ ) {
+			if ( !pending[i] ) {
+				continue;
+			}
+			shadowRequest_t request;
+			request.lightIdx = i;
+			request.partitions = ( i % 3 == 0 ) ? 6 : 1;
+			request.triangles = request.partitions * trianglesPerPartition;
+			request.coverage = coverage[i];
+			requests.push_back( request );
+		}
+
+		scheduler.Schedule( requests, scheduled );
+
+		unsigned int frameCost = 0;
+		unsigned int firstCost = 0; //the first light is rendered even when it alone is over budget
+		for ( unsigned int i = 0; i < scheduled.size(); i++ ) {
+			const unsigned int lightIdx = scheduled[i];
+			for ( unsigned int j = 0; j < requests.size(); j++ ) {
+				if ( requests[j].lightIdx == lightIdx ) {
+					const unsigned int cost = scheduler.RequestCost( requests[j] );
+					frameCost += cost;
+					if ( i == 0 ) {
+						firstCost = cost;
+					}
+					break;
+				}
+			}
+			totalLatency += ( double )( frame - dirtySince[lightIdx] );
+			renderCount += 1;
+			pending[lightIdx] = false;
+
+			//FNV-1a over frame and light idx
+			stats.checksum = ( stats.checksum ^ frame ) * 16777619u;
+			stats.checksum = ( stats.checksum ^ lightIdx ) * 16777619u;
+		}
+		totalCost += ( double )frameCost;
+		stats.maxCost = std::max( stats.maxCost, frameCost );
+		if ( frameCost > std::max( s_budget, firstCost ) ) {
+			stats.overBudgetFrames += 1;
+		}
+
+		for ( unsigned int i = 0; i < lightCount; i++ ) {
+			stats.maxStaleness = std::max( stats.maxStaleness, scheduler.Staleness( i ) );
+		}
+	}
+
+	for ( unsigned int i = 0; i < lightCount; i++ ) {
+		if ( scheduler.Staleness( i ) > s_maxStaleness ) {
+			stats.starvedLights += 1;
+		}
+	}
+	if ( frameCount > 0 ) {
+		stats.avgCost = ( float )( totalCost / ( double )frameCount );
+	}
+	if ( renderCount > 0 ) {
+		stats.avgLatency = ( float )( totalLatency / ( double )renderCount );
+	}
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef __SHADOWSCHEDULER_H_INCLUDE__
+#define __SHADOWSCHEDULER_H_INCLUDE__
+
+#include <vector>
+#include "Vector.h"
+
+enum shadowBudget_t {
+	SHADOW_BUDGET_PARTITIONS = 0,
+	SHADOW_BUDGET_TRIANGLES
+};
+
+struct shadowRequest_t {
+	unsigned int lightIdx;
+	unsigned int partitions; //atlas partitions the light renders to
+	unsigned int triangles; //estimated triangles submitted for all partitions
+	float coverage; //fraction of the screen covered by the light's volume [0,1]
+};
+
+struct shadowSimStats_t {
+	unsigned int frames;
+	unsigned int maxCost;
+	unsigned int overBudgetFrames; //over the budget with more than the always rendered first light, should be 0
+	float avgCost;
+	unsigned int maxStaleness;
+	float avgLatency; //frames between a light becoming dirty and being rendered
+	unsigned int starvedLights; //lights that were dirty at the end and waited longer than the staleness cap
+	unsigned int checksum; //hash of every scheduled light idx of every frame
+};
+
+/*
+==============================
+ShadowScheduler
+	-decides which shadow casting lights get their atlas partitions rendered this frame.
+	-lights that went stale past s_maxStaleness are scheduled first, then on screen lights by
+	 coverage * ( 1 + staleness ), then off screen lights in round robin order.
+	-the first light in that order is always rendered so that a single light more expensive than
+	 the budget still makes progress. Every other light must fit in the remaining budget.
+==============================
+*/
+class ShadowScheduler {
+	public:
+		ShadowScheduler() { m_cursor = 0; }
+		~ShadowScheduler() {};
+
+		void Reset() { m_staleness.clear(); m_cursor = 0; }
+		void Schedule( const std::vector< shadowRequest_t >& requests, std::vector< unsigned int >& scheduled );
+		unsigned int RequestCost( const shadowRequest_t& request ) const;
+		unsigned int Staleness( const unsigned int lightIdx ) const;
+		static unsigned int MaxStaleness( const unsigned int lightCount );
+
+		static float EstimateCoverage( const Vec3& center, const float radius, const Vec3& camPos, const Vec3& camLook, const float fovy, const float aspect );
+		static shadowSimStats_t Simulate( const unsigned int lightCount, const unsigned int frameCount, const unsigned int seed );
+
+		static shadowBudget_t s_budgetType;
+		static unsigned int s_budget;
+		static unsigned int s_maxStaleness;
+
+	private:
+		std::vector< unsigned int > m_staleness; //frames each light has been waiting to be rendered
+		unsigned int m_cursor; //next light idx for the round robin of off screen lights
+};
+
+#endif
\ No newline at end of file
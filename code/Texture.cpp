@@ -2,6 +2,10 @@
 #include "Fileio.h"
 #include "Framebuffer.h"
 #include "Mesh.h"
+#include "ThreadPool.h"
+#include "BuildManifest.h"
+#include "TextureStreamer.h"
+#include "EnvMapBaker.h"
 
 #pragma once
 #define STB_IMAGE_IMPLEMENTATION
@@ -12,6 +16,9 @@
 #define BC7_COMPRESSED	2
 #define BC6H_COMPRESSED	3
 
+//bump when a change to the compressor or the mip filter changes its output, so the build manifest rebuilds every texture
+#define COMPRESSOR_VERSION	2
+
 struct bc_header {
 	uint8_t type;
 	uint8_t blockdim_x;
@@ -20,9 +27,74 @@ struct bc_header {
 	unsigned int ysize;
 };
 
+//set on bc_header::type when a bc_mipHeader follows the header. Files without it only store mip 0.
+#define BC_HAS_MIPS	0x80
+#define BC_MAX_MIPS	16
+#define BC_LEVEL_ALIGNMENT	4096 //levels of a page or more start on a page boundary of the file
+
+struct bc_mipHeader {
+	unsigned int mipCount;
+	unsigned int mipOffsets[BC_MAX_MIPS]; //from the start of the file
+};
+
 //static members initialized in glSetup()
 unsigned int Texture::s_errorTexture = 0;
 unsigned int CubemapTexture::s_errorCube = 0;
+unsigned int Texture::s_compressStripHeight = 16;
+textureRegistry_t Texture::s_registry;
+
+/*
+===============================
+NormalizeTexturePath
+	-lower case with back slashes, so different spellings of a path map to the same texture
+===============================
+*/
+static std::string NormalizeTexturePath( const char * relativePath ) {
+	std::string normalized( relativePath );
+	for ( unsigned int i = 0; i < normalized.size(); i++ ) {
+		if ( normalized[i] == '/' ) {
+			normalized[i] = '\\';
+		} else {
+			normalized[i] = ( char )tolower( ( unsigned char )normalized[i] );
+		}
+	}
+	return normalized;
+}
+
+/*
+===============================
+ReadBCHeader
+	-reads the bc header and, if the file has mips, the mip header after it. False if a level is cut off.
+===============================
+*/
+static bool ReadBCHeader( const mappedFile_t & file, bc_header & file_header, bc_mipHeader & mip_header ) {
+	if ( file.size < sizeof( bc_header ) ) {
+		return false;
+	}
+	memcpy( &file_header, file.data, sizeof( bc_header ) );
+	if ( ( file_header.type & BC_HAS_MIPS ) == 0 ) {
+		mip_header.mipCount = 1;
+		mip_header.mipOffsets[0] = sizeof( bc_header );
+	} else {
+		if ( file.size < sizeof( bc_header ) + sizeof( bc_mipHeader ) ) {
+			return false;
+		}
+		memcpy( &mip_header, file.data + sizeof( bc_header ), sizeof( bc_mipHeader ) );
+		if ( mip_header.mipCount == 0 || mip_header.mipCount > BC_MAX_MIPS ) {
+			return false;
+		}
+	}
+
+	//every level has to be inside the file
+	for ( unsigned int level = 0; level < mip_header.mipCount; level++ ) {
+		const int levelWidth = Texture::MipDimension( ( int )file_header.xsize, level );
+		const int levelHeight = Texture::MipDimension( ( int )file_header.ysize, level );
+		if ( ( size_t )mip_header.mipOffsets[level] + Texture::CompressedLevelSize( levelWidth, levelHeight ) > file.size ) {
+			return false;
+		}
+	}
+	return true;
+}
 
 /*
 ===============================
@@ -115,6 +187,11 @@ Texture::Texture() {
 	mChanCount = 0;
 	m_empty = true;
 	m_compressed = false;
+	m_streamed = false;
+	m_residentLevel = 0;
+	m_mipCount = 1;
+	m_registryKey = 0;
+	m_refCount = 0;
 	mTarget = GL_TEXTURE_2D;
 }
 
@@ -125,6 +202,10 @@ Texture::Delete
 ===============================
 */
 void Texture::Delete() {
+	if ( m_streamed ) {
+		TextureStreamer::getInstance()->Remove( this );
+		m_streamed = false;
+	}
 	if ( mName > 0 ) {
 		if ( mName != s_errorTexture ) {
 			glDeleteTextures( 1, &mName );
@@ -133,12 +214,211 @@ void Texture::Delete() {
 	}
 }
 
+/*
+===============================
+Texture::PathHash
+===============================
+*/
+uint64_t Texture::PathHash( const char * relativePath, const bool cubemap ) {
+	const std::string normalized = NormalizeTexturePath( relativePath );
+	const uint64_t pathHash = BuildManifest::HashBytes( normalized.c_str(), normalized.size() );
+	const unsigned char type = cubemap ? 1 : 0; //the same file can be loaded as both
+	return BuildManifest::HashBytes( &type, 1, pathHash );
+}
+
+/*
+===============================
+Texture::Acquire
+	-returns the registered texture for relativePath, loading it on first use. Every call has to be
+	 matched by a Release.
+===============================
+*/
+Texture * Texture::Acquire( const char * relativePath, const bool cubemap ) {
+	const uint64_t key = PathHash( relativePath, cubemap );
+	Texture * registered = FindRegistered( key, relativePath );
+	if ( registered != NULL ) {
+		registered->m_refCount += 1;
+		return registered;
+	}
+
+	Texture * texture = NULL;
+	if ( cubemap ) {
+		texture = new CubemapTexture;
+		texture->InitFromFile( relativePath );
+	} else {
+		texture = new Texture;
+		if ( !TextureStreamer::s_enabled || !TextureStreamer::getInstance()->Register( texture, relativePath ) ) {
+			texture->InitFromFile( relativePath );
+		}
+	}
+	texture->m_registryKey = key;
+	texture->m_refCount = 1;
+	s_registry.insert( std::make_pair( key, texture ) );
+	return texture;
+}
+
+/*
+===============================
+Texture::Release
+	-frees the texture once the last user released it
+===============================
+*/
+void Texture::Release( Texture * texture ) {
+	if ( texture == NULL ) {
+		return;
+	}
+	assert( texture->m_refCount > 0 );
+	texture->m_refCount -= 1;
+	if ( texture->m_refCount > 0 ) {
+		return;
+	}
+
+	std::pair< textureRegistry_t::iterator, textureRegistry_t::iterator > range = s_registry.equal_range( texture->m_registryKey );
+	for ( textureRegistry_t::iterator it = range.first; it != range.second; it++ ) {
+		if ( it->second == texture ) {
+			s_registry.erase( it );
+			break;
+		}
+	}
+	texture->Delete();
+	delete texture;
+}
+
+/*
+===============================
+Texture::FindRegistered
+	-NULL if relativePath isnt registered under key
+===============================
+*/
+Texture * Texture::FindRegistered( const uint64_t key, const char * relativePath ) {
+	const std::string normalized = NormalizeTexturePath( relativePath );
+	std::pair< textureRegistry_t::iterator, textureRegistry_t::iterator > range = s_registry.equal_range( key );
+	for ( textureRegistry_t::iterator it = range.first; it != range.second; it++ ) {
+		if ( NormalizeTexturePath( it->second->mStrName ) == normalized ) {
+			return it->second;
+		}
+	}
+	return NULL;
+}
+
+/*
+===============================
+Texture::AcquireAll
+	-Acquire for every request, textures[i] is the texture of requests[i].
+	-the files of textures that arent registered yet are mapped on the thread pool, at most
+	 maxThreads at once, 0 for every worker. Only the gl textures are made on this thread, each
+	 file is unmapped once its texture is uploaded.
+===============================
+*/
+void Texture::AcquireAll( const std::vector< textureRequest_t > & requests, std::vector< Texture * > & textures, const unsigned int maxThreads ) {
+	textures.assign( requests.size(), NULL );
+
+	//a texture that isnt registered is loaded once, however many requests share it
+	std::vector< textureLoad_t > loads;
+	std::vector< uint64_t > loadKeys;
+	std::map< std::pair< std::string, bool >, unsigned int > loadIdxs;
+	std::vector< int > requestLoads( requests.size(), -1 );
+	for ( size_t i = 0; i < requests.size(); i++ ) {
+		const textureRequest_t & request = requests[i];
+		const uint64_t key = PathHash( request.path.c_str(), request.cubemap );
+		Texture * registered = FindRegistered( key, request.path.c_str() );
+		if ( registered != NULL ) {
+			registered->m_refCount += 1;
+			textures[i] = registered;
+			continue;
+		}
+
+		const std::pair< std::string, bool > loadName( NormalizeTexturePath( request.path.c_str() ), request.cubemap );
+		std::map< std::pair< std::string, bool >, unsigned int >::iterator it = loadIdxs.find( loadName );
+		if ( it == loadIdxs.end() ) {
+			it = loadIdxs.insert( std::make_pair( loadName, ( unsigned int )loads.size() ) ).first;
+			textureLoad_t load;
+			load.path = request.path;
+			load.cubemap = request.cubemap;
+			load.streamed = false;
+			load.read = false;
+			loads.push_back( load );
+			loadKeys.push_back( key );
+		}
+		requestLoads[i] = ( int )it->second;
+	}
+
+	ReadLoads( loads, maxThreads );
+
+	std::vector< Texture * > loaded( loads.size(), NULL );
+	for ( size_t i = 0; i < loads.size(); i++ ) {
+		textureLoad_t & load = loads[i];
+		Texture * texture = NULL;
+		if ( load.cubemap ) {
+			texture = new CubemapTexture;
+		} else {
+			texture = new Texture;
+		}
+		if ( load.streamed ) {
+			TextureStreamer::getInstance()->Register( texture, load.path.c_str(), load.info, load.levels );
+		} else if ( load.read ) {
+			texture->InitFromLevels( load.path.c_str(), load.levels, load.file.data );
+		} else {
+			texture->InitFromFile( load.path.c_str() );
+		}
+		UnmapFile( load.file ); //the levels are on the gpu now
+		load.levels = compressedLevels_t();
+		texture->m_registryKey = loadKeys[i];
+		texture->m_refCount = 0;
+		s_registry.insert( std::make_pair( loadKeys[i], texture ) );
+		loaded[i] = texture;
+	}
+
+	for ( size_t i = 0; i < requests.size(); i++ ) {
+		if ( requestLoads[i] >= 0 ) {
+			textures[i] = loaded[ requestLoads[i] ];
+			textures[i]->m_refCount += 1;
+		}
+	}
+}
+
+/*
+===============================
+Texture::ReadLoads
+	-reads the bc files of loads on the thread pool. 2D textures only copy their mip tail when
+	 they can be streamed, everything else maps its file and reads the header. The mapped
+	 files are prefaulted here too, so the upload on the main thread doesnt wait on the disk.
+	-the files stay mapped until the loads are uploaded or passed to UnmapLoads
+===============================
+*/
+void Texture::ReadLoads( std::vector< textureLoad_t > & loads, const unsigned int maxThreads ) {
+	const bool streaming = TextureStreamer::s_enabled;
+	ThreadPool::getInstance()->ParallelFor( ( unsigned int )loads.size(), [&loads, streaming]( unsigned int i ) {
+		textureLoad_t & load = loads[i];
+		load.file.data = NULL;
+		load.file.size = 0;
+		load.streamed = !load.cubemap && streaming && TextureStreamer::ReadMipTail( load.path.c_str(), load.info, load.levels );
+		load.read = load.streamed || MapCompressedLevels( load.path.c_str(), load.levels, load.file );
+		PrefaultFile( load.file );
+	}, maxThreads );
+}
+
+/*
+===============================
+Texture::UnmapLoads
+	-for loads that are read without being uploaded
+===============================
+*/
+void Texture::UnmapLoads( std::vector< textureLoad_t > & loads ) {
+	for ( size_t i = 0; i < loads.size(); i++ ) {
+		UnmapFile( loads[i].file );
+		loads[i].levels = compressedLevels_t();
+	}
+}
+
 /*
 ===============================
 Texture::InitWithData
+	-mipCount and mipOffsets are only used for compressed data. mipOffsets[i] is where level i starts in data.
+	 With a single level the rest of the chain is generated by the driver.
 ===============================
 */
-void Texture::InitWithData( const unsigned char * data, const int width, const int height, const int chanCount, const char * ext ) {
+void Texture::InitWithData( const unsigned char * data, const int width, const int height, const int chanCount, const char * ext, const unsigned int mipCount, const unsigned int * mipOffsets ) {
 	// Store the width and height of the texture
 	mWidth = width;
 	mHeight = height;
@@ -159,6 +439,7 @@ void Texture::InitWithData( const unsigned char * data, const int width, const i
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
 
+	bool storedMips = false;
 	if ( strcmp( ext, "tga" ) == 0 ) {
 		assert( chanCount > 0 && chanCount <= 4 );
 		if( chanCount == 1 ) {
@@ -172,16 +453,25 @@ void Texture::InitWithData( const unsigned char * data, const int width, const i
 		}
 	} else if ( strcmp( ext, "hdr" ) == 0 ) {
 		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB16F, mWidth, mHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data );
-	} else if ( strcmp( ext, "bc7" ) == 0 || strcmp( ext, "bc7a" ) == 0 ) {
-		const GLsizei imgSize = ( mWidth / 4 ) * ( mHeight / 4 ) * 16; //total number of blocks at 16bytes per block
-		glCompressedTexImage2D( GL_TEXTURE_2D, 0, GL_COMPRESSED_RGBA_BPTC_UNORM, mWidth, mHeight, 0, imgSize, data );
-	} else if ( strcmp( ext, "bc6h" ) == 0 ) {
-		const GLsizei imgSize = ( mWidth / 4 ) * ( mHeight / 4 ) * 16; //total number of blocks at 16bytes per block
-		glCompressedTexImage2D( GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB, mWidth, mHeight, 0, imgSize, data );
+	} else if ( strcmp( ext, "bc7" ) == 0 || strcmp( ext, "bc7a" ) == 0 || strcmp( ext, "bc6h" ) == 0 ) {
+		const GLenum internalFormat = ( strcmp( ext, "bc6h" ) == 0 ) ? GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		for ( unsigned int level = 0; level < mipCount; level++ ) {
+			const int levelWidth = MipDimension( mWidth, level );
+			const int levelHeight = MipDimension( mHeight, level );
+			const GLsizei imgSize = ( GLsizei )CompressedLevelSize( levelWidth, levelHeight ); //total number of blocks at 16bytes per block
+			const unsigned int offset = ( mipOffsets != NULL ) ? mipOffsets[level] : 0;
+			glCompressedTexImage2D( GL_TEXTURE_2D, level, internalFormat, levelWidth, levelHeight, 0, imgSize, data + offset );
+		}
+		if ( mipCount > 1 ) {
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipCount - 1 );
+			storedMips = true;
+		}
 	}
 
 	//generate mipmaps
-	glGenerateMipmap( GL_TEXTURE_2D );
+	if ( !storedMips ) {
+		glGenerateMipmap( GL_TEXTURE_2D );
+	}
 		
 	// Reset the bound texture to nothing
 	glBindTexture( GL_TEXTURE_2D, 0 );
@@ -242,24 +532,26 @@ bool Texture::InitFromFile( const char * relativePath ) {
 		return false;
 	}
 
-	//get absolute path
-	char output_file_absolute[ 2048 ];
-	RelativePathToFullPath( output_file_relative.c_str(), output_file_absolute );
-
-	//open file
-	FILE * fs = fopen( output_file_absolute, "rb" );
-	if ( !fs ) {
+	//map file. The levels are uploaded straight from the mapping.
+	mappedFile_t file;
+	if ( !MapFile( output_file_relative.c_str(), file ) ) {
 		printf( "Failed to load uncompressed texture: %s\n", output_file_relative.c_str() );
 		UseErrorTexture();
 		return false;
-	}	
+	}
 
 	//load header data
 	bc_header file_header;
-	fread( &file_header, sizeof( bc_header ), 1, fs );	
+	bc_mipHeader mip_header;
+	if ( !ReadBCHeader( file, file_header, mip_header ) ) {
+		printf( "Following texture had invalid header: %s\n", output_file_relative.c_str() );
+		UnmapFile( file );
+		UseErrorTexture();
+		return false;
+	}
 
 	int chanCount;
-	const unsigned int imgType = ( unsigned int )file_header.type;
+	const unsigned int imgType = ( unsigned int )( file_header.type & ~BC_HAS_MIPS );
 	Str fileExtension;
 	if ( imgType == BC6H_COMPRESSED ) {
 		chanCount = 3;
@@ -272,86 +564,253 @@ bool Texture::InitFromFile( const char * relativePath ) {
 		fileExtension = "bc7a";
 	} else {
 		printf( "Following texture had invalid header: %s\n", output_file_relative.c_str() );
+		UnmapFile( file );
 		UseErrorTexture();
 		return false;
 	}
 	const int width = ( int )file_header.xsize;
 	const int height = ( int )file_header.ysize;	
 
-	//load img data
-	const size_t bytes_per_block = 16;
-	const size_t ptr_size = ( width / ( int )file_header.blockdim_x ) * ( height / ( int )file_header.blockdim_y ) * ( int )bytes_per_block;
-	unsigned char * data = new unsigned char[ptr_size];
-	fread( data, ptr_size, 1, fs );
-	InitWithData( data, width, height, chanCount, fileExtension.c_str() ); //pass to gpu
-	delete[] data;
-	data = nullptr;
+	InitWithData( file.data, width, height, chanCount, fileExtension.c_str(), mip_header.mipCount, mip_header.mipOffsets ); //pass to gpu
+	UnmapFile( file );
 	m_empty = false;
 
 	return true;
 }
 
+/*
+===============================
+LevelsExtension
+	-the extension InitWithData expects for the format of levels read from a bc file
+===============================
+*/
+static const char * LevelsExtension( const compressedLevels_t & levels ) {
+	if ( levels.internalFormat == GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB ) {
+		return "bc6h";
+	}
+	return ( levels.chanCount == 4 ) ? "bc7a" : "bc7";
+}
 
+/*
+===============================
+Texture::InitFromLevels
+	-like InitFromFile, with every level of the bc file in levels. Its offsets are into data,
+	 the mapped file of MapCompressedLevels or levels.data.
+===============================
+*/
+bool Texture::InitFromLevels( const char * relativePath, const compressedLevels_t & levels, const unsigned char * data ) {
+	strcpy( mStrName, relativePath );
+	assert( levels.firstLevel == 0 && levels.offsets.size() == levels.mipCount );
+
+	unsigned int mipOffsets[ BC_MAX_MIPS ];
+	for ( unsigned int level = 0; level < levels.mipCount; level++ ) {
+		mipOffsets[ level ] = ( unsigned int )levels.offsets[ level ];
+	}
+	InitWithData( data, levels.width, levels.height, ( int )levels.chanCount, LevelsExtension( levels ), levels.mipCount, mipOffsets ); //pass to gpu
+	m_empty = false;
+
+	return true;
+}
 
 /*
 ===============================
-store_bc6h
-	-write compressed img data to disc
+Texture::MapCompressedLevels
+	-maps the bc file of a texture and fills the header fields of levels. Its offsets are where
+	 every level starts in file.data, levels.data stays empty. file has to be unmapped with
+	 UnmapFile when the levels arent needed anymore.
+	-no gl calls so it can be run on the thread pool
 ===============================
 */
-void store_bc6h( const rgba_surface * img, const unsigned int width, const unsigned int height, const char* filename ) {
-    FILE * fs = fopen( filename, "wb" );
-
-    bc_header file_header;
-	file_header.type = BC6H_COMPRESSED;
-    file_header.blockdim_x = 4;
-    file_header.blockdim_y = 4;
-	file_header.xsize = width;
-	file_header.ysize = height;
-
-    fwrite( &file_header, sizeof( bc_header ), 1, fs );
-
-    const unsigned int bytes_per_block = 16;
-    fwrite( img->ptr, img->width * img->height * bytes_per_block, 1, fs );
-
-    fclose( fs );
+bool Texture::MapCompressedLevels( const char * relativePath, compressedLevels_t & levels, mappedFile_t & file ) {
+	const Str output_file_relative = CompressedPath( relativePath );
+	if ( output_file_relative.IsEmpty() ) {
+		return false;
+	}
+	if ( !MapFile( output_file_relative.c_str(), file ) ) {
+		return false;
+	}
+	bc_header file_header;
+	bc_mipHeader mip_header;
+	if ( !ReadBCHeader( file, file_header, mip_header ) ) {
+		printf( "Following texture had invalid header: %s\n", output_file_relative.c_str() );
+		UnmapFile( file );
+		return false;
+	}
+
+	const unsigned int imgType = ( unsigned int )( file_header.type & ~BC_HAS_MIPS );
+	if ( imgType == BC6H_COMPRESSED ) {
+		levels.chanCount = 3;
+		levels.internalFormat = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB;
+	} else if ( imgType == BC7_COMPRESSED || imgType == BC7A_COMPRESSED ) {
+		levels.chanCount = ( imgType == BC7A_COMPRESSED ) ? 4 : 3;
+		levels.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+	} else {
+		printf( "Following texture had invalid header: %s\n", output_file_relative.c_str() );
+		UnmapFile( file );
+		return false;
+	}
+	levels.width = ( int )file_header.xsize;
+	levels.height = ( int )file_header.ysize;
+	levels.mipCount = mip_header.mipCount;
+	levels.firstLevel = 0;
+	levels.data.clear();
+	levels.offsets.assign( mip_header.mipOffsets, mip_header.mipOffsets + mip_header.mipCount );
+	return true;
+}
+
+/*
+===============================
+Texture::ReadCompressedLevels
+	-copies levels [firstLevel, endLevel) of the bc file of a texture. The header fields of levels
+	 are always filled, pass endLevel <= firstLevel to only read the header.
+	-no gl calls so it can be run on the thread pool
+===============================
+*/
+bool Texture::ReadCompressedLevels( const char * relativePath, const unsigned int firstLevel, const unsigned int endLevel, compressedLevels_t & levels ) {
+	mappedFile_t file;
+	if ( !MapCompressedLevels( relativePath, levels, file ) ) {
+		return false;
+	}
+	const std::vector< size_t > fileOffsets = levels.offsets;
+	levels.firstLevel = firstLevel;
+	levels.offsets.clear();
+
+	const unsigned int lastLevel = ( endLevel < levels.mipCount ) ? endLevel : levels.mipCount;
+	for ( unsigned int level = firstLevel; level < lastLevel; level++ ) {
+		const size_t levelSize = CompressedLevelSize( MipDimension( levels.width, level ), MipDimension( levels.height, level ) );
+		const unsigned char * levelData = file.data + fileOffsets[ level ];
+		levels.offsets.push_back( levels.data.size() );
+		levels.data.insert( levels.data.end(), levelData, levelData + levelSize );
+	}
+	UnmapFile( file );
+	return true;
+}
+
+/*
+===============================
+Texture::SetResidentLevels
+	-makes levels [firstLevel, mipCount) resident. Levels that are already resident are copied from
+	 the old texture, the rest come from levels, which has to hold them.
+	-immutable storage cant grow or shrink, so the texture is recreated and gets a new name.
+===============================
+*/
+void Texture::SetResidentLevels( const compressedLevels_t & levels, const unsigned int firstLevel ) {
+	const unsigned int residentCount = levels.mipCount - firstLevel;
+	const int width = MipDimension( levels.width, firstLevel );
+	const int height = MipDimension( levels.height, firstLevel );
+	const bool hasOldLevels = !m_empty && mName > 0 && mName != s_errorTexture && m_mipCount == levels.mipCount;
+
+	unsigned int textureID;
+	glGenTextures( 1, &textureID );
+	glBindTexture( GL_TEXTURE_2D, textureID );
+	glTexStorage2D( GL_TEXTURE_2D, residentCount, levels.internalFormat, width, height );
+	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 8.0f );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+
+	for ( unsigned int level = firstLevel; level < levels.mipCount; level++ ) {
+		const int levelWidth = MipDimension( levels.width, level );
+		const int levelHeight = MipDimension( levels.height, level );
+		if ( hasOldLevels && level >= m_residentLevel ) {
+			glCopyImageSubData( mName, GL_TEXTURE_2D, level - m_residentLevel, 0, 0, 0, textureID, GL_TEXTURE_2D, level - firstLevel, 0, 0, 0, levelWidth, levelHeight, 1 ); //gpu to gpu
+		} else {
+			assert( level >= levels.firstLevel && level - levels.firstLevel < levels.offsets.size() );
+			const GLsizei imgSize = ( GLsizei )CompressedLevelSize( levelWidth, levelHeight );
+			glCompressedTexSubImage2D( GL_TEXTURE_2D, level - firstLevel, 0, 0, levelWidth, levelHeight, levels.internalFormat, imgSize, levels.data.data() + levels.offsets[ level - levels.firstLevel ] );
+		}
+	}
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	if ( mName > 0 && mName != s_errorTexture ) {
+		glDeleteTextures( 1, &mName );
+	}
+	mName = textureID;
+	mWidth = width;
+	mHeight = height;
+	mChanCount = ( int )levels.chanCount;
+	m_residentLevel = firstLevel;
+	m_mipCount = levels.mipCount;
+	m_empty = false;
 }
 
 /*
 ===============================
-store_bc7
-	-write compressed img data to disc
+Texture::MipDimension
 ===============================
 */
-void store_bc7( const rgba_surface * img, const unsigned int width, const unsigned int height, const unsigned int chanCount, const char* filename ) {
-    FILE * fs = fopen( filename, "wb" );
+int Texture::MipDimension( const int size, const unsigned int level ) {
+	const int levelSize = size >> level;
+	return ( levelSize > 0 ) ? levelSize : 1;
+}
+
+/*
+===============================
+Texture::CompressedLevelSize
+	-bytes of a bc6h or bc7 mip level. Partial blocks at the edges are stored as full blocks.
+===============================
+*/
+size_t Texture::CompressedLevelSize( const int width, const int height ) {
+	const size_t bytes_per_block = 16;
+	return ( size_t )( ( width + 3 ) / 4 ) * ( size_t )( ( height + 3 ) / 4 ) * bytes_per_block;
+}
+
+/*
+===============================
+store_bc
+	-write compressed img data to disc. Every level is written after the headers, largest first.
+	-levels of BC_LEVEL_ALIGNMENT bytes or more are padded to start on a page so they can be read
+	 straight out of a mapping of the file.
+===============================
+*/
+void store_bc( const uint8_t type, const unsigned int width, const unsigned int height, const std::vector< std::vector< uint8_t > > & levels, const char* filename ) {
+	FILE * fs = fopen( filename, "wb" );
+	if ( !fs ) {
+		return;
+	}
 
-    bc_header file_header;
-	if ( chanCount == 3 ) {
-		file_header.type = BC7_COMPRESSED;
-	} else {
-		file_header.type = BC7A_COMPRESSED;
-	}
-    file_header.blockdim_x = 4;
-    file_header.blockdim_y = 4;
+	bc_header file_header;
+	file_header.type = type | BC_HAS_MIPS;
+	file_header.blockdim_x = 4;
+	file_header.blockdim_y = 4;
 	file_header.xsize = width;
 	file_header.ysize = height;
 
-    fwrite( &file_header, sizeof( bc_header ), 1, fs );
+	bc_mipHeader mip_header;
+	memset( &mip_header, 0, sizeof( bc_mipHeader ) );
+	mip_header.mipCount = ( unsigned int )levels.size();
+	unsigned int offset = sizeof( bc_header ) + sizeof( bc_mipHeader );
+	for ( unsigned int i = 0; i < levels.size(); i++ ) {
+		if ( levels[i].size() >= BC_LEVEL_ALIGNMENT ) {
+			offset = ( offset + BC_LEVEL_ALIGNMENT - 1 ) & ~( BC_LEVEL_ALIGNMENT - 1 );
+		}
+		mip_header.mipOffsets[i] = offset;
+		offset += ( unsigned int )levels[i].size();
+	}
 
-    const unsigned int bytes_per_block = 16;
-    fwrite( img->ptr, img->width * img->height * bytes_per_block, 1, fs );
+	fwrite( &file_header, sizeof( bc_header ), 1, fs );
+	fwrite( &mip_header, sizeof( bc_mipHeader ), 1, fs );
+	const std::vector< uint8_t > padding( BC_LEVEL_ALIGNMENT, 0 );
+	unsigned int written = sizeof( bc_header ) + sizeof( bc_mipHeader );
+	for ( unsigned int i = 0; i < levels.size(); i++ ) {
+		if ( mip_header.mipOffsets[i] > written ) {
+			fwrite( padding.data(), mip_header.mipOffsets[i] - written, 1, fs );
+		}
+		fwrite( levels[i].data(), levels[i].size(), 1, fs );
+		written = mip_header.mipOffsets[i] + ( unsigned int )levels[i].size();
+	}
 
-    fclose( fs );
+	fclose( fs );
 }
 
 /*
 ===============================
-Texture::CompressImage
+Texture::CompressedPath
+	-path of the generated bc file for a source texture. Empty if the format cant be compressed.
 ===============================
 */
-bool Texture::CompressFromFile( const char * relativePath ) {
-	//get relative path the generated bc file
+Str Texture::CompressedPath( const char * relativePath ) {
 	Str output_file_relative = Str( relativePath );
 	output_file_relative.ReplaceChar( '/', '\\' );
 	output_file_relative.Replace( "data\\texture\\", "data\\generated\\texture\\", false );
@@ -360,27 +819,85 @@ bool Texture::CompressFromFile( const char * relativePath ) {
 	} else if ( output_file_relative.EndsWith( "hdr" ) ) {
 		output_file_relative.Replace( ".hdr", ".bc", false );
 	} else {
-		return false;
+		return Str();
 	}
+	return output_file_relative;
+}
 
-	//create windows folders
-	int filename_idx = -1;
-	for ( unsigned int i = output_file_relative.Length() - 1; i >= 0; i-- ) {
-		if ( output_file_relative[i] == '\\' || output_file_relative[i] == '/' ) {
-			filename_idx = ( int )i;
-			break;
-		}
-	}	
-	assert( filename_idx > -1 );
-	Str output_dir = output_file_relative.Substring( 0, filename_idx );
-	if ( dirExists( output_dir.c_str() ) == false ) {
-		makeDir( output_dir.c_str() );
+/*
+===============================
+Texture::CompressionMemoryEstimate
+	-bytes CompressFromFile holds at its peak for a source texture. Only reads the image header.
+===============================
+*/
+size_t Texture::CompressionMemoryEstimate( const char * relativePath, const bool generateMips ) {
+	char imgPath[ 2048 ];
+	RelativePathToFullPath( relativePath, imgPath ); //get absolute path
+
+	int width, height, chanCount;
+	if ( stbi_info( imgPath, &width, &height, &chanCount ) == 0 ) {
+		return 0;
+	}
+	const size_t pixelCount = ( size_t )width * ( size_t )height;
+	const std::string fileExtension = GetExtension( relativePath );
+	size_t bytes = 0;
+	if ( fileExtension == "hdr" ) {
+		bytes = pixelCount * ( sizeof( float ) * 3 + sizeof( unsigned short ) * 4 + 1 ); //float rgb + half rgba + 1 byte per pixel of blocks
+	} else {
+		bytes = pixelCount * ( chanCount + 4 + 1 ); //source + rgba + 1 byte per pixel of blocks
 	}
+	if ( generateMips ) {
+		bytes += pixelCount * sizeof( float ) * 4 * 2; //float rgba of two levels at a time. Ignores the smaller levels' blocks.
+	}
+	return bytes;
+}
 
-	//get absolute path
-	char output_file_absolute[ 2048 ];
-	RelativePathToFullPath( output_file_relative.c_str(), output_file_absolute ); //get absolute path
+/*
+===============================
+Texture::CompressionSettingsHash
+	-hash of everything besides the source file that affects the output of CompressFromFile
+===============================
+*/
+uint64_t Texture::CompressionSettingsHash( const bool generateMips, const textureUsage_t usage ) {
+	char settings[ 256 ];
+	sprintf( settings, "version %d bc7 alpha_basic bc6h basic mips %d usage %d", COMPRESSOR_VERSION, generateMips ? 1 : 0, ( int )usage );
+	return BuildManifest::HashBytes( settings, strlen( settings ) );
+}
 
+/*
+===============================
+PadToBlocks
+	-grows the surface to a multiple of 4 pixels by repeating the last row and column
+===============================
+*/
+static void PadToBlocks( compressionInput_t & input, const size_t bytesPerPixel ) {
+	const int paddedWidth = ( input.width + 3 ) & ~3;
+	const int paddedHeight = ( input.height + 3 ) & ~3;
+	if ( paddedWidth != input.width || paddedHeight != input.height ) {
+		std::vector< uint8_t > padded( ( size_t )paddedWidth * paddedHeight * bytesPerPixel );
+		for ( int y = 0; y < paddedHeight; y++ ) {
+			const int srcY = ( y < input.height ) ? y : input.height - 1;
+			for ( int x = 0; x < paddedWidth; x++ ) {
+				const int srcX = ( x < input.width ) ? x : input.width - 1;
+				memcpy( &padded[ ( ( size_t )y * paddedWidth + x ) * bytesPerPixel ], &input.pixels[ ( ( size_t )srcY * input.width + srcX ) * bytesPerPixel ], bytesPerPixel );
+			}
+		}
+		input.pixels.swap( padded );
+	}
+	input.surface.width = paddedWidth;
+	input.surface.height = paddedHeight;
+	input.surface.stride = paddedWidth * ( int )bytesPerPixel;
+	input.surface.ptr = input.pixels.data();
+}
+
+/*
+===============================
+Texture::LoadCompressionInput
+	-decodes a tga or hdr file into the rgba surface ispc_texcomp expects
+	-tga becomes 8 bit rgba for bc7, hdr becomes half float rgba for bc6h
+===============================
+*/
+bool Texture::LoadCompressionInput( const char * relativePath, compressionInput_t & input ) {
 	//get file extension
 	const std::string fileExtension = GetExtension( relativePath );
 	if( fileExtension.empty() ) {
@@ -390,90 +907,38 @@ bool Texture::CompressFromFile( const char * relativePath ) {
 	RelativePathToFullPath( relativePath, imgPath ); //get absolute path
 
 	int width, height, chanCount;
-	const unsigned int block_width = 4;
-	const unsigned int block_height = 4;
-	const size_t bytes_per_block = 16;
-	stbi_set_flip_vertically_on_load( true );
+	stbi_set_flip_vertically_on_load( true ); //every compression job sets the same value so this is safe to call from the thread pool
 	if ( fileExtension == "tga" ) { //bc7
 		unsigned char * buffer_data = stbi_load( imgPath, &width, &height, &chanCount, 0 );
 		if ( !buffer_data ) {
 			return false;
 		}
-		if ( chanCount < 1 || width < 4 || height < 4 ) {
+		if ( chanCount < 1 || chanCount > 4 || width < 4 || height < 4 ) {
+			if ( chanCount > 4 ) {
+				printf( "ERROR :: BC7 image must have 3 or 4 channels!!!\n" );
+			}
 			stbi_image_free( buffer_data );
 			return false;
 		}
 
-		rgba_surface input_tex;
-		input_tex.width = width;
-		input_tex.height = height;
-		input_tex.stride = width * sizeof( unsigned char ) * 4; //LDR input is 32 bit/pixel (sRGB)
-		input_tex.ptr = buffer_data;
-		unsigned char * data = NULL;
-
-		rgba_surface output_tex;
-		const int width_blockCount = width / 4;
-		const int height_blockCount = height / 4;
-		output_tex.width = width_blockCount;
-		output_tex.height = height_blockCount;
-		output_tex.stride = width_blockCount * bytes_per_block;
-		output_tex.ptr = new uint8_t[ width_blockCount * height_blockCount * bytes_per_block ];
-
-		//compress
-		bc7_enc_settings settings;
-		if ( chanCount == 1 ) {
-			data = new unsigned char[ width * height * 4 ];
-			for ( unsigned int i = 0; i < width * height; i++ ) {
-				data[ i * 4 + 0 ] = buffer_data[ i ];
-				data[ i * 4 + 1 ] = buffer_data[ i ];
-				data[ i * 4 + 2 ] = buffer_data[ i ];
-				data[ i * 4 + 3 ] = 0;
-			}
-			input_tex.ptr = data;
-			chanCount = 4;
-			GetProfile_alpha_basic( &settings );
-		} else if ( chanCount == 2 ) {
-			data = new unsigned char[ width * height * 4 ];
-			for ( unsigned int i = 0; i < width * height; i++ ) {
-				data[ i * 4 + 0 ] = buffer_data[ i * 2 + 0 ];
-				data[ i * 4 + 1 ] = buffer_data[ i * 2 + 1 ];
-				data[ i * 4 + 2 ] = 0;
-				data[ i * 4 + 3 ] = 0;
-			}
-			input_tex.ptr = data;
-			chanCount = 4;
-			GetProfile_alpha_basic( &settings );
-		} else if ( chanCount == 3 ) {
-			data = new unsigned char[ width * height * 4 ];
-			for ( unsigned int i = 0; i < width * height; i++ ) {
-				data[ i * 4 + 0 ] = buffer_data[ i * 3 + 0 ];
-				data[ i * 4 + 1 ] = buffer_data[ i * 3 + 1 ];
-				data[ i * 4 + 2 ] = buffer_data[ i * 3 + 2 ];
-				data[ i * 4 + 3 ] = 0;
-			}
-			input_tex.ptr = data;
-			chanCount = 4;
-			GetProfile_alpha_basic( &settings );
-		} else if ( chanCount == 4 ) {
-			GetProfile_alpha_basic( &settings );				
-		} else {
-			delete[] output_tex.ptr;
-			output_tex.ptr = nullptr;
-			printf( "ERROR :: BC7 image must have 3 or 4 channels!!!\n" );
-			stbi_image_free( buffer_data );
-			return false;
+		//expand to rgba. Missing channels are 0.
+		const size_t pixelCount = ( size_t )width * ( size_t )height;
+		input.pixels.assign( pixelCount * 4, 0 );
+		for ( size_t i = 0; i < pixelCount; i++ ) {
+			if ( chanCount == 1 ) {
+				input.pixels[ i * 4 + 0 ] = buffer_data[ i ];
+				input.pixels[ i * 4 + 1 ] = buffer_data[ i ];
+				input.pixels[ i * 4 + 2 ] = buffer_data[ i ];
+			} else {
+				for ( int j = 0; j < chanCount; j++ ) {
+					input.pixels[ i * 4 + j ] = buffer_data[ i * chanCount + j ];
+				}
+			}
 		}
-		CompressBlocksBC7( &input_tex,  output_tex.ptr, &settings );
-
-		store_bc7( &output_tex, width, height, chanCount, output_file_absolute );
-		delete[] output_tex.ptr;
-		output_tex.ptr = nullptr;
 		stbi_image_free( buffer_data );
-		if ( data != NULL ) {
-			delete[] data;
-			data = nullptr;
-		}
 
+		input.hdr = false;
+		input.chanCount = 4;
 	} else if ( fileExtension == "hdr" ) { //bc6h
 		float * data = stbi_loadf( imgPath, &width, &height, &chanCount, 0 );
 		if ( !data ) {
@@ -486,43 +951,332 @@ bool Texture::CompressFromFile( const char * relativePath ) {
 
 		//hdr vals for bc6h uses 2 bytes. So we convert each float in data to a short.
 		//we also need to have each pixel have 8 bytes (two per value). So we convert to rgba with a==1.
-		rgba_surface input_tex;
-		input_tex.width = width;
-		input_tex.height = height;
-		input_tex.stride = width * sizeof( unsigned short ) * 4; //HDR is 64 bit/pixel (half float), thus chanCount for output must be 4
-		const unsigned int valCount = width * height * chanCount;
-		unsigned short * data_short = new unsigned short [ width * height * 4 ];
-		for ( unsigned int i = 0; i < width * height; i++ ) {
-			for ( unsigned int j = 0; j < chanCount; j++ ) {
-				data_short[ i * 4 + j ] = F32toF16( data[ i * 3 + j ] );
+		//the rows are also flipped vertically.
+		const size_t pixelCount = ( size_t )width * ( size_t )height;
+		input.pixels.resize( pixelCount * sizeof( unsigned short ) * 4 );
+		unsigned short * data_short = ( unsigned short * )input.pixels.data();
+		for ( int y = 0; y < height; y++ ) {
+			const float * srcRow = data + ( size_t )( height - 1 - y ) * width * 3;
+			unsigned short * dstRow = data_short + ( size_t )y * width * 4;
+			for ( int x = 0; x < width; x++ ) {
+				for ( int j = 0; j < chanCount; j++ ) {
+					dstRow[ x * 4 + j ] = F32toF16( srcRow[ x * 3 + j ] );
+				}
+				dstRow[ x * 4 + 3 ] = 1; //fill alpha channel
 			}
-			data_short[ i * 4 + 3 ] = 1; //fill alpha channel
 		}
-		input_tex.ptr = ( uint8_t * )data_short;
 		stbi_image_free( data );
 
-		//flip the image vertically
-		input_tex.ptr += ( input_tex.height - 1 ) * input_tex.stride;
-		input_tex.stride *= -1;
+		input.hdr = true;
+		input.chanCount = 3;
+	} else {
+		return false;
+	}
+
+	input.width = width;
+	input.height = height;
+	PadToBlocks( input, input.hdr ? sizeof( unsigned short ) * 4 : 4 );
+	return true;
+}
+
+/*
+===============================
+srgbTable_t
+	-the shaders linearize albedo with pow( albedo, 2.2 ) so color mips are filtered in that space
+===============================
+*/
+struct srgbTable_t {
+	float toLinear[256];
+	srgbTable_t() {
+		for ( unsigned int i = 0; i < 256; i++ ) {
+			toLinear[i] = powf( ( float )i / 255.0f, 2.2f );
+		}
+	}
+};
+static const srgbTable_t s_srgbTable;
+
+/*
+===============================
+DecodeMipSource
+	-converts a level 0 compression input into linear float rgba
+===============================
+*/
+static void DecodeMipSource( const compressionInput_t & input, const textureUsage_t usage, std::vector< float > & rgba ) {
+	const size_t pixelCount = ( size_t )input.width * ( size_t )input.height;
+	rgba.resize( pixelCount * 4 );
+	for ( int y = 0; y < input.height; y++ ) {
+		for ( int x = 0; x < input.width; x++ ) {
+			const size_t dst = ( ( size_t )y * input.width + x ) * 4;
+			const size_t src = ( ( size_t )y * input.surface.width + x ) * 4;
+			if ( input.hdr ) {
+				const unsigned short * halfs = ( const unsigned short * )input.pixels.data();
+				rgba[ dst + 0 ] = F16toF32( halfs[ src + 0 ] );
+				rgba[ dst + 1 ] = F16toF32( halfs[ src + 1 ] );
+				rgba[ dst + 2 ] = F16toF32( halfs[ src + 2 ] );
+				rgba[ dst + 3 ] = 1.0f;
+			} else {
+				for ( unsigned int c = 0; c < 4; c++ ) {
+					const uint8_t value = input.pixels[ src + c ];
+					if ( usage == TEXTURE_USAGE_COLOR && c < 3 ) {
+						rgba[ dst + c ] = s_srgbTable.toLinear[ value ];
+					} else if ( usage == TEXTURE_USAGE_NORMAL && c < 3 ) {
+						rgba[ dst + c ] = ( ( float )value / 255.0f ) * 2.0f - 1.0f;
+					} else {
+						rgba[ dst + c ] = ( float )value / 255.0f;
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+===============================
+DownsampleMip
+	-2x2 box filter. Odd sizes drop the last row or column. Normals are renormalized.
+===============================
+*/
+static void DownsampleMip( const std::vector< float > & src, const int srcWidth, const int srcHeight, const textureUsage_t usage, std::vector< float > & dst, const int dstWidth, const int dstHeight ) {
+	dst.resize( ( size_t )dstWidth * dstHeight * 4 );
+	for ( int y = 0; y < dstHeight; y++ ) {
+		const int y0 = ( y * 2 < srcHeight ) ? y * 2 : srcHeight - 1;
+		const int y1 = ( y * 2 + 1 < srcHeight ) ? y * 2 + 1 : y0;
+		const float * row0 = &src[ ( size_t )y0 * srcWidth * 4 ];
+		const float * row1 = &src[ ( size_t )y1 * srcWidth * 4 ];
+		float * dstRow = &dst[ ( size_t )y * dstWidth * 4 ];
+		for ( int x = 0; x < dstWidth; x++ ) {
+			const int x0 = ( x * 2 < srcWidth ) ? x * 2 : srcWidth - 1;
+			const int x1 = ( x * 2 + 1 < srcWidth ) ? x * 2 + 1 : x0;
+			for ( unsigned int c = 0; c < 4; c++ ) {
+				dstRow[ x * 4 + c ] = ( row0[ x0 * 4 + c ] + row0[ x1 * 4 + c ] + row1[ x0 * 4 + c ] + row1[ x1 * 4 + c ] ) * 0.25f;
+			}
+			if ( usage == TEXTURE_USAGE_NORMAL ) {
+				Vec3 normal = Vec3( dstRow[ x * 4 + 0 ], dstRow[ x * 4 + 1 ], dstRow[ x * 4 + 2 ] );
+				if ( normal.length() > EPSILON ) {
+					normal.normalize();
+				} else {
+					normal = Vec3( 0.0f, 0.0f, 1.0f ); //opposing normals cancelled out
+				}
+				dstRow[ x * 4 + 0 ] = normal.x;
+				dstRow[ x * 4 + 1 ] = normal.y;
+				dstRow[ x * 4 + 2 ] = normal.z;
+			}
+		}
+	}
+}
+
+/*
+===============================
+EncodeMip
+	-converts linear float rgba back into the format of the compression input
+===============================
+*/
+static void EncodeMip( const std::vector< float > & rgba, const int width, const int height, const bool hdr, const textureUsage_t usage, compressionInput_t & level ) {
+	const size_t pixelCount = ( size_t )width * ( size_t )height;
+	level.width = width;
+	level.height = height;
+	level.hdr = hdr;
+	if ( hdr ) {
+		level.pixels.resize( pixelCount * sizeof( unsigned short ) * 4 );
+		unsigned short * halfs = ( unsigned short * )level.pixels.data();
+		for ( size_t i = 0; i < pixelCount; i++ ) {
+			halfs[ i * 4 + 0 ] = F32toF16( rgba[ i * 4 + 0 ] );
+			halfs[ i * 4 + 1 ] = F32toF16( rgba[ i * 4 + 1 ] );
+			halfs[ i * 4 + 2 ] = F32toF16( rgba[ i * 4 + 2 ] );
+			halfs[ i * 4 + 3 ] = 1; //fill alpha channel the same way as level 0
+		}
+		PadToBlocks( level, sizeof( unsigned short ) * 4 );
+		return;
+	}
+
+	level.pixels.resize( pixelCount * 4 );
+	for ( size_t i = 0; i < pixelCount * 4; i++ ) {
+		float value = rgba[i];
+		const bool isColor = ( i % 4 ) < 3;
+		if ( usage == TEXTURE_USAGE_COLOR && isColor ) {
+			value = powf( value, 1.0f / 2.2f );
+		} else if ( usage == TEXTURE_USAGE_NORMAL && isColor ) {
+			value = value * 0.5f + 0.5f;
+		}
+		value = value * 255.0f + 0.5f;
+		if ( value < 0.0f ) {
+			value = 0.0f;
+		} else if ( value > 255.0f ) {
+			value = 255.0f;
+		}
+		level.pixels[i] = ( uint8_t )value;
+	}
+	PadToBlocks( level, 4 );
+}
+
+/*
+===============================
+Texture::CompressSurface
+	-compresses input into bc7 or bc6h blocks.
+	-the image is split into strips of s_compressStripHeight block rows that are compressed on the thread pool.
+	 Every block is compressed independently so the result is the same for any strip count.
+===============================
+*/
+void Texture::CompressSurface( const compressionInput_t & input, std::vector< uint8_t > & blocks, const bool multithreaded ) {
+	const int width_blockCount = input.surface.width / 4;
+	const int height_blockCount = input.surface.height / 4;
+	const size_t bytes_per_block = 16;
+	const size_t blockRow_size = width_blockCount * bytes_per_block;
+	blocks.resize( blockRow_size * height_blockCount );
+
+	unsigned int stripHeight = height_blockCount;
+	if ( multithreaded && s_compressStripHeight > 0 ) {
+		stripHeight = s_compressStripHeight;
+	}
+	const unsigned int stripCount = ( height_blockCount + stripHeight - 1 ) / stripHeight;
+
+	uint8_t * output = blocks.data();
+	ThreadPool::getInstance()->ParallelFor( stripCount, [&input, output, blockRow_size, stripHeight, height_blockCount]( unsigned int stripIdx ) {
+		const int firstBlockRow = stripIdx * stripHeight;
+		int stripBlockRows = height_blockCount - firstBlockRow;
+		if ( stripBlockRows > ( int )stripHeight ) {
+			stripBlockRows = ( int )stripHeight;
+		}
+
+		rgba_surface strip = input.surface;
+		strip.ptr += ( ptrdiff_t )firstBlockRow * 4 * strip.stride;
+		strip.height = stripBlockRows * 4;
+		uint8_t * stripOutput = output + firstBlockRow * blockRow_size;
+		if ( input.hdr ) {
+			bc6h_enc_settings settings;
+			GetProfile_bc6h_basic( &settings );
+			CompressBlocksBC6H( &strip, stripOutput, &settings );
+		} else {
+			bc7_enc_settings settings;
+			GetProfile_alpha_basic( &settings );
+			CompressBlocksBC7( &strip, stripOutput, &settings );
+		}
+	} );
+}
+
+/*
+===============================
+Texture::CompressFromFile
+	-compresses a tga or hdr texture and saves the bc file to data\generated\
+	-generateMips: filters and stores the full mip chain. Off for cubemap strips, whose faces would bleed together.
+	-pixelCount: optional, receives the number of pixels compressed over all levels
+	-safe to call from the thread pool
+===============================
+*/
+bool Texture::CompressFromFile( const char * relativePath, const bool generateMips, const textureUsage_t usage, size_t * pixelCount ) {
+	//get relative path the generated bc file
+	Str output_file_relative = CompressedPath( relativePath );
+	if ( output_file_relative.Length() == 0 ) {
+		return false;
+	}
 
-		rgba_surface output_tex;
-		const int width_blockCount = width / 4;
-		const int height_blockCount = height / 4;
-		output_tex.width = width_blockCount;
-		output_tex.height = height_blockCount;
-		output_tex.stride = width_blockCount * bytes_per_block;
-		output_tex.ptr = new uint8_t[ width_blockCount * height_blockCount * bytes_per_block ];
+	//create windows folders
+	int filename_idx = -1;
+	for ( unsigned int i = output_file_relative.Length() - 1; i >= 0; i-- ) {
+		if ( output_file_relative[i] == '\\' || output_file_relative[i] == '/' ) {
+			filename_idx = ( int )i;
+			break;
+		}
+	}	
+	assert( filename_idx > -1 );
+	Str output_dir = output_file_relative.Substring( 0, filename_idx );
+	if ( dirExists( output_dir.c_str() ) == false ) {
+		makeDir( output_dir.c_str() );
+	}
+
+	//get absolute path
+	char output_file_absolute[ 2048 ];
+	RelativePathToFullPath( output_file_relative.c_str(), output_file_absolute ); //get absolute path
+
+	compressionInput_t input;
+	if ( !LoadCompressionInput( relativePath, input ) ) {
+		return false;
+	}
+
+	//compress level 0
+	std::vector< std::vector< uint8_t > > levels( 1 );
+	CompressSurface( input, levels[0], true );
+	size_t compressedPixels = ( size_t )input.width * ( size_t )input.height;
+
+	//filter and compress the rest of the chain. Each level is made from the one above it in linear float.
+	if ( generateMips ) {
+		const textureUsage_t levelUsage = input.hdr ? TEXTURE_USAGE_LINEAR : usage;
+		std::vector< float > src;
+		std::vector< float > dst;
+		DecodeMipSource( input, levelUsage, src );
+		int srcWidth = input.width;
+		int srcHeight = input.height;
+		for ( unsigned int level = 1; level < BC_MAX_MIPS && ( srcWidth > 1 || srcHeight > 1 ); level++ ) {
+			const int dstWidth = MipDimension( input.width, level );
+			const int dstHeight = MipDimension( input.height, level );
+			DownsampleMip( src, srcWidth, srcHeight, levelUsage, dst, dstWidth, dstHeight );
+
+			compressionInput_t levelInput;
+			EncodeMip( dst, dstWidth, dstHeight, input.hdr, levelUsage, levelInput );
+			levels.push_back( std::vector< uint8_t >() );
+			CompressSurface( levelInput, levels.back(), true );
+			compressedPixels += ( size_t )dstWidth * ( size_t )dstHeight;
+
+			src.swap( dst );
+			srcWidth = dstWidth;
+			srcHeight = dstHeight;
+		}
+	}
+
+	uint8_t type = BC6H_COMPRESSED;
+	if ( !input.hdr ) {
+		type = ( input.chanCount == 3 ) ? BC7_COMPRESSED : BC7A_COMPRESSED;
+	}
+	store_bc( type, input.width, input.height, levels, output_file_absolute );
+
+	if ( pixelCount != NULL ) {
+		*pixelCount = compressedPixels;
+	}
+	return true;
+}
+
+/*
+===============================
+Texture::CompressCubemap
+	-compresses the levels of a gl order cubemap strip to bc6h and saves them as the bc file of relativePath
+	-unlike CompressFromFile the rows arent flipped, faces are stored top row first the way gl
+	 expects cubemap faces. Level faces must be a multiple of 4 so faces dont share blocks.
+===============================
+*/
+bool Texture::CompressCubemap( const char * relativePath, const std::vector< envImage_t > & levels ) {
+	const Str output_file_relative = CompressedPath( relativePath );
+	if ( output_file_relative.Length() == 0 || levels.empty() || levels.size() > BC_MAX_MIPS ) {
+		return false;
+	}
+	char output_file_absolute[ 2048 ];
+	RelativePathToFullPath( output_file_relative.c_str(), output_file_absolute ); //get absolute path
 
-		//compress
-		bc6h_enc_settings settings;
-		GetProfile_bc6h_basic( &settings );
-		CompressBlocksBC6H( &input_tex,  output_tex.ptr, &settings );
+	std::vector< std::vector< uint8_t > > blocks( levels.size() );
+	for ( unsigned int i = 0; i < levels.size(); i++ ) {
+		const envImage_t & level = levels[i];
+		if ( level.height < 4 || level.height % 4 != 0 || level.width != level.height * 6 ) {
+			return false;
+		}
 
-		store_bc6h( &output_tex, width, height, output_file_absolute );
-		delete[] output_tex.ptr;
-		output_tex.ptr = nullptr;
-	}				
+		compressionInput_t input;
+		const size_t pixelCount = ( size_t )level.width * ( size_t )level.height;
+		input.pixels.resize( pixelCount * sizeof( unsigned short ) * 4 );
+		unsigned short * data_short = ( unsigned short * )input.pixels.data();
+		for ( size_t j = 0; j < pixelCount; j++ ) {
+			data_short[ j * 4 + 0 ] = F32toF16( level.pixels[ j * 3 + 0 ] );
+			data_short[ j * 4 + 1 ] = F32toF16( level.pixels[ j * 3 + 1 ] );
+			data_short[ j * 4 + 2 ] = F32toF16( level.pixels[ j * 3 + 2 ] );
+			data_short[ j * 4 + 3 ] = 1; //fill alpha channel
+		}
+		input.width = level.width;
+		input.height = level.height;
+		input.chanCount = 3;
+		input.hdr = true;
+		PadToBlocks( input, sizeof( unsigned short ) * 4 );
+		CompressSurface( input, blocks[i], true );
+	}
 
+	store_bc( BC6H_COMPRESSED, levels[0].width, levels[0].height, blocks, output_file_absolute );
 	return true;
 }
 
@@ -575,7 +1329,7 @@ void CubemapTexture::Delete() {
 CubemapTexture::InitWithData
 ===============================
 */
-void CubemapTexture::InitWithData( const void * data, const int face, const int height, const int chanCount, const char * ext ) {
+void CubemapTexture::InitWithData( const void * data, const int face, const int height, const int chanCount, const char * ext, const int level ) {
 	if ( strcmp( ext, "tga" ) == 0 ) {
 		//Map a face of the cube
 		unsigned char * src = ( unsigned char * )data;
@@ -617,43 +1371,25 @@ void CubemapTexture::InitWithData( const void * data, const int face, const int
 		delete[] face_data;
 		face_data = nullptr;
 
-	} else if ( strcmp( ext, "bc7" ) == 0 || strcmp( ext, "bc7a" ) == 0 ) {
-		//Map a face of the cube
-		const unsigned int bytesPerBlock = 16;
-		const unsigned int height_inBlocks = height / 4;
-		unsigned char * src = ( unsigned char * )data;
-		unsigned char * face_data = new unsigned char[ height_inBlocks * height_inBlocks * bytesPerBlock ];
-		for ( unsigned int i = 0; i < height_inBlocks; i++ ) {
-			for ( unsigned int j = 0; j < height_inBlocks; j++ ) {
-				unsigned int k = height_inBlocks * ( unsigned int )face + j;
-				for ( unsigned int n = 0; n < bytesPerBlock; n++ ) {
-					face_data[ ( height_inBlocks * i + j ) * bytesPerBlock + n ] = src[ ( height_inBlocks * 6 * i + k ) * bytesPerBlock + n ];
-				}
-			}
-		}
-		const GLsizei imgSize = height_inBlocks * height_inBlocks * bytesPerBlock; //total number of blocks at 16bytes per block for this face
-		glCompressedTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_COMPRESSED_RGBA_BPTC_UNORM, height, height, 0, imgSize, face_data );
-		delete[] face_data;
-		face_data = nullptr;
-
-	} else if ( strcmp( ext, "bc6h" ) == 0 ) {
-		//Map a face of the cube
+	} else if ( strcmp( ext, "bc7" ) == 0 || strcmp( ext, "bc7a" ) == 0 || strcmp( ext, "bc6h" ) == 0 ) {
+		//Map a face of the cube. The unpack state picks the face's blocks out of the strip so nothing is copied.
 		const unsigned int bytesPerBlock = 16;
 		const unsigned int height_inBlocks = height / 4;
-		unsigned char * src = ( unsigned char * )data;
-		unsigned char * face_data = new unsigned char[ height_inBlocks * height_inBlocks * bytesPerBlock ];
-		for ( unsigned int i = 0; i < height_inBlocks; i++ ) {
-			for ( unsigned int j = 0; j < height_inBlocks; j++ ) {
-				unsigned int k = height_inBlocks * ( unsigned int )face + j;
-				for ( unsigned int n = 0; n < bytesPerBlock; n++ ) {
-					face_data[ ( height_inBlocks * i + j ) * bytesPerBlock + n ] = src[ ( height_inBlocks * 6 * i + k ) * bytesPerBlock + n ];
-				}
-			}
-		}
+		const GLenum internalFormat = ( strcmp( ext, "bc6h" ) == 0 ) ? GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		glPixelStorei( GL_UNPACK_COMPRESSED_BLOCK_WIDTH, 4 );
+		glPixelStorei( GL_UNPACK_COMPRESSED_BLOCK_HEIGHT, 4 );
+		glPixelStorei( GL_UNPACK_COMPRESSED_BLOCK_SIZE, bytesPerBlock );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, height * 6 );
+		glPixelStorei( GL_UNPACK_SKIP_PIXELS, height * face );
 		const GLsizei imgSize = height_inBlocks * height_inBlocks * bytesPerBlock; //total number of blocks at 16bytes per block for this face
-		glCompressedTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB, height, height, 0, imgSize, face_data );
-		delete[] face_data;
-		face_data = nullptr;
+		glCompressedTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, internalFormat, height, height, 0, imgSize, data );
+
+		//restore the default unpack state
+		glPixelStorei( GL_UNPACK_COMPRESSED_BLOCK_WIDTH, 0 );
+		glPixelStorei( GL_UNPACK_COMPRESSED_BLOCK_HEIGHT, 0 );
+		glPixelStorei( GL_UNPACK_COMPRESSED_BLOCK_SIZE, 0 );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+		glPixelStorei( GL_UNPACK_SKIP_PIXELS, 0 );
 	}
 }
 
@@ -806,24 +1542,26 @@ bool CubemapTexture::InitFromFile( const char * relativePath ) {
 		return false;
 	}
 
-	//get absolute path
-	char output_file_absolute[ 2048 ];
-	RelativePathToFullPath( output_file_relative.c_str(), output_file_absolute );
-
-	//open file
-	FILE * fs = fopen( output_file_absolute, "rb" );
-	if ( !fs ) {
+	//map file. The faces are uploaded straight from the mapping.
+	mappedFile_t file;
+	if ( !MapFile( output_file_relative.c_str(), file ) ) {
 		printf( "Failed to load texture: %s\n", output_file_relative.c_str() );
 		UseErrorTexture();
 		return false;
-	}	
+	}
 
 	//load header data
 	bc_header file_header;
-	fread( &file_header, sizeof( bc_header ), 1, fs );	
+	bc_mipHeader mip_header;
+	if ( !ReadBCHeader( file, file_header, mip_header ) ) {
+		printf( "Following texture had invalid header: %s\n", output_file_relative.c_str() );
+		UnmapFile( file );
+		UseErrorTexture();
+		return false;
+	}
 
 	int chanCount;
-	const unsigned int imgType = ( unsigned int )file_header.type;
+	const unsigned int imgType = ( unsigned int )( file_header.type & ~BC_HAS_MIPS );
 	Str fileExtension;
 	if ( imgType == BC6H_COMPRESSED ) {
 		chanCount = 3;
@@ -836,12 +1574,46 @@ bool CubemapTexture::InitFromFile( const char * relativePath ) {
 		fileExtension = "bc7a";
 	} else {
 		printf( "Following texture had invalid header: %s\n", output_file_relative.c_str() );
+		UnmapFile( file );
 		UseErrorTexture();
 		return false;
 	}
 	const int width = ( int )file_header.xsize;
 	const int height = ( int )file_header.ysize;
 
+	const unsigned char * levelData[ BC_MAX_MIPS ];
+	for ( unsigned int level = 0; level < mip_header.mipCount; level++ ) {
+		levelData[ level ] = file.data + mip_header.mipOffsets[ level ];
+	}
+	const bool initialized = InitWithLevels( relativePath, levelData, mip_header.mipCount, width, height, chanCount, fileExtension.c_str() );
+	UnmapFile( file );
+	return initialized;
+}
+
+/*
+===============================
+CubemapTexture::InitFromLevels
+	-like InitFromFile, with every level of the bc file in levels. Its offsets are into data.
+===============================
+*/
+bool CubemapTexture::InitFromLevels( const char * relativePath, const compressedLevels_t & levels, const unsigned char * data ) {
+	strcpy( mStrName, relativePath ); //initialize mStrName
+	assert( levels.firstLevel == 0 && levels.offsets.size() == levels.mipCount );
+
+	const unsigned char * levelData[ BC_MAX_MIPS ];
+	for ( unsigned int level = 0; level < levels.mipCount; level++ ) {
+		levelData[ level ] = data + levels.offsets[ level ];
+	}
+	return InitWithLevels( relativePath, levelData, levels.mipCount, levels.width, levels.height, ( int )levels.chanCount, LevelsExtension( levels ) );
+}
+
+/*
+===============================
+CubemapTexture::InitWithLevels
+	-levelData[i] is the strip of the 6 faces of level i
+===============================
+*/
+bool CubemapTexture::InitWithLevels( const char * relativePath, const unsigned char * const * levelData, const unsigned int mipCount, const int width, const int height, const int chanCount, const char * ext ) {
 	if ( height < 4 ) {
 		UseErrorTexture();
 		printf( "Cubemap width must be 4 or larger: %s\n", relativePath );
@@ -853,11 +1625,11 @@ bool CubemapTexture::InitFromFile( const char * relativePath ) {
 		return false;
 	}
 
-	//load img data
-	const size_t bytes_per_block = 16;
-	const size_t ptr_size = ( width / ( int )file_header.blockdim_x ) * ( height / ( int )file_header.blockdim_y ) * ( int )bytes_per_block;
-	unsigned char * data = new unsigned char[ptr_size];
-	fread( data, ptr_size, 1, fs );
+	//levels whose faces arent a multiple of 4 would share blocks with the next face
+	unsigned int levelCount = 1;
+	while ( levelCount < mipCount && MipDimension( height, levelCount ) % 4 == 0 ) {
+		levelCount++;
+	}
 
 	mWidth = width;
 	mHeight = height;
@@ -875,18 +1647,20 @@ bool CubemapTexture::InitFromFile( const char * relativePath ) {
 
 	//Setup the filtering between texels
 	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, ( levelCount > 1 ) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levelCount - 1 );
 
 	//pass to gpu
-	for ( int face = 0; face < 6; face++ ) {
-		InitWithData( data, face, height, chanCount, fileExtension.c_str() );
+	for ( unsigned int level = 0; level < levelCount; level++ ) {
+		for ( int face = 0; face < 6; face++ ) {
+			InitWithData( levelData[ level ], face, MipDimension( height, level ), chanCount, ext, ( int )level );
+		}
 	}
+	m_mipCount = levelCount;
 
 	// Reset the bound texture to nothing
 	glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
 
-	delete[] data;
-	data = nullptr;
 	m_empty = false;
 
 	return true;
@@ -908,127 +1682,171 @@ void CubemapTexture::UseErrorTexture() {
 
 /*
 ===============================
-CubemapTexture::PrefilterSpeculateProbe
+CubemapArrayTexture::CubemapArrayTexture
 ===============================
 */
-void CubemapTexture::PrefilterSpeculateProbe() {
-	glBindTexture( GL_TEXTURE_CUBE_MAP, mName );
+CubemapArrayTexture::CubemapArrayTexture() {
+	mName = 0;
+	mWidth = 0;
+	mHeight = 0;
+	mChanCount = 0;
+	m_empty = true;
+	m_compressed = false;
+	mTarget = GL_TEXTURE_CUBE_MAP_ARRAY;
+	m_layerCount = 0;
+}
 
-	//set new filtering between texels because we plan on samplint the textures mipmaps and have trilinear filtering
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR ); 
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-	glGenerateMipmap( GL_TEXTURE_CUBE_MAP ); //allocate enough memory for the mip levels
-	
-	//create framebuffer whose color attachement we are drawing to
-	Framebuffer prefilterFBO( "cubemap" );
-	const unsigned int cubeSize = 128;
-	prefilterFBO.CreateNewBuffer( cubeSize, cubeSize, "cubemap" );
-    prefilterFBO.AttachCubeMapTextureBuffer( GL_RGB16F, GL_COLOR_ATTACHMENT0, GL_RGB, GL_FLOAT );
-	if ( !prefilterFBO.Status() ) {
-		assert( false );
-	}
-
-	//specify storage for all mips of cubemap color attachement of prefilterFBO
-	const unsigned int maxMipLevelCount = 5;
-	glBindTexture( GL_TEXTURE_CUBE_MAP, prefilterFBO.m_attachements[0] );
-	glTexStorage2D( GL_TEXTURE_CUBE_MAP, maxMipLevelCount, GL_RGB16F, cubeSize, cubeSize ); //allocate the memory for maxMipLevelCount mips
-	glGenerateMipmap( GL_TEXTURE_CUBE_MAP ); //generate the mip data
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR ); //required to be able to sample specific mips in the frag shader
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-		
-	//compile prefilter shader and pass uniforms
-	Shader * shaderProg = new Shader();
-	shaderProg = shaderProg->GetShader( "prefilter_envMap" );
-	shaderProg->UseProgram();
-	shaderProg->SetAndBindUniformTexture( "environmentMap", 0, GL_TEXTURE_CUBE_MAP, mName );
-	Mat4 projection = Mat4();
-	projection.Perspective( to_radians( 90.0f ), 1.0f, 0.1f, 10.0f );
-	shaderProg->SetUniformMatrix4f( "projection", 1, false, projection.as_ptr() );
-
-	//create cube geo and views to render cubemap to
-	Cube renderBox = Cube( "" );
-	Mat4 views[] = { Mat4(), Mat4(), Mat4(), Mat4(), Mat4(), Mat4() };
-	views[0].LookAt( Vec3( 0.0f, 0.0f, 0.0f ), Vec3( 1.0f, 0.0f, 0.0f ), Vec3( 0.0f, -1.0f, 0.0f ) );
-	views[1].LookAt( Vec3( 0.0f, 0.0f, 0.0f ), Vec3( -1.0f, 0.0f, 0.0f ), Vec3( 0.0f, -1.0f, 0.0f ) );
-	views[2].LookAt( Vec3( 0.0f, 0.0f, 0.0f ), Vec3( 0.0f, 1.0f, 0.0f ), Vec3( 0.0f, 0.0f, 1.0f ) );
-	views[3].LookAt( Vec3( 0.0f, 0.0f, 0.0f ), Vec3( 0.0f, -1.0f, 0.0f ), Vec3( 0.0f, 0.0f, -1.0f ) );
-	views[4].LookAt( Vec3( 0.0f, 0.0f, 0.0f ), Vec3( 0.0f, 0.0f, 1.0f ), Vec3( 0.0f, -1.0f, 0.0f ) );
-	views[5].LookAt( Vec3( 0.0f, 0.0f, 0.0f ), Vec3( 0.0f, 0.0f, -1.0f ), Vec3( 0.0f, -1.0f, 0.0f ) );
-
-	//draw to prefilterFBO by convoluting each face of env cubemap for each mip level
-	prefilterFBO.Bind();
-	shaderProg->UseProgram();
-	for ( unsigned int mip = 0; mip < maxMipLevelCount; mip++ ) {
-		unsigned int mipDimension = cubeSize * pow( 0.5, mip );
-		glViewport( 0, 0, mipDimension, mipDimension );
-
-		const float roughness = ( float )mip / ( float )( maxMipLevelCount - 1 );
-		shaderProg->SetUniform1f( "roughness", 1, &roughness );
-
-		for ( int faceIdx = 0; faceIdx < 6; faceIdx++ ) {
-			shaderProg->SetUniformMatrix4f( "view", 1, false, views[faceIdx].as_ptr() );
-			glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + faceIdx, prefilterFBO.m_attachements[0], mip );
-			glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-			renderBox.DrawSurface( true );
+/*
+===============================
+IsStripCubemap
+	-level 0 of a bc cubemap strip whose faces start on a block
+===============================
+*/
+static bool IsStripCubemap( const compressedLevels_t & cubemap ) {
+	return cubemap.height >= 4 && cubemap.height % 4 == 0 && cubemap.width == cubemap.height * 6 && cubemap.firstLevel == 0 && !cubemap.offsets.empty();
+}
+
+/*
+===============================
+CubemapArrayTexture::PackLayers
+	-repacks the levels of strip cubemaps into the layout of a cubemap array. Layer i is cubemaps[i].
+	-the first usable cubemap decides the face size, format and level count. Levels whose faces
+	 arent a multiple of 4 are dropped.
+	-layers that dont match, or lack some of the levels, are flagged in missingLayers. The blocks
+	 they dont have stay zero, which bc6h and bc7 decode to black.
+===============================
+*/
+bool CubemapArrayTexture::PackLayers( const std::vector< compressedLevels_t > & cubemaps, const unsigned int levelCount, cubemapArrayData_t & packed ) {
+	packed.layerCount = ( unsigned int )cubemaps.size();
+	packed.levels.clear();
+	packed.missingLayers.assign( cubemaps.size(), true );
+
+	int reference = -1;
+	for ( unsigned int i = 0; i < cubemaps.size() && reference < 0; i++ ) {
+		if ( IsStripCubemap( cubemaps[i] ) ) {
+			reference = ( int )i;
 		}
 	}
-	prefilterFBO.Unbind();
+	if ( reference < 0 || levelCount < 1 ) {
+		return false;
+	}
+	packed.faceSize = cubemaps[ reference ].height;
+	packed.internalFormat = cubemaps[ reference ].internalFormat;
+	packed.mipCount = 1;
+	while ( packed.mipCount < levelCount && MipDimension( packed.faceSize, packed.mipCount ) % 4 == 0 ) {
+		packed.mipCount++;
+	}
 
-	//delete old cubemap texture
-	glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
-	if ( mName != s_errorCube ) {
-		glDeleteTextures( 1, &mName );
+	const size_t bytesPerBlock = 16;
+	packed.levels.resize( packed.mipCount );
+	for ( unsigned int level = 0; level < packed.mipCount; level++ ) {
+		const size_t faceBlocks = ( size_t )MipDimension( packed.faceSize, level ) / 4;
+		packed.levels[ level ].assign( faceBlocks * faceBlocks * bytesPerBlock * 6 * packed.layerCount, 0 );
 	}
 
-	//replace the current cubemap with the FBO color attachement
-	mName = prefilterFBO.m_attachements[0];
-	mHeight = cubeSize;
-	mWidth = cubeSize * 6;
+	for ( unsigned int layer = 0; layer < packed.layerCount; layer++ ) {
+		const compressedLevels_t & cubemap = cubemaps[ layer ];
+		if ( !IsStripCubemap( cubemap ) || cubemap.height != packed.faceSize || cubemap.internalFormat != packed.internalFormat ) {
+			continue;
+		}
 
-	//DEBUG: SAVE OUT prefiltered env and its mips
-	/*
-	char imgPath[ 2048 ];
-	if ( RelativePathToFullPath( mStrName, imgPath ) == false ) {
-		assert( false );
-	}
-	Str prefilteredMap_absolute = Str( imgPath );
-
-	for ( unsigned int mip = 0; mip < maxMipLevelCount; mip++ ) {
-		unsigned int mipDimension = cubeSize * std::pow( 0.5, mip );
-
-		//copy prefiltered env texture data from gpu to cpu
-		float * output_data = new float[ mipDimension * 6 * mipDimension * mChanCount ];
-		float * cubemapFace_data = new float[ mipDimension * mipDimension * mChanCount ];
-		for ( int faceIdx = 0; faceIdx < 6; faceIdx++ ) {
-			//copy from gpu to cubemapFace_data
-			glBindTexture( GL_TEXTURE_CUBE_MAP, prefilterFBO.m_attachements[0] );
-			glGetTexImage( GL_TEXTURE_CUBE_MAP_POSITIVE_X + faceIdx, mip, GL_RGB,  GL_FLOAT, cubemapFace_data );
-
-			//write from cubemapFace_data to output_data
-			for ( int i = 0; i < mipDimension; i++ ) {
-				for ( int j = 0; j < mipDimension; j++ ) {
-					const int k = faceIdx * mipDimension + j;
-					const int output_idx = ( i * mipDimension * 6 * mChanCount ) + ( k * mChanCount );
-					const int cubemapFace_idx = ( i * mipDimension * mChanCount ) + ( j * mChanCount );
-					output_data[ output_idx + 0 ] = cubemapFace_data[ cubemapFace_idx + 0 ];
-					output_data[ output_idx + 1 ] = cubemapFace_data[ cubemapFace_idx + 1 ];
-					output_data[ output_idx + 2 ] = cubemapFace_data[ cubemapFace_idx + 2 ];
+		unsigned int level = 0;
+		for ( ; level < packed.mipCount && level < cubemap.offsets.size(); level++ ) {
+			const size_t faceBlocks = ( size_t )MipDimension( packed.faceSize, level ) / 4;
+			const size_t faceRowBytes = faceBlocks * bytesPerBlock;
+			if ( cubemap.offsets[ level ] + faceRowBytes * 6 * faceBlocks > cubemap.data.size() ) {
+				break;
+			}
+
+			//a strip row of blocks holds a row of every face, the array wants each face's rows together
+			const uint8_t * src = cubemap.data.data() + cubemap.offsets[ level ];
+			uint8_t * dst = packed.levels[ level ].data() + ( size_t )layer * 6 * faceBlocks * faceRowBytes;
+			for ( unsigned int face = 0; face < 6; face++ ) {
+				for ( size_t blockRow = 0; blockRow < faceBlocks; blockRow++ ) {
+					memcpy( dst + ( face * faceBlocks + blockRow ) * faceRowBytes, src + blockRow * faceRowBytes * 6 + face * faceRowBytes, faceRowBytes );
 				}
-			}			
+			}
 		}
+		packed.missingLayers[ layer ] = ( level < packed.mipCount );
+	}
+	return true;
+}
 
-		//generate output image path
-		prefilteredMap_absolute = prefilteredMap_absolute.Substring( 0, prefilteredMap_absolute.Length() - 9 );
-		prefilteredMap_absolute += "_env";
-		prefilteredMap_absolute += std::to_string( mip ).c_str();
-		prefilteredMap_absolute += ".hdr";
-		stbi_write_hdr( prefilteredMap_absolute.c_str(), mipDimension * 6, mipDimension, mChanCount, output_data ); //save image
-		delete[] cubemapFace_data;
-		cubemapFace_data = nullptr;
-		delete[] output_data;
-		output_data = nullptr;
+/*
+===============================
+CubemapArrayTexture::InitFromFiles
+	-loads the bc files of strip cubemaps into the layers of one cubemap array, up to levelCount levels
+	-missingCount: optional, receives the number of layers that couldnt be loaded completely
+===============================
+*/
+bool CubemapArrayTexture::InitFromFiles( const std::vector< Str > & relativePaths, const unsigned int levelCount, unsigned int * missingCount ) {
+	std::vector< compressedLevels_t > cubemaps( relativePaths.size() );
+	for ( unsigned int i = 0; i < relativePaths.size(); i++ ) {
+		ReadCompressedLevels( relativePaths[i].c_str(), 0, levelCount, cubemaps[i] ); //layers that cant be read stay empty and are reported below
 	}
-	*/
+
+	cubemapArrayData_t packed;
+	if ( !PackLayers( cubemaps, levelCount, packed ) ) {
+		printf( "Failed to load cubemap array, no layer could be loaded\n" );
+		UseErrorTexture();
+		return false;
+	}
+	unsigned int missing = 0;
+	for ( unsigned int i = 0; i < packed.layerCount; i++ ) {
+		if ( packed.missingLayers[i] ) {
+			printf( "Failed to load texture: %s\n", relativePaths[i].c_str() );
+			missing++;
+		}
+	}
+	if ( missingCount != NULL ) {
+		*missingCount = missing;
+	}
+
+	Delete();
+	glGenTextures( 1, &mName );
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARRAY, mName );
+	glTexStorage3D( GL_TEXTURE_CUBE_MAP_ARRAY, packed.mipCount, packed.internalFormat, packed.faceSize, packed.faceSize, packed.layerCount * 6 );
+
+	//Set the texture wrapping to clamp to edge
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+
+	//Setup the filtering between texels
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, ( packed.mipCount > 1 ) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+
+	//every layer-face of a level is uploaded at once
+	for ( unsigned int level = 0; level < packed.mipCount; level++ ) {
+		const int levelSize = MipDimension( packed.faceSize, level );
+		glCompressedTexSubImage3D( GL_TEXTURE_CUBE_MAP_ARRAY, level, 0, 0, 0, levelSize, levelSize, packed.layerCount * 6, packed.internalFormat, ( GLsizei )packed.levels[ level ].size(), packed.levels[ level ].data() );
+	}
+	glBindTexture( GL_TEXTURE_CUBE_MAP_ARRAY, 0 );
+
+	mWidth = packed.faceSize * 6;
+	mHeight = packed.faceSize;
+	mChanCount = 3;
+	mTarget = GL_TEXTURE_CUBE_MAP_ARRAY;
+	m_mipCount = packed.mipCount;
+	m_layerCount = packed.layerCount;
+	m_compressed = true;
+	m_empty = false;
+	return true;
+}
+
+/*
+===============================
+CubemapArrayTexture::UseErrorTexture
+	-there is no error cubemap array, sampling an unbound one gives black
+===============================
+*/
+void CubemapArrayTexture::UseErrorTexture() {
+	mName = 0;
+	mWidth = 0;
+	mHeight = 0;
+	mChanCount = 3;
+	mTarget = GL_TEXTURE_CUBE_MAP_ARRAY;
+	m_layerCount = 0;
 }
 
 /*
@@ -2,7 +2,9 @@
 #ifndef __TEXTURE_H_INCLUDE__
 #define __TEXTURE_H_INCLUDE__
 
+#include <string>
 #include <vector>
+#include <unordered_map>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
@@ -11,6 +13,8 @@
 #include <windows.h>
 #include <vector>
 #include "ispc_texcomp.h"
+#include "String.h"
+#include "Fileio.h"
 
 /*
 ========================
@@ -33,6 +37,99 @@ inline unsigned short F32toF16( float a ) {
 	return ( unsigned short )( signbit | ( exponent << 10 ) | ( mantissa >> 13 ) );
 }
 
+/*
+========================
+F16toF32
+	-inverse of F32toF16. Denormals are flushed to zero.
+========================
+*/
+inline float F16toF32( unsigned short a ) {
+	unsigned int signbit = ( a & 0x8000 ) << 16;
+	unsigned int exponent = ( a & 0x7C00 ) >> 10;
+	unsigned int mantissa = ( a & 0x03FF );
+
+	union {
+		unsigned int u;
+		float f;
+	} bits;
+	bits.u = signbit;
+	if ( exponent != 0 ) {
+		bits.u |= ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 );
+	}
+	return bits.f;
+}
+
+/*
+===============================
+textureUsage_t
+	-how texel values are filtered when generating mips
+===============================
+*/
+enum textureUsage_t {
+	TEXTURE_USAGE_COLOR,	//rgb is gamma 2.2, alpha is linear
+	TEXTURE_USAGE_LINEAR,
+	TEXTURE_USAGE_NORMAL,	//rgb is a unit vector packed into 0-1, renormalized after filtering
+};
+
+/*
+===============================
+compressionInput_t
+	-decoded image ready to be compressed. surface points into pixels.
+===============================
+*/
+struct compressionInput_t {
+	std::vector< uint8_t > pixels; //rgba8 for bc7, rgba16f for bc6h
+	rgba_surface surface;
+	int width;
+	int height;
+	int chanCount; //channel count written to the bc header
+	bool hdr;
+};
+
+/*
+===============================
+compressedLevels_t
+	-a range of levels read out of a bc file. Header fields describe the whole file.
+	-levels of a mapped bc file leave data empty, offsets are into the mapping then.
+===============================
+*/
+struct compressedLevels_t {
+	int width; //of level 0
+	int height;
+	unsigned int mipCount;
+	unsigned int chanCount;
+	GLenum internalFormat;
+	unsigned int firstLevel; //level of the first entry in offsets
+	std::vector< uint8_t > data;
+	std::vector< size_t > offsets; //where each level starts in data, or in the mapped file
+};
+
+//a texture of a decl, see Texture::AcquireAll
+struct textureRequest_t {
+	std::string path;
+	bool cubemap;
+};
+
+/*
+===============================
+textureLoad_t
+	-the part of loading a texture that is done on the thread pool, see Texture::ReadLoads
+===============================
+*/
+struct textureLoad_t {
+	std::string path;
+	bool cubemap;
+	bool streamed; //only the mip tail was read, for the TextureStreamer
+	bool read; //false when the file couldnt be read, InitFromFile is used to report it
+	compressedLevels_t info; //layout of the file, only for streamed textures
+	compressedLevels_t levels; //the mip tail of streamed textures, otherwise the offsets of every level in file
+	mappedFile_t file; //bc file of textures that arent streamed, mapped until they are uploaded
+};
+
+struct envImage_t;
+class Texture;
+typedef std::unordered_multimap< uint64_t, Texture* > textureRegistry_t; //paths with colliding hashes share a key
+
 /*
 ===============================
 Texture
@@ -41,10 +138,20 @@ Texture
 class Texture {
 	public:
 		Texture();
-		~Texture() {};
-		void Delete();
+		virtual ~Texture() {};
+		virtual void Delete();
+
+		//registry of the textures used by decls, keyed by the hash of the normalized path
+		static Texture * Acquire( const char * relativePath, const bool cubemap );
+		static void Release( Texture * texture );
+		static uint64_t PathHash( const char * relativePath, const bool cubemap );
+		static unsigned int RegisteredCount() { return ( unsigned int )s_registry.size(); }
+		static void AcquireAll( const std::vector< textureRequest_t > & requests, std::vector< Texture * > & textures, const unsigned int maxThreads = 0 );
+		static void ReadLoads( std::vector< textureLoad_t > & loads, const unsigned int maxThreads = 0 );
+		static void UnmapLoads( std::vector< textureLoad_t > & loads );
 	
 		virtual bool InitFromFile( const char * relativePath );
+		virtual bool InitFromLevels( const char * relativePath, const compressedLevels_t & levels, const unsigned char * data );
 		virtual bool InitFromFile_Uncompressed( const char * relativePath );
 		unsigned int GetName()	const { return mName; }
 		int GetWidth() const { return mWidth; }
@@ -52,9 +159,25 @@ class Texture {
 		int GetChanCount() const { return mChanCount; }
 		GLenum GetTarget() const { return mTarget; }
 
-		static bool CompressFromFile( const char * relativePath );
+		static bool CompressFromFile( const char * relativePath, const bool generateMips, const textureUsage_t usage, size_t * pixelCount = NULL );
+		static bool CompressCubemap( const char * relativePath, const std::vector< envImage_t > & levels );
+		static Str CompressedPath( const char * relativePath );
+		static size_t CompressionMemoryEstimate( const char * relativePath, const bool generateMips );
+		static uint64_t CompressionSettingsHash( const bool generateMips, const textureUsage_t usage );
+		static bool LoadCompressionInput( const char * relativePath, compressionInput_t & input );
+		static void CompressSurface( const compressionInput_t & input, std::vector< uint8_t > & blocks, const bool multithreaded );
+		static unsigned int s_compressStripHeight; //block rows per compression job
+		static int MipDimension( const int size, const unsigned int level );
+		static size_t CompressedLevelSize( const int width, const int height );
+
+		//streaming
+		static bool MapCompressedLevels( const char * relativePath, compressedLevels_t & levels, mappedFile_t & file );
+		static bool ReadCompressedLevels( const char * relativePath, const unsigned int firstLevel, const unsigned int endLevel, compressedLevels_t & levels );
+		void SetResidentLevels( const compressedLevels_t & levels, const unsigned int firstLevel );
+		unsigned int GetResidentLevel() const { return m_residentLevel; }
+		unsigned int GetMipCount() const { return m_mipCount; }
+		bool m_streamed; //levels are managed by the TextureStreamer
 
-		static std::vector< Texture* > s_textures;
 		char mStrName[1024];
 		bool m_empty;
 		bool m_compressed;
@@ -69,9 +192,16 @@ class Texture {
 		int mHeight;
 		int mChanCount;
 		GLenum mTarget;
+		unsigned int m_residentLevel; //finest level in gpu memory
+		unsigned int m_mipCount;
+		uint64_t m_registryKey;
+		unsigned int m_refCount; //decls using the texture, only counted for registered textures
+
+		static textureRegistry_t s_registry;
+		static Texture * FindRegistered( const uint64_t key, const char * relativePath );
 
 	private:
-		void InitWithData( const unsigned char * data, const int width, const int height, const int chanCount, const char * ext );
+		void InitWithData( const unsigned char * data, const int width, const int height, const int chanCount, const char * ext, const unsigned int mipCount = 1, const unsigned int * mipOffsets = NULL );
 };
 
 /*
@@ -83,21 +213,58 @@ class CubemapTexture : public Texture {
 	public:
 		CubemapTexture();
 		~CubemapTexture() {};
-		void Delete();
+		void Delete() override;
 
 		bool InitFromFile( const char * relativePath );
 		bool InitFromFile_Uncompressed( const char * relativePath );
-		void PrefilterSpeculateProbe();
+		bool InitFromLevels( const char * relativePath, const compressedLevels_t & levels, const unsigned char * data ) override;
 
 		static unsigned int s_errorCube;
 		static unsigned int InitErrorCube();
 		void UseErrorTexture() override;
 
 	private:
-		void InitWithData( const void * data, const int face, const int height, const int chanCount, const char * ext );
+		bool InitWithLevels( const char * relativePath, const unsigned char * const * levelData, const unsigned int mipCount, const int width, const int height, const int chanCount, const char * ext );
+		void InitWithData( const void * data, const int face, const int height, const int chanCount, const char * ext, const int level = 0 );
 		void InitWithData( const float * data, const int face, const int height, const int chanCount );
 };
 
+/*
+===============================
+cubemapArrayData_t
+	-compressed levels of strip cubemaps repacked for a cubemap array. Each level holds the faces
+	 of every layer one after another, layer major, with the blocks of a face contiguous.
+===============================
+*/
+struct cubemapArrayData_t {
+	int faceSize; //of level 0
+	unsigned int layerCount;
+	unsigned int mipCount;
+	GLenum internalFormat;
+	std::vector< std::vector< uint8_t > > levels;
+	std::vector< bool > missingLayers; //layers missing some or all of their levels
+};
+
+/*
+===============================
+CubemapArrayTexture
+===============================
+*/
+class CubemapArrayTexture : public Texture {
+	public:
+		CubemapArrayTexture();
+		~CubemapArrayTexture() {};
+
+		bool InitFromFiles( const std::vector< Str > & relativePaths, const unsigned int levelCount, unsigned int * missingCount = NULL );
+		unsigned int GetLayerCount() const { return m_layerCount; }
+		void UseErrorTexture() override;
+
+		static bool PackLayers( const std::vector< compressedLevels_t > & cubemaps, const unsigned int levelCount, cubemapArrayData_t & packed );
+
+	private:
+		unsigned int m_layerCount;
+};
+
 /*
 ===============================
 LUTTexture
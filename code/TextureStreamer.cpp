@@ -0,0 +1,571 @@
+#include "TextureStreamer.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "Decl.h"
+
+#include <algorithm>
+#include <math.h>
+
+TextureStreamer * TextureStreamer::inst_ = NULL; //Define the static Singleton pointer
+bool TextureStreamer::s_enabled = true;
+unsigned int TextureStreamer::s_mipTailSize = 128;
+size_t StreamingScheduler::s_budget = ( size_t )512 * 1024 * 1024;
+unsigned int StreamingScheduler::s_maxLoadsInFlight = 4;
+
+struct loadCandidate_t {
+	unsigned int textureId;
+	unsigned int missingLevels; //sorted descending
+};
+
+/*
+================================
+CompareLoadCandidates
+================================
+*/
+static bool CompareLoadCandidates( const loadCandidate_t& a, const loadCandidate_t& b ) {
+	if ( a.missingLevels != b.missingLevels ) {
+		return a.missingLevels > b.missingLevels;
+	}
+	return a.textureId < b.textureId;
+}
+
+/*
+================================
+StreamingScheduler::LevelBytes
+	-bytes of levels [firstLevel, endLevel)
+================================
+*/
+size_t StreamingScheduler::LevelBytes( const entry_t & entry, const unsigned int firstLevel, const unsigned int endLevel ) const {
+	size_t bytes = 0;
+	for ( unsigned int i = firstLevel; i < endLevel && i < entry.levelBytes.size(); i++ ) {
+		bytes += entry.levelBytes[i];
+	}
+	return bytes;
+}
+
+/*
+================================
+StreamingScheduler::AddTexture
+	-the texture starts out with only its mip tail resident. Returns the texture id.
+================================
+*/
+unsigned int StreamingScheduler::AddTexture( const std::vector< size_t > & levelBytes, const unsigned int tailLevel ) {
+	entry_t entry;
+	entry.levelBytes = levelBytes;
+	entry.tailLevel = std::min( tailLevel, ( unsigned int )levelBytes.size() - 1 );
+	entry.residentLevel = entry.tailLevel;
+	entry.pendingLevel = entry.tailLevel;
+	entry.wantedLevel = entry.tailLevel;
+	entry.lastUsedFrame = 0;
+	entry.active = true;
+	m_committedBytes += LevelBytes( entry, entry.tailLevel, ( unsigned int )levelBytes.size() );
+	m_entries.push_back( entry );
+	return ( unsigned int )m_entries.size() - 1;
+}
+
+/*
+================================
+StreamingScheduler::RemoveTexture
+	-a load that is still in flight must still be reported to LoadFinished
+================================
+*/
+void StreamingScheduler::RemoveTexture( const unsigned int textureId ) {
+	entry_t & entry = m_entries[ textureId ];
+	if ( !entry.active ) {
+		return;
+	}
+	const unsigned int firstLevel = std::min( entry.residentLevel, entry.pendingLevel );
+	m_committedBytes -= LevelBytes( entry, firstLevel, ( unsigned int )entry.levelBytes.size() );
+	entry.active = false;
+}
+
+/*
+================================
+StreamingScheduler::Request
+	-the texture is visible this frame and needs level. Keeps the finest level requested in a frame.
+================================
+*/
+void StreamingScheduler::Request( const unsigned int textureId, const unsigned int level, const unsigned int frame ) {
+	entry_t & entry = m_entries[ textureId ];
+	const unsigned int clampedLevel = std::min( level, entry.tailLevel );
+	if ( entry.lastUsedFrame != frame ) {
+		entry.wantedLevel = clampedLevel;
+		entry.lastUsedFrame = frame;
+	} else {
+		entry.wantedLevel = std::min( entry.wantedLevel, clampedLevel );
+	}
+}
+
+/*
+================================
+StreamingScheduler::EvictOne
+	-frees the finest level of one texture. Textures that werent used this frame go first, least
+	 recently used first. Then visible textures that have finer levels than they want.
+	-returns false if nothing can be evicted
+================================
+*/
+bool StreamingScheduler::EvictOne( const unsigned int frame, std::vector< streamRequest_t > & evictions ) {
+	int bestIdx = -1;
+	for ( unsigned int i = 0; i < m_entries.size(); i++ ) {
+		const entry_t & entry = m_entries[i];
+		if ( !entry.active || entry.pendingLevel != entry.residentLevel || entry.residentLevel >= entry.tailLevel || entry.lastUsedFrame == frame ) {
+			continue;
+		}
+		if ( bestIdx < 0 || entry.lastUsedFrame < m_entries[ bestIdx ].lastUsedFrame ) {
+			bestIdx = ( int )i;
+		}
+	}
+	if ( bestIdx < 0 ) {
+		unsigned int bestSurplus = 0;
+		for ( unsigned int i = 0; i < m_entries.size(); i++ ) {
+			const entry_t & entry = m_entries[i];
+			if ( !entry.active || entry.pendingLevel != entry.residentLevel || entry.residentLevel >= entry.wantedLevel ) {
+				continue;
+			}
+			const unsigned int surplus = entry.wantedLevel - entry.residentLevel;
+			if ( surplus > bestSurplus ) {
+				bestSurplus = surplus;
+				bestIdx = ( int )i;
+			}
+		}
+	}
+	if ( bestIdx < 0 ) {
+		return false;
+	}
+
+	entry_t & entry = m_entries[ bestIdx ];
+	m_committedBytes -= entry.levelBytes[ entry.residentLevel ];
+	entry.residentLevel += 1;
+	entry.pendingLevel = entry.residentLevel;
+
+	//merge with an earlier eviction of the same texture so it is only recreated once
+	for ( unsigned int i = 0; i < evictions.size(); i++ ) {
+		if ( evictions[i].textureId == ( unsigned int )bestIdx ) {
+			evictions[i].level = entry.residentLevel;
+			return true;
+		}
+	}
+	streamRequest_t eviction;
+	eviction.textureId = ( unsigned int )bestIdx;
+	eviction.level = entry.residentLevel;
+	evictions.push_back( eviction );
+	return true;
+}
+
+/*
+================================
+StreamingScheduler::Update
+	-loads are the levels to read and upload. Evictions are applied to the accounting right away,
+	 the caller has to drop the levels before the loads finish.
+================================
+*/
+void StreamingScheduler::Update( const unsigned int frame, std::vector< streamRequest_t > & loads, std::vector< streamRequest_t > & evictions ) {
+	loads.clear();
+	evictions.clear();
+
+	std::vector< loadCandidate_t > candidates;
+	for ( unsigned int i = 0; i < m_entries.size(); i++ ) {
+		const entry_t & entry = m_entries[i];
+		if ( entry.active && entry.lastUsedFrame == frame && entry.pendingLevel == entry.residentLevel && entry.wantedLevel < entry.residentLevel ) {
+			loadCandidate_t candidate;
+			candidate.textureId = i;
+			candidate.missingLevels = entry.residentLevel - entry.wantedLevel;
+			candidates.push_back( candidate );
+		}
+	}
+	std::sort( candidates.begin(), candidates.end(), CompareLoadCandidates );
+
+	for ( unsigned int i = 0; i < candidates.size() && m_loadsInFlight < s_maxLoadsInFlight; i++ ) {
+		entry_t & entry = m_entries[ candidates[i].textureId ];
+
+		//a coarser level is tried when the wanted one doesnt fit
+		unsigned int level = entry.wantedLevel;
+		size_t bytes = 0;
+		while ( level < entry.residentLevel ) {
+			bytes = LevelBytes( entry, level, entry.residentLevel );
+			while ( m_committedBytes + bytes > s_budget && EvictOne( frame, evictions ) ) {
+			}
+			if ( m_committedBytes + bytes <= s_budget ) {
+				break;
+			}
+			level += 1;
+		}
+		if ( level >= entry.residentLevel ) {
+			continue;
+		}
+
+		entry.pendingLevel = level;
+		m_committedBytes += bytes;
+		m_loadsInFlight += 1;
+
+		streamRequest_t load;
+		load.textureId = candidates[i].textureId;
+		load.level = level;
+		loads.push_back( load );
+	}
+}
+
+/*
+================================
+StreamingScheduler::LoadFinished
+================================
+*/
+void StreamingScheduler::LoadFinished( const unsigned int textureId, const bool success ) {
+	m_loadsInFlight -= 1;
+	entry_t & entry = m_entries[ textureId ];
+	if ( !entry.active ) {
+		return; //bytes were released by RemoveTexture
+	}
+	if ( success ) {
+		entry.residentLevel = entry.pendingLevel;
+	} else {
+		m_committedBytes -= LevelBytes( entry, entry.pendingLevel, entry.residentLevel );
+		entry.pendingLevel = entry.residentLevel;
+	}
+}
+
+/*
+================================
+StreamingScheduler::TextureCount
+================================
+*/
+unsigned int StreamingScheduler::TextureCount() const {
+	unsigned int count = 0;
+	for ( unsigned int i = 0; i < m_entries.size(); i++ ) {
+		if ( m_entries[i].active ) {
+			count += 1;
+		}
+	}
+	return count;
+}
+
+/*
+================================
+StreamingScheduler::TailBytes
+	-bytes that are resident no matter the budget
+================================
+*/
+size_t StreamingScheduler::TailBytes() const {
+	size_t bytes = 0;
+	for ( unsigned int i = 0; i < m_entries.size(); i++ ) {
+		if ( m_entries[i].active ) {
+			bytes += LevelBytes( m_entries[i], m_entries[i].tailLevel, ( unsigned int )m_entries[i].levelBytes.size() );
+		}
+	}
+	return bytes;
+}
+
+/*
+================================
+SimRandom
+	-lcg so that the simulation gives the same results on every platform
+================================
+*/
+static unsigned int SimRandom( unsigned int * state ) {
+	*state = *state * 1664525u + 1013904223u;
+	return *state >> 8;
+}
+
+/*
+================================
+StreamingScheduler::Simulate
+	-runs the scheduler against synthetic bc7 textures from 256 to 4096 pixels using the current budget.
+	-the camera moves every 60 frames, each texture is then visible with a chance of 1 in 3 and
+	 wants a random level. Loads take 3 frames.
+================================
+*/
+streamSimStats_t StreamingScheduler::Simulate( const unsigned int textureCount, const unsigned int frameCount, const unsigned int seed ) {
+	const unsigned int loadLatency = 3;
+	const unsigned int tailSize = 128;
+
+	unsigned int rng = seed;
+	StreamingScheduler scheduler;
+	for ( unsigned int i = 0; i < textureCount; i++ ) {
+		const unsigned int size = 256 << ( SimRandom( &rng ) % 5 );
+		std::vector< size_t > levelBytes;
+		unsigned int tailLevel = 0;
+		for ( unsigned int level = 0; ( size >> level ) > 0; level++ ) {
+			const size_t levelSize = size >> level;
+			const size_t blocks = ( levelSize + 3 ) / 4;
+			levelBytes.push_back( blocks * blocks * 16 );
+			if ( levelSize > tailSize ) {
+				tailLevel = level + 1;
+			}
+		}
+		scheduler.AddTexture( levelBytes, tailLevel );
+	}
+
+	streamSimStats_t stats;
+	stats.frames = frameCount;
+	stats.loads = 0;
+	stats.evictions = 0;
+	stats.peakCommittedBytes = 0;
+	stats.overBudgetFrames = 0;
+	stats.avgLevelGap = 0.0f;
+	stats.checksum = 2166136261u;
+
+	std::vector< unsigned int > wanted( textureCount, 0 );
+	std::vector< bool > visible( textureCount, false );
+	std::vector< std::pair< unsigned int, unsigned int > > inFlight; //texture id, frame the load finishes
+	std::vector< streamRequest_t > loads;
+	std::vector< streamRequest_t > evictions;
+	double totalGap = 0.0;
+	unsigned int gapSamples = 0;
+	const size_t tailBytes = scheduler.TailBytes();
+	for ( unsigned int frame = 1; frame <= frameCount; frame++ ) {
+		//move the camera
+		if ( frame % 60 == 1 ) {
+			for ( unsigned int i = 0; i < textureCount; i++ ) {
+				visible[i] = ( SimRandom( &rng ) % 3 ) == 0;
+				wanted[i] = SimRandom( &rng ) % 6;
+			}
+		}
+
+		//finish loads
+		for ( unsigned int i = 0; i < inFlight.size(); ) {
+			if ( inFlight[i].second <= frame ) {
+				scheduler.LoadFinished( inFlight[i].first, true );
+				inFlight.erase( inFlight.begin() + i );
+			} else {
+				i++;
+			}
+		}
+
+		for ( unsigned int i = 0; i < textureCount; i++ ) {
+			if ( visible[i] ) {
+				scheduler.Request( i, wanted[i], frame );
+			}
+		}
+		scheduler.Update( frame, loads, evictions );
+
+		for ( unsigned int i = 0; i < loads.size(); i++ ) {
+			inFlight.push_back( std::pair< unsigned int, unsigned int >( loads[i].textureId, frame + loadLatency ) );
+			stats.checksum = ( stats.checksum ^ loads[i].textureId ) * 16777619u;
+			stats.checksum = ( stats.checksum ^ loads[i].level ) * 16777619u;
+		}
+		for ( unsigned int i = 0; i < evictions.size(); i++ ) {
+			stats.checksum = ( stats.checksum ^ ( evictions[i].textureId | 0x80000000u ) ) * 16777619u;
+			stats.checksum = ( stats.checksum ^ evictions[i].level ) * 16777619u;
+		}
+		stats.loads += ( unsigned int )loads.size();
+		stats.evictions += ( unsigned int )evictions.size();
+
+		stats.peakCommittedBytes = std::max( stats.peakCommittedBytes, scheduler.CommittedBytes() );
+		if ( scheduler.CommittedBytes() > std::max( s_budget, tailBytes ) ) {
+			stats.overBudgetFrames += 1;
+		}
+		for ( unsigned int i = 0; i < textureCount; i++ ) {
+			if ( visible[i] ) {
+				const unsigned int wantedLevel = std::min( wanted[i], scheduler.m_entries[i].tailLevel );
+				totalGap += ( double )( scheduler.ResidentLevel( i ) - std::min( wantedLevel, scheduler.ResidentLevel( i ) ) );
+				gapSamples += 1;
+			}
+		}
+	}
+	stats.avgLevelGap = ( gapSamples > 0 ) ? ( float )( totalGap / ( double )gapSamples ) : 0.0f;
+
+	return stats;
+}
+
+/*
+================================
+TextureStreamer::getInstance
+================================
+*/
+TextureStreamer * TextureStreamer::getInstance() {
+	if ( inst_ == NULL ) {
+		inst_ = new TextureStreamer();
+	}
+	return( inst_ );
+}
+
+/*
+================================
+TextureStreamer::Register
+	-uploads the mip tail of the texture's bc file and starts streaming it.
+	-returns false if the file cant be streamed, the texture is left untouched in that case.
+================================
+*/
+bool TextureStreamer::Register( Texture * texture, const char * relativePath ) {
+	compressedLevels_t info;
+	compressedLevels_t tail;
+	if ( !ReadMipTail( relativePath, info, tail ) ) {
+		return false;
+	}
+	Register( texture, relativePath, info, tail );
+	return true;
+}
+
+/*
+================================
+TextureStreamer::ReadMipTail
+	-reads the layout of a bc file and its mip tail, every level that fits in s_mipTailSize.
+	-false if the file cant be streamed.
+	-no gl calls so it can be run on the thread pool
+================================
+*/
+bool TextureStreamer::ReadMipTail( const char * relativePath, compressedLevels_t & info, compressedLevels_t & tail ) {
+	if ( !Texture::ReadCompressedLevels( relativePath, 0, 0, info ) || info.mipCount < 2 ) {
+		return false;
+	}
+
+	unsigned int tailLevel = 0;
+	for ( unsigned int level = 0; level < info.mipCount; level++ ) {
+		const int levelWidth = Texture::MipDimension( info.width, level );
+		const int levelHeight = Texture::MipDimension( info.height, level );
+		if ( ( unsigned int )std::max( levelWidth, levelHeight ) > s_mipTailSize ) {
+			tailLevel = level + 1;
+		}
+	}
+	tailLevel = std::min( tailLevel, info.mipCount - 1 );
+	return Texture::ReadCompressedLevels( relativePath, tailLevel, info.mipCount, tail );
+}
+
+/*
+================================
+TextureStreamer::Register
+	-uploads a mip tail read with ReadMipTail and starts streaming the texture
+================================
+*/
+void TextureStreamer::Register( Texture * texture, const char * relativePath, const compressedLevels_t & info, const compressedLevels_t & tail ) {
+	const unsigned int tailLevel = tail.firstLevel;
+	std::vector< size_t > levelBytes;
+	for ( unsigned int level = 0; level < info.mipCount; level++ ) {
+		levelBytes.push_back( Texture::CompressedLevelSize( Texture::MipDimension( info.width, level ), Texture::MipDimension( info.height, level ) ) );
+	}
+
+	strcpy( texture->mStrName, relativePath );
+	texture->SetResidentLevels( tail, tailLevel );
+	texture->m_streamed = true;
+
+	streamedTexture_t streamed;
+	streamed.texture = texture;
+	streamed.path = relativePath;
+	streamed.info = info;
+	const unsigned int textureId = m_scheduler.AddTexture( levelBytes, tailLevel );
+	assert( textureId == m_textures.size() );
+	m_textures.push_back( streamed );
+	m_ids[ texture ] = textureId;
+}
+
+/*
+================================
+TextureStreamer::Remove
+	-stops streaming a texture that is about to be deleted
+================================
+*/
+void TextureStreamer::Remove( Texture * texture ) {
+	std::map< Texture *, unsigned int >::iterator it = m_ids.find( texture );
+	if ( it == m_ids.end() ) {
+		return;
+	}
+	m_scheduler.RemoveTexture( it->second );
+	m_textures[ it->second ].texture = NULL;
+	m_ids.erase( it );
+}
+
+/*
+================================
+TextureStreamer::RequestMeshLevels
+	-every visible texture asks for the level whose texels are about a pixel on screen, assuming
+	 the texture covers the mesh's bounds once.
+================================
+*/
+void TextureStreamer::RequestMeshLevels( Scene * scene, const Camera & camera, const int screenHeight ) {
+	const float pixelsPerUnitAtOne = ( float )screenHeight * 0.5f / tanf( to_radians( camera.m_fov ) * 0.5f );
+	for ( int i = 0; i < scene->MeshCount(); i++ ) {
+		Mesh * mesh = scene->MeshByIndex( i );
+		for ( unsigned int j = 0; j < mesh->m_transforms.size(); j++ ) {
+			const bbox & bounds = mesh->m_transforms[j]->GetWorldBounds();
+			const Vec3 center = ( bounds.max + bounds.min ) * 0.5f;
+			const float radius = ( bounds.max - bounds.min ).length() * 0.5f;
+			const float dist = ( center - camera.GetPosition() ).length();
+
+			//behind the camera counts too, the camera can turn faster than levels stream in
+			float projectedDiameter = 1000000.0f;
+			if ( dist > radius ) {
+				projectedDiameter = 2.0f * radius * pixelsPerUnitAtOne / dist;
+			}
+
+			for ( unsigned int k = 0; k < mesh->m_surfaces.size(); k++ ) {
+				if ( mesh->m_surfaces[k]->declId == DECL_ID_NONE ) {
+					continue;
+				}
+				MaterialDecl * matDecl = MaterialDecl::DeclById( mesh->m_surfaces[k]->declId );
+				textureMap::iterator it_tex = matDecl->m_textures.begin();
+				while ( it_tex != matDecl->m_textures.end() ) {
+					std::map< Texture *, unsigned int >::iterator it_id = m_ids.find( it_tex->second );
+					if ( it_id != m_ids.end() ) {
+						const compressedLevels_t & info = m_textures[ it_id->second ].info;
+						const float texels = ( float )std::max( info.width, info.height );
+						const float ratio = texels / std::max( projectedDiameter, 1.0f );
+						const unsigned int level = ( ratio > 1.0f ) ? ( unsigned int )floorf( log2f( ratio ) ) : 0;
+						m_scheduler.Request( it_id->second, level, m_frame );
+					}
+					it_tex++;
+				}
+			}
+		}
+	}
+}
+
+/*
+================================
+TextureStreamer::Update
+	-called once per frame on the main thread
+================================
+*/
+void TextureStreamer::Update( Scene * scene, const Camera & camera, const int screenHeight ) {
+	m_frame += 1;
+
+	//upload the levels that finished loading
+	std::vector< finishedLoad_t * > finished;
+	{
+		std::lock_guard< std::mutex > lock( m_finishedMutex );
+		finished.swap( m_finished );
+	}
+	for ( unsigned int i = 0; i < finished.size(); i++ ) {
+		const unsigned int textureId = finished[i]->textureId;
+		Texture * texture = m_textures[ textureId ].texture;
+		if ( texture != NULL && finished[i]->success ) {
+			texture->SetResidentLevels( finished[i]->levels, finished[i]->levels.firstLevel );
+		}
+		m_scheduler.LoadFinished( textureId, finished[i]->success );
+		delete finished[i];
+	}
+
+	if ( m_textures.empty() ) {
+		return;
+	}
+
+	RequestMeshLevels( scene, camera, screenHeight );
+
+	std::vector< streamRequest_t > loads;
+	std::vector< streamRequest_t > evictions;
+	m_scheduler.Update( m_frame, loads, evictions );
+
+	//drop evicted levels. The remaining levels are copied to a smaller texture.
+	for ( unsigned int i = 0; i < evictions.size(); i++ ) {
+		Texture * texture = m_textures[ evictions[i].textureId ].texture;
+		if ( texture != NULL ) {
+			texture->SetResidentLevels( m_textures[ evictions[i].textureId ].info, evictions[i].level );
+		}
+	}
+
+	//read the new levels on the thread pool. GL calls have to wait for the main thread.
+	ThreadPool * pool = ThreadPool::getInstance();
+	for ( unsigned int i = 0; i < loads.size(); i++ ) {
+		const unsigned int textureId = loads[i].textureId;
+		const unsigned int firstLevel = loads[i].level;
+		const unsigned int endLevel = m_scheduler.ResidentLevel( textureId );
+		const std::string path = m_textures[ textureId ].path;
+		pool->Submit( m_group, [this, textureId, firstLevel, endLevel, path] {
+			finishedLoad_t * load = new finishedLoad_t;
+			load->textureId = textureId;
+			load->success = Texture::ReadCompressedLevels( path.c_str(), firstLevel, endLevel, load->levels );
+
+			std::lock_guard< std::mutex > lock( m_finishedMutex );
+			m_finished.push_back( load );
+		} );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+#ifndef __TEXTURESTREAMER_H_INCLUDE__
+#define __TEXTURESTREAMER_H_INCLUDE__
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Texture.h"
+#include "ThreadPool.h"
+
+class Scene;
+class Camera;
+
+struct streamRequest_t {
+	unsigned int textureId;
+	unsigned int level; //first resident level once the request is done
+};
+
+struct streamSimStats_t {
+	unsigned int frames;
+	unsigned int loads;
+	unsigned int evictions;
+	size_t peakCommittedBytes;
+	unsigned int overBudgetFrames; //frames where more than the budget was committed while tails alone fit
+	float avgLevelGap; //levels a visible texture was coarser than wanted, averaged over frames and visible textures
+	unsigned int checksum; //hash of every load and eviction of every frame
+};
+
+/*
+==============================
+StreamingScheduler
+	-decides which mip levels of the streamed textures should be resident.
+	-every texture always keeps its mip tail. Finer levels are loaded for textures that were
+	 requested this frame, the textures missing the most levels first.
+	-bytes of loads in flight count against the budget from the moment they are issued. When a
+	 load doesnt fit, the least recently used textures give up their finest levels, and visible
+	 textures give up levels finer than they want. If that still isnt enough a coarser level is tried.
+==============================
+*/
+class StreamingScheduler {
+	public:
+		StreamingScheduler() { m_committedBytes = 0; m_loadsInFlight = 0; }
+		~StreamingScheduler() {};
+
+		unsigned int AddTexture( const std::vector< size_t > & levelBytes, const unsigned int tailLevel );
+		void RemoveTexture( const unsigned int textureId );
+		void Request( const unsigned int textureId, const unsigned int level, const unsigned int frame );
+		void Update( const unsigned int frame, std::vector< streamRequest_t > & loads, std::vector< streamRequest_t > & evictions );
+		void LoadFinished( const unsigned int textureId, const bool success );
+
+		unsigned int ResidentLevel( const unsigned int textureId ) const { return m_entries[ textureId ].residentLevel; }
+		unsigned int TextureCount() const;
+		size_t CommittedBytes() const { return m_committedBytes; }
+		size_t TailBytes() const;
+		unsigned int LoadsInFlight() const { return m_loadsInFlight; }
+
+		static streamSimStats_t Simulate( const unsigned int textureCount, const unsigned int frameCount, const unsigned int seed );
+
+		static size_t s_budget; //bytes of texture levels that may be resident or loading
+		static unsigned int s_maxLoadsInFlight;
+
+	private:
+		struct entry_t {
+			std::vector< size_t > levelBytes;
+			unsigned int tailLevel; //levels from here on are never evicted
+			unsigned int residentLevel;
+			unsigned int pendingLevel; //equal to residentLevel when no load is in flight
+			unsigned int wantedLevel;
+			unsigned int lastUsedFrame;
+			bool active;
+		};
+
+		size_t LevelBytes( const entry_t & entry, const unsigned int firstLevel, const unsigned int endLevel ) const;
+		bool EvictOne( const unsigned int frame, std::vector< streamRequest_t > & evictions );
+
+		std::vector< entry_t > m_entries; //indexed by texture id
+		size_t m_committedBytes;
+		unsigned int m_loadsInFlight;
+};
+
+/*
+==============================
+TextureStreamer
+	-singleton that streams the mips of compressed 2D textures.
+	-Register uploads only the mip tail. Update estimates the level each texture needs from the
+	 projected size of the meshes using it, reads finer levels on the thread pool and uploads them
+	 on the main thread.
+	-changing the resident levels recreates the GL texture, so a streamed texture's name changes.
+==============================
+*/
+class TextureStreamer {
+	public:
+		static TextureStreamer * getInstance();
+		~TextureStreamer() {};
+
+		bool Register( Texture * texture, const char * relativePath );
+		void Register( Texture * texture, const char * relativePath, const compressedLevels_t & info, const compressedLevels_t & tail );
+		static bool ReadMipTail( const char * relativePath, compressedLevels_t & info, compressedLevels_t & tail );
+		void Remove( Texture * texture );
+		void Update( Scene * scene, const Camera & camera, const int screenHeight );
+		const StreamingScheduler & GetScheduler() const { return m_scheduler; }
+
+		static bool s_enabled; //only affects textures loaded afterwards
+		static unsigned int s_mipTailSize; //largest dimension of the levels that are always resident
+
+	private:
+		TextureStreamer() { m_frame = 0; }
+
+		struct streamedTexture_t {
+			Texture * texture; //NULL once removed
+			std::string path;
+			compressedLevels_t info; //layout of the file, without level data
+		};
+		struct finishedLoad_t {
+			unsigned int textureId;
+			bool success;
+			compressedLevels_t levels;
+		};
+
+		void RequestMeshLevels( Scene * scene, const Camera & camera, const int screenHeight );
+
+		StreamingScheduler m_scheduler;
+		std::vector< streamedTexture_t > m_textures; //indexed by scheduler texture id
+		std::map< Texture *, unsigned int > m_ids;
+		jobGroup_t m_group;
+		std::mutex m_finishedMutex;
+		std::vector< finishedLoad_t * > m_finished;
+		unsigned int m_frame;
+
+		static TextureStreamer * inst_; //single instance
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "ThreadPool.h"
+
+#include <chrono>
+
+ThreadPool * ThreadPool::inst_ = NULL; //Define the static Singleton pointer
+unsigned int ThreadPool::s_threadCount = 0;
+
+/*
+================================
+ThreadPool::getInstance
+================================
+*/
+ThreadPool * ThreadPool::getInstance() {
+	if ( inst_ == NULL ) {
+		inst_ = new ThreadPool();
+	}
+	return( inst_ );
+}
+
+/*
+================================
+ThreadPool::ThreadPool
+================================
+*/
+ThreadPool::ThreadPool() {
+	m_quit = false;
+	unsigned int threadCount = s_threadCount;
+	if ( threadCount == 0 ) {
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if ( threadCount == 0 ) {
+		threadCount = 4; //hardware_concurrency isnt always known
+	}
+	for ( unsigned int i = 0; i < threadCount; i++ ) {
+		m_workers.push_back( std::thread( &ThreadPool::WorkerLoop, this ) );
+	}
+}
+
+/*
+================================
+ThreadPool::~ThreadPool
+================================
+*/
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_quit = true;
+	}
+	m_jobAdded.notify_all();
+	for ( unsigned int i = 0; i < m_workers.size(); i++ ) {
+		m_workers[i].join();
+	}
+}
+
+/*
+================================
+ThreadPool::WorkerLoop
+================================
+*/
+void ThreadPool::WorkerLoop() {
+	while ( true ) {
+		job_t job;
+		{
+			std::unique_lock< std::mutex > lock( m_mutex );
+			m_jobAdded.wait( lock, [this] { return m_quit || !m_jobs.empty(); } );
+			if ( m_jobs.empty() ) {
+				return; //quitting
+			}
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		job.fn();
+
+		{
+			std::lock_guard< std::mutex > lock( m_mutex );
+			job.group->pending -= 1;
+		}
+		m_jobDone.notify_all();
+	}
+}
+
+/*
+================================
+ThreadPool::RunPendingJob
+	-runs one of group's queued jobs on the calling thread. Returns false if none are queued.
+	-only the group's own jobs are taken. Another group's job could block on something the caller holds.
+================================
+*/
+bool ThreadPool::RunPendingJob( jobGroup_t & group ) {
+	job_t job;
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		std::deque< job_t >::iterator it = FindJob( group );
+		if ( it == m_jobs.end() ) {
+			return false;
+		}
+		job = *it;
+		m_jobs.erase( it );
+	}
+
+	job.fn();
+
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		job.group->pending -= 1;
+	}
+	m_jobDone.notify_all();
+	return true;
+}
+
+/*
+================================
+ThreadPool::FindJob
+	-m_mutex must be held
+================================
+*/
+std::deque< ThreadPool::job_t >::iterator ThreadPool::FindJob( jobGroup_t & group ) {
+	std::deque< job_t >::iterator it = m_jobs.begin();
+	while ( it != m_jobs.end() && it->group != &group ) {
+		it++;
+	}
+	return it;
+}
+
+/*
+================================
+ThreadPool::Submit
+================================
+*/
+void ThreadPool::Submit( jobGroup_t & group, const std::function< void() > & fn ) {
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		group.pending += 1;
+		job_t job;
+		job.fn = fn;
+		job.group = &group;
+		m_jobs.push_back( job );
+	}
+	m_jobAdded.notify_one();
+}
+
+/*
+================================
+ThreadPool::Wait
+	-blocks until every job in group is done. Helps run the group's queued jobs in the meantime.
+================================
+*/
+void ThreadPool::Wait( jobGroup_t & group ) {
+	while ( group.pending > 0 ) {
+		if ( RunPendingJob( group ) ) {
+			continue;
+		}
+		std::unique_lock< std::mutex > lock( m_mutex );
+		m_jobDone.wait( lock, [this, &group] { return group.pending == 0 || FindJob( group ) != m_jobs.end(); } );
+	}
+}
+
+/*
+================================
+ThreadPool::WaitFor
+	-blocks until every job in group is done or the timeout passes. Doesnt run jobs itself so the caller
+	 can report progress at a steady rate. Returns true if the group is done.
+================================
+*/
+bool ThreadPool::WaitFor( jobGroup_t & group, const unsigned int milliseconds ) {
+	std::unique_lock< std::mutex > lock( m_mutex );
+	return m_jobDone.wait_for( lock, std::chrono::milliseconds( milliseconds ), [&group] { return group.pending == 0; } );
+}
+
+/*
+================================
+ThreadPool::ParallelFor
+	-calls fn( i ) for every i in [0, count) across the pool and returns when all calls are done
+	-with maxThreads only that many jobs are submitted, each taking the next i until none are left
+================================
+*/
+void ThreadPool::ParallelFor( const unsigned int count, const std::function< void( unsigned int ) > & fn, const unsigned int maxThreads ) {
+	if ( count == 1 ) {
+		fn( 0 );
+		return;
+	}
+	jobGroup_t group;
+	if ( maxThreads == 0 || maxThreads >= count ) {
+		for ( unsigned int i = 0; i < count; i++ ) {
+			Submit( group, [&fn, i] { fn( i ); } );
+		}
+	} else {
+		std::atomic< unsigned int > next( 0 );
+		for ( unsigned int t = 0; t < maxThreads; t++ ) {
+			Submit( group, [&fn, &next, count] {
+				for ( unsigned int i = next++; i < count; i = next++ ) {
+					fn( i );
+				}
+			} );
+		}
+	}
+	Wait( group );
+}
+
+/*
+================================
+MemoryBudget::Acquire
+	-blocks until bytes fit in the budget
+================================
+*/
+void MemoryBudget::Acquire( const size_t bytes ) {
+	std::unique_lock< std::mutex > lock( m_mutex );
+	m_released.wait( lock, [this, bytes] { return m_used == 0 || m_used + bytes <= m_budget; } );
+	m_used += bytes;
+}
+
+/*
+================================
+MemoryBudget::Release
+================================
+*/
+void MemoryBudget::Release( const size_t bytes ) {
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_used -= bytes;
+	}
+	m_released.notify_all();
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef __THREADPOOL_H_INCLUDE__
+#define __THREADPOOL_H_INCLUDE__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+==============================
+jobGroup_t
+	-counts the unfinished jobs that were submitted with it. Must outlive its jobs.
+==============================
+*/
+struct jobGroup_t {
+	jobGroup_t() : pending( 0 ) {}
+	std::atomic< unsigned int > pending;
+};
+
+/*
+==============================
+ThreadPool
+	-singleton pool of worker threads that runs cpu jobs.
+	-Wait() runs the group's queued jobs on the calling thread until the group is done, so jobs can
+	 wait on nested jobs without starving the pool.
+	-jobs must not make GL or Console calls. Those only work on the main thread.
+==============================
+*/
+class ThreadPool {
+	public:
+		static ThreadPool * getInstance();
+		~ThreadPool();
+
+		unsigned int WorkerCount() const { return ( unsigned int )m_workers.size(); }
+
+		void Submit( jobGroup_t & group, const std::function< void() > & fn );
+		void Wait( jobGroup_t & group );
+		bool WaitFor( jobGroup_t & group, const unsigned int milliseconds );
+		void ParallelFor( const unsigned int count, const std::function< void( unsigned int ) > & fn, const unsigned int maxThreads = 0 );
+
+		static unsigned int s_threadCount; //0 -> one worker per hardware thread
+
+	private:
+		ThreadPool();
+		struct job_t {
+			std::function< void() > fn;
+			jobGroup_t * group;
+		};
+
+		void WorkerLoop();
+		bool RunPendingJob( jobGroup_t & group );
+		std::deque< job_t >::iterator FindJob( jobGroup_t & group );
+
+		std::vector< std::thread > m_workers;
+		std::deque< job_t > m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_jobAdded;
+		std::condition_variable m_jobDone;
+		bool m_quit;
+
+		static ThreadPool * inst_; //single instance
+};
+
+/*
+==============================
+MemoryBudget
+	-limits how many bytes concurrent jobs may hold at once.
+	-a request larger than the budget is let through when nothing else is held so it cant block forever.
+==============================
+*/
+class MemoryBudget {
+	public:
+		MemoryBudget( const size_t budget ) { m_budget = budget; m_used = 0; }
+		~MemoryBudget() {};
+
+		void Acquire( const size_t bytes );
+		void Release( const size_t bytes );
+
+	private:
+		size_t m_budget;
+		size_t m_used;
+		std::mutex m_mutex;
+		std::condition_variable m_released;
+};
+
+#endif
\ No newline at end of file
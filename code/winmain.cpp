@@ -1,4 +1,8 @@
 #include <ctime>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
@@ -7,6 +11,15 @@
 #include "PostProcess.h"
 #include "Command.h"
 #include "Console.h"
+#include "GLRecorder.h"
+#include "ShadowScheduler.h"
+#include "TextureStreamer.h"
+#include "LightBinning.h"
+#include "ShaderPreprocessor.h"
+#include "DrawList.h"
+#include "IndirectDraw.h"
+#include "MaterialTable.h"
+#include "EnvMapBaker.h"
 
 //Global storage of the window size
 int gScreenWidth  = 1920;
@@ -44,6 +57,13 @@ extern CVar * g_cvar_showSSAO;
 extern CVar * g_cvar_screenshot;
 
 Scene * g_scene = Scene::getInstance(); //declare g_scene singleton
+ShadowScheduler g_shadowScheduler;
+DrawList g_drawList; //draws of the main scene pass, rebuilt every frame
+std::vector< drawElementsCommand_t > g_drawCommands; //g_drawList as indirect commands, kept so they dont allocate every frame
+std::vector< indirectBatch_t > g_drawBatches;
+std::vector< unsigned int > g_drawMaterials; //material of each of g_drawCommands
+std::vector< uint8_t > g_tableMaterials; //by decl id, non zero when the decl's program reads the material table
+UniformBlock g_frameBlock; //per frame constants of the programs with a frame_block
 
 Framebuffer depthPrepassFBO( "screenTexture" );
 
@@ -56,15 +76,7 @@ void ForwardPlus_Prepass( const float * view, const float * projection ) {
 	const Mat4 VPMatrix = Mat4( projection ) * Mat4( view );
 	Light::s_depthShader->UseProgram(); //reuse depth shader from light class
 	Light::s_depthShader->SetUniformMatrix4f( "lightSpaceMatrix", 1, false, VPMatrix.as_ptr() );
-
-	for ( unsigned int i = 0; i < g_scene->MeshCount(); i++ ) {
-		Mesh * mesh = NULL;
-		g_scene->MeshByIndex( i, &mesh );
-
-		for ( unsigned int j = 0; j < mesh->m_surfaces.size(); j++ ) {
-			mesh->DrawSurface( j );
-		}
-	}
+	g_scene->DrawAll();
 	depthPrepassFBO.Unbind();
 
 	//calculate the size of the groups for the compute shader
@@ -87,7 +99,7 @@ void ForwardPlus_Prepass( const float * view, const float * projection ) {
 
 	//pass in the lookup table where light indexes will be stored. Each place in the table is a 32x32 screen tile.
 	//This is what the compute shader initializes.
-	const unsigned int maxLightPerTile = 32;
+	const unsigned int maxLightPerTile = LightBinning::s_maxLightsPerTile;
 	const int block_index = tilePrepass_shader->BufferBlockIndexByName( "light_LUT" );
 	Buffer * ssbo = NULL;
 	const GLsizeiptr totalSize = gNumTiles * ( sizeof( unsigned int ) * ( maxLightPerTile + 1 ) );
@@ -183,7 +195,7 @@ void RenderDebug( const float * view, const float * perspective, int mode ) {
 		g_scene->MeshByIndex( n, &mesh );
 
 		for ( unsigned int j = 0; j < mesh->m_surfaces.size(); j++ ) {
-			matDecl = MaterialDecl::GetMaterialDecl( mesh->m_surfaces[j]->materialName.c_str() );
+			matDecl = MaterialDecl::DeclById( mesh->m_surfaces[j]->declId );
 			
 			//get the target uniform name bassed off the debug mode and shader type
 			Str uniformName;
@@ -275,16 +287,35 @@ RenderScene
 ================================
 */
 void RenderScene( const float * view, const float * projection ) {
-	//update depth buffers for shadowmaps
+	//update depth buffers for shadowmaps. Only lights that changed or that overlap a moved instance are re-rendered.
+	std::vector< bbox > movedBounds;
+	g_scene->UpdateMovedInstances( movedBounds );
+	const unsigned int sceneTriCount = g_scene->InstancedTriangleCount();
+	const float aspect = ( float )gScreenWidth / ( float )gScreenHeight;
+	std::vector< shadowRequest_t > shadowRequests;
 	Light * light = NULL;
 	for ( unsigned int i = 0; i < g_scene->LightCount(); i++ ) {
 		g_scene->LightByIndex( i, &light );
-		if ( light->GetShadow() ) {
-			if ( ( light->m_cachedShadows && !light->m_firstFrameRendered ) || !light->m_cachedShadows ) {
-				light->UpdateDepthBuffer( g_scene );
-			}
+		if ( light->NeedsShadowUpdate( movedBounds ) ) {
+			shadowRequest_t request;
+			request.lightIdx = i;
+			request.partitions = light->ShadowPartitionCount();
+			request.triangles = request.partitions * sceneTriCount;
+			request.coverage = ShadowScheduler::EstimateCoverage( light->GetPosition(), light->EffectRadius(), camera.m_position, camera.m_look, to_radians( camera.m_fov ), aspect );
+			shadowRequests.push_back( request );
 		}
-		light->m_firstFrameRendered = true;
+	}
+
+	//only render the lights that fit in this frame's shadow budget. The rest stay dirty for the next frame.
+	std::vector< unsigned int > scheduledLights;
+	g_shadowScheduler.Schedule( shadowRequests, scheduledLights );
+	for ( unsigned int i = 0; i < shadowRequests.size(); i++ ) {
+		g_scene->LightByIndex( shadowRequests[i].lightIdx, &light );
+		light->MarkShadowDirty();
+	}
+	for ( unsigned int i = 0; i < scheduledLights.size(); i++ ) {
+		g_scene->LightByIndex( scheduledLights[i], &light );
+		light->UpdateDepthBuffer( g_scene );
 	}
 
 	//peform light binning
@@ -298,70 +329,139 @@ void RenderScene( const float * view, const float * projection ) {
 
 	GLuint currentShaderProg = 0;
 
-	MaterialDecl* matDecl;
+	//the probe arrays are shared by every instance, each instance picks its layer with its probe index
+	EnvProbe::BindTextures( 5 );
+
+	//camera data is uploaded once, programs with a frame_block read it from there
+	FrameStorage frameStorage;
+	memcpy( frameStorage.view, view, sizeof( frameStorage.view ) );
+	memcpy( frameStorage.projection, projection, sizeof( frameStorage.projection ) );
+	memcpy( frameStorage.camPos, camera.m_position.as_ptr(), sizeof( frameStorage.camPos ) );
+	frameStorage.screenWidth = gScreenWidth;
+	g_frameBlock.Upload( sizeof( FrameStorage ), &frameStorage );
+	g_frameBlock.BindBase( UNIFORM_BLOCK_FRAME );
+
+	//one key per surface and orientation, sorted so draws sharing a program and material are submitted together
+	g_drawList.Clear();
+	g_tableMaterials.clear();
 	for ( unsigned int i = 0; i < g_scene->MeshCount(); i++ ) {
 		Mesh * mesh = NULL;
 		g_scene->MeshByIndex( i, &mesh );
 
 		for ( unsigned int j = 0; j < mesh->m_surfaces.size(); j++ ) {
-			matDecl = MaterialDecl::GetMaterialDecl( mesh->m_surfaces[j]->materialName.c_str() );
+			surface * currentSurface = mesh->m_surfaces[j];
+			if ( currentSurface->declId == DECL_ID_NONE ) {
+				currentSurface->declId = MaterialDecl::GetMaterialDecl( currentSurface->materialName.c_str() )->m_id;
+			}
+			MaterialDecl * surfaceDecl = MaterialDecl::DeclById( currentSurface->declId );
+			const unsigned int program = surfaceDecl->shader->GetShaderProgram();
+
+			//without multi draw indirect gl_DrawIDARB is always 0, so materials of the table only share batches with it on.
+			//The handles of a batch also differ then, which is only defined with NV_gpu_shader5.
+			if ( currentSurface->declId >= g_tableMaterials.size() ) {
+				g_tableMaterials.resize( currentSurface->declId + 1, 0 );
+			}
+			g_tableMaterials[ currentSurface->declId ] = ( IndirectDraw::s_enabled && MaterialTable::s_nonuniformHandles && surfaceDecl->UsesMaterialTable() ) ? 1 : 0;
+			if ( mesh->InstanceCount( false ) > 0 ) {
+				g_drawList.Add( DrawList::MakeKey( program, currentSurface->declId, i, j, false ) );
+			}
+			if ( mesh->InstanceCount( true ) > 0 ) {
+				g_drawList.Add( DrawList::MakeKey( program, currentSurface->declId, i, j, true ) );
+			}
+		}
+	}
+	if ( DrawList::s_sort ) {
+		g_drawList.Sort();
+	}
+
+	//after the keys, building them can load decls
+	MaterialTable::Update();
+
+	//one batch per program, material and front face, or per program and front face for materials of the table.
+	//State only changes when the field of the key it depends on changes.
+	IndirectDraw::BuildKeyCommands( g_scene->GetIndirectScene(), g_drawList.Keys(), g_tableMaterials, g_drawCommands, g_drawMaterials, g_drawBatches );
+	g_scene->UploadFrameCommands( g_drawCommands );
+	MaterialTable::SetDrawMaterials( g_drawMaterials );
+	g_scene->BindGeometry( true );
+	MaterialDecl * matDecl = NULL;
+	bool flipped = false;
+	for ( unsigned int b = 0; b < g_drawBatches.size(); b++ ) {
+		const indirectBatch_t & batch = g_drawBatches[b];
+		const bool newProgram = ( b == 0 ) || DrawList::KeyProgram( batch.key ) != DrawList::KeyProgram( g_drawBatches[ b - 1 ].key );
+		const bool newMaterial = newProgram || DrawList::KeyMaterial( batch.key ) != DrawList::KeyMaterial( g_drawBatches[ b - 1 ].key );
+		if ( newMaterial ) {
+			matDecl = MaterialDecl::DeclById( DrawList::KeyMaterial( batch.key ) );
 			matDecl->BindTextures();
 			matDecl->PassVec3Uniforms();
 
-			//exit early if this material is errored out
+			//errored out materials only need the camera
 			if ( matDecl->m_shaderProg == "error" ) {
 				matDecl->shader->SetUniformMatrix4f( "view", 1, false, view );
-				matDecl->shader->SetUniformMatrix4f( "projection", 1, false, projection );	
-				mesh->DrawSurface( j ); //draw surface
-				continue;
+				matDecl->shader->SetUniformMatrix4f( "projection", 1, false, projection );
 			}
+		}
 
-			//pass uniforms
-			const GLuint thisShaderProg = matDecl->shader->GetShaderProgram();
-			if ( thisShaderProg != currentShaderProg ) {
-				currentShaderProg = thisShaderProg;
+		//pass uniforms
+		const GLuint thisShaderProg = matDecl->shader->GetShaderProgram();
+		if ( matDecl->m_shaderProg != "error" && thisShaderProg != currentShaderProg ) {
+			currentShaderProg = thisShaderProg;
 
-				//pass in camera data
+			//pass in camera data, unless the program reads it from the frame block
+			if ( matDecl->shader->FindUniformBlock( "frame_block" ) == NULL ) {
 				matDecl->shader->SetUniformMatrix4f( "view", 1, false, view );
 				matDecl->shader->SetUniformMatrix4f( "projection", 1, false, projection );
 				matDecl->shader->SetUniform1i( "screenWidth", 1, &gScreenWidth );
 				matDecl->shader->SetUniform3f( "camPos", 1, camera.m_position.as_ptr() );
+			}
 
-				//bind the light lookup table
-				const int block_index = matDecl->shader->BufferBlockIndexByName( "light_LUT" );
-				Buffer * ssbo = NULL;
-				if ( block_index == GL_INVALID_INDEX ) {
-					ssbo = ssbo->GetBuffer( "light_LUT" );
-					matDecl->shader->AddBuffer( ssbo );
-				} else {
-					ssbo = matDecl->shader->BufferByBlockIndex( block_index );
-				}
-				glBindBuffer( GL_SHADER_STORAGE_BUFFER, ssbo->GetID() );
-				glBindBufferBase( GL_SHADER_STORAGE_BUFFER, ssbo->GetBindingPoint(), ssbo->GetID() );
-				glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
-
-				//pass lights data
-				for ( int k = 0; k < g_scene->LightCount(); k++ ) {
-					g_scene->LightByIndex( k, &light );
-					if ( k == 0 ) {
-						light->PassDepthAttribute( matDecl->shader, 4 );
-						const int shadowMapPartitionSize = ( unsigned int )( light->s_partitionSize );
-						matDecl->shader->SetUniform1i( "shadowMapPartitionSize", 1, &shadowMapPartitionSize );
-					}				
-					light->PassUniforms( matDecl->shader, k );
-				}
-
-				//pass in EnvProbe data
-				const EnvProbe * probe = mesh->GetProbe();
-				if ( probe != NULL ) {
-					probe->PassUniforms( matDecl->shader, 5 );
-				}
+			//bind the light lookup table
+			const int block_index = matDecl->shader->BufferBlockIndexByName( "light_LUT" );
+			Buffer * ssbo = NULL;
+			if ( block_index == GL_INVALID_INDEX ) {
+				ssbo = ssbo->GetBuffer( "light_LUT" );
+				matDecl->shader->AddBuffer( ssbo );
+			} else {
+				ssbo = matDecl->shader->BufferByBlockIndex( block_index );
 			}
-	
-			//draw surface
-			mesh->DrawSurface( j );
+			glBindBuffer( GL_SHADER_STORAGE_BUFFER, ssbo->GetID() );
+			glBindBufferBase( GL_SHADER_STORAGE_BUFFER, ssbo->GetBindingPoint(), ssbo->GetID() );
+			glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+			//pass lights data
+			for ( int l = 0; l < g_scene->LightCount(); l++ ) {
+				g_scene->LightByIndex( l, &light );
+				if ( l == 0 && matDecl->shader->HasUniform( "shadowAtlas" ) ) { //permutations without shadows have no atlas
+					light->PassDepthAttribute( matDecl->shader, 4 );
+					const int shadowMapPartitionSize = ( unsigned int )( light->s_partitionSize );
+					matDecl->shader->SetUniform1i( "shadowMapPartitionSize", 1, &shadowMapPartitionSize );
+				}				
+				light->PassUniforms( matDecl->shader, l );
+			}
+
+			//pass in EnvProbe data
+			EnvProbe::PassUniforms( matDecl->shader, 5 );
+
+			//material textures and constants of programs built with BINDLESS_TEXTURES
+			MaterialTable::Bind( matDecl->shader );
+		}
+
+		//the vertex shader finds the material of each command at firstDraw + gl_DrawIDARB
+		if ( matDecl->UsesMaterialTable() ) {
+			const int firstDraw = ( int )batch.firstCommand;
+			matDecl->shader->SetUniform1i( "firstDraw", 1, &firstDraw );
 		}
+
+		if ( batch.flipped != flipped ) {
+			glFrontFace( batch.flipped ? GL_CW : GL_CCW );
+			flipped = batch.flipped;
+		}
+
+		//draw surfaces
+		g_scene->DrawBatch( g_drawCommands, batch );
 	}
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+	glBindVertexArray( 0 );
+	glFrontFace( GL_CCW );
 	mainFBO.Unbind();
 }
 
@@ -379,6 +479,9 @@ void DrawFrame( void ) {
 	//get key inputs from user
 	keyOperations();
 
+	//rebuild the programs whose shader files changed, before this frame draws with any of them
+	Shader::ReloadChanged();
+
 	//clear buffers
 	glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
 	glClearDepth( 1.0f );
@@ -401,6 +504,9 @@ void DrawFrame( void ) {
 	camera.UpdateProjection( aspect );
 	const Mat4 projection = camera.GetProjection();
 
+	//stream in the texture levels the camera needs
+	TextureStreamer::getInstance()->Update( g_scene, camera, gScreenHeight );
+
 	//g_cvar_showEdgeHighlights	
 	unsigned int edgeHighlights_renderMode = 0;
 	if ( g_cvar_showEdgeHighlights->GetState() ) { //0 -> no highlights, 1 -> with highlights, 2 -> only highlights
@@ -444,7 +550,7 @@ void DrawFrame( void ) {
 		MaterialDecl* skyMat;
 		const Cube * sceneSkybox = g_scene->GetSkybox();
 		if ( sceneSkybox != NULL ) {
-			skyMat = MaterialDecl::GetMaterialDecl( sceneSkybox->m_surface->materialName.c_str() );
+			skyMat = MaterialDecl::DeclById( sceneSkybox->m_surface->declId );
 			skyMat->BindTextures();
 			Mat4 skyBox_viewMat = view;
 			skyBox_viewMat[3] = Vec4( 0.0f, 0.0f, 0.0f, 1.0f );
@@ -546,6 +652,7 @@ void DrawFrame( void ) {
 		
 	glFinish(); //Tell OpenGL to finish all the previous OpenGL commands before continuing
 	glutSwapBuffers(); //Swap the back buffer to the front buffer
+	GLRecorder::NewFrame();
 }
 
 /*
@@ -606,16 +713,101 @@ bool glSetup( int argc, char ** argv ) {
 	//initialize static error textures
 	Texture::s_errorTexture = Texture::InitErrorTexture();
 	CubemapTexture::s_errorCube = CubemapTexture::InitErrorCube();
+
+	//sizes the shaders share with the cpu side
+	ShaderPreprocessor::SetGlobalDefine( "MAX_LIGHTS_PER_TILE", LightBinning::s_maxLightsPerTile );
+	ShaderPreprocessor::SetGlobalDefine( "LIGHT_VOLUME_MAX_VERTS", LIGHT_VOLUME_MAX_VERTS );
+	ShaderPreprocessor::SetGlobalDefine( "LIGHT_VOLUME_MAX_TRIS", LIGHT_VOLUME_MAX_TRIS );
+
+	//material textures come from the material table when the driver has bindless textures
+	MaterialTable::Init();
+	ShaderPreprocessor::SetGlobalDefine( "BINDLESS_TEXTURES", MaterialTable::s_bindless ? 1 : 0 );
 	
 	return true;
 }
 
+/*
+================================
+BakeEnvOffline
+	-runs the env map conversions from the command line without opening a window:
+	 -bakeCubemap <equirect .hdr or .tga> [faceSize] [supersample] saves <name>_cube next to it
+	 -bakeSH <env probe cubemap> saves <name>_sh.txt next to it
+	 paths are used as they are given. Returns the exit code.
+================================
+*/
+int BakeEnvOffline( int argc, char ** argv ) {
+	const std::string mode = argv[1];
+	if ( argc < 3 ) {
+		printf( "%s :: path arg required\n", mode.c_str() );
+		return 1;
+	}
+	const std::string path = argv[2];
+	if ( path.length() < 5 ) {
+		printf( "%s :: invalid path %s\n", mode.c_str(), path.c_str() );
+		return 1;
+	}
+	const std::string extension = path.substr( path.length() - 4 );
+	const std::string stem = path.substr( 0, path.length() - 4 );
+
+	if ( mode == "-bakeCubemap" ) {
+		const int faceSize = ( argc > 3 ) ? atoi( argv[3] ) : 0;
+		const int supersample = ( argc > 4 ) ? atoi( argv[4] ) : 1;
+		if ( faceSize < 0 || supersample < 1 || supersample > 8 ) {
+			printf( "%s :: invalid face size or supersample count\n", mode.c_str() );
+			return 1;
+		}
+		if ( extension != ".tga" && extension != ".hdr" ) {
+			printf( "%s :: unsupported filetype %s\n", mode.c_str(), path.c_str() );
+			return 1;
+		}
+
+		envImage_t equirect;
+		if ( !EnvMapBaker::LoadEnvImage( path.c_str(), equirect ) ) {
+			printf( "%s :: couldnt load %s\n", mode.c_str(), path.c_str() );
+			return 1;
+		}
+		envImage_t cubemap;
+		EnvMapBaker::EquirectToCubemap( equirect, ( faceSize > 0 ) ? faceSize : equirect.height / 2, supersample, cubemap, true, true );
+		const std::string cubemapPath = stem + "_cube" + extension;
+		if ( !EnvMapBaker::SaveEnvImage( cubemapPath.c_str(), cubemap ) ) {
+			printf( "%s :: couldnt write %s\n", mode.c_str(), cubemapPath.c_str() );
+			return 1;
+		}
+		printf( "Cubemap image saved to: %s\n", cubemapPath.c_str() );
+		return 0;
+	}
+
+	if ( mode == "-bakeSH" ) {
+		envImage_t cubemap;
+		if ( !EnvMapBaker::LoadEnvImage( path.c_str(), cubemap ) || cubemap.width != cubemap.height * 6 ) {
+			printf( "%s :: couldnt load cubemap %s\n", mode.c_str(), path.c_str() );
+			return 1;
+		}
+		irradianceSH_t sh;
+		EnvMapBaker::ProjectIrradianceSH( cubemap, sh, true );
+		const std::string shPath = stem + "_sh.txt";
+		if ( !EnvMapBaker::SaveIrradianceSH( shPath.c_str(), sh ) ) {
+			printf( "%s :: couldnt save %s\n", mode.c_str(), shPath.c_str() );
+			return 1;
+		}
+		printf( "Irradiance SH saved to: %s\n", shPath.c_str() );
+		return 0;
+	}
+
+	printf( "unknown mode %s, expected -bakeCubemap or -bakeSH\n", mode.c_str() );
+	return 1;
+}
+
 /*
 ================================
 main
 ================================
 */
 int main( int argc, char ** argv ) {
+	if ( argc > 1 && strncmp( argv[1], "-bake", 5 ) == 0 ) {
+		return BakeEnvOffline( argc, argv ); //offline tool, no window or gl context
+	}
+
 	if( !glSetup( argc, argv ) ) {
 		return 0;
 	}
@@ -9,38 +9,8 @@ uniform sampler2D glossTexture;
 uniform vec3 emissiveColor;
 
 const float E = 2.71828182846;
-const float PI = 3.14159265359;
-uniform sampler2DShadow shadowAtlas;
-
-struct Light {
-	int typeIndex;
-	float pos_x, pos_y, pos_z;
-	float col_r, col_g, col_b;
-	float dir_x, dir_y, dir_z;
-	float angle; //splot light only
-	float radius;
-	float max_radius;
-	float dir_radius; //directional light only
-	float brightness;
-	int shadowIdx;
-};
-layout ( std430 ) buffer light_buffer {
-	Light light_data[];
-};
-
-struct Shadow {
-	vec4 m_row1;
-	vec4 m_row2;
-	vec4 m_row3;
-	vec4 m_row4;
-	vec4 loc;
-};
-layout ( std430 ) buffer shadow_buffer {
-	Shadow shadow_data[];
-};
 
 //scene uniforms
-uniform int shadowMapPartitionSize;
 uniform vec3 camPos;
 uniform int lightCount;
 
@@ -48,100 +18,8 @@ in vec3 FragPos;
 in mat3 TBN;
 in vec2 TexCoord;
 
-//Trowbridge-Reitz microfacet distribution function
-float NormalDistribution( float NdotH, float roughness ) {
-	float alpha = roughness * roughness;
-	float denom = NdotH * NdotH * ( alpha * alpha - 1.0 ) + 1.0;
-	return ( alpha * alpha ) / ( PI * denom * denom );
-}
-
-//Shlick approximation of the Fresnel equation
-vec3 FresnelShlickIBL( float cosTheta, vec3 F0, float roughness ) {
-	//Sébastien Lagarde describes a way to inject the roughness term into the Shlick approximation:
-	//	https://seblagarde.wordpress.com/2011/08/17/hello-world/
-	return F0 + ( max( vec3( 1.0 - roughness ), F0 ) - F0 ) * pow( 1.0 - cosTheta, 5.0 );
-}
-
-//Shlick approximation of the Fresnel equation
-vec3 FresnelShlick( float cosTheta, vec3 F0 ) {
-	return F0 + ( 1.0 - F0 ) * pow( 1.0 - cosTheta, 5.0 );
-}
-
-//Lazarov [2011] does a substitution that combines the denom of the BRDF and the Geometry masking term.
-float VisibilityTerm( float NdotV, float roughness ) {
-	//Schlick-Beckmann except with k = a / 2;
-	if ( NdotV > 0.0 ) {
-		float alpha2 = roughness * roughness * roughness * roughness;
-		float NdotV2 = NdotV * NdotV;
-		float denom = NdotV + ( sqrt( alpha2 + pow( 1.0 - alpha2, 2.0 ) * NdotV2 ) );
-		return NdotV2 / denom;
-	} else {
-		return 0.0;
-	}
-}
-
-//returns the index of the axis most aligned with dir arg
-int GetFaceIdx( vec3 dir ) {
-	int returnIdx = 0;
-	float largesttDot = -1.0;
-
-	float dots[6];
-	dots[0] = dot( dir, vec3( 1.0, 0.0, 0.0 ) );
-	dots[1] = dot( dir, vec3( 0.0, 0.0, 1.0 ) );
-	dots[2] = dot( dir, vec3( -1.0, 0.0, 0.0 ) );
-	dots[3] = dot( dir, vec3( 0.0, 0.0, -1.0 ) );
-	dots[4] = dot( dir, vec3( 0.0, 1.0, 0.0 ) );
-	dots[5] = dot( dir, vec3( 0.0, -1.0, 0.0 ) );
-
-	for ( int i = 0; i < 6; i++ ) {
-		float testDot = dots[i];
-		if ( testDot > largesttDot ) {
-			largesttDot = testDot;
-			returnIdx = i;
-		}
-	}
-
-	return returnIdx;
-}
-
-float ShadowCalculation( float bias, Light light ) {
-	vec2 atlasSize = vec2( textureSize( shadowAtlas, 0 ) );
-	int shadowIdx = light.shadowIdx;
-
-	int faceIdx = 0;
-	if ( light.typeIndex == 3 ) {
-		vec3 lightPos = vec3( light.pos_x, light.pos_y, light.pos_z );
-		faceIdx = GetFaceIdx( normalize( FragPos - lightPos ) ); //get which face to sample shadows from
-	}
-
-	mat4 shadowMatrix;
-	shadowMatrix[0] = shadow_data[shadowIdx + faceIdx].m_row1;
-	shadowMatrix[1] = shadow_data[shadowIdx + faceIdx].m_row2;
-	shadowMatrix[2] = shadow_data[shadowIdx + faceIdx].m_row3;
-	shadowMatrix[3] = shadow_data[shadowIdx + faceIdx].m_row4;
-
-	vec4 FragPosLightSpace = shadowMatrix * vec4( FragPos, 1.0 );	
-	vec3 projCoords = FragPosLightSpace.xyz / FragPosLightSpace.w; //perform perspective divide
-	projCoords = projCoords * 0.5 + 0.5; //transform to [0,1] range	
-	float tileSize_normalized = float( shadowMapPartitionSize ) / atlasSize.x;
-	projCoords.x = projCoords.x * tileSize_normalized + shadow_data[shadowIdx + faceIdx].loc.x;
-	projCoords.y = projCoords.y * tileSize_normalized + shadow_data[shadowIdx + faceIdx].loc.y;
-
-	vec3 samplePos;
-	int sampleCount = 0;
-	vec2 texelSize = 1.0 / atlasSize;
-	float cumulativeShadow = 0.0;
-	for ( int x = -4; x <= 4; x++ ) {
-		for ( int y = -4; y <= 4; y++ ) {
-			samplePos = vec3( projCoords.xy + ( vec2( x, y ) * texelSize ), projCoords.z - bias );
-			cumulativeShadow += texture( shadowAtlas, samplePos, 0 );
-			sampleCount += 1;
-		}
-	}
-	cumulativeShadow /= float( sampleCount );
-
-	return cumulativeShadow;
-}
+#include "include/brdf.glsl"
+#include "include/shadows.glsl"
 
 float LightAttenuation( vec3 P, vec3 lightCenter, float lightRadius, float maxRadius, float brightness, float cutoff ) {
 	//https://imdoingitwrong.wordpress.com/2011/01/31/light-attenuation/
@@ -1,164 +1,90 @@
 #version 430 core
 
+//permutations, selected with shaderDefines in the material decl
+#ifndef SHADOWS
+#define SHADOWS 1
+#endif
+#ifndef IBL
+#define IBL 1
+#endif
+//set for every program when the driver has ARB_bindless_texture and ARB_shader_draw_parameters
+#ifndef BINDLESS_TEXTURES
+#define BINDLESS_TEXTURES 0
+#endif
+
+#if BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#extension GL_NV_gpu_shader5 : enable //lets the draws of a multi draw sample different handles, see MaterialTable
+#endif
+
 out vec4 FragColor;
 
+#if BINDLESS_TEXTURES
+#include "include/material_table.glsl"
+#else
 uniform sampler2D albedoTexture;
 uniform sampler2D specularTexture;
 uniform sampler2D normalTexture;
 uniform sampler2D glossTexture;
-uniform vec3 emissiveColor;
-
-uniform sampler2DShadow shadowAtlas;
-
-uniform sampler2D brdfLUT;
-uniform samplerCube irradianceMap;
-uniform samplerCube prefilteredEnvMap;
-
-const float E = 2.71828182846;
-const float PI = 3.14159265359;
-const float MAX_REFLECTION_LOD = 4.0;
-
-const int maxLightsPerTile = 32;
-struct lightIDs {
-	uint count;
-	int ids[maxLightsPerTile];
-};
-layout ( std430 ) buffer light_LUT {
-	lightIDs lightLists[];
-};
 
-struct Light {
-	int typeIndex;
-	float pos_x, pos_y, pos_z;
-	float col_r, col_g, col_b;
-	float dir_x, dir_y, dir_z;
-	float angle; //splot light only
-	float radius;
-	float max_radius;
-	float dir_radius; //directional light only
-	float brightness;
-	int shadowIdx;
-};
-layout ( std430 ) buffer light_buffer {
-	Light light_data[];
-};
-
-struct Shadow {
-	vec4 m_row1;
-	vec4 m_row2;
-	vec4 m_row3;
-	vec4 m_row4;
-	vec4 loc;
-};
-layout ( std430 ) buffer shadow_buffer {
-	Shadow shadow_data[];
+layout ( std140 ) uniform material_block {
+	vec3 emissiveColor;
 };
+#endif
 
 //scene uniforms
 #define WORK_GROUP_SIZE 16
-uniform int screenWidth;
+layout ( std140 ) uniform frame_block {
+	mat4 view;
+	mat4 projection;
+	vec3 camPos;
+	int screenWidth;
+};
 //uniform int screenHeight;
-uniform int shadowMapPartitionSize;
-uniform vec3 camPos;
 
 in vec3 FragPos;
 in mat3 TBN;
 in vec2 TexCoord;
+flat in uint ProbeIndex;
 
-//Trowbridge-Reitz microfacet distribution function
-float NormalDistribution( float NdotH, float roughness ) {
-	float alpha = roughness * roughness;
-	float denom = NdotH * NdotH * ( alpha * alpha - 1.0 ) + 1.0;
-	return ( alpha * alpha ) / ( PI * denom * denom );
-}
-
-//Shlick approximation of the Fresnel equation
-vec3 FresnelShlickIBL( float cosTheta, vec3 F0, float roughness ) {
-	//Sébastien Lagarde describes a way to inject the roughness term into the Shlick approximation:
-	//	https://seblagarde.wordpress.com/2011/08/17/hello-world/
-	return F0 + ( max( vec3( 1.0 - roughness ), F0 ) - F0 ) * pow( 1.0 - cosTheta, 5.0 );
-}
+#include "include/brdf.glsl"
+#include "include/lights.glsl"
+#include "include/light_lut.glsl"
+#if SHADOWS
+#include "include/shadows.glsl"
+#endif
 
-//Shlick approximation of the Fresnel equation
-vec3 FresnelShlick( float cosTheta, vec3 F0 ) {
-	return F0 + ( 1.0 - F0 ) * pow( 1.0 - cosTheta, 5.0 );
-}
-
-//Lazarov [2011] does a substitution that combines the denom of the BRDF and the Geometry masking term.
-float VisibilityTerm( float NdotV, float roughness ) {
-	//Schlick-Beckmann except with k = a / 2;
-	if ( NdotV > 0.0 ) {
-		float alpha2 = roughness * roughness * roughness * roughness;
-		float NdotV2 = NdotV * NdotV;
-		float denom = NdotV + ( sqrt( alpha2 + pow( 1.0 - alpha2, 2.0 ) * NdotV2 ) );
-		return NdotV2 / denom;
-	} else {
-		return 0.0;
-	}
-}
-
-//returns the index of the axis most aligned with dir arg
-int GetFaceIdx( vec3 dir ) {
-	int returnIdx = 0;
-	float largesttDot = -1.0;
-
-	float dots[6];
-	dots[0] = dot( dir, vec3( 1.0, 0.0, 0.0 ) );
-	dots[1] = dot( dir, vec3( 0.0, 0.0, 1.0 ) );
-	dots[2] = dot( dir, vec3( -1.0, 0.0, 0.0 ) );
-	dots[3] = dot( dir, vec3( 0.0, 0.0, -1.0 ) );
-	dots[4] = dot( dir, vec3( 0.0, 1.0, 0.0 ) );
-	dots[5] = dot( dir, vec3( 0.0, -1.0, 0.0 ) );
-
-	for ( int i = 0; i < 6; i++ ) {
-		float testDot = dots[i];
-		if ( testDot > largesttDot ) {
-			largesttDot = testDot;
-			returnIdx = i;
-		}
-	}
-
-	return returnIdx;
-}
+const float E = 2.71828182846;
 
-float ShadowCalculation( float bias, Light light ) {
-	vec2 atlasSize = vec2( textureSize( shadowAtlas, 0 ) );
-	int shadowIdx = light.shadowIdx;
+#if IBL
+uniform sampler2D brdfLUT;
+uniform samplerCubeArray irradianceMaps;
+uniform samplerCubeArray prefilteredEnvMaps;
 
-	int faceIdx = 0;
-	if ( light.typeIndex == 3 ) {
-		vec3 lightPos = vec3( light.pos_x, light.pos_y, light.pos_z );
-		faceIdx = GetFaceIdx( normalize( FragPos - lightPos ) ); //get which face to sample shadows from
-	}
+const float MAX_REFLECTION_LOD = 4.0;
 
-	mat4 shadowMatrix;
-	shadowMatrix[0] = shadow_data[shadowIdx + faceIdx].m_row1;
-	shadowMatrix[1] = shadow_data[shadowIdx + faceIdx].m_row2;
-	shadowMatrix[2] = shadow_data[shadowIdx + faceIdx].m_row3;
-	shadowMatrix[3] = shadow_data[shadowIdx + faceIdx].m_row4;
-
-	vec4 FragPosLightSpace = shadowMatrix * vec4( FragPos, 1.0 );
-	vec3 projCoords = FragPosLightSpace.xyz / FragPosLightSpace.w; //perform perspective divide
-	projCoords = projCoords * 0.5 + 0.5; //transform to [0,1] range	
-	float tileSize_normalized = float( shadowMapPartitionSize ) / atlasSize.x;
-	projCoords.x = projCoords.x * tileSize_normalized + shadow_data[shadowIdx + faceIdx].loc.x;
-	projCoords.y = projCoords.y * tileSize_normalized + shadow_data[shadowIdx + faceIdx].loc.y;
-
-	vec3 samplePos;
-	int sampleCount = 0;
-	vec2 texelSize = 1.0 / atlasSize;
-	float cumulativeShadow = 0.0;
-	for ( int x = -4; x <= 4; x++ ) {
-		for ( int y = -4; y <= 4; y++ ) {
-			samplePos = vec3( projCoords.xy + ( vec2( x, y ) * texelSize ), projCoords.z - bias );
-			cumulativeShadow += texture( shadowAtlas, samplePos, 0 );
-			sampleCount += 1;
-		}
-	}
-	cumulativeShadow /= float( sampleCount );
+struct Probe {
+	vec4 irradianceSH[9]; //rgb
+	int hasIrradianceSH;
+};
+layout ( std430 ) buffer probe_buffer {
+	Probe probe_data[];
+};
 
-	return cumulativeShadow;
+//irradiance from the probe's L2 spherical harmonics, the coefficients are already divided by PI
+vec3 IrradianceSH( uint probe, vec3 n ) {
+	vec3 result = probe_data[probe].irradianceSH[0].rgb * 0.282095;
+	result += probe_data[probe].irradianceSH[1].rgb * 0.488603 * n.y;
+	result += probe_data[probe].irradianceSH[2].rgb * 0.488603 * n.z;
+	result += probe_data[probe].irradianceSH[3].rgb * 0.488603 * n.x;
+	result += probe_data[probe].irradianceSH[4].rgb * 1.092548 * n.x * n.y;
+	result += probe_data[probe].irradianceSH[5].rgb * 1.092548 * n.y * n.z;
+	result += probe_data[probe].irradianceSH[6].rgb * 0.315392 * ( 3.0 * n.z * n.z - 1.0 );
+	result += probe_data[probe].irradianceSH[7].rgb * 1.092548 * n.x * n.z;
+	result += probe_data[probe].irradianceSH[8].rgb * 0.546274 * ( n.x * n.x - n.y * n.y );
+	return max( result, vec3( 0.0 ) );
 }
+#endif
 
 float LightAttenuation( vec3 fragPos, vec3 lightCenter, float lightRadius, float maxRadius, float brightness ) {
 	//https://imdoingitwrong.wordpress.com/2011/01/31/light-attenuation/
@@ -208,14 +134,18 @@ void main() {
 	float NdotV = clamp( dot( N, V ), 0.0, 1.0 );
 
 	//ambient
-	vec3 irradiance = texture( irradianceMap, N ).rgb;
+#if IBL
+	vec3 irradiance = ( probe_data[ProbeIndex].hasIrradianceSH != 0 ) ? IrradianceSH( ProbeIndex, N ) : texture( irradianceMaps, vec4( N, float( ProbeIndex ) ) ).rgb;
 	vec3 diffuse_IBL = irradiance * albedo;
 	vec3 R = reflect( -V, N );
-	vec3 prefilteredColor = textureLod( prefilteredEnvMap, R, roughness * MAX_REFLECTION_LOD ).rgb;
+	vec3 prefilteredColor = textureLod( prefilteredEnvMaps, vec4( R, float( ProbeIndex ) ), roughness * MAX_REFLECTION_LOD ).rgb;
 	vec2 envBRDF = texture( brdfLUT, vec2( NdotV, roughness ) ).rg;	
 	vec3 F_IBL = FresnelShlickIBL( NdotV, specular, roughness );
 	vec3 specularIBL = prefilteredColor * ( F_IBL * envBRDF.x + envBRDF.y );
 	vec3 ambientComponent = ( 1.0 - F_IBL ) * diffuse_IBL + specularIBL;
+#else
+	vec3 ambientComponent = vec3( 0.0 );
+#endif
 
 	ivec2 tiledCoord = ivec2( gl_FragCoord.xy ) / WORK_GROUP_SIZE;
 	int workGroupID = tiledCoord.x + tiledCoord.y * screenWidth / WORK_GROUP_SIZE;
@@ -277,11 +207,13 @@ void main() {
 		vec3 outgoingRadiance = ( diffuseComponent + specularComponent ) * radiance * NdotL;
 
 		//shadow
+#if SHADOWS
 		if ( currentLight.shadowIdx > -1 ){
 			float bias = max( 0.01 * ( 1.0 - NdotL ), 0.001 );
 			float shadow = ShadowCalculation( bias, currentLight );
 			outgoingRadiance *= shadow;
 		}
+#endif
 
 		totalRadiance += outgoingRadiance;
 	}
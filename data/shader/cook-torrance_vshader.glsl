@@ -1,4 +1,13 @@
-#version 330 core
+#version 430 core
+
+//set for every program when the driver has ARB_bindless_texture and ARB_shader_draw_parameters
+#ifndef BINDLESS_TEXTURES
+#define BINDLESS_TEXTURES 0
+#endif
+
+#if BINDLESS_TEXTURES
+#extension GL_ARB_shader_draw_parameters : require
+#endif
 
 layout ( location = 0 ) in vec3 aPos;
 layout ( location = 1 ) in vec3 aNormal;
@@ -6,18 +15,38 @@ layout ( location = 2 ) in vec3 aTangent;
 layout ( location = 3 ) in vec2 aUV;
 layout ( location = 4 ) in float aFSign;
 layout ( location = 5 ) in mat4 model;
+layout ( location = 9 ) in uint aProbeIndex;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout ( std140 ) uniform frame_block {
+	mat4 view;
+	mat4 projection;
+	vec3 camPos;
+	int screenWidth;
+};
 
 out vec3 FragPos;
 out vec2 TexCoord;
 out mat3 TBN;
+flat out uint ProbeIndex;
+
+#if BINDLESS_TEXTURES
+//material of every draw command of the frame, filled by MaterialTable
+layout ( std430 ) buffer draw_material_buffer {
+	uint draw_materials[];
+};
+uniform int firstDraw; //command of the first draw of the multi draw
+
+flat out uint MaterialId;
+#endif
 
 void main() {
 	//pass frag data
 	FragPos = ( model * vec4( aPos, 1.0 ) ).xyz;
 	TexCoord = aUV;
+	ProbeIndex = aProbeIndex;
+#if BINDLESS_TEXTURES
+	MaterialId = draw_materials[ firstDraw + gl_DrawIDARB ];
+#endif
 
 	//compute tangent space matrix
 	//mat3 model_noScale = mat3( transpose( inverse( model ) ) );
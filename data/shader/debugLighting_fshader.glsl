@@ -5,28 +5,8 @@ out vec4 FragColor;
 uniform sampler2D sampleTexture;
 uniform int mode;
 
-const int maxLightsPerTile = 32;
-struct LightIDs {
-	uint count;
-	int ids[maxLightsPerTile];
-};
-layout ( std430 ) buffer light_LUT {
-	LightIDs lightLists[];
-};
-
-struct Tri {
-	uint vIdxs[3];
-};
-
-struct LightEffect {
-	uint vCount;
-	uint tCount;
-	float vPos[ 8 * 3 ];
-	uint tris[ 12 * 3 ];
-};
-layout( std430 ) buffer lightEffect_buffer {
-	LightEffect lights[];
-};
+#include "include/light_lut.glsl"
+#include "include/light_volume.glsl"
 
 #define WORK_GROUP_SIZE 16
 uniform int screenWidth;
@@ -41,77 +21,6 @@ uniform int lightCount;
 in vec2 TexCoord;
 in mat3 TBN;
 
-vec3 Barycentric( vec2 P, vec2 A, vec2 B, vec2 C ) {
-	// precompute the affine transform from fragment coordinates to barycentric coordinates
-	float denom = 1.0 / ( ( A.x - C.x ) * ( B.y - A.y ) - ( A.x - B.x ) * ( C.y - A.y ) );
-	vec3 barycentric_d0 = denom * vec3( B.y - C.y, C.y - A.y, A.y - B.y );
-	vec3 barycentric_d1 = denom * vec3( C.x - B.x, A.x - C.x, B.x - A.x );
-	vec3 barycentric_0 = denom * vec3( B.x * C.y - C.x * B.y, C.x * A.y - A.x * C.y, A.x * B.y - B.x * A.y );
-
-	return P.x * barycentric_d0 + P.y * barycentric_d1 + barycentric_0;
-}
-
-bool PointInTriangle( vec2 P, vec2 A, vec2 B, vec2 C ) {
-	//Compute vectors
-	vec2 v0 = C - A;
-	vec2 v1 = B - A;
-	vec2 v2 = P - A;
-
-	//Compute dot products
-	float dot00 = dot( v0, v0 );
-	float dot01 = dot( v0, v1 );
-	float dot02 = dot( v0, v2 );
-	float dot11 = dot( v1, v1 );
-	float dot12 = dot( v1, v2 );
-
-	//Compute barycentric coordinates
-	float invDenom = 1.0 / ( dot00 * dot11 - dot01 * dot01 );
-	float u = ( dot11 * dot02 - dot01 * dot12 ) * invDenom;
-	float v = ( dot00 * dot12 - dot01 * dot02 ) * invDenom;
-
-	// Check if point is in triangle
-	return ( u >= 0.0 ) && ( v >= 0.0 ) && ( u + v < 1.0 );
-}
-
-float distanceToPlane( vec3 v, vec3 N, vec3 P ) {
-	return dot( N, v - P );
-}
-
-vec3 planeLineIntersection( vec3 v0, vec3 v1, vec3 N, vec3 P ) {
-	vec3 Pv0 = v0 - P;
-	vec3 v0v1 = v1 - v0;
-	return v0 - v0v1 * ( dot( Pv0, N ) / dot( v0v1, N ) );
-}
-
-float getFragDepth( vec3 barycentric, vec3 vDepths ) {
-	float ndc_depth = dot( barycentric, vDepths );
-	return ( ( ( gl_DepthRange.far - gl_DepthRange.near ) * ndc_depth ) + gl_DepthRange.near + gl_DepthRange.far ) / 2.0;
-}
-
-//test if point P is within volume
-bool WithinVolume( LightEffect volume, vec3 P ) {
-	for ( uint i = 0; i < volume.tCount; i++ ) {
-		Tri testTri;
-		testTri.vIdxs[0] = volume.tris[ i * 3 + 0];
-		testTri.vIdxs[1] = volume.tris[ i * 3 + 1];
-		testTri.vIdxs[2] = volume.tris[ i * 3 + 2];
-
-		vec3 p0_v3 = vec3( volume.vPos[ testTri.vIdxs[0] * 3 ], volume.vPos[ testTri.vIdxs[0] * 3 + 1 ], volume.vPos[ testTri.vIdxs[0] * 3 + 2 ] );
-		vec3 p1_v3 = vec3( volume.vPos[ testTri.vIdxs[1] * 3 ], volume.vPos[ testTri.vIdxs[1] * 3 + 1 ], volume.vPos[ testTri.vIdxs[1] * 3 + 2 ] );
-		vec3 p2_v3 = vec3( volume.vPos[ testTri.vIdxs[2] * 3 ], volume.vPos[ testTri.vIdxs[2] * 3 + 1 ], volume.vPos[ testTri.vIdxs[2] * 3 + 2 ] );
-
-		vec3 p0p1 = p1_v3 - p0_v3;
-		vec3 p0p2 = p2_v3 - p0_v3;
-
-		vec3 plane_normal = normalize( cross( p0p1, p0p2 ) );
-
-		if ( distanceToPlane( P, plane_normal, p2_v3 ) > 0.0 ) {
-			return false;
-		}
-	}
-	return true;
-}
-
 void main() {
 	if ( mode == 3 ) {
 		vec3 normal = texture( sampleTexture, TexCoord ).rgb;
@@ -1,19 +1,31 @@
-#version 330 core
-layout ( triangles ) in;
-layout ( triangle_strip, max_vertices=18 ) out;
+#version 410 core
+layout ( triangles, invocations = 6 ) in; //one invocation per cube face
+layout ( triangle_strip, max_vertices = 3 ) out;
 
 uniform mat4 lightSpaceMatrix[6];
 
-out vec4 FragPos; // FragPos from GS (output per emitvertex)
-
 void main() {
-	for ( int face = 0; face < 6; ++face ) {
-		gl_Layer = face; //built-in variable that specifies to which face we render.
-		for( int i = 0; i < 3; ++i ) { //for each triangle's vertices
-			FragPos = gl_in[i].gl_Position;
-			gl_Position = lightSpaceMatrix[face] * FragPos;
-			EmitVertex();
+	const int face = gl_InvocationID;
+
+	vec4 clipPos[3];
+	for ( int i = 0; i < 3; ++i ) {
+		clipPos[i] = lightSpaceMatrix[face] * gl_in[i].gl_Position;
+	}
+
+	//skip triangles that are entirely outside of one of this face's frustum planes
+	for ( int axis = 0; axis < 3; ++axis ) {
+		if ( clipPos[0][axis] > clipPos[0].w && clipPos[1][axis] > clipPos[1].w && clipPos[2][axis] > clipPos[2].w ) {
+			return;
 		}
-		EndPrimitive();
+		if ( clipPos[0][axis] < -clipPos[0].w && clipPos[1][axis] < -clipPos[1].w && clipPos[2][axis] < -clipPos[2].w ) {
+			return;
+		}
+	}
+
+	for ( int i = 0; i < 3; ++i ) {
+		gl_ViewportIndex = face; //built-in variable that selects the atlas partition of this face
+		gl_Position = clipPos[i];
+		EmitVertex();
 	}
+	EndPrimitive();
 }
\ No newline at end of file
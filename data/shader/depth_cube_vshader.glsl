@@ -1,8 +1,7 @@
-#version 330 core
+#version 410 core
 layout ( location = 0 ) in vec3 aPos;
-
-uniform mat4 model;
+layout ( location = 5 ) in mat4 model;
 
 void main() {
-	gl_Position = model * vec4( aPos, 1.0 );
+	gl_Position = model * vec4( aPos, 1.0 ); //world space. The geometry shader applies each face's light matrix
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+//cook-torrance BRDF terms
+
+const float PI = 3.14159265359;
+
+//Trowbridge-Reitz microfacet distribution function
+float NormalDistribution( float NdotH, float roughness ) {
+	float alpha = roughness * roughness;
+	float denom = NdotH * NdotH * ( alpha * alpha - 1.0 ) + 1.0;
+	return ( alpha * alpha ) / ( PI * denom * denom );
+}
+
+//Shlick approximation of the Fresnel equation
+vec3 FresnelShlickIBL( float cosTheta, vec3 F0, float roughness ) {
+	//Sébastien Lagarde describes a way to inject the roughness term into the Shlick approximation:
+	//	https://seblagarde.wordpress.com/2011/08/17/hello-world/
+	return F0 + ( max( vec3( 1.0 - roughness ), F0 ) - F0 ) * pow( 1.0 - cosTheta, 5.0 );
+}
+
+//Shlick approximation of the Fresnel equation
+vec3 FresnelShlick( float cosTheta, vec3 F0 ) {
+	return F0 + ( 1.0 - F0 ) * pow( 1.0 - cosTheta, 5.0 );
+}
+
+//Lazarov [2011] does a substitution that combines the denom of the BRDF and the Geometry masking term.
+float VisibilityTerm( float NdotV, float roughness ) {
+	//Schlick-Beckmann except with k = a / 2;
+	if ( NdotV > 0.0 ) {
+		float alpha2 = roughness * roughness * roughness * roughness;
+		float NdotV2 = NdotV * NdotV;
+		float denom = NdotV + ( sqrt( alpha2 + pow( 1.0 - alpha2, 2.0 ) * NdotV2 ) );
+		return NdotV2 / denom;
+	} else {
+		return 0.0;
+	}
+}
\ No newline at end of file
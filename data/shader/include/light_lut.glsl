@@ -0,0 +1,13 @@
+//per tile light lists written by the tilePrepass compute shader
+
+#ifndef MAX_LIGHTS_PER_TILE
+#define MAX_LIGHTS_PER_TILE 32 //set from LightBinning::s_maxLightsPerTile
+#endif
+
+struct LightIDs {
+	uint count;
+	int ids[MAX_LIGHTS_PER_TILE];
+};
+layout ( std430 ) buffer light_LUT {
+	LightIDs lightLists[];
+};
\ No newline at end of file
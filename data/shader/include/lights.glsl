@@ -0,0 +1,17 @@
+//scene lights, filled by Light::PassUniforms
+
+struct Light {
+	int typeIndex;
+	float pos_x, pos_y, pos_z;
+	float col_r, col_g, col_b;
+	float dir_x, dir_y, dir_z;
+	float angle; //splot light only
+	float radius;
+	float max_radius;
+	float dir_radius; //directional light only
+	float brightness;
+	int shadowIdx;
+};
+layout ( std430 ) buffer light_buffer {
+	Light light_data[];
+};
\ No newline at end of file
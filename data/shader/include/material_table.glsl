@@ -0,0 +1,17 @@
+//every material decl, filled by MaterialTable and indexed by the decl's id. Textures are bindless handles.
+
+struct Material {
+	uvec2 textures[4]; //albedo, specular, normal, gloss
+	vec4 emissiveColor; //rgb
+};
+layout ( std430 ) buffer material_buffer {
+	Material material_data[];
+};
+
+flat in uint MaterialId; //of the draw command, read by the vertex shader from draw_material_buffer
+
+#define albedoTexture sampler2D( material_data[ MaterialId ].textures[0] )
+#define specularTexture sampler2D( material_data[ MaterialId ].textures[1] )
+#define normalTexture sampler2D( material_data[ MaterialId ].textures[2] )
+#define glossTexture sampler2D( material_data[ MaterialId ].textures[3] )
+#define emissiveColor material_data[ MaterialId ].emissiveColor.rgb
\ No newline at end of file
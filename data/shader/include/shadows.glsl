@@ -0,0 +1,80 @@
+//shadow atlas lookups. FragPos has to be declared before this is included.
+
+#include "lights.glsl"
+
+uniform sampler2DShadow shadowAtlas;
+uniform int shadowMapPartitionSize;
+
+struct Shadow {
+	vec4 m_row1;
+	vec4 m_row2;
+	vec4 m_row3;
+	vec4 m_row4;
+	vec4 loc;
+};
+layout ( std430 ) buffer shadow_buffer {
+	Shadow shadow_data[];
+};
+
+//returns the index of the axis most aligned with dir arg
+int GetFaceIdx( vec3 dir ) {
+	int returnIdx = 0;
+	float largesttDot = -1.0;
+
+	float dots[6];
+	dots[0] = dot( dir, vec3( 1.0, 0.0, 0.0 ) );
+	dots[1] = dot( dir, vec3( 0.0, 0.0, 1.0 ) );
+	dots[2] = dot( dir, vec3( -1.0, 0.0, 0.0 ) );
+	dots[3] = dot( dir, vec3( 0.0, 0.0, -1.0 ) );
+	dots[4] = dot( dir, vec3( 0.0, 1.0, 0.0 ) );
+	dots[5] = dot( dir, vec3( 0.0, -1.0, 0.0 ) );
+
+	for ( int i = 0; i < 6; i++ ) {
+		float testDot = dots[i];
+		if ( testDot > largesttDot ) {
+			largesttDot = testDot;
+			returnIdx = i;
+		}
+	}
+
+	return returnIdx;
+}
+
+float ShadowCalculation( float bias, Light light ) {
+	vec2 atlasSize = vec2( textureSize( shadowAtlas, 0 ) );
+	int shadowIdx = light.shadowIdx;
+
+	int faceIdx = 0;
+	if ( light.typeIndex == 3 ) {
+		vec3 lightPos = vec3( light.pos_x, light.pos_y, light.pos_z );
+		faceIdx = GetFaceIdx( normalize( FragPos - lightPos ) ); //get which face to sample shadows from
+	}
+
+	mat4 shadowMatrix;
+	shadowMatrix[0] = shadow_data[shadowIdx + faceIdx].m_row1;
+	shadowMatrix[1] = shadow_data[shadowIdx + faceIdx].m_row2;
+	shadowMatrix[2] = shadow_data[shadowIdx + faceIdx].m_row3;
+	shadowMatrix[3] = shadow_data[shadowIdx + faceIdx].m_row4;
+
+	vec4 FragPosLightSpace = shadowMatrix * vec4( FragPos, 1.0 );
+	vec3 projCoords = FragPosLightSpace.xyz / FragPosLightSpace.w; //perform perspective divide
+	projCoords = projCoords * 0.5 + 0.5; //transform to [0,1] range	
+	float tileSize_normalized = float( shadowMapPartitionSize ) / atlasSize.x;
+	projCoords.x = projCoords.x * tileSize_normalized + shadow_data[shadowIdx + faceIdx].loc.x;
+	projCoords.y = projCoords.y * tileSize_normalized + shadow_data[shadowIdx + faceIdx].loc.y;
+
+	vec3 samplePos;
+	int sampleCount = 0;
+	vec2 texelSize = 1.0 / atlasSize;
+	float cumulativeShadow = 0.0;
+	for ( int x = -4; x <= 4; x++ ) {
+		for ( int y = -4; y <= 4; y++ ) {
+			samplePos = vec3( projCoords.xy + ( vec2( x, y ) * texelSize ), projCoords.z - bias );
+			cumulativeShadow += texture( shadowAtlas, samplePos, 0 );
+			sampleCount += 1;
+		}
+	}
+	cumulativeShadow /= float( sampleCount );
+
+	return cumulativeShadow;
+}
\ No newline at end of file
@@ -30,7 +30,7 @@ void main() {
 			// tangent space to world
 			vec3 sampleVec = tangentSample.x * right + tangentSample.y * up + tangentSample.z * N; 
 
-			irradiance += texture(environmentMap, sampleVec).rgb * cos(theta) * sin(theta);
+			irradiance += textureLod(environmentMap, sampleVec, 0.0).rgb * cos(theta) * sin(theta);
 			nrSamples++;
 		}
 	}